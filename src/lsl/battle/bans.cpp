@@ -0,0 +1,275 @@
+#include "bans.h"
+
+#include <lslutils/conversion.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace LSL {
+namespace Battle {
+
+using Util::Net::Address;
+
+const std::time_t BanList::PERMANENT;
+const boost::uint32_t BanList::NO_NODE;
+
+namespace {
+
+std::string FormatRule( const std::string& kind, const std::string& value, std::time_t expires )
+{
+	std::string result = kind + " " + value;
+	if ( expires != BanList::PERMANENT )
+		result += " " + Util::ToString( boost::int64_t( expires ) );
+	return result;
+}
+
+} // namespace
+
+size_t BanList::ExpireNames( NameMap& names, std::time_t now )
+{
+	size_t dropped = 0;
+	for ( NameMap::iterator it = names.begin(); it != names.end(); ) {
+		if ( InForce( it->second, now ) )
+			++it;
+		else {
+			it = names.erase( it );
+			++dropped;
+		}
+	}
+	return dropped;
+}
+
+BanList::BanList()
+	: m_networks( 0 )
+{
+	Clear();
+}
+
+void BanList::BanNick( const std::string& nick, std::time_t expires )
+{
+	m_nicks[nick] = expires;
+}
+
+void BanList::BanAccount( const std::string& account, std::time_t expires )
+{
+	m_accounts[account] = expires;
+}
+
+bool BanList::BanNetwork( const std::string& network, std::time_t expires )
+{
+	Address key;
+	unsigned int length;
+	if ( !Util::Net::ParseNetwork( network, key, length ) )
+		return false;
+	Insert( key, length, expires );
+	return true;
+}
+
+bool BanList::Unban( const std::string& entry )
+{
+	bool found = m_nicks.erase( entry ) > 0;
+	found = m_accounts.erase( entry ) > 0 || found;
+	Address key;
+	unsigned int length;
+	if ( Util::Net::ParseNetwork( entry, key, length ) ) {
+		const boost::uint32_t node = FindNode( key, length );
+		if ( node != NO_NODE && m_nodes[node].rule ) {
+			// the node stays, Expire drops it with the next rebuild
+			m_nodes[node].rule = false;
+			--m_networks;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void BanList::Clear()
+{
+	m_nicks.clear();
+	m_accounts.clear();
+	m_nodes.clear();
+	NewNode( Address(), 0 );
+	m_networks = 0;
+}
+
+bool BanList::IsBanned( const std::string& nick, const std::string& account, const std::string& ip, std::time_t now ) const
+{
+	NameMap::const_iterator it = m_nicks.find( nick );
+	if ( it != m_nicks.end() && InForce( it->second, now ) )
+		return true;
+	it = m_accounts.find( account );
+	if ( it != m_accounts.end() && InForce( it->second, now ) )
+		return true;
+	Address address;
+	return m_networks > 0 && Util::Net::ParseAddress( ip, address ) && IsAddressBanned( address, now );
+}
+
+bool BanList::IsAddressBanned( const Address& address, std::time_t now ) const
+{
+	boost::uint32_t index = 0;
+	while ( index != NO_NODE ) {
+		const Node& node = m_nodes[index];
+		if ( node.length > 0 && address.CommonBits( node.key ) < node.length )
+			return false;
+		if ( node.rule && InForce( node.expires, now ) )
+			return true;
+		if ( node.length == 128 )
+			return false;
+		index = node.child[address.Bit( node.length )];
+	}
+	return false;
+}
+
+size_t BanList::Load( std::istream& in, size_t* errors )
+{
+	size_t count = 0, bad = 0;
+	std::string line, kind, value;
+	std::istringstream fields;
+	while ( std::getline( in, line ) ) {
+		if ( line.empty() || line[0] == '#' || line.find_first_not_of( " \t\r" ) == std::string::npos )
+			continue;
+		fields.clear();
+		fields.str( line );
+		boost::int64_t expires = PERMANENT;
+		fields >> kind >> value;
+		if ( !fields || ( !( fields >> expires ) && !fields.eof() ) ) {
+			++bad;
+			continue;
+		}
+		if ( kind == "nick" )
+			BanNick( value, std::time_t( expires ) );
+		else if ( kind == "account" )
+			BanAccount( value, std::time_t( expires ) );
+		else if ( kind != "ip" || !BanNetwork( value, std::time_t( expires ) ) ) {
+			++bad;
+			continue;
+		}
+		++count;
+	}
+	if ( errors )
+		*errors = bad;
+	return count;
+}
+
+size_t BanList::LoadFile( const std::string& path, size_t* errors )
+{
+	std::ifstream file( path.c_str() );
+	if ( !file.is_open() ) {
+		if ( errors )
+			*errors = 0;
+		return 0;
+	}
+	return Load( file, errors );
+}
+
+size_t BanList::Expire( std::time_t now )
+{
+	size_t dropped = ExpireNames( m_nicks, now ) + ExpireNames( m_accounts, now );
+
+	bool expired = false;
+	for ( size_t i = 0; i < m_nodes.size() && !expired; ++i )
+		expired = m_nodes[i].rule && !InForce( m_nodes[i].expires, now );
+	if ( !expired )
+		return dropped;
+
+	// rebuild the trie from what is left, that also gets rid of unbanned nodes
+	std::vector<Node> old;
+	old.swap( m_nodes );
+	NewNode( Address(), 0 );
+	m_networks = 0;
+	for ( size_t i = 0; i < old.size(); ++i ) {
+		if ( !old[i].rule )
+			continue;
+		if ( InForce( old[i].expires, now ) )
+			Insert( old[i].key, old[i].length, old[i].expires );
+		else
+			++dropped;
+	}
+	return dropped;
+}
+
+StringVector BanList::List() const
+{
+	StringVector result;
+	result.reserve( size() );
+	for ( NameMap::const_iterator it = m_nicks.begin(); it != m_nicks.end(); ++it )
+		result.push_back( FormatRule( "nick", it->first, it->second ) );
+	for ( NameMap::const_iterator it = m_accounts.begin(); it != m_accounts.end(); ++it )
+		result.push_back( FormatRule( "account", it->first, it->second ) );
+	for ( size_t i = 0; i < m_nodes.size(); ++i )
+		if ( m_nodes[i].rule )
+			result.push_back( FormatRule( "ip", Util::Net::FormatNetwork( m_nodes[i].key, m_nodes[i].length ),
+										  m_nodes[i].expires ) );
+	return result;
+}
+
+void BanList::Insert( const Address& network, unsigned int length, std::time_t expires )
+{
+	const Address key = network.Prefix( length );
+	boost::uint32_t index = 0;
+	// invariant: the node at index is a prefix of key no longer than length
+	while ( m_nodes[index].length < length ) {
+		const int bit = key.Bit( m_nodes[index].length );
+		const boost::uint32_t child = m_nodes[index].child[bit];
+		if ( child == NO_NODE ) {
+			const boost::uint32_t leaf = NewNode( key, length );
+			m_nodes[index].child[bit] = leaf;
+			index = leaf;
+			break;
+		}
+		const unsigned int child_length = m_nodes[child].length;
+		const unsigned int common = std::min( std::min( key.CommonBits( m_nodes[child].key ), child_length ), length );
+		if ( common == child_length ) {
+			index = child;
+			continue;
+		}
+		// the child branches off below common, put a node there
+		const boost::uint32_t split = NewNode( key.Prefix( common ), common );
+		m_nodes[split].child[m_nodes[child].key.Bit( common )] = child;
+		m_nodes[index].child[bit] = split;
+		index = split;
+		if ( common < length ) {
+			const boost::uint32_t leaf = NewNode( key, length );
+			m_nodes[split].child[key.Bit( common )] = leaf;
+			index = leaf;
+		}
+		break;
+	}
+	Node& node = m_nodes[index];
+	if ( !node.rule )
+		++m_networks;
+	// like for nicks, banning again replaces the expiry
+	node.rule = true;
+	node.expires = expires;
+}
+
+boost::uint32_t BanList::FindNode( const Address& network, unsigned int length ) const
+{
+	const Address key = network.Prefix( length );
+	boost::uint32_t index = 0;
+	while ( index != NO_NODE ) {
+		const Node& node = m_nodes[index];
+		if ( node.length > length || key.CommonBits( node.key ) < node.length )
+			return NO_NODE;
+		if ( node.length == length )
+			return index;
+		index = node.child[key.Bit( node.length )];
+	}
+	return NO_NODE;
+}
+
+boost::uint32_t BanList::NewNode( const Address& key, unsigned int length )
+{
+	Node node;
+	node.key = key;
+	node.length = length;
+	node.child[0] = node.child[1] = NO_NODE;
+	node.rule = false;
+	node.expires = PERMANENT;
+	m_nodes.push_back( node );
+	return boost::uint32_t( m_nodes.size() - 1 );
+}
+
+} // namespace Battle
+} // namespace LSL
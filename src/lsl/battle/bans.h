@@ -0,0 +1,113 @@
+#ifndef LSL_HEADERGUARD_BATTLE_BANS_H
+#define LSL_HEADERGUARD_BATTLE_BANS_H
+
+#include <lslutils/type_forwards.h>
+#include <lslutils/net.h>
+
+#include <ctime>
+#include <istream>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief nick, account and address bans of a hosted battle
+ * Nicks and account ids are hashed, addresses go into a binary radix trie over the
+ * 128 bit ( IPv4-mapped ) address space, so a whole IPv4 or IPv6 network is one rule
+ * and a lookup costs at most one node per prefix bit. Every rule can expire.
+ **/
+class BanList
+{
+public:
+	//! expiry of a rule that never expires
+	static const std::time_t PERMANENT = 0;
+
+	BanList();
+
+	void BanNick( const std::string& nick, std::time_t expires = PERMANENT );
+	void BanAccount( const std::string& account, std::time_t expires = PERMANENT );
+	//! \return false if \param network is neither an address nor "address/prefix"
+	bool BanNetwork( const std::string& network, std::time_t expires = PERMANENT );
+	//! lifts every rule written as \param entry, be it a nick, account or network
+	bool Unban( const std::string& entry );
+	void Clear();
+
+	//! \return true if any rule that is still in force at \param now matches
+	bool IsBanned( const std::string& nick, const std::string& account, const std::string& ip, std::time_t now ) const;
+	bool IsAddressBanned( const Util::Net::Address& address, std::time_t now ) const;
+
+	/** reads rules, one per line as "nick|account|ip <value> [expiry]" with expiry in
+	 * seconds since the epoch. Empty lines and lines starting with '#' are skipped.
+	 * \return number of rules read, lines that don't parse are counted in \param errors */
+	size_t Load( std::istream& in, size_t* errors = NULL );
+	size_t LoadFile( const std::string& path, size_t* errors = NULL );
+	//! drops every rule that expired at \param now and rebuilds the trie if any did
+	size_t Expire( std::time_t now );
+
+	//! every rule, in the format Load reads
+	StringVector List() const;
+	size_t size() const { return m_nicks.size() + m_accounts.size() + m_networks; }
+	bool empty() const { return size() == 0; }
+
+private:
+	typedef boost::unordered_map<std::string, std::time_t> NameMap;
+
+	static const boost::uint32_t NO_NODE = boost::uint32_t( -1 );
+
+	struct Node
+	{
+		Util::Net::Address key;
+		boost::uint32_t length;
+		boost::uint32_t child[2];
+		bool rule;
+		std::time_t expires;
+	};
+
+	static bool InForce( std::time_t expires, std::time_t now ) { return expires == PERMANENT || expires > now; }
+	static size_t ExpireNames( NameMap& names, std::time_t now );
+	void Insert( const Util::Net::Address& key, unsigned int length, std::time_t expires );
+	//! index of the node holding exactly \param key / \param length, or NO_NODE
+	boost::uint32_t FindNode( const Util::Net::Address& key, unsigned int length ) const;
+	boost::uint32_t NewNode( const Util::Net::Address& key, unsigned int length );
+
+	NameMap m_nicks;
+	NameMap m_accounts;
+	//! m_nodes[0] is the root, the /0 network
+	std::vector<Node> m_nodes;
+	size_t m_networks;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_BANS_H
+
+/**
+ * \file bans.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -7,10 +7,13 @@
 #include "battle.h"
 #include "signals.h"
 
+#include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <lsl/networking/iserver.h>
 #include <lsl/user/user.h>
 #include <lslutils/misc.h>
+#include <lslutils/color.h>
+#include <lslutils/balance.h>
 #include <lslutils/debug.h>
 #include <lslutils/logging.h>
 #include <lslutils/conversion.h>
@@ -37,7 +40,8 @@ Battle::Battle(IServerPtr serv, int id ) :
     m_serv(serv),
     m_autolock_on_start(false),
     m_auto_unspec(false),
-    m_id( id )
+    m_id( id ),
+    m_autospec_due( boost::posix_time::not_a_date_time )
 
 {
     m_opts.battleid =  m_id;
@@ -49,7 +53,7 @@ Battle::~Battle()
 
 void Battle::SendHostInfo( Enum::HostInfo update )
 {
-    m_serv->SendHostInfo( update );
+    m_serv->SendHostInfo( shared_from_this(), update );
 }
 
 void Battle::SendHostInfo( const std::string& Tag )
@@ -75,7 +79,7 @@ void Battle::Leave()
 
 void Battle::OnRequestBattleStatus()
 {
-    UserBattleStatus& bs = m_serv->GetMe()->BattleStatus();
+    UserBattleStatus bs = GetMe()->BattleStatus();
     bs.team = GetFreeTeam( true );
     bs.ally = GetFreeAlly( true );
     bs.spectator = false;
@@ -84,23 +88,28 @@ void Battle::OnRequestBattleStatus()
     // theres some highly annoying bug with color changes on player join/leave.
 	if ( !bs.color.IsOk() )
 		bs.color = Util::GetFreeColor( GetMe() );
-    SendMyBattleStatus();
+    SendMyBattleStatus( bs );
 }
 
 void Battle::SendMyBattleStatus()
 {
-    UserBattleStatus& bs = m_serv->GetMe()->BattleStatus();
+    SendMyBattleStatus( GetMe()->BattleStatus() );
+}
+
+void Battle::SendMyBattleStatus( UserBattleStatus bs )
+{
     if ( IsSynced() ) bs.sync = SYNC_SYNCED;
     else bs.sync = SYNC_UNSYNCED;
+    // the server echoes this back as CLIENTBATTLESTATUS, which recounts me from my current status
+    SetUserBattleStatus( GetMe(), bs );
     m_serv->SendMyBattleStatus( bs );
 }
 
 void Battle::SetImReady( bool ready )
 {
-    UserBattleStatus& bs = m_serv->GetMe()->BattleStatus();
+    UserBattleStatus bs = GetMe()->BattleStatus();
     bs.ready = ready;
-    //m_serv->GetMe()->SetBattleStatus( bs );
-    SendMyBattleStatus();
+    SendMyBattleStatus( bs );
 }
 
 /*bool Battle::HasMod()
@@ -184,10 +193,7 @@ void Battle::OnUserAdded( const CommonUserPtr user )
         return;
     m_userlist.Add( user );
     IBattle::OnUserAdded( user );
-	if ( user == GetMe() )
-    {
-        m_timer->async_wait( boost::bind( &Battle::OnTimer, this, _1 ) );
-    }
+    ArmAutoSpecTimer();
     user->SetBattle( shared_from_this() );
 	user->BattleStatus().isfromdemo = false;
 
@@ -252,6 +258,7 @@ void Battle::OnUserBattleStatusUpdated( const CommonUserPtr user, UserBattleStat
         }
     }
     IBattle::OnUserBattleStatusUpdated( user, status );
+    ArmAutoSpecTimer();
     if ( status.handicap != 0 )
     {
 //        UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
@@ -275,14 +282,14 @@ void Battle::OnUserRemoved( CommonUserPtr user )
 {
 //    m_ah.OnUserRemoved(user);
     IBattle::OnUserRemoved( user );
+    ArmAutoSpecTimer();
     ShouldAutoUnspec();
 }
 
 void Battle::RingNotReadyPlayers()
 {
-	for (size_t i = 0; i < m_userlist.size(); i++)
+	for ( const CommonUserPtr& u: m_userlist.Items() )
     {
-        const ConstCommonUserPtr u = m_userlist.At(i);
 		const UserBattleStatus& bs = u->BattleStatus();
 		if ( bs.IsBot() ) continue;
         if ( !bs.ready && !bs.spectator ) m_serv->Ring( u );
@@ -291,9 +298,8 @@ void Battle::RingNotReadyPlayers()
 
 void Battle::RingNotSyncedPlayers()
 {
-	for (size_t i = 0; i < m_userlist.size(); i++)
+	for ( const CommonUserPtr& u: m_userlist.Items() )
     {
-        const ConstCommonUserPtr u = m_userlist.At(i);
 		const UserBattleStatus& bs = u->BattleStatus();
         if ( bs.IsBot() ) continue;
         if ( !bs.sync && !bs.spectator ) m_serv->Ring( u );
@@ -302,9 +308,8 @@ void Battle::RingNotSyncedPlayers()
 
 void Battle::RingNotSyncedAndNotReadyPlayers()
 {
-	for (size_t i = 0; i < m_userlist.size(); i++)
+	for ( const CommonUserPtr& u: m_userlist.Items() )
     {
-        const ConstCommonUserPtr u = m_userlist.At(i);
 		const UserBattleStatus& bs = u->BattleStatus();
         if ( bs.IsBot() ) continue;
         if ( ( !bs.sync || !bs.ready ) && !bs.spectator ) m_serv->Ring( u );
@@ -338,7 +343,7 @@ bool Battle::ExecuteSayCommand( const std::string& cmd )
 		if ( cmd_name == "/ban" )
         {
             std::string nick = Util::AfterFirst(cmd," ");
-            m_banned_users.insert(nick);
+            m_bans.BanNick(nick);
             try
             {
                 const CommonUserPtr user = GetUser( nick );
@@ -356,7 +361,7 @@ bool Battle::ExecuteSayCommand( const std::string& cmd )
 		if ( cmd_name == "/unban" )
         {
             std::string nick = Util::AfterFirst(cmd," ");
-            m_banned_users.erase(nick);
+            m_bans.Unban(nick);
 //            UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
 //						UiEvents::OnBattleActionData( std::string(" ") , nick+" unbanned" )
 //                        );
@@ -369,26 +374,19 @@ bool Battle::ExecuteSayCommand( const std::string& cmd )
 //						UiEvents::OnBattleActionData( std::string(" ") , "banlist:" )
 //                        );
 
-            for (std::set<std::string>::const_iterator i=m_banned_users.begin();i!=m_banned_users.end();++i)
+            const StringVector bans = m_bans.List();
+            for (StringVector::const_iterator i=bans.begin();i!=bans.end();++i)
             {
 //                UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
 //							UiEvents::OnBattleActionData( std::string(" ") , *i )
 //                            );
-            }
-            for (std::set<std::string>::iterator i=m_banned_ips.begin();i!=m_banned_ips.end();++i)
-            {
-//                UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
-//							UiEvents::OnBattleActionData( std::string(" ") , *i )
-//                            );
-
             }
             return true;
         }
 		if ( cmd_name == "/unban" )
         {
             std::string nick = Util::AfterFirst(cmd," ");
-            m_banned_users.erase(nick);
-            m_banned_ips.erase(nick);
+            m_bans.Unban(nick);
 //            UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
 //						UiEvents::OnBattleActionData( std::string(" ") , nick+" unbanned" )
 //                        );
@@ -399,7 +397,10 @@ bool Battle::ExecuteSayCommand( const std::string& cmd )
 		if ( cmd_name == "/ipban" )
         {
             std::string nick = Util::AfterFirst(cmd," ");
-            m_banned_users.insert(nick);
+            // an address or network bans that range, anything else is a nick
+            if ( m_bans.BanNetwork(nick) )
+                return true;
+            m_bans.BanNick(nick);
 //            UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
 //						UiEvents::OnBattleActionData( std::string(" ") , nick+" banned" )
 //                        );
@@ -410,14 +411,13 @@ bool Battle::ExecuteSayCommand( const std::string& cmd )
                 const CommonUserPtr user=GetUser(nick);
 				if (!user->BattleStatus().ip.empty())
                 {
-					m_banned_ips.insert(user->BattleStatus().ip);
+					m_bans.BanNetwork(user->BattleStatus().ip);
 //                    UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
 //								UiEvents::OnBattleActionData( std::string(" ") , user->BattleStatus().ip+" banned" )
 //                                );
                 }
                 m_serv->BattleKickPlayer( shared_from_this(), user );
             }
-            //m_banned_ips.erase(nick);
 
             //m_serv->DoActionBattle( m_opts.battleid, cmd.AfterFirst(' ') );
             return true;
@@ -433,7 +433,7 @@ bool Battle::IsBanned( const CommonUserPtr user )
 {
     if (IsFounderMe())
     {
-        if (m_banned_users.count(user->Nick())>0 )
+        if (m_bans.IsBanned(user->Nick(), user->Id(), user->BattleStatus().ip, std::time(NULL)))
 //				|| useractions().DoActionOnUser(UserActions::ActAutokick, user->Nick() ) )
         {
             KickPlayer(user);
@@ -441,14 +441,6 @@ bool Battle::IsBanned( const CommonUserPtr user )
 //						UiEvents::OnBattleActionData( std::string(" ") , user->Nick()+" is banned, kicking" )
 //                        );
             return true;
-        }
-		else if (m_banned_ips.count(user->BattleStatus().ip)>0)
-        {
-//            UiEvents::GetUiEventSender( UiEvents::OnBattleActionEvent ).SendEvent(
-//						UiEvents::OnBattleActionData( std::string(" ") , user->BattleStatus().ip+" is banned, kicking" )
-//                        );
-            KickPlayer(user);
-            return true;
         }
     }
     return false;
@@ -523,10 +515,8 @@ void Battle::SetHandicap( CommonUserPtr user, int handicap)
 
 void Battle::ForceUnsyncedToSpectate()
 {
-    const size_t numusers = m_userlist.size();
-    for ( size_t i = 0; i < numusers; ++i )
+    for ( const CommonUserPtr& user: m_userlist.Items() )
     {
-        const CommonUserPtr user = m_userlist.At(i);
 		UserBattleStatus& bs = user->BattleStatus();
         if ( bs.IsBot() ) continue;
         if ( !bs.spectator && !bs.sync ) ForceSpectator( user, true );
@@ -535,10 +525,8 @@ void Battle::ForceUnsyncedToSpectate()
 
 void Battle::ForceUnReadyToSpectate()
 {
-    const size_t numusers = m_userlist.size();
-    for ( size_t i = 0; i < numusers; ++i )
+    for ( const CommonUserPtr& user: m_userlist.Items() )
     {
-        const CommonUserPtr user = m_userlist.At(i);
 		UserBattleStatus& bs = user->BattleStatus();
         if ( bs.IsBot() ) continue;
         if ( !bs.spectator && !bs.ready ) ForceSpectator( user, true );
@@ -547,10 +535,8 @@ void Battle::ForceUnReadyToSpectate()
 
 void Battle::ForceUnsyncedAndUnreadyToSpectate()
 {
-    const size_t numusers = m_userlist.size();
-    for ( size_t i = 0; i < numusers; ++i )
+    for ( const CommonUserPtr& user: m_userlist.Items() )
     {
-        const CommonUserPtr user = m_userlist.At(i);
 		UserBattleStatus& bs = user->BattleStatus();
         if ( bs.IsBot() ) continue;
         if ( !bs.spectator && ( !bs.sync || !bs.ready ) ) ForceSpectator( user, true );
@@ -624,7 +610,9 @@ void Battle::StartSpring()
     const CommonUserPtr me = GetMe();
     if ( me && !me->Status().in_game )
     {
-        me->BattleStatus().ready = false;
+        UserBattleStatus status = me->BattleStatus();
+        status.ready = false;
+        SetUserBattleStatus( me, status );
         SendMyBattleStatus();
         // set m_generating_script, this will make the script.txt writer realize we're just clients even if using a relayhost
         m_generating_script = true;
@@ -638,160 +626,166 @@ void Battle::StartSpring()
 void Battle::OnTimer( const boost::system::error_code& error  )
 {
     if (error)
-        return;
+        return; // cancelled or moved by ArmAutoSpecTimer
+    m_autospec_due = boost::posix_time::not_a_date_time;
     if ( !IsFounderMe() ) return;
     if ( InGame() ) return;
     int autospect_trigger_time = sett().GetBattleLastAutoSpectTime();
     if ( autospect_trigger_time == 0 ) return;
-    time_t now = time(0);
-    for ( unsigned int i = 0; i < m_userlist.size(); ++i )
-    {
-        const CommonUserPtr usr = m_userlist[i];
-        UserBattleStatus& status = usr->BattleStatus();
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    std::vector<std::string> due;
+    m_ready_up.PopDue( now - boost::posix_time::seconds( autospect_trigger_time ), due );
+    const ConstCommonUserPtr me = GetMe();
+    for ( const std::string& key: due )
+    {
+        const CommonUserPtr usr = m_userlist.Find( key );
+        if ( !usr ) continue; // left in the meantime
+        const UserBattleStatus& status = usr->BattleStatus();
         if ( status.IsBot() || status.spectator ) continue;
         if ( status.sync && status.ready ) continue;
-        if ( usr == GetMe() ) continue;
-        std::map<std::string, time_t>::const_iterator itor = m_ready_up_map.find( usr->Nick() );
-        if ( itor != m_ready_up_map.end() )
-        {
-            if ( ( now - itor->second ) > autospect_trigger_time )
-            {
-                ForceSpectator( usr, true );
-            }
-        }
+        if ( usr == me ) continue;
+        // retried after another trigger period unless the spectator status comes back and cancels it
+        m_ready_up.Schedule( key, now );
+        ForceSpectator( usr, true );
     }
+    ArmAutoSpecTimer();
+}
+
+void Battle::OnSelfLeftBattle()
+{
+    IBattle::OnSelfLeftBattle(); // stops m_timer
+    m_autospec_due = boost::posix_time::not_a_date_time;
+}
+
+void Battle::ArmAutoSpecTimer()
+{
+    boost::posix_time::ptime due( boost::posix_time::not_a_date_time );
+    const int autospect_trigger_time = sett().GetBattleLastAutoSpectTime();
+    if ( IsFounderMe() && !InGame() && autospect_trigger_time != 0 && !m_ready_up.empty() )
+        due = m_ready_up.Next() + boost::posix_time::seconds( autospect_trigger_time );
+    if ( due == m_autospec_due )
+        return;
+    m_autospec_due = due;
+    if ( due.is_not_a_date_time() )
+    {
+        m_timer->cancel();
+        return;
+    }
+    m_timer->expires_at( due ); // cancels the previous wait
+    m_timer->async_wait( boost::bind( &Battle::OnTimer, this, _1 ) );
 }
 
 void Battle::SetInGame( bool value )
 {
-    time_t now = time(0);
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
     if ( InGame() && !value )
     {
-        for ( int i = 0; i < long(m_userlist.size()); ++i )
+        for ( const CommonUserPtr& user: m_userlist.Items() )
         {
-            const CommonUserPtr user = m_userlist[i];
 			UserBattleStatus& status = user->BattleStatus();
             if ( status.IsBot() || status.spectator ) continue;
             if ( status.ready && status.sync ) continue;
-			m_ready_up_map[user->Nick()] = now;
+			m_ready_up.Schedule( user->key(), now );
         }
     }
     IBattle::SetInGame( value );
+    ArmAutoSpecTimer();
 }
 
 void Battle::FixColors()
 {
     if ( !IsFounderMe() )return;
-    std::vector<lslColor> &palette = GetFixColorsPalette( m_teams_sizes.size() + 1 );
-    std::vector<int> palette_use( palette.size(), 0 );
+    const ConstCommonUserPtr me = GetMe();
+    const lslColor my_col = me->BattleStatus().color; // Never changes color of founder (me) :-)
+    const int my_team = me->BattleStatus().spectator ? -1 : me->BattleStatus().team;
 
-	lslColor my_col = GetMe()->BattleStatus().color; // Never changes color of founder (me) :-)
-    int my_diff = 0;
-    int my_col_i = GetClosestFixColor( my_col, palette_use,my_diff );
-    palette_use[my_col_i]++;
-    std::set<int> parsed_teams;
+    // one slot per team, colored like its first member
+    std::vector<int> slot_team;
+    std::vector<lslColor> current;
+    for ( MemberIndex::const_iterator team = m_team_members.begin(); team != m_team_members.end(); ++team )
+    {
+        if ( team->first == my_team ) continue;
+        slot_team.push_back( team->first );
+        current.push_back( team->second.front()->BattleStatus().color );
+    }
+    const std::vector<lslColor> fixed = Util::AssignTeamColors( my_col, current );
 
-    for ( size_t i = 0; i < m_userlist.size(); i++ )
+    // only send the colors that actually change
+    for ( const CommonUserPtr& user: GetTeamMembers( my_team ) )
+    {
+        if ( user != me && user->BattleStatus().color != my_col )
+            ForceColor( user, my_col );
+    }
+    for ( size_t slot = 0; slot < slot_team.size(); ++slot )
     {
-        const CommonUserPtr user = m_userlist.At(i);
-        if ( user == GetMe() ) continue; // skip founder ( yourself )
-		UserBattleStatus& status = user->BattleStatus();
-        if ( status.spectator ) continue;
-        if ( parsed_teams.find( status.team ) != parsed_teams.end() ) continue; // skip duplicates
-        parsed_teams.insert( status.team );
-
-        lslColor &user_col=status.color;
-        int user_col_i=GetClosestFixColor(user_col,palette_use, 60);
-        palette_use[user_col_i]++;
-        for ( size_t j = 0; j < m_userlist.size(); ++j )
+        for ( const CommonUserPtr& user: GetTeamMembers( slot_team[slot] ) )
         {
-            const CommonUserPtr other_user = m_userlist.At(j);
-            if ( other_user->BattleStatus().team == status.team )
-            {
-                ForceColor( other_user, palette[user_col_i]);
-            }
+            if ( user->BattleStatus().color != fixed[slot] )
+                ForceColor( user, fixed[slot] );
         }
     }
 }
 
-bool PlayerRankCompareFunction( const ConstCommonUserPtr a, const ConstCommonUserPtr b ) // should never operate on nulls. Hence, ASSERT_LOGIC is appropriate here.
+int my_random( int range )
 {
-	ASSERT_LOGIC( a, "fail in Autobalance, NULL player" );
-	ASSERT_LOGIC( b, "fail in Autobalance, NULL player" );
-    return ( a->GetBalanceRank() > b->GetBalanceRank() );
+    return rand() % range;
 }
 
-bool PlayerTeamCompareFunction( const ConstCommonUserPtr a, const ConstCommonUserPtr b ) // should never operate on nulls. Hence, ASSERT_LOGIC is appropriate here.
+void shuffle( CommonUserVector& players) // proper shuffle.
 {
-	ASSERT_LOGIC( a, "fail in Autobalance, NULL player" );
-	ASSERT_LOGIC( b, "fail in Autobalance, NULL player" );
-    return ( a->BattleStatus().team > b->BattleStatus().team );
+    for ( size_t i=0; i < players.size(); ++i ) // the players below i are shuffled, the players above arent
+    {
+        int rn = i + my_random( players.size() - i ); // the top of shuffled part becomes random card from unshuffled part
+        CommonUserPtr tmp = players[i];
+        players[i] = players[rn];
+        players[rn] = tmp;
+    }
 }
 
-struct Alliance
+/** one balance group per player: members of a clan that stays together share one,
+ * everybody else gets their own. A clan is ignored if it is too small (only 1 clan
+ * member in battle) or, without strong clans, bigger than an even share of \param bins */
+std::vector<size_t> GroupClans( const CommonUserVector& players, bool support_clans, bool strong_clans, size_t bins )
 {
-    CommonUserVector players;
-    float ranksum;
-    int allynum;
-    Alliance(): ranksum(0), allynum(-1) {}
-    Alliance(int i): ranksum(0), allynum(i) {}
-    void AddPlayer( const CommonUserPtr player )
+    std::map<std::string, size_t> clan_sizes;
+    if ( support_clans )
     {
-        if ( player )
+        for ( size_t i = 0; i < players.size(); ++i )
         {
-            players.push_back( player );
-            ranksum += player->GetBalanceRank();
+            const std::string clan = players[i]->GetClan();
+            if ( !clan.empty() )
+                clan_sizes[clan]++;
         }
     }
-    void AddAlliance( const Alliance &other )
+    const size_t max_clan_size = ( players.size() + bins - 1 ) / bins;
+    std::vector<size_t> groups( players.size() );
+    std::map<std::string, size_t> clan_groups;
+    size_t next_group = 0;
+    for ( size_t i = 0; i < players.size(); ++i )
     {
-        for ( CommonUserVector::const_iterator i = other.players.begin(); i != other.players.end(); ++i )
-            AddPlayer( *i );
-    }
-    bool operator < ( const Alliance &other ) const
-    {
-        return ranksum < other.ranksum;
-    }
-};
-
-struct ControlTeam
-{
-    CommonUserVector players;
-    float ranksum;
-    int teamnum;
-    ControlTeam(): ranksum(0), teamnum(-1) {}
-    ControlTeam( int i ): ranksum(0), teamnum(i) {}
-    void AddPlayer( const CommonUserPtr player )
-    {
-        if ( player )
+        const std::string clan = support_clans ? players[i]->GetClan() : std::string();
+        std::map<std::string, size_t>::const_iterator size = clan_sizes.find( clan );
+        if ( clan.empty() || size == clan_sizes.end() || size->second < 2 || ( !strong_clans && size->second > max_clan_size ) )
         {
-            players.push_back( player );
-            ranksum += player->GetBalanceRank();
+            groups[i] = next_group++;
+            continue;
         }
+        std::map<std::string, size_t>::const_iterator group = clan_groups.find( clan );
+        if ( group == clan_groups.end() )
+            group = clan_groups.insert( std::make_pair( clan, next_group++ ) ).first;
+        groups[i] = group->second;
     }
-    void AddTeam( ControlTeam &other )
-    {
-        for ( CommonUserVector::const_iterator i = other.players.begin(); i != other.players.end(); ++i ) AddPlayer( *i );
-    }
-    bool operator < (const ControlTeam &other) const
-    {
-        return ranksum < other.ranksum;
-    }
-};
-
-int my_random( int range )
-{
-    return rand() % range;
+    return groups;
 }
 
-void shuffle( CommonUserVector& players) // proper shuffle.
+Util::PartitionMethod GetPartitionMethod( Enum::BalanceType balance_type )
 {
-    for ( size_t i=0; i < players.size(); ++i ) // the players below i are shuffled, the players above arent
+    switch ( balance_type )
     {
-        int rn = i + my_random( players.size() - i ); // the top of shuffled part becomes random card from unshuffled part
-        CommonUserPtr tmp = players[i];
-        players[i] = players[rn];
-        players[rn] = tmp;
+        case Enum::balance_random: return Util::PARTITION_IN_ORDER;
+        case Enum::balance_differencing: return Util::PARTITION_DIFFERENCING;
+        case Enum::balance_exact: return Util::PARTITION_EXACT;
+        default: return Util::PARTITION_GREEDY;
     }
 }
 
@@ -815,7 +809,7 @@ void Battle::Autobalance( Enum::BalanceType balance_type, bool support_clans, bo
 {
 //    lslDebug("Autobalancing alliances, type=%d, clans=%d, strong_clans=%d, numallyteams=%d",balance_type, support_clans,strong_clans, numallyteams);
 
-    std::vector<Alliance> alliances;
+    std::vector<int> alliances;
     if ( numallyteams == 0 || numallyteams == -1 ) // 0 or 1 -> use num start rects
     {
         int ally = 0;
@@ -825,138 +819,55 @@ void Battle::Autobalance( Enum::BalanceType balance_type, bool support_clans, bo
             if ( sr.IsOk() )
             {
                 ally=i;
-                alliances.push_back( Alliance( ally ) );
+                alliances.push_back( ally );
                 ally++;
             }
         }
         // make at least two alliances
         while ( alliances.size() < 2 )
         {
-            alliances.push_back( Alliance( ally ) );
+            alliances.push_back( ally );
             ally++;
         }
     }
     else
     {
-        for ( int i = 0; i < numallyteams; i++ ) alliances.push_back( Alliance( i ) );
+        for ( int i = 0; i < numallyteams; i++ ) alliances.push_back( i );
     }
 
-    //for(i=0;i<alliances.size();++i)alliances[i].allynum=i;
-
-    CommonUserVector players_sorted;
-    players_sorted.reserve( m_userlist.size() );
-
-    for ( size_t i = 0; i < m_userlist.size(); ++i )
-    {
-        CommonUserPtr usr = m_userlist[i];
-        if ( !usr->BattleStatus().spectator )
-        {
-            players_sorted.push_back( usr );
-        }
-    }
-
-    // remove players in the same team so only one remains
-    std::map< int, CommonUserPtr> dedupe_teams;
-    for ( std::vector<CommonUserPtr>::const_iterator it = players_sorted.begin(); it != players_sorted.end(); ++it )
-    {
-        dedupe_teams[(*it)->BattleStatus().team] = *it;
-    }
-    players_sorted.clear();
-    players_sorted.reserve( dedupe_teams.size() );
-    for ( std::map<int, CommonUserPtr>::const_iterator it = dedupe_teams.begin(); it != dedupe_teams.end(); ++it )
+    // one player per team stands in for it
+    CommonUserVector players;
+    players.reserve( m_team_members.size() );
+    for ( MemberIndex::const_iterator team = m_team_members.begin(); team != m_team_members.end(); ++team )
     {
-        players_sorted.push_back( it->second );
+        players.push_back( team->second.back() );
     }
 
-    shuffle( players_sorted );
-
-    std::map<std::string, Alliance> clan_alliances;
-    if ( support_clans )
-    {
-        for ( size_t i=0; i < players_sorted.size(); ++i )
-        {
-            std::string clan = players_sorted[i]->GetClan();
-            if ( !clan.empty() )
-            {
-                clan_alliances[clan].AddPlayer( players_sorted[i] );
-            }
-        }
-    };
-
-    if ( balance_type != Enum::balance_random )
-        std::sort( players_sorted.begin(), players_sorted.end(), PlayerRankCompareFunction );
-
-    if ( support_clans )
-    {
-        std::map<std::string, Alliance>::iterator clan_it = clan_alliances.begin();
-        while ( clan_it != clan_alliances.end() )
-        {
-            Alliance &clan = (*clan_it).second;
-            // if clan is too small (only 1 clan member in battle) or too big, dont count it as clan
-            if ( ( clan.players.size() < 2 ) ||
-                 ( !strong_clans && ( clan.players.size() >
-                                      ( ( players_sorted.size() + alliances.size() -1 ) / alliances.size() ) ) ) )
-            {
-                std::map<std::string, Alliance>::iterator next = clan_it;
-                ++next;
-                clan_alliances.erase( clan_it );
-                clan_it = next;
-                continue;
-            }
-            std::sort( alliances.begin(), alliances.end() );
-            float lowestrank = alliances[0].ranksum;
-            int rnd_k = 1;// number of alliances with rank equal to lowestrank
-            while ( size_t( rnd_k ) < alliances.size() )
-            {
-                if ( fabs( alliances[rnd_k].ranksum - lowestrank ) > 0.01 ) break;
-                rnd_k++;
-            }
-            alliances[my_random( rnd_k )].AddAlliance( clan );
-            ++clan_it;
-        }
-    }
+    // the engine breaks ties by order, shuffling keeps equal setups from always ending up the same way
+    shuffle( players );
+    for ( size_t i = 0; i < alliances.size(); ++i )
+        std::swap( alliances[i], alliances[i + my_random( alliances.size() - i )] );
 
-    for ( size_t i = 0; i < players_sorted.size(); ++i )
+    const std::vector<size_t> groups = GroupClans( players, support_clans, strong_clans, alliances.size() );
+    std::vector<float> weights;
+    for ( size_t i = 0; i < players.size(); ++i )
     {
-        // skip clanners, those have been added already.
-        if ( clan_alliances.count( players_sorted[i]->GetClan() ) > 0 )
-        {
-            continue;
-        }
-
-        // find alliances with lowest ranksum
-        // insert current user into random one out of them
-        // since performance doesnt matter here, i simply sort alliances,
-        // then find how many alliances in beginning have lowest ranksum
-        // note that balance player ranks range from 1 to 1.1 now
-        // i.e. them are quasi equal
-        // so we're essentially adding to alliance with smallest number of players,
-        // the one with smallest ranksum.
-
-        std::sort( alliances.begin(), alliances.end() );
-        float lowestrank = alliances[0].ranksum;
-        int rnd_k = 1;// number of alliances with rank equal to lowestrank
-        while ( size_t( rnd_k ) < alliances.size() )
-        {
-            if ( fabs( alliances[rnd_k].ranksum - lowestrank ) > 0.01 ) break;
-            rnd_k++;
-        }
-        alliances[my_random( rnd_k )].AddPlayer( players_sorted[i] );
+        if ( groups[i] >= weights.size() )
+            weights.resize( groups[i] + 1, 0 );
+        weights[groups[i]] += players[i]->GetBalanceRank();
     }
+    const std::vector<size_t> assignment = Util::PartitionWeights( weights, alliances.size(), GetPartitionMethod( balance_type ) );
 
-    const size_t totalplayers = m_userlist.size();
-    for ( size_t i = 0; i < alliances.size(); ++i )
+    for ( size_t i = 0; i < players.size(); ++i ) // change ally num of all players in the team
     {
-        for ( size_t j = 0; j < alliances[i].players.size(); ++j )
+		ASSERT_LOGIC( players[i], "fail in Autobalance, NULL player" );
+        const int ally = alliances[assignment[groups[i]]];
+        // a copy, ForceAlly reindexes the members
+        const CommonUserVector members = GetTeamMembers( players[i]->BattleStatus().team );
+        for ( const CommonUserPtr& usr: members )
         {
-			ASSERT_LOGIC( alliances[i].players[j], "fail in Autobalance, NULL player" );
-            int balanceteam = alliances[i].players[j]->BattleStatus().team;
-            for ( size_t h = 0; h < totalplayers; h++ ) // change ally num of all players in the team
-            {
-                CommonUserPtr usr = m_userlist[h];
-                if ( usr->BattleStatus().team == balanceteam )
-                    ForceAlly( usr, alliances[i].allynum );
-            }
+            if ( usr->BattleStatus().ally != ally )
+                ForceAlly( usr, ally );
         }
     }
 }
@@ -964,9 +875,17 @@ void Battle::Autobalance( Enum::BalanceType balance_type, bool support_clans, bo
 void Battle::FixTeamIDs( Enum::BalanceType balance_type, bool support_clans, bool strong_clans, int numcontrolteams )
 {
 //	wxLogMessage("Autobalancing teams, type=%d, clans=%d, strong_clans=%d, numcontrolteams=%d",balance_type, support_clans, strong_clans, numcontrolteams);
-    std::vector<ControlTeam> control_teams;
+    CommonUserVector players;
+    players.reserve( m_userlist.size() );
+    for ( const CommonUserPtr& user: m_userlist.Items() ) // don't count spectators
+    {
+        if ( !user->BattleStatus().spectator )
+            players.push_back( user );
+    }
+    if ( players.empty() )
+        return;
 
-    if ( numcontrolteams == 0 || numcontrolteams == -1 ) numcontrolteams = m_userlist.size() - GetSpectators(); // 0 or -1 -> use num players, will use comshare only if no available team slots
+    if ( numcontrolteams == 0 || numcontrolteams == -1 ) numcontrolteams = players.size(); // 0 or -1 -> use num players, will use comshare only if no available team slots
     Enum::StartType position_type = (Enum::StartType)
             Util::FromString<long>( CustomBattleOptions()->getSingleValue( "startpostype", LSL::OptionsWrapper::EngineOption ) );
     if ( ( position_type == Enum::ST_Fixed ) || ( position_type == Enum::ST_Random ) ) // if fixed start pos type or random, use max teams = start pos count
@@ -978,147 +897,34 @@ void Battle::FixTeamIDs( Enum::BalanceType balance_type, bool support_clans, boo
         }
         catch( ... ) {}
     }
+    numcontrolteams = std::max( numcontrolteams, 1 );
 
-    if ( numcontrolteams >= (int)( m_userlist.size() - GetSpectators() ) ) // autobalance behaves weird when trying to put one player per team and i CBA to fix it, so i'll reuse the old code :P
-    {
-        // apparently tasserver doesnt like when i fix/force ids of everyone.
-        std::set<int> allteams;
-        const size_t numusers = m_userlist.size();
-        for( size_t i = 0; i < numusers; ++i )
-        {
-            const CommonUserPtr user = m_userlist.At(i);
-			if( !user->BattleStatus().spectator ) allteams.insert( user->BattleStatus().team );
-        }
-        std::set<int> teams;
-        int t = 0;
-        for( size_t i = 0; i < m_userlist.size(); ++i )
-        {
-            const CommonUserPtr user = m_userlist.At(i);
-			if( !user->BattleStatus().spectator )
-            {
-				if( teams.count( user->BattleStatus().team ) )
-                {
-                    while( allteams.count(t) || teams.count( t ) ) t++;
-					ForceTeam( m_userlist.At(i), t );
-                    teams.insert( t );
-                }
-                else
-                {
-					teams.insert( user->BattleStatus().team );
-                }
-            }
-        }
-        return;
-    }
-    for ( int i = 0; i < numcontrolteams; i++ )
-        control_teams.push_back( ControlTeam( i ) );
-
-    std::vector<CommonUserPtr> players_sorted;
-    players_sorted.reserve( m_userlist.size() );
-
-    int player_team_counter = 0;
-
-    for ( size_t i = 0; i < m_userlist.size(); ++i ) // don't count spectators
-    {
-        if ( !m_userlist.At(i)->BattleStatus().spectator )
-        {
-            players_sorted.push_back( m_userlist.At(i) );
-            // -- server fail? it doesnt work right.
-			//ForceTeam(m_userlist.At(i),player_team_counter);
-            player_team_counter++;
-        }
-    }
-
-    shuffle( players_sorted );
-
-    std::map<std::string, ControlTeam> clan_teams;
-    if ( support_clans )
-    {
-        for ( size_t i = 0; i < players_sorted.size(); ++i )
-        {
-            std::string clan = players_sorted[i]->GetClan();
-            if ( !clan.empty() )
-            {
-                clan_teams[clan].AddPlayer( players_sorted[i] );
-            }
-        }
-    };
-
-    if ( balance_type != Enum::balance_random )
-        std::sort( players_sorted.begin(), players_sorted.end(), PlayerRankCompareFunction );
-
-    if ( support_clans )
-    {
-        std::map<std::string, ControlTeam>::iterator clan_it = clan_teams.begin();
-        while ( clan_it != clan_teams.end() )
-        {
-            ControlTeam &clan = (*clan_it).second;
-            // if clan is too small (only 1 clan member in battle) or too big, dont count it as clan
-            if ( ( clan.players.size() < 2 ) || ( !strong_clans && ( clan.players.size() >  ( ( players_sorted.size() + control_teams.size() -1 ) / control_teams.size() ) ) ) )
-            {
-//				wxLogMessage("removing clan %s",(*clan_it).first.c_str());
-                std::map<std::string, ControlTeam>::iterator next = clan_it;
-                ++next;
-                clan_teams.erase( clan_it );
-                clan_it = next;
-                continue;
-            }
-//			wxLogMessage( "Inserting clan %s", (*clan_it).first.c_str() );
-            std::sort( control_teams.begin(), control_teams.end() );
-            float lowestrank = control_teams[0].ranksum;
-            int rnd_k = 1; // number of alliances with rank equal to lowestrank
-            while ( size_t( rnd_k ) < control_teams.size() )
-            {
-                if ( fabs( control_teams[rnd_k].ranksum - lowestrank ) > 0.01 ) break;
-                rnd_k++;
-            }
-//			wxLogMessage("number of lowestrank teams with same rank=%d", rnd_k );
-            control_teams[my_random( rnd_k )].AddTeam( clan );
-            ++clan_it;
-        }
-    }
+    // a fixed order gives the same split when fixing again, random balance wants a new one each time
+    if ( balance_type == Enum::balance_random )
+        shuffle( players );
+    else
+        std::sort( players.begin(), players.end(), []( const CommonUserPtr& a, const CommonUserPtr& b ) { return a->Nick() < b->Nick(); } );
 
-    for (size_t i = 0; i < players_sorted.size(); ++i )
+    const std::vector<size_t> groups = GroupClans( players, support_clans, strong_clans, numcontrolteams );
+    std::vector<int> current( players.size() );
+    std::vector<float> ranks( players.size() );
+    for ( size_t i = 0; i < players.size(); ++i )
     {
-        // skip clanners, those have been added already.
-        if ( clan_teams.count( players_sorted[i]->GetClan() ) > 0 )
-        {
-//			wxLogMessage( "clanner already added, nick=%s",players_sorted[i]->Nick().c_str() );
-            continue;
-        }
-
-        // find teams with lowest ranksum
-        // insert current user into random one out of them
-        // since performance doesnt matter here, i simply sort teams,
-        // then find how many teams in beginning have lowest ranksum
-        // note that balance player ranks range from 1 to 1.1 now
-        // i.e. them are quasi equal
-        // so we're essentially adding to teams with smallest number of players,
-        // the one with smallest ranksum.
-
-        std::sort( control_teams.begin(), control_teams.end() );
-        float lowestrank = control_teams[0].ranksum;
-        int rnd_k = 1; // number of alliances with rank equal to lowestrank
-        while ( size_t( rnd_k ) < control_teams.size() )
-        {
-            if ( fabs ( control_teams[rnd_k].ranksum - lowestrank ) > 0.01 ) break;
-            rnd_k++;
-        }
-//		wxLogMessage( "number of lowestrank teams with same rank=%d", rnd_k );
-        control_teams[my_random( rnd_k )].AddPlayer( players_sorted[i] );
+        current[i] = players[i]->BattleStatus().team;
+        ranks[i] = players[i]->GetBalanceRank();
     }
+    const std::vector<int> teams = Util::PackControlTeams( current, ranks, groups, numcontrolteams, GetPartitionMethod( balance_type ) );
 
-
-    for ( size_t i=0; i < control_teams.size(); ++i )
+    // with a team per player alliances are left alone, shared control teams also get an alliance each.
+    // only what changed is sent, tasserver doesnt like when everyone gets forced
+    const bool comshare = size_t( numcontrolteams ) < players.size();
+    for ( size_t i = 0; i < players.size(); ++i )
     {
-        for ( size_t j = 0; j < control_teams[i].players.size(); ++j )
-        {
-			ASSERT_LOGIC( control_teams[i].players[j], "fail in Autobalance teams, NULL player" );
-//			std::string msg = (boost::format( "setting player %s to team and ally %d" ) % control_teams[i].players[j]->Nick() % i).str();
-//			wxLogMessage( "%s", msg.c_str() );
-            ForceTeam( control_teams[i].players[j], control_teams[i].teamnum );
-            ForceAlly( control_teams[i].players[j], control_teams[i].teamnum );
-        }
+		ASSERT_LOGIC( players[i], "fail in Autobalance teams, NULL player" );
+        if ( teams[i] != current[i] )
+            ForceTeam( players[i], teams[i] );
+        if ( comshare && teams[i] != players[i]->BattleStatus().ally )
+            ForceAlly( players[i], teams[i] );
     }
 }
 
@@ -6,6 +6,7 @@
 #include <lslutils/type_forwards.h>
 #include "ibattle.h"
 #include "enum.h"
+#include "bans.h"
 
 namespace LSL {
 
@@ -65,6 +66,7 @@ public:
     void OnUserAdded( const CommonUserPtr user );
     void OnUserBattleStatusUpdated( const CommonUserPtr user, UserBattleStatus status );
     void OnUserRemoved( const CommonUserPtr user );
+    void OnSelfLeftBattle();
 
     void ForceUnsyncedToSpectate();
     void ForceUnReadyToSpectate();
@@ -85,6 +87,9 @@ public:
     ///< quick hotfix for bans
     bool IsBanned(const CommonUserPtr user );
     ///>
+    //! the rules IsBanned checks joining users against, autohosts can bulk load theirs here
+    BanList& Bans() { return m_bans; }
+    const BanList& Bans() const { return m_bans; }
 
     void SetImReady( bool ready );
 
@@ -111,18 +116,21 @@ public:
     const ChannelPtr GetChannel();
 private:
     void OnTimer( const boost::system::error_code& error );
+    //! sends bs as my status and applies it to me through SetUserBattleStatus
+    void SendMyBattleStatus( UserBattleStatus bs );
+    //! points m_timer at the next auto spectate deadline, or stops it if there is none
+    void ArmAutoSpecTimer();
     // Battle variables
 
-    ///< quick hotfix for bans
-    std::set<std::string> m_banned_users;
-    std::set<std::string> m_banned_ips;
-    ///>
+    BanList m_bans;
 
     IServerPtr m_serv;
     bool m_autolock_on_start;
     bool m_auto_unspec;
     const int m_id;
     ChannelPtr m_channel;
+    //! what m_timer waits for, not_a_date_time while it is idle
+    boost::posix_time::ptime m_autospec_due;
 };
 
 } // namespace Battle {
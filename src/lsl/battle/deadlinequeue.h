@@ -0,0 +1,155 @@
+#ifndef LSL_HEADERGUARD_BATTLE_DEADLINEQUEUE_H
+#define LSL_HEADERGUARD_BATTLE_DEADLINEQUEUE_H
+
+#include <functional>
+#include <queue>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/date_time/posix_time/ptime.hpp>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief keys waiting for a point in time, earliest first
+ * A min-heap with lazy deletion: rescheduling or cancelling a key only touches
+ * the index, outdated heap entries are dropped once they reach the top. The heap
+ * is rebuilt when outdated entries outnumber the pending ones.
+ **/
+template < class Key, class Hash = boost::hash<Key> >
+class DeadlineQueue
+{
+public:
+	typedef boost::posix_time::ptime Time;
+
+	DeadlineQueue() : m_serial( 0 ) {}
+
+	//! (re)schedule \param key for \param when
+	void Schedule( const Key& key, const Time& when )
+	{
+		Pending& pending = m_pending[key];
+		pending.when = when;
+		pending.serial = ++m_serial;
+		m_heap.push( Entry( when, pending.serial, key ) );
+		Compact();
+	}
+
+	//! schedule \param key for \param when unless it already waits
+	void ScheduleOnce( const Key& key, const Time& when )
+	{
+		if ( !Contains( key ) )
+			Schedule( key, when );
+	}
+
+	void Cancel( const Key& key )
+	{
+		m_pending.erase( key );
+		Compact();
+	}
+
+	bool Contains( const Key& key ) const { return m_pending.find( key ) != m_pending.end(); }
+	bool empty() const { return m_pending.empty(); }
+	size_t size() const { return m_pending.size(); }
+
+	void clear()
+	{
+		m_pending.clear();
+		m_heap = Heap();
+	}
+
+	//! earliest pending time, not_a_date_time if nothing is pending
+	Time Next()
+	{
+		DropOutdated();
+		return m_heap.empty() ? Time( boost::posix_time::not_a_date_time ) : m_heap.top().when;
+	}
+
+	//! removes every key due at or before \param now and appends it to \param due, earliest first
+	void PopDue( const Time& now, std::vector<Key>& due )
+	{
+		for ( DropOutdated(); !m_heap.empty() && m_heap.top().when <= now; DropOutdated() ) {
+			due.push_back( m_heap.top().key );
+			m_pending.erase( m_heap.top().key );
+			m_heap.pop();
+		}
+	}
+
+private:
+	struct Pending
+	{
+		Time when;
+		unsigned long serial;
+	};
+
+	struct Entry
+	{
+		Entry( const Time& w, unsigned long s, const Key& k ) : when( w ), serial( s ), key( k ) {}
+		bool operator > ( const Entry& other ) const
+		{
+			return when > other.when || ( when == other.when && serial > other.serial );
+		}
+		Time when;
+		unsigned long serial;
+		Key key;
+	};
+
+	typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > Heap;
+
+	bool Outdated( const Entry& entry ) const
+	{
+		typename PendingMap::const_iterator it = m_pending.find( entry.key );
+		return it == m_pending.end() || it->second.serial != entry.serial;
+	}
+
+	void DropOutdated()
+	{
+		while ( !m_heap.empty() && Outdated( m_heap.top() ) )
+			m_heap.pop();
+	}
+
+	void Compact()
+	{
+		if ( m_heap.size() <= 2 * m_pending.size() + 16 )
+			return;
+		Heap heap;
+		for ( typename PendingMap::const_iterator it = m_pending.begin(); it != m_pending.end(); ++it )
+			heap.push( Entry( it->second.when, it->second.serial, it->first ) );
+		m_heap.swap( heap );
+	}
+
+	typedef boost::unordered_map<Key, Pending, Hash> PendingMap;
+	PendingMap m_pending;
+	Heap m_heap;
+	unsigned long m_serial;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_DEADLINEQUEUE_H
+
+/**
+ * \file deadlinequeue.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -22,7 +22,9 @@ enum BattleType
 enum BalanceType
 {
     balance_divide,
-    balance_random
+    balance_random,
+    balance_differencing, //!< Karmarkar-Karp, better spread than balance_divide for many players
+    balance_exact //!< optimal for up to 16 players/clans, balance_differencing above that
 };
 
 enum StartType
@@ -2,6 +2,7 @@
 
 #include <lslutils/debug.h>
 #include <lslutils/misc.h>
+#include <lslutils/color.h>
 #include <lslutils/conversion.h>
 #include <lslutils/config.h>
 #include <lslutils/autopointers.h>
@@ -17,9 +18,13 @@
 
 #include "signals.h"
 #include "tdfcontainer.h"
+#include "scriptsections.h"
+#include "presets.h"
 
 #include <algorithm>
+#include <cassert>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/mutex.hpp>
 
 #define ASSERT_EXCEPTION(cond,msg) do { if (!(cond)) { LSL_THROW( battle, msg ); } } while (0)
 
@@ -27,7 +32,6 @@ namespace LSL {
 namespace Battle {
 
 boost::asio::io_service _io;
-const boost::posix_time::seconds TIMER_INTERVAL(1000);
 const unsigned int TIMER_ID               = 101;
 
 BattleOptions::BattleOptions()
@@ -56,12 +60,14 @@ IBattle::IBattle():
 	, m_previous_local_mod_name( std::string() )
     , m_opt_wrap( new OptionsWrapper() )
 	, m_ingame(false)
+	, m_spectators(0)
+	, m_players_active(0)
 	, m_players_ready(0)
 	, m_players_sync(0)
 	, m_players_ok(0)
 	, m_is_self_in(false)
 	, m_generating_script(false)
-    , m_timer ( new boost::asio::deadline_timer( _io, TIMER_INTERVAL ) )
+    , m_timer ( new boost::asio::deadline_timer( _io ) )
 {
 }
 
@@ -73,15 +79,27 @@ IBattle::~IBattle()
 }
 
 bool IBattle::IsSynced()
+{
+	const size_t generation = GetCatalogGeneration();
+	bool synced;
+	if ( m_sync.Lookup( m_host_map.name, m_host_map.hash, m_host_mod.name, m_host_mod.hash, generation, synced ) )
+		return synced;
+	synced = CheckSynced();
+	m_sync.Store( m_host_map.name, m_host_map.hash, m_host_mod.name, m_host_mod.hash, generation, synced );
+	return synced;
+}
+
+size_t IBattle::GetCatalogGeneration() const
+{
+	return usync().GetCatalogGeneration();
+}
+
+bool IBattle::CheckSynced()
 {
 	LoadMod();
 	LoadMap();
-	bool synced = true;
-	if ( !m_host_map.hash.empty() || m_host_map.hash != "0" ) synced = synced && (m_local_map.hash == m_host_map.hash);
-	if ( !m_host_map.name.empty() ) synced = synced && (m_local_map.name == m_host_map.name);
-	if ( !m_host_mod.hash.empty() || m_host_mod.hash != "0" ) synced = synced && (m_local_mod.hash == m_host_mod.hash);
-	if ( !m_host_mod.name.empty() ) synced = synced && (m_local_mod.name == m_host_mod.name);
-	return synced;
+	return ArchiveSynced( m_host_map.name, m_host_map.hash, m_local_map.name, m_local_map.hash )
+		&& ArchiveSynced( m_host_mod.name, m_host_mod.hash, m_local_mod.name, m_local_mod.hash );
 }
 
 std::vector<lslColor>& IBattle::GetFixColorsPalette( int numteams ) const
@@ -98,64 +116,26 @@ lslColor IBattle::GetFixColor(int i) const
 
 int IBattle::GetPlayerNum( const ConstCommonUserPtr user ) const
 {
-	for ( size_t i = 0; i < m_userlist.size(); ++i )
+	size_t i = 0;
+	for ( const CommonUser* u: m_userlist.Items() )
 	{
 		//is this wise? userlist is a map that changes order on insert
-		if ( m_userlist.At(i) == user ) return i;
+		if ( u == user.get() ) return i;
+		++i;
 	}
 
 	ASSERT_EXCEPTION(false, "The player is not in this game.");
 	return lslNotFound;
 }
 
-class DismissColor {
-protected:
-	typedef std::vector<lslColor>
-		ColorVec;
-	const ColorVec& m_other;
-
-public:
-	DismissColor( const ColorVec& other )
-		: m_other( other )
-	{}
-
-	bool operator() ( lslColor to_check ) {
-		return std::find ( m_other.begin(), m_other.end(), to_check ) != m_other.end();
-	}
-};
-
-class AreColorsSimilarProxy {
-	const int m_mindiff;
-
-public:
-    AreColorsSimilarProxy( int mindiff )
-		: m_mindiff ( mindiff )
-	{}
-
-	bool operator() ( lslColor a, lslColor b ) {
-        return Util::AreColorsSimilar( a, b, m_mindiff );
-	}
-};
-
-lslColor IBattle::GetFreeColor( const ConstCommonUserPtr user) const
+lslColor IBattle::GetFreeColor( const ConstCommonUserPtr for_whom ) const
 {
-	typedef std::vector<lslColor>
-		ColorVec;
-
-	ColorVec current_used_colors;
-	for ( size_t i = 0; i < m_userlist.size(); ++i ) {
-		const UserBattleStatus& bs = m_userlist.At( i )->BattleStatus();
-		current_used_colors.push_back( bs.color );
-	}
-
-	int inc = 1;
-	while ( true ) {
-		ColorVec fixcolorspalette = GetFixColorsPalette( m_teams_sizes.size() + inc++ );
-		ColorVec::iterator fixcolorspalette_new_end; //= std::unique( fixcolorspalette.begin(), fixcolorspalette.end(), AreColorsSimilarProxy( 20 ) );
-		fixcolorspalette_new_end = std::remove_if( fixcolorspalette.begin(), fixcolorspalette.end(), DismissColor( current_used_colors ) );
-		if ( fixcolorspalette_new_end != fixcolorspalette.begin() )
-			return (*fixcolorspalette.begin());
+	Util::ColorAllocator colors;
+	for ( const CommonUser* u: m_userlist.Items() ) {
+		if ( u == for_whom.get() || u->BattleStatus().spectator ) continue;
+		colors.Take( u->BattleStatus().color );
 	}
+	return colors.Next();
 }
 
 lslColor IBattle::GetNewColor() const
@@ -163,32 +143,32 @@ lslColor IBattle::GetNewColor() const
     return GetFreeColor();
 }
 
-int IBattle::ColorDifference(const lslColor &a, const lslColor &b)  const// returns max difference of r,g,b.
+int IBattle::ColorDifference(const lslColor &a, const lslColor &b)  const// returns perceptual difference, see Util::ColorDistance
 {
-	return std::max(abs(a.Red()-b.Red()),std::max(abs(a.Green()-b.Green()),abs(a.Blue()-b.Blue())));
+	return int( Util::ColorDistance( a, b ) );
+
+}
 
+//! \param from if nobody is in it, else the next number after it nobody is in, \param ignore counts as free
+static int FirstFreeFrom( const MemberIndex& members, int from, int ignore )
+{
+	// only numbers past Occupancy::LIMIT are left to look at, the bitset had none free below it
+	if ( from < Occupancy::LIMIT ) return from;
+	while ( from != ignore && members.Count( from ) > 0 ) from++;
+	return from;
 }
 
 int IBattle::GetFreeTeam( bool excludeme ) const
 {
-	int lowest = 0;
-	bool changed = true;
-	while ( changed )
+	int ignore = -1;
+	const ConstCommonUserPtr me = GetMe();
+	if ( excludeme && me && !me->BattleStatus().spectator && m_userlist.Exists( me->key() ) )
 	{
-		changed = false;
-		for ( size_t i = 0; i < m_userlist.size(); i++ )
-		{
-            const ConstCommonUserPtr user = m_userlist.At( i );
-			if ( ( user == GetMe() ) && excludeme ) continue;
-			if ( user->BattleStatus().spectator ) continue;
-			if ( user->BattleStatus().team == lowest )
-			{
-				lowest++;
-				changed = true;
-			}
-		}
+		// a team only we are in counts as free
+		const int team = me->BattleStatus().team;
+		if ( m_team_members.Count( team ) == 1 ) ignore = team;
 	}
-	return lowest;
+	return FirstFreeFrom( m_team_members, m_team_occupancy.FirstFree( ignore ), ignore );
 }
 
 int IBattle::GetClosestFixColor(const lslColor &col, const std::vector<int> &excludes, int difference) const
@@ -240,19 +220,11 @@ void IBattle::OnUserAdded(const CommonUserPtr user )
 		pos = GetFreePosition();
 		UserPositionChanged( user );
 	}
-	if ( !bs.spectator )
-	{
-		PlayerJoinedAlly( bs.ally );
-		PlayerJoinedTeam( bs.team );
-	}
+	CountStatus( user, 1 );
 	if ( bs.spectator && IsFounderMe() ) m_opts.spectators++;
-	if ( !bs.spectator && !bs.IsBot() )
-	{
-		if ( bs.ready ) m_players_ready++;
-		if ( bs.sync) m_players_sync++;
-		if ( !bs.ready || !bs.sync ) m_ready_up_map[user->Nick()] = time(0);
-		if ( bs.ready && bs.sync ) m_players_ok++;
-	}
+	if ( !bs.spectator && !bs.IsBot() && ( !bs.ready || !bs.sync ) )
+		m_ready_up.Schedule( user->key(), boost::posix_time::microsec_clock::universal_time() );
+	CheckStatusCounts();
 }
 
 CommonUserPtr IBattle::OnBotAdded( const std::string& nick, const UserBattleStatus& bs )
@@ -280,56 +252,136 @@ unsigned int IBattle::GetNumActivePlayers() const
 
 void IBattle::OnUserBattleStatusUpdated( CommonUserPtr user, UserBattleStatus status )
 {
-	UserBattleStatus previousstatus = user->BattleStatus();
+	SetUserBattleStatus( user, status );
+	unsigned int oldspeccount = m_opts.spectators;
+	m_opts.spectators = m_spectators;
+	if ( oldspeccount != m_opts.spectators  )
+	{
+		if ( IsFounderMe() ) SendHostInfo( Enum::HI_Spectators );
+	}
+	if ( !status.IsBot() )
+	{
+		if ( ( status.ready && status.sync ) || status.spectator )
+			m_ready_up.Cancel( user->key() );
+		else
+			m_ready_up.ScheduleOnce( user->key(), boost::posix_time::microsec_clock::universal_time() );
+	}
+}
 
+void IBattle::SetUserBattleStatus( const CommonUserPtr user, const UserBattleStatus& status )
+{
+	// me may not have joined yet, only listed users are counted
+	const bool listed = m_userlist.Exists( user->key() );
+	if ( listed ) CountStatus( user, -1 );
 	user->UpdateBattleStatus( status );
-	unsigned int oldspeccount = m_opts.spectators;
-	m_opts.spectators = 0;
-	m_players_sync = 0;
+	if ( listed ) CountStatus( user, 1 );
+	CheckStatusCounts();
+}
+
+void IBattle::CountStatus( const CommonUserPtr& user, int sign )
+{
+	const UserBattleStatus& bs = user->BattleStatus();
+	if ( bs.spectator )
+	{
+		m_spectators += sign;
+		return;
+	}
+	// bots take up teams as well, but aren't in the team and ally sizes
+	if ( sign > 0 )
+	{
+		m_team_members.Add( bs.team, user );
+		m_ally_members.Add( bs.ally, user );
+		m_team_occupancy.Set( bs.team );
+		m_ally_occupancy.Set( bs.ally );
+	}
+	else
+	{
+		m_team_members.Remove( bs.team, user );
+		m_ally_members.Remove( bs.ally, user );
+		if ( m_team_members.Count( bs.team ) == 0 ) m_team_occupancy.Reset( bs.team );
+		if ( m_ally_members.Count( bs.ally ) == 0 ) m_ally_occupancy.Reset( bs.ally );
+	}
+	if ( bs.IsBot() ) return;
+	if ( sign > 0 )
+	{
+		PlayerJoinedTeam( bs.team );
+		PlayerJoinedAlly( bs.ally );
+	}
+	else
+	{
+		PlayerLeftTeam( bs.team );
+		PlayerLeftAlly( bs.ally );
+	}
+	m_players_active += sign;
+	if ( bs.ready ) m_players_ready += sign;
+	if ( bs.sync ) m_players_sync += sign;
+	if ( bs.ready && bs.sync ) m_players_ok += sign;
+}
+
+void IBattle::RecountStatus()
+{
+	m_spectators = 0;
+	m_players_active = 0;
 	m_players_ready = 0;
+	m_players_sync = 0;
 	m_players_ok = 0;
 	m_teams_sizes.clear();
 	m_ally_sizes.clear();
-	for ( unsigned int i = 0; i < m_userlist.size(); i++ )
+	m_team_occupancy.clear();
+	m_ally_occupancy.clear();
+	m_team_members.clear();
+	m_ally_members.clear();
+	for ( const CommonUserPtr& user: m_userlist.Items() )
+		CountStatus( user, 1 );
+}
+
+void IBattle::CheckStatusCounts() const
+{
+#ifdef LSL_CHECK_STATUS_COUNTS
+	unsigned int spectators = 0, active = 0, ready = 0, sync = 0, ok = 0;
+	std::map<int, int> teams, allies, team_members, ally_members;
+	for ( const CommonUser* user: m_userlist.Items() )
 	{
-        const ConstCommonUserPtr loopuser = m_userlist.At( i );
-		const UserBattleStatus& loopstatus = loopuser->BattleStatus();
-		if ( loopstatus.spectator ) m_opts.spectators++;
-		if ( !loopstatus.IsBot() )
+		const UserBattleStatus& bs = user->BattleStatus();
+		if ( bs.spectator )
 		{
-			if ( !loopstatus.spectator )
-			{
-				if ( loopstatus.ready && loopstatus.spectator ) m_players_ready++;
-				if ( loopstatus.sync ) m_players_sync++;
-				if ( loopstatus.ready && loopstatus.sync ) m_players_ok++;
-				PlayerJoinedTeam( loopstatus.team );
-				PlayerJoinedAlly( loopstatus.ally );
-			}
+			spectators++;
+			continue;
 		}
+		team_members[bs.team]++;
+		ally_members[bs.ally]++;
+		if ( bs.IsBot() ) continue;
+		teams[bs.team]++;
+		allies[bs.ally]++;
+		active++;
+		if ( bs.ready ) ready++;
+		if ( bs.sync ) sync++;
+		if ( bs.ready && bs.sync ) ok++;
 	}
-	if ( oldspeccount != m_opts.spectators  )
+	assert( spectators == m_spectators );
+	assert( active == m_players_active );
+	assert( ready == m_players_ready );
+	assert( sync == m_players_sync );
+	assert( ok == m_players_ok );
+	assert( teams == m_teams_sizes );
+	assert( allies == m_ally_sizes );
+	assert( m_team_members.size() == team_members.size() );
+	assert( m_ally_members.size() == ally_members.size() );
+	for ( MemberIndex::const_iterator it = m_team_members.begin(); it != m_team_members.end(); ++it )
 	{
-		if ( IsFounderMe() ) SendHostInfo( Enum::HI_Spectators );
+		assert( int( it->second.size() ) == team_members[it->first] );
+		assert( m_team_occupancy.Test( it->first ) || it->first < 0 || it->first >= Occupancy::LIMIT );
+		for ( const CommonUserPtr& user: it->second )
+			assert( !user->BattleStatus().spectator && user->BattleStatus().team == it->first );
 	}
-	if ( !status.IsBot() )
+	for ( MemberIndex::const_iterator it = m_ally_members.begin(); it != m_ally_members.end(); ++it )
 	{
-		if ( ( status.ready && status.sync ) || status.spectator )
-		{
-			std::map<std::string, time_t>::iterator itor = m_ready_up_map.find( user->Nick() );
-			if ( itor != m_ready_up_map.end() )
-			{
-				m_ready_up_map.erase( itor );
-			}
-		}
-		if ( ( !status.ready || !status.sync ) && !status.spectator )
-		{
-			std::map<std::string, time_t>::iterator itor = m_ready_up_map.find( user->Nick() );
-			if ( itor == m_ready_up_map.end() )
-			{
-				m_ready_up_map[user->Nick()] = time(0);
-			}
-		}
+		assert( int( it->second.size() ) == ally_members[it->first] );
+		assert( m_ally_occupancy.Test( it->first ) || it->first < 0 || it->first >= Occupancy::LIMIT );
+		for ( const CommonUserPtr& user: it->second )
+			assert( !user->BattleStatus().spectator && user->BattleStatus().ally == it->first );
 	}
+#endif
 }
 
 bool IBattle::ShouldAutoStart() const
@@ -343,49 +395,46 @@ bool IBattle::ShouldAutoStart() const
 void IBattle::OnUserRemoved( CommonUserPtr user )
 {
 	UserBattleStatus& bs = user->BattleStatus();
-	if ( !bs.spectator )
-	{
-		PlayerLeftTeam( bs.team );
-		PlayerLeftAlly( bs.ally );
-	}
-	if ( !bs.spectator && !bs.IsBot() )
-	{
-		if ( bs.ready ) m_players_ready--;
-		if ( bs.sync ) m_players_sync--;
-		if ( bs.ready && bs.sync ) m_players_ok--;
-	}
-	if ( IsFounderMe() && bs.spectator )
+	// a kicked bot is removed once more when the server confirms it
+	const bool listed = m_userlist.Exists( user->key() );
+	if ( listed ) CountStatus( user, -1 );
+	if ( listed && IsFounderMe() && bs.spectator )
 	{
 		m_opts.spectators--;
 		SendHostInfo( Enum::HI_Spectators );
 	}
+	m_userlist.Remove( user->key() );
+	m_ready_up.Cancel( user->key() );
+	CheckStatusCounts();
 	if ( user == GetMe() )
 	{
 		OnSelfLeftBattle();
 	}
-	m_userlist.Remove( user->Nick() );
 	if ( !bs.IsBot() )
         user->SetBattle( IBattlePtr() );
 	else
     {
-        m_internal_bot_list.Remove( user->Nick() );
+        m_internal_bot_list.Remove( user->key() );
 	}
 }
 
+void IBattle::OnUserRenamed( const CommonUserPtr user, const std::string& old_nick )
+{
+	m_userlist.Renamed( user, old_nick );
+	if ( m_opts.founder == old_nick ) m_opts.founder = user->Nick();
+}
 
 bool IBattle::IsEveryoneReady() const
 {
-	for ( unsigned int i = 0; i < GetNumPlayers(); i++ )
+	unsigned int waiting = m_players_active - m_players_ok;
+	const ConstCommonUserPtr me = GetMe();
+	if ( waiting == 1 && me && m_userlist.Exists( me->key() ) )
 	{
-        const ConstCommonUserPtr usr = m_userlist.At( i );
-		const UserBattleStatus& status = usr->BattleStatus();
-		if ( status.IsBot() ) continue;
-		if ( status.spectator ) continue;
-		if ( usr == GetMe() ) continue;
-		if ( !status.ready ) return false;
-		if ( !status.sync ) return false;
+		// everybody but me counts
+		const UserBattleStatus& status = me->BattleStatus();
+		if ( !status.IsBot() && !status.spectator && !( status.ready && status.sync ) ) waiting--;
 	}
-	return true;
+	return waiting == 0;
 }
 
 void IBattle::AddStartRect( unsigned int allyno, unsigned int left, unsigned int top, unsigned int right, unsigned int bottom )
@@ -516,12 +565,9 @@ void IBattle::ForceTeam(const CommonUserPtr user, int team )
 {
 	if ( IsFounderMe() || user->BattleStatus().IsBot() )
 	{
-		if ( !user->BattleStatus().spectator )
-		{
-			PlayerLeftTeam( user->BattleStatus().team );
-			PlayerJoinedTeam( team );
-		}
+		CountStatus( user, -1 );
 		user->BattleStatus().team = team;
+		CountStatus( user, 1 );
 	}
 }
 
@@ -531,12 +577,9 @@ void IBattle::ForceAlly(const CommonUserPtr user, int ally )
 
 	if ( IsFounderMe() || user->BattleStatus().IsBot() )
 	{
-		if ( !user->BattleStatus().spectator )
-		{
-			PlayerLeftAlly( user->BattleStatus().ally );
-			PlayerJoinedAlly( ally );
-		}
+		CountStatus( user, -1 );
 		user->BattleStatus().ally = ally;
+		CountStatus( user, 1 );
 	}
 
 }
@@ -571,10 +614,7 @@ void IBattle::PlayerLeftTeam( int team )
 	if ( itor != m_teams_sizes.end() )
 	{
 		itor->second = itor->second -1;
-		if ( itor->second == 0 )
-		{
-			m_teams_sizes.erase( itor );
-		}
+		if ( itor->second == 0 ) m_teams_sizes.erase( itor );
 	}
 }
 
@@ -584,10 +624,7 @@ void IBattle::PlayerLeftAlly( int ally )
 	if ( iter != m_ally_sizes.end() )
 	{
 		iter->second = iter->second - 1;
-		if ( iter->second == 0 )
-		{
-			m_ally_sizes.erase( iter );
-		}
+		if ( iter->second == 0 ) m_ally_sizes.erase( iter );
 	}
 }
 
@@ -596,20 +633,7 @@ void IBattle::ForceSpectator(const CommonUserPtr user, bool spectator )
 	if ( IsFounderMe() || user->BattleStatus().IsBot() )
 	{
 		UserBattleStatus& status = user->BattleStatus();
-
-		if ( !status.spectator ) // leaving spectator status
-		{
-			PlayerJoinedTeam( status.team );
-			PlayerJoinedAlly( status.ally );
-			if ( status.ready && !status.IsBot() ) m_players_ready++;
-		}
-
-		if (spectator) // entering spectator status
-		{
-			PlayerLeftTeam( status.team );
-			PlayerLeftAlly( status.ally );
-			if ( status.ready && !status.IsBot() ) m_players_ready--;
-		}
+		CountStatus( user, -1 );
 
 		if ( IsFounderMe() )
 		{
@@ -626,7 +650,8 @@ void IBattle::ForceSpectator(const CommonUserPtr user, bool spectator )
 				SendHostInfo( Enum::HI_Spectators );
 			}
 		}
-		user->BattleStatus().spectator = spectator;
+		status.spectator = spectator;
+		CountStatus( user, 1 );
 	}
 }
 
@@ -649,24 +674,15 @@ void IBattle::KickPlayer(const CommonUserPtr user )
 
 int IBattle::GetFreeAlly( bool excludeme ) const
 {
-	int lowest = 0;
-	bool changed = true;
-	while ( changed )
+	int ignore = -1;
+	const ConstCommonUserPtr me = GetMe();
+	if ( excludeme && me && !me->BattleStatus().spectator && m_userlist.Exists( me->key() ) )
 	{
-		changed = false;
-		for ( unsigned int i = 0; i < m_userlist.size(); i++ )
-		{
-            const ConstCommonUserPtr user = m_userlist.At( i );
-			if ( ( user == GetMe() ) && excludeme ) continue;
-			if ( user->BattleStatus().spectator ) continue;
-			if ( user->BattleStatus().ally == lowest )
-			{
-				lowest++;
-				changed = true;
-			}
-		}
+		// an ally only we are in counts as free
+		const int ally = me->BattleStatus().ally;
+		if ( m_ally_members.Count( ally ) == 1 ) ignore = ally;
 	}
-	return lowest;
+	return FirstFreeFrom( m_ally_members, m_ally_occupancy.FirstFree( ignore ), ignore );
 }
 
 UserPosition IBattle::GetFreePosition()
@@ -676,9 +692,8 @@ UserPosition IBattle::GetFreePosition()
 	for ( int i = 0; i < int(map.info.positions.size()); i++ )
 	{
 		bool taken = false;
-		for ( unsigned int bi = 0; bi < m_userlist.size(); bi++ )
+		for ( const CommonUserPtr& user: m_userlist.Items() )
 		{
-            ConstCommonUserPtr user = m_userlist.At( bi );
             const UserBattleStatus& status = user->BattleStatus();
 			if ( status.spectator ) continue;
 			if ( ( map.info.positions[i].x == status.pos.x ) && ( map.info.positions[i].y == status.pos.y ) )
@@ -722,6 +737,7 @@ void IBattle::SetLocalMap(const UnitsyncMap& map)
 	if ( map.name != m_local_map.name || map.hash != m_local_map.hash ) {
 		m_local_map = map;
 		m_map_loaded = true;
+		m_sync.Invalidate();
 		if ( !m_host_map.hash.empty() )
 			m_map_exists = usync().MapExists( m_host_map.name, m_host_map.hash );
 		else
@@ -779,6 +795,7 @@ void IBattle::SetLocalMod( const UnitsyncMod& mod )
 		m_previous_local_mod_name = m_local_mod.name;
 		m_local_mod = mod;
 		m_mod_loaded = true;
+		m_sync.Invalidate();
 		if ( !m_host_mod.hash.empty() ) m_mod_exists = usync().ModExists( m_host_mod.name, m_host_mod.hash );
 		else m_mod_exists = usync().ModExists( m_host_mod.name );
 	}
@@ -794,6 +811,7 @@ const UnitsyncMod& IBattle::LoadMod()
 			bool options_loaded = CustomBattleOptions()->loadOptions( LSL::OptionsWrapper::ModOption, m_host_mod.name );
 			ASSERT_EXCEPTION( options_loaded, "couldn't load the mod options" );
 			m_mod_loaded = true;
+			m_restrictions.Bind( usync().GetUnitsList( m_host_mod.name ) );
 		} catch (...) {}
 	}
 	return m_local_mod;
@@ -825,24 +843,22 @@ bool IBattle::ModExists() const
 
 void IBattle::RestrictUnit( const std::string& unitname, int count )
 {
-	m_restricted_units[ unitname ] = count;
+	m_restrictions.Restrict( unitname, count );
 }
 
 void IBattle::UnrestrictUnit( const std::string& unitname )
 {
-	std::map<std::string,int>::iterator pos = m_restricted_units.find( unitname );
-	if ( pos == m_restricted_units.end() ) return;
-	m_restricted_units.erase( pos );
+	m_restrictions.Unrestrict( unitname );
 }
 
 void IBattle::UnrestrictAllUnits()
 {
-	m_restricted_units.clear();
+	m_restrictions.Clear();
 }
 
 std::map<std::string,int> IBattle::RestrictedUnits() const
 {
-	return m_restricted_units;
+	return m_restrictions.ToMap();
 }
 
 void IBattle::OnSelfLeftBattle()
@@ -862,147 +878,236 @@ void IBattle::OnSelfLeftBattle()
 		}
 	}
 	ClearStartRects();
-	m_teams_sizes.clear();
-	m_ally_sizes.clear();
-	m_players_ready = 0;
-	m_players_sync = 0;
-	m_players_ok = 0;
 	usync().UnSetCurrentMod(); //left battle
 }
 
 void IBattle::OnUnitsyncReloaded()
 {
+	m_sync.Invalidate();
 	if ( !m_host_mod.hash.empty() ) m_mod_exists = usync().ModExists( m_host_mod.name, m_host_mod.hash);
 	else m_mod_exists = usync().ModExists( m_host_mod.name );
 	if ( !m_host_map.hash.empty() )  m_map_exists = usync().MapExists( m_host_map.name, m_host_map.hash );
 	else  m_map_exists = usync().MapExists( m_host_map.name );
 }
 
-static std::string FixPresetName( const std::string& name )
+//! the hosting presets stored in the settings
+static PresetStore LoadHostingPresets()
 {
-	// look name up case-insensitively
-	const StringVector& presetList = sett().GetPresetList();
-	const int index = Util::IndexInSequenceIf( presetList, Util::Predicates::CaseInsensitive( name ) );
-	if ( index == lslNotFound )
-		return "";
-	// set preset to the actual name, with correct case
-	return presetList[index];
+	PresetStore presets;
+	const StringVector names = sett().GetPresetList();
+	for ( size_t n = 0; n < names.size(); ++n )
+	{
+		std::vector<StringMap> categories( LSL::OptionsWrapper::LastOption );
+		for ( size_t i = 0; i < categories.size(); ++i )
+			categories[i] = sett().GetHostingPreset( names[n], i );
+		presets.Put( HostingPreset::FromSettings( names[n], categories ) );
+	}
+	return presets;
 }
 
-bool IBattle::LoadOptionsPreset( const std::string& name )
+/** presets by case folded name, shared by all battles and read from the
+ * settings the first time one is asked for. Every access locks, presets are
+ * handed out as copies so none is read while another thread replaces it */
+class SharedPresets
 {
-	std::string preset = FixPresetName(name);
-	if (preset == "") return false; //preset not found
-	m_preset = preset;
+public:
+	SharedPresets() : m_loaded( false ) {}
 
-	for ( unsigned int i = 0; i < LSL::OptionsWrapper::LastOption; i++)
+	//! copies the preset called \param name in any case to \param preset, false if there is none
+	bool Find( const std::string& name, HostingPreset& preset )
 	{
-		std::map<std::string,std::string> options = sett().GetHostingPreset( m_preset, i );
-		if ( (LSL::OptionsWrapper::GameOption)i != LSL::OptionsWrapper::PrivateOptions )
+		boost::mutex::scoped_lock lock( m_mutex );
+		const HostingPreset* found = Loaded().Find( name );
+		if ( found ) preset = *found;
+		return found != NULL;
+	}
+	//! the stored name of the preset called \param name in any case, empty if there is none
+	std::string StoredName( const std::string& name )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		const HostingPreset* found = Loaded().Find( name );
+		return found ? found->name : std::string();
+	}
+	void Put( const HostingPreset& preset )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		Loaded().Put( preset );
+	}
+	void Remove( const std::string& name )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		Loaded().Remove( name );
+	}
+	StringVector Names()
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		return Loaded().Names();
+	}
+	void Reload()
+	{
+		PresetStore presets = LoadHostingPresets();
+		boost::mutex::scoped_lock lock( m_mutex );
+		m_presets = presets;
+		m_loaded = true;
+	}
+
+private:
+	//! call with m_mutex held
+	PresetStore& Loaded()
+	{
+		if ( !m_loaded )
 		{
-			for ( std::map<std::string,std::string>::const_iterator itor = options.begin(); itor != options.end(); ++itor )
-			{
-				CustomBattleOptions()->setSingleOption( itor->first, itor->second, (LSL::OptionsWrapper::GameOption)i );
-			}
+			m_presets = LoadHostingPresets();
+			m_loaded = true;
 		}
-		else
-		{
-			if ( !options["mapname"].empty() )
-			{
-				if ( usync().MapExists( options["mapname"] ) ) {
-					UnitsyncMap map = usync().GetMapEx( options["mapname"] );
-					SetLocalMap( map );
-					SendHostInfo( Enum::HI_Map );
-				}
-//				else if ( !ui().OnPresetRequiringMap( options["mapname"] ) ) {
-//					//user didn't want to download the missing map, so set to empty to not have it tried to be loaded again
-//					options["mapname"] = "";
-//					sett().SetHostingPreset( m_preset, i, options );
-//				}
-			}
+		return m_presets;
+	}
 
-			for( unsigned int j = 0; j <= GetLastRectIdx(); ++j ) {
-				if ( GetStartRect( j ).IsOk() )
-					RemoveStartRect(j); // remove all rects that might come from map presets
-			}
-			SendHostInfo( Enum::HI_StartRects );
+	boost::mutex m_mutex;
+	PresetStore m_presets;
+	bool m_loaded;
+};
 
-			unsigned int rectcount = Util::FromString<long>( options["numrects"] );
-			for ( unsigned int loadrect = 0; loadrect < rectcount; loadrect++)
-			{
-				int ally = Util::FromString<long>(options["rect_" + Util::ToString(loadrect) + "_ally"]);
-				if ( ally == 0 ) continue;
-				AddStartRect( ally - 1, Util::FromString<long>(options["rect_" + Util::ToString(loadrect) + "_left"]),
-							  Util::FromString<long>(options["rect_" + Util::ToString(loadrect) + "_top"]),
-							  Util::FromString<long>(options["rect_" + Util::ToString(loadrect) + "_right"]),
-							  Util::FromString<long>(options["rect_" + Util::ToString(loadrect) + "_bottom"]) );
-			}
-			SendHostInfo( Enum::HI_StartRects );
+static SharedPresets& HostingPresets()
+{
+	static SharedPresets presets;
+	return presets;
+}
 
-            m_restricted_units.clear();
-            const StringVector infos = Util::StringTokenize( options["restrictions"], "\t" );
-			for( const std::string unitinfo: infos )
-			{
-				RestrictUnit( Util::BeforeLast(unitinfo,"="),
-						Util::FromString<long>( Util::AfterLast(unitinfo,"=") ) );
-			}
-			SendHostInfo( Enum::HI_Restrictions );
-			Update( (boost::format( "%d_restrictions" ) % LSL::OptionsWrapper::PrivateOptions).str() );
+void IBattle::ReloadPresets()
+{
+	HostingPresets().Reload();
+}
+
+static std::string FixPresetName( const std::string& name )
+{
+	// look name up case-insensitively, the stored one has the correct case
+	return HostingPresets().StoredName( name );
+}
+
+bool IBattle::LoadOptionsPreset( const std::string& name )
+{
+	HostingPreset preset;
+	if ( !HostingPresets().Find( name, preset ) ) return false; //preset not found
+	m_preset = preset.name;
 
+	// only what differs from the current battle gets touched, and sent in one go
+	int update = Enum::HI_None;
+	if ( !preset.map.empty() && preset.map != m_local_map.name && usync().MapExists( preset.map ) )
+	{
+		SetLocalMap( usync().GetMapEx( preset.map ) );
+		update |= Enum::HI_Map;
+	}
+//	else if ( !ui().OnPresetRequiringMap( preset.map ) ) {
+//		//user didn't want to download the missing map, so set to empty to not have it tried to be loaded again
+//	}
+
+	for ( size_t i = 0; i < preset.options.size() && i < size_t( LSL::OptionsWrapper::LastOption ); i++ )
+	{
+		const LSL::OptionsWrapper::GameOption category = (LSL::OptionsWrapper::GameOption)i;
+		const HostingPreset::OptionList& options = preset.options[i];
+		for ( HostingPreset::OptionList::const_iterator itor = options.begin(); itor != options.end(); ++itor )
+		{
+			if ( CustomBattleOptions()->getSingleValue( itor->first, category ) == itor->second )
+				continue;
+			if ( CustomBattleOptions()->setSingleOption( itor->first, itor->second, category ) )
+				m_changed_options.push_back( std::make_pair( int( i ), itor->first ) );
 		}
 	}
-	SendHostInfo( Enum::HI_Send_All_opts );
+	if ( !m_changed_options.empty() )
+		update |= Enum::HI_Options;
+
+	// the rects of the preset replace all others, including those that came from map presets
+	std::vector<bool> kept( GetLastRectIdx() + 1, false );
+	for ( size_t r = 0; r < preset.rects.size(); ++r )
+	{
+		const PresetRect& rect = preset.rects[r];
+		if ( rect.ally < 0 )
+			continue;
+		if ( size_t( rect.ally ) < kept.size() )
+			kept[rect.ally] = true;
+		std::map<unsigned int,BattleStartRect>::iterator current = m_rects.find( rect.ally );
+		if ( current == m_rects.end() || !current->second.exist )
+		{
+			AddStartRect( rect.ally, rect.left, rect.top, rect.right, rect.bottom );
+			update |= Enum::HI_StartRects;
+			continue;
+		}
+		BattleStartRect& sr = current->second;
+		if ( !sr.todelete && sr.left == rect.left && sr.top == rect.top && sr.right == rect.right && sr.bottom == rect.bottom )
+			continue;
+		sr.todelete = false;
+		sr.left = rect.left;
+		sr.top = rect.top;
+		sr.right = rect.right;
+		sr.bottom = rect.bottom;
+		if ( !sr.toadd )
+			ResizeStartRect( rect.ally );
+		update |= Enum::HI_StartRects;
+	}
+	for ( unsigned int j = 0; j < kept.size(); ++j )
+	{
+		if ( !kept[j] && GetStartRect( j ).IsOk() )
+		{
+			RemoveStartRect( j );
+			update |= Enum::HI_StartRects;
+		}
+	}
+
+	m_restrictions.Assign( preset.restrictions );
+	if ( m_restrictions.HasChanges() )
+	{
+		update |= Enum::HI_Restrictions;
+		Update( (boost::format( "%d_restrictions" ) % LSL::OptionsWrapper::PrivateOptions).str() );
+	}
+
+	if ( update != Enum::HI_None )
+		SendHostInfo( Enum::HostInfo( update ) );
+	// a battle we don't host never takes them, don't let them pile up for the next load
+	m_changed_options.clear();
 	Signals::sig_ReloadPresetList();
 	return true;
 }
 
 void IBattle::SaveOptionsPreset( const std::string& name )
 {
-	//TODO presets needs to be modeled in a class of their own
 	m_preset = FixPresetName(name);
 	if (m_preset == "") m_preset = name; //new preset
 
+	HostingPreset preset;
+	preset.name = m_preset;
+	preset.options.resize( OptionsWrapper::LastOption );
 	for ( int i = 0; i < (int)OptionsWrapper::LastOption; i++)
 	{
-		if ( (LSL::OptionsWrapper::GameOption)i != LSL::OptionsWrapper::PrivateOptions )
-		{
-			sett().SetHostingPreset( m_preset, (LSL::OptionsWrapper::GameOption)i, CustomBattleOptions()->getOptionsMap( (LSL::OptionsWrapper::GameOption)i ) );
-		}
-		else
+		if ( (LSL::OptionsWrapper::GameOption)i == LSL::OptionsWrapper::PrivateOptions )
+			continue;
+		const StringMap options = CustomBattleOptions()->getOptionsMap( (LSL::OptionsWrapper::GameOption)i );
+		preset.options[i].assign( options.begin(), options.end() );
+	}
+	preset.map = GetHostMapName();
+	if ( Util::FromString<long> (CustomBattleOptions()->getSingleValue( "startpostype", LSL::OptionsWrapper::EngineOption ) )
+		 == Enum::ST_Choose )
+	{
+		unsigned int boxcount = GetLastRectIdx();
+		for ( unsigned int boxnum = 0; boxnum <= boxcount; boxnum++ )
 		{
-			std::map<std::string,std::string> opts;
-			opts["mapname"] = GetHostMapName();
-			unsigned int validrectcount = 0;
-			if ( Util::FromString<long> (CustomBattleOptions()->getSingleValue( "startpostype", LSL::OptionsWrapper::EngineOption ) )
-				 == Enum::ST_Choose )
+			BattleStartRect rect = GetStartRect( boxnum );
+			if ( rect.IsOk() )
 			{
-				unsigned int boxcount = GetLastRectIdx();
-				for ( unsigned int boxnum = 0; boxnum <= boxcount; boxnum++ )
-				{
-					BattleStartRect rect = GetStartRect( boxnum );
-					if ( rect.IsOk() )
-					{
-						opts["rect_" + Util::ToString(validrectcount) + "_ally"] = Util::ToString( rect.ally + 1 );
-						opts["rect_" + Util::ToString(validrectcount) + "_left"] = Util::ToString( rect.left );
-						opts["rect_" + Util::ToString(validrectcount) + "_top"] = Util::ToString( rect.top );
-						opts["rect_" + Util::ToString(validrectcount) + "_bottom"] = Util::ToString( rect.bottom );
-						opts["rect_" + Util::ToString(validrectcount) + "_right"] = Util::ToString( rect.right );
-						validrectcount++;
-					}
-				}
-			}
-			opts["numrects"] = Util::ToString( validrectcount );
-
-			std::stringstream restrictionsstring;
-			for ( std::map<std::string, int>::const_iterator itor = m_restricted_units.begin(); itor != m_restricted_units.end(); ++itor )
-			{
-				restrictionsstring << itor->first << '=' << Util::ToString(itor->second) << '\t';
+				const PresetRect saved = { rect.ally, rect.left, rect.top, rect.right, rect.bottom };
+				preset.rects.push_back( saved );
 			}
-			opts["restrictions"] = restrictionsstring.str();
-
-			sett().SetHostingPreset( m_preset, (LSL::OptionsWrapper::GameOption)i, opts );
 		}
 	}
+	std::vector< std::pair<std::string, int> >& restrictions = preset.restrictions;
+	m_restrictions.ForEach( [&restrictions]( const std::string& unit, int count ) {
+		restrictions.push_back( std::make_pair( unit, count ) );
+	} );
+	HostingPresets().Put( preset );
+
+	const std::vector<StringMap> categories = preset.ToSettings();
+	for ( size_t i = 0; i < categories.size(); i++ )
+		sett().SetHostingPreset( m_preset, i, categories[i] );
 	sett().SaveSettings();
     Signals::sig_ReloadPresetList();
 }
@@ -1016,13 +1121,14 @@ void IBattle::DeletePreset( const std::string& name )
 {
 	std::string preset = FixPresetName(name);
 	if ( m_preset == preset ) m_preset = "";
+	HostingPresets().Remove( preset );
 	sett().DeletePreset( preset );
 	Signals::sig_ReloadPresetList();
 }
 
 StringVector IBattle::GetPresetList()
 {
-	return sett().GetPresetList();
+	return HostingPresets().Names();
 }
 
 void IBattle::UserPositionChanged( const CommonUserPtr /*unused*/ )
@@ -1058,15 +1164,8 @@ bool IBattle::IsFounderMe() const
 
 bool IBattle::IsFounder( const CommonUserPtr user ) const
 {
-	if ( m_userlist.Exists( m_opts.founder ) ) {
-		try
-		{
-			return GetFounder() == user;
-		}
-		catch(UserList::MissingItemException& m){return false;}
-	}
-	else
-		return false;
+	const ConstCommonUserPtr founder = GetFounder();
+	return founder && founder == user;
 }
 
 int IBattle::GetMyPlayerNum() const
@@ -1104,8 +1203,7 @@ void IBattle::LoadScriptMMOpts( const TDF::PDataList& node )
 void IBattle::GetBattleFromScript( bool loadmapmod )
 {
 	BattleOptions opts;
-	std::stringstream ss ( GetScript() );
-    TDF::PDataList script( TDF::ParseTDF(ss) );
+    TDF::PDataList script( TDF::ParseTDF( GetScript() ) );
 
     TDF::PDataList replayNode ( script->Find("GAME" ) );
 	if ( replayNode.ok() )
@@ -1140,17 +1238,17 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 			sides = usync().GetSides( modname );
 		}
 
-		IBattle::TeamVec parsed_teams = GetParsedTeamsVec();
-		IBattle::AllyVec parsed_allies = GetParsedAlliesVec();
+		// one walk over the GAME section instead of a lookup per player, team and ally
+		const ScriptSections sections( replayNode, std::max( playernum, 0 ), replayNode->GetInt( "NumTeams", 0 ),
+			replayNode->GetInt( "NumAllyTeams", 0 ) );
 
 		//[PLAYERX] sections
 		for ( int i = 0; i < playernum ; ++i )
 		{
-            TDF::PDataList player ( replayNode->Find( "PLAYER" + Util::ToString(i) ) );
-            TDF::PDataList bot ( replayNode->Find( "AI" + Util::ToString(i) ) );
-			if ( player.ok() || bot.ok() )
+			const TDF::PDataList bot( sections.Bot( i ) );
+			const TDF::PDataList player( bot.ok() ? bot : sections.Player( i ) );
+			if ( player.ok() )
 			{
-				if ( bot.ok() ) player = bot;
                 const CommonUserPtr user( new CommonUser( User::GetNewUserId(), player->GetString( "Name" ),
                                                     boost::to_upper_copy(player->GetString( "CountryCode") )) );
 				UserBattleStatus& status = user->BattleStatus();
@@ -1158,22 +1256,9 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 				status.spectator = player->GetInt( "Spectator", 0 );
 				opts.spectators += user->BattleStatus().spectator;
 				status.team = player->GetInt( "Team" );
-				if ( !status.spectator )
-				{
-					PlayerJoinedTeam( status.team );
-				}
 				status.sync = true;
 				status.ready = true;
 				if ( status.spectator ) m_opts.spectators++;
-				else
-				{
-					if ( !bot.ok() )
-					{
-						if ( status.ready) m_players_ready++;
-						if ( status.sync ) m_players_sync++;
-						if ( status.sync && status.ready ) m_players_ok++;
-					}
-				}
 
 				//! (koshi) changed this from ServerRankContainer to RankContainer
 				user->Status().rank = (UserStatus::RankContainer)player->GetInt( "Rank", -1 );
@@ -1182,18 +1267,17 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 				{
 					status.aishortname = bot->GetString( "ShortName" );
 					status.aiversion = bot->GetString( "Version" );
-					int ownerindex = bot->GetInt( "Host" );
-                    TDF::PDataList aiowner ( replayNode->Find( "PLAYER" + Util::ToString(ownerindex) ) );
+					const TDF::PDataList aiowner( sections.Player( bot->GetInt( "Host" ) ) );
 					if ( aiowner.ok() )
 					{
 						status.owner = aiowner->GetString( "Name" );
 					}
 				}
 
-				IBattle::TeamInfoContainer teaminfos = parsed_teams[user->BattleStatus().team];
+				IBattle::TeamInfoContainer& teaminfos = m_parsed_teams[status.team];
 				if ( !teaminfos.exist )
 				{
-                    TDF::PDataList team( replayNode->Find( "TEAM" + Util::ToString( user->BattleStatus().team ) ) );
+					const TDF::PDataList team( sections.Team( status.team ) );
 					if ( team.ok() )
 					{
 						teaminfos.exist = true;
@@ -1204,9 +1288,7 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
                         teaminfos.RGBColor = Util::ColorFromFloatString( team->GetString( "RGBColor" ) );
 						teaminfos.SideName = team->GetString( "Side", "" );
 						teaminfos.Handicap = team->GetInt( "Handicap", 0 );
-						int sidepos = Util::IndexInSequence( sides, teaminfos.SideName );
-						teaminfos.SideNum = sidepos;
-						parsed_teams[ user->BattleStatus().team ] = teaminfos;
+						teaminfos.SideNum = Util::IndexInSequence( sides, teaminfos.SideName );
 					}
 				}
 				if ( teaminfos.exist )
@@ -1216,15 +1298,11 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 					status.pos.y = teaminfos.StartPosY;
 					status.color = teaminfos.RGBColor;
 					status.handicap = teaminfos.Handicap;
-					if ( !status.spectator )
-					{
-						PlayerJoinedAlly( status.ally );
-					}
 					if ( teaminfos.SideNum >= 0 ) status.side = teaminfos.SideNum;
-					IBattle::AllyInfoContainer allyinfos = parsed_allies[user->BattleStatus().ally];
+					IBattle::AllyInfoContainer& allyinfos = m_parsed_allies[status.ally];
 					if ( !allyinfos.exist )
 					{
-                        TDF::PDataList ally( replayNode->Find( "ALLYTEAM" + Util::ToString( user->BattleStatus().ally ) ) );
+						const TDF::PDataList ally( sections.Ally( status.ally ) );
 						if ( ally.ok() )
 						{
 							allyinfos.exist = true;
@@ -1233,8 +1311,7 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 							allyinfos.StartRectTop = ally->GetInt( "StartRectTop", 0 );
 							allyinfos.StartRectRight = ally->GetInt( "StartRectRight", 0 );
 							allyinfos.StartRectBottom = ally->GetInt( "StartRectBottom", 0 );
-							parsed_allies[ user->BattleStatus().ally ] = allyinfos;
-							AddStartRect( user->BattleStatus().ally, allyinfos.StartRectTop, allyinfos.StartRectTop, allyinfos.StartRectRight, allyinfos.StartRectBottom );
+							AddStartRect( status.ally, allyinfos.StartRectLeft, allyinfos.StartRectTop, allyinfos.StartRectRight, allyinfos.StartRectBottom );
 						}
 					}
 				}
@@ -1243,8 +1320,7 @@ void IBattle::GetBattleFromScript( bool loadmapmod )
 			}
 
 		}
-		SetParsedTeamsVec( parsed_teams );
-		SetParsedAlliesVec( parsed_allies );
+		RecountStatus();
 
 		//MMoptions, this'll fail unless loading map/mod into wrapper first
 		if ( loadmapmod )
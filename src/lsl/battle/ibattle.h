@@ -8,6 +8,12 @@
 #include <lslunitsync/data.h>
 
 #include "enum.h"
+#include "occupancy.h"
+#include "membership.h"
+#include "deadlinequeue.h"
+#include "scripttags.h"
+#include "restrictions.h"
+#include "syncstate.h"
 
 #include <sstream>
 #include <boost/scoped_ptr.hpp>
@@ -161,6 +167,8 @@ public:
     void OnUserAdded(const CommonUserPtr user );
     void OnUserBattleStatusUpdated(CommonUserPtr user, UserBattleStatus status );
     void OnUserRemoved(CommonUserPtr user );
+    //! \param user was renamed from \param old_nick while in the battle
+    void OnUserRenamed( const CommonUserPtr user, const std::string& old_nick );
 
     void ForceSide(const CommonUserPtr user, int side );
     void ForceAlly( const CommonUserPtr user, int ally );
@@ -202,6 +210,17 @@ public:
 	virtual void UnrestrictUnit( const std::string& unitname );
 	virtual void UnrestrictAllUnits();
 	virtual std::map<std::string,int> RestrictedUnits() const;
+	const UnitRestrictions& Restrictions() const { return m_restrictions; }
+	//! restriction changes since the last call, for the host to send
+	UnitRestrictions::Changes TakeRestrictionChanges() { return m_restrictions.TakeChanges(); }
+	//! (category, key) of the options the preset being loaded changed, for HI_Options;
+	//! only valid while LoadOptionsPreset dispatches its SendHostInfo, which hands this battle to the server
+	std::vector< std::pair<int, std::string> > TakeChangedOptions()
+	{
+		std::vector< std::pair<int, std::string> > changed;
+		changed.swap( m_changed_options );
+		return changed;
+	}
 
 	virtual void OnUnitsyncReloaded(  );
 
@@ -213,6 +232,8 @@ public:
 	virtual std::string GetCurrentPreset();
 	virtual void DeletePreset( const std::string& name );
 	virtual StringVector GetPresetList();
+	//! rereads the presets shared by all battles from the settings, e.g. after they were edited elsewhere
+	static void ReloadPresets();
 
     std::vector<lslColor> &GetFixColorsPalette( int numteams ) const;
     virtual int GetClosestFixColor(const lslColor &col, const std::vector<int> &excludes, int difference) const;
@@ -221,14 +242,19 @@ public:
     lslColor GetNewColor() const;
     int ColorDifference(const lslColor &a, const lslColor &b)  const;
 
-    const ConstCommonUserPtr GetFounder() const { return m_userlist.Get( m_opts.founder ); }
-    CommonUserPtr GetFounder() { return m_userlist.Get( m_opts.founder ); }
+    //! null while the founder isn't in the battle
+    const ConstCommonUserPtr GetFounder() const { return m_userlist.FindByNick( m_opts.founder ); }
+    CommonUserPtr GetFounder() { return m_userlist.FindByNick( m_opts.founder ); }
 
 	bool IsFull() const { return GetMaxPlayers() == GetNumActivePlayers(); }
 
+    //! copies the userlist, only needed when the battle may change while iterating
     ConstCommonUserVector Users() const { return m_userlist.Vectorize(); }
     CommonUserVector Users() { return m_userlist.Vectorize(); }
-    unsigned int GetNumUsers() { return m_userlist.size(); }
+    //! non-copying view on the userlist, invalidated by adding/removing users
+    CommonUserList::ConstView UsersView() const { return m_userlist.Items(); }
+    CommonUserList::View UsersView() { return m_userlist.Items(); }
+    unsigned int GetNumUsers() const { return m_userlist.size(); }
     unsigned int GetNumPlayers() const;
     unsigned int GetNumActivePlayers() const;
     unsigned int GetNumReadyPlayers() const { return m_players_ready; }
@@ -324,7 +350,12 @@ public:
 	virtual std::map<int, int> GetAllySizes() { return m_ally_sizes; }
 	virtual std::map<int, int> GetTeamSizes() { return m_teams_sizes; }
 
-	std::map<std::string, std::string> m_script_tags; // extra script tags to reload in the case of map/mod reload
+	//! users ( bots included, spectators not ) in control team \param team
+	const CommonUserVector& GetTeamMembers( int team ) const { return m_team_members.Members( team ); }
+	//! users ( bots included, spectators not ) in allyteam \param ally
+	const CommonUserVector& GetAllyMembers( int ally ) const { return m_ally_members.Members( ally ); }
+
+	ScriptTags m_script_tags; // extra script tags to reload in the case of map/mod reload
 
     long GetBattleRunningTime() const; // returns 0 if not started
 
@@ -333,12 +364,29 @@ public:
 
     CommonUserPtr GetUser( const std::string& nick );
 
+protected:
+	//! replaces the battle status of \param user, keeping the battle wide counts in step if it is listed
+	void SetUserBattleStatus( const CommonUserPtr user, const UserBattleStatus& status );
+	//! generation of the unitsync map and game lists, IsSynced keeps its result while it stays the same
+	virtual size_t GetCatalogGeneration() const;
+	//! IsSynced without the memo: loads the local archives and compares them with the host's
+	virtual bool CheckSynced();
+
 private:
 	void PlayerLeftTeam( int team );
 	void PlayerLeftAlly( int ally );
 	void PlayerJoinedTeam( int team );
 	void PlayerJoinedAlly( int ally );
 
+	/** adds ( \param sign = 1 ) or removes ( -1 ) what the status of \param user contributes to the
+	 * battle wide counts and member indices, every change of a battle status in the userlist goes
+	 * between a pair of these */
+	void CountStatus( const CommonUserPtr& user, int sign );
+	//! rebuilds all counts and member indices from the userlist
+	void RecountStatus();
+	//! compares the counts against a full recount, only built in with LSL_CHECK_STATUS_COUNTS
+	void CheckStatusCounts() const;
+
 	bool m_map_loaded;
 	bool m_mod_loaded;
 	bool m_map_exists;
@@ -349,7 +397,10 @@ private:
 	UnitsyncMod m_host_mod;
 	std::string m_previous_local_mod_name;
 
-	std::map<std::string, int> m_restricted_units;
+	UnitRestrictions m_restrictions;
+	//! what IsSynced last found, for the host archives and unitsync catalog it looked at
+	SyncState m_sync;
+	std::vector< std::pair<int, std::string> > m_changed_options;
 
 	OptionsWrapperPtr m_opt_wrap;
 
@@ -357,11 +408,14 @@ private:
 
 	std::map<unsigned int,BattleStartRect> m_rects;
 
+	unsigned int m_spectators; // spectators in the userlist, m_opts.spectators may come from the server instead
+	unsigned int m_players_active; // users neither spectating nor bots
 	unsigned int m_players_ready;
 	unsigned int m_players_sync;
 	unsigned int m_players_ok; // players which are ready and in sync
 
-	std::map<int, int> m_ally_sizes; // allyteam -> number of people in
+	std::map<int, int> m_ally_sizes; // allyteam -> number of people in, bots not counted
+	Occupancy m_ally_occupancy; // allyteams with at least one player or bot, mirrors m_ally_members
 
 	std::string m_preset;
 
@@ -381,8 +435,11 @@ protected:
     CommonUserList m_userlist;
     bool m_generating_script;
     boost::scoped_ptr< boost::asio::deadline_timer > m_timer;
-    std::map<std::string, time_t> m_ready_up_map; // player name -> time counting from join/unspect
-    std::map<int, int> m_teams_sizes; // controlteam -> number of people in
+    DeadlineQueue<std::string> m_ready_up; // unready players by key -> time counting from join/unspect, resolved through m_userlist
+    std::map<int, int> m_teams_sizes; // controlteam -> number of people in, bots not counted
+    Occupancy m_team_occupancy; // controlteams with at least one player or bot, mirrors m_team_members
+    MemberIndex m_team_members; // controlteam -> players and bots in
+    MemberIndex m_ally_members; // allyteam -> players and bots in
 };
 
 } // namespace Battle
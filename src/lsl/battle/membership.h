@@ -0,0 +1,88 @@
+#ifndef LSL_HEADERGUARD_BATTLE_MEMBERSHIP_H
+#define LSL_HEADERGUARD_BATTLE_MEMBERSHIP_H
+
+#include <algorithm>
+#include <map>
+#include <lslutils/type_forwards.h>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief team or ally number -> the users in it
+ * Numbers without members are dropped, so iterating visits taken numbers only,
+ * in ascending order. Members keep the order they were added in until one leaves.
+ **/
+class MemberIndex
+{
+public:
+	typedef std::map<int, CommonUserVector> Map;
+	typedef Map::const_iterator const_iterator;
+
+	void Add( int num, const CommonUserPtr& user )
+	{
+		m_members[num].push_back( user );
+	}
+
+	void Remove( int num, const CommonUserPtr& user )
+	{
+		Map::iterator it = m_members.find( num );
+		if ( it == m_members.end() )
+			return;
+		CommonUserVector& members = it->second;
+		CommonUserVector::iterator pos = std::find( members.begin(), members.end(), user );
+		if ( pos != members.end() )
+			members.erase( pos );
+		if ( members.empty() )
+			m_members.erase( it );
+	}
+
+	//! the users in \param num, empty if there are none
+	const CommonUserVector& Members( int num ) const
+	{
+		static const CommonUserVector none;
+		const_iterator it = m_members.find( num );
+		return it == m_members.end() ? none : it->second;
+	}
+
+	size_t Count( int num ) const { return Members( num ).size(); }
+
+	const_iterator begin() const { return m_members.begin(); }
+	const_iterator end() const { return m_members.end(); }
+	size_t size() const { return m_members.size(); }
+	void clear() { m_members.clear(); }
+
+private:
+	Map m_members;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_MEMBERSHIP_H
+
+/**
+ * \file membership.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,99 @@
+#ifndef LSL_HEADERGUARD_BATTLE_OCCUPANCY_H
+#define LSL_HEADERGUARD_BATTLE_OCCUPANCY_H
+
+#include <cstddef>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <lslutils/bits.h>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief set of taken team or ally numbers
+ * grows with the highest number set, up to LIMIT. Numbers outside [0,LIMIT)
+ * are not tracked, FirstFree returns LIMIT once everything below it is taken
+ * and the caller has to look further itself. FirstFree looks at one 64bit
+ * word at a time.
+ **/
+class Occupancy
+{
+public:
+	//! far above what spring allows, keeps a bogus number from the server from allocating much
+	static const int LIMIT = 1 << 16;
+
+	void Set( int num )
+	{
+		if ( !InRange( num ) )
+			return;
+		if ( size_t( num / BITS ) >= m_words.size() )
+			m_words.resize( num / BITS + 1, 0 );
+		m_words[num / BITS] |= Bit( num );
+	}
+
+	void Reset( int num )
+	{
+		if ( Tracked( num ) )
+			m_words[num / BITS] &= ~Bit( num );
+	}
+
+	bool Test( int num ) const
+	{
+		return Tracked( num ) && ( m_words[num / BITS] & Bit( num ) );
+	}
+
+	void clear() { m_words.clear(); }
+
+	//! lowest number not taken, treating \param ignore as free; LIMIT if all below it are taken
+	int FirstFree( int ignore = -1 ) const
+	{
+		for ( size_t w = 0; w < m_words.size(); ++w ) {
+			boost::uint64_t taken = m_words[w];
+			if ( Tracked( ignore ) && size_t( ignore / BITS ) == w )
+				taken &= ~Bit( ignore );
+			if ( ~taken )
+				return int( w * BITS + Util::CountTrailingZeros( ~taken ) );
+		}
+		return int( m_words.size() * BITS );
+	}
+
+private:
+	static const size_t BITS = 64;
+
+	static bool InRange( int num ) { return num >= 0 && num < LIMIT; }
+	bool Tracked( int num ) const { return num >= 0 && size_t( num / BITS ) < m_words.size(); }
+	static boost::uint64_t Bit( int num ) { return boost::uint64_t(1) << ( num % BITS ); }
+
+	std::vector<boost::uint64_t> m_words;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_OCCUPANCY_H
+
+/**
+ * \file occupancy.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -48,17 +48,24 @@ OfflineBattle& OfflineBattle::operator = ( const OfflineBattle& other )
     m_local_mod = other.m_local_mod;
     m_host_map = other.m_host_map;
     m_host_mod = other.m_host_mod;
-    m_restricted_units = other.m_restricted_units;
+    m_restrictions = other.m_restrictions;
     m_opt_wrap = other.m_opt_wrap;
     m_opts = other.m_opts;
     m_ingame = other.m_ingame;
     m_generating_script = other.m_generating_script;
     m_rects = other.m_rects;
-    m_ready_up_map = other.m_ready_up_map; // player name -> time counting from join/unspect
+    m_ready_up = other.m_ready_up; // unready players -> time counting from join/unspect
+    m_spectators = other.m_spectators;
+    m_players_active = other.m_players_active;
     m_players_ready = other.m_players_ready;
     m_players_sync = other.m_players_sync;
+    m_players_ok = other.m_players_ok;
     m_teams_sizes = other.m_teams_sizes; // controlteam -> number of people in
     m_ally_sizes = other.m_ally_sizes; // allyteam -> number of people in
+    m_team_occupancy = other.m_team_occupancy;
+    m_ally_occupancy = other.m_ally_occupancy;
+    m_team_members = other.m_team_members;
+    m_ally_members = other.m_ally_members;
     m_preset = other.m_preset;
     m_is_self_in = other.m_is_self_in;
     m_internal_bot_list = other.m_internal_bot_list;
@@ -0,0 +1,307 @@
+#include "presets.h"
+#include "restrictions.h"
+
+#include <lslunitsync/optionswrapper.h>
+#include <lslutils/conversion.h>
+#include <lslutils/casefold.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <boost/cstdint.hpp>
+
+namespace LSL {
+namespace Battle {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = { 'L', 'S', 'L', 'P' };
+const boost::uint32_t SNAPSHOT_VERSION = 1;
+
+//! little endian, fixed width, so snapshots move between machines
+class Writer
+{
+public:
+	explicit Writer( std::string& out ) : m_out( out ) {}
+
+	void U32( boost::uint32_t v )
+	{
+		for ( int i = 0; i < 4; ++i )
+			m_out += char( ( v >> ( 8 * i ) ) & 0xff );
+	}
+	void I32( int v ) { U32( boost::uint32_t( v ) ); }
+	void String( const std::string& s )
+	{
+		U32( boost::uint32_t( s.size() ) );
+		m_out += s;
+	}
+
+private:
+	std::string& m_out;
+};
+
+//! reads what Writer wrote, every read fails once the data ran out
+class Reader
+{
+public:
+	explicit Reader( const std::string& in ) : m_pos( in.data() ), m_end( in.data() + in.size() ) {}
+
+	bool U32( boost::uint32_t& v )
+	{
+		if ( m_end - m_pos < 4 )
+			return false;
+		v = 0;
+		for ( int i = 0; i < 4; ++i )
+			v |= boost::uint32_t( static_cast<unsigned char>( m_pos[i] ) ) << ( 8 * i );
+		m_pos += 4;
+		return true;
+	}
+	bool I32( int& v )
+	{
+		boost::uint32_t u;
+		if ( !U32( u ) )
+			return false;
+		v = int( u );
+		return true;
+	}
+	bool String( std::string& s )
+	{
+		boost::uint32_t size;
+		if ( !U32( size ) || boost::uint32_t( m_end - m_pos ) < size )
+			return false;
+		s.assign( m_pos, size );
+		m_pos += size;
+		return true;
+	}
+	//! a count of entries that take at least \param min_size bytes each
+	bool Count( boost::uint32_t& count, size_t min_size )
+	{
+		return U32( count ) && count <= size_t( m_end - m_pos ) / min_size;
+	}
+	bool Raw( const char* data, size_t size )
+	{
+		if ( size_t( m_end - m_pos ) < size || std::memcmp( m_pos, data, size ) != 0 )
+			return false;
+		m_pos += size;
+		return true;
+	}
+	bool AtEnd() const { return m_pos == m_end; }
+
+private:
+	const char* m_pos;
+	const char* const m_end;
+};
+
+void WritePreset( Writer& out, const HostingPreset& preset )
+{
+	out.String( preset.name );
+	out.U32( boost::uint32_t( preset.options.size() ) );
+	for ( size_t c = 0; c < preset.options.size(); ++c ) {
+		out.U32( boost::uint32_t( preset.options[c].size() ) );
+		for ( size_t i = 0; i < preset.options[c].size(); ++i ) {
+			out.String( preset.options[c][i].first );
+			out.String( preset.options[c][i].second );
+		}
+	}
+	out.String( preset.map );
+	out.U32( boost::uint32_t( preset.rects.size() ) );
+	for ( size_t i = 0; i < preset.rects.size(); ++i ) {
+		const PresetRect& rect = preset.rects[i];
+		out.I32( rect.ally );
+		out.I32( rect.left );
+		out.I32( rect.top );
+		out.I32( rect.right );
+		out.I32( rect.bottom );
+	}
+	out.U32( boost::uint32_t( preset.restrictions.size() ) );
+	for ( size_t i = 0; i < preset.restrictions.size(); ++i ) {
+		out.String( preset.restrictions[i].first );
+		out.I32( preset.restrictions[i].second );
+	}
+}
+
+bool ReadPreset( Reader& in, HostingPreset& preset )
+{
+	boost::uint32_t count;
+	if ( !in.String( preset.name ) || !in.Count( count, 4 ) )
+		return false;
+	preset.options.resize( count );
+	for ( size_t c = 0; c < preset.options.size(); ++c ) {
+		if ( !in.Count( count, 8 ) )
+			return false;
+		preset.options[c].resize( count );
+		for ( size_t i = 0; i < count; ++i )
+			if ( !in.String( preset.options[c][i].first ) || !in.String( preset.options[c][i].second ) )
+				return false;
+	}
+	if ( !in.String( preset.map ) || !in.Count( count, 20 ) )
+		return false;
+	preset.rects.resize( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		PresetRect& rect = preset.rects[i];
+		if ( !in.I32( rect.ally ) || !in.I32( rect.left ) || !in.I32( rect.top ) || !in.I32( rect.right )
+			 || !in.I32( rect.bottom ) )
+			return false;
+	}
+	if ( !in.Count( count, 8 ) )
+		return false;
+	preset.restrictions.resize( count );
+	for ( size_t i = 0; i < count; ++i )
+		if ( !in.String( preset.restrictions[i].first ) || !in.I32( preset.restrictions[i].second ) )
+			return false;
+	return true;
+}
+
+long Number( const StringMap& map, const std::string& key )
+{
+	StringMap::const_iterator it = map.find( key );
+	return it == map.end() ? 0 : Util::FromString<long>( it->second );
+}
+
+} // namespace
+
+HostingPreset HostingPreset::FromSettings( const std::string& name, const std::vector<StringMap>& categories )
+{
+	HostingPreset preset;
+	preset.name = name;
+	preset.options.resize( categories.size() );
+	for ( size_t c = 0; c < categories.size(); ++c ) {
+		const StringMap& options = categories[c];
+		if ( c != size_t( OptionsWrapper::PrivateOptions ) ) {
+			preset.options[c].assign( options.begin(), options.end() );
+			continue;
+		}
+		StringMap::const_iterator map = options.find( "mapname" );
+		if ( map != options.end() )
+			preset.map = map->second;
+		const long rectcount = Number( options, "numrects" );
+		for ( long r = 0; r < rectcount; ++r ) {
+			const std::string prefix = "rect_" + Util::ToString( r ) + "_";
+			const long ally = Number( options, prefix + "ally" );
+			if ( ally == 0 )
+				continue;
+			const PresetRect rect = { int( ally - 1 ), int( Number( options, prefix + "left" ) ),
+									  int( Number( options, prefix + "top" ) ), int( Number( options, prefix + "right" ) ),
+									  int( Number( options, prefix + "bottom" ) ) };
+			preset.rects.push_back( rect );
+		}
+		StringMap::const_iterator restrictions = options.find( "restrictions" );
+		if ( restrictions != options.end() )
+			preset.restrictions = UnitRestrictions::ParsePresetString( restrictions->second );
+	}
+	return preset;
+}
+
+std::vector<StringMap> HostingPreset::ToSettings() const
+{
+	std::vector<StringMap> categories( std::max( options.size(), size_t( OptionsWrapper::PrivateOptions ) + 1 ) );
+	for ( size_t c = 0; c < options.size(); ++c )
+		categories[c].insert( options[c].begin(), options[c].end() );
+	StringMap& opts = categories[OptionsWrapper::PrivateOptions];
+	opts["mapname"] = map;
+	for ( size_t r = 0; r < rects.size(); ++r ) {
+		const std::string prefix = "rect_" + Util::ToString( r ) + "_";
+		opts[prefix + "ally"] = Util::ToString( rects[r].ally + 1 );
+		opts[prefix + "left"] = Util::ToString( rects[r].left );
+		opts[prefix + "top"] = Util::ToString( rects[r].top );
+		opts[prefix + "bottom"] = Util::ToString( rects[r].bottom );
+		opts[prefix + "right"] = Util::ToString( rects[r].right );
+	}
+	opts["numrects"] = Util::ToString( rects.size() );
+	std::string text;
+	for ( size_t i = 0; i < restrictions.size(); ++i )
+		text += restrictions[i].first + "=" + Util::ToString( restrictions[i].second ) + "\t";
+	opts["restrictions"] = text;
+	return categories;
+}
+
+const HostingPreset* PresetStore::Find( const std::string& name ) const
+{
+	boost::unordered_map<std::string, HostingPreset>::const_iterator it = m_presets.find( Fold( name ) );
+	return it == m_presets.end() ? NULL : &it->second;
+}
+
+void PresetStore::Put( const HostingPreset& preset )
+{
+	HostingPreset& stored = m_presets[Fold( preset.name )];
+	stored = preset;
+	// the option lists are looked up and diffed by key
+	for ( size_t c = 0; c < stored.options.size(); ++c )
+		std::sort( stored.options[c].begin(), stored.options[c].end() );
+}
+
+bool PresetStore::Remove( const std::string& name )
+{
+	return m_presets.erase( Fold( name ) ) > 0;
+}
+
+StringVector PresetStore::Names() const
+{
+	StringVector result;
+	result.reserve( m_presets.size() );
+	for ( boost::unordered_map<std::string, HostingPreset>::const_iterator it = m_presets.begin(); it != m_presets.end(); ++it )
+		result.push_back( it->second.name );
+	std::sort( result.begin(), result.end() );
+	return result;
+}
+
+std::string PresetStore::Snapshot() const
+{
+	std::string result( SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) );
+	Writer out( result );
+	out.U32( SNAPSHOT_VERSION );
+	out.U32( boost::uint32_t( m_presets.size() ) );
+	for ( boost::unordered_map<std::string, HostingPreset>::const_iterator it = m_presets.begin(); it != m_presets.end(); ++it )
+		WritePreset( out, it->second );
+	return result;
+}
+
+bool PresetStore::LoadSnapshot( const std::string& data )
+{
+	Reader in( data );
+	boost::uint32_t version, count;
+	if ( !in.Raw( SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) ) || !in.U32( version ) || version != SNAPSHOT_VERSION
+		 || !in.Count( count, 4 ) )
+		return false;
+	boost::unordered_map<std::string, HostingPreset> presets;
+	presets.reserve( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		HostingPreset preset;
+		if ( !ReadPreset( in, preset ) )
+			return false;
+		const std::string key = Fold( preset.name );
+		std::swap( presets[key], preset );
+	}
+	if ( !in.AtEnd() )
+		return false;
+	m_presets.swap( presets );
+	return true;
+}
+
+bool PresetStore::SaveSnapshotFile( const std::string& path ) const
+{
+	std::ofstream file( path.c_str(), std::ios::binary | std::ios::trunc );
+	const std::string data = Snapshot();
+	file.write( data.data(), data.size() );
+	return bool( file );
+}
+
+bool PresetStore::LoadSnapshotFile( const std::string& path )
+{
+	std::ifstream file( path.c_str(), std::ios::binary );
+	if ( !file.is_open() )
+		return false;
+	const std::string data( ( std::istreambuf_iterator<char>( file ) ), std::istreambuf_iterator<char>() );
+	return LoadSnapshot( data );
+}
+
+std::string PresetStore::Fold( const std::string& name )
+{
+	std::string folded( name );
+	std::transform( folded.begin(), folded.end(), folded.begin(), Util::FoldChar );
+	return folded;
+}
+
+} // namespace Battle
+} // namespace LSL
@@ -0,0 +1,109 @@
+#ifndef LSL_HEADERGUARD_BATTLE_PRESETS_H
+#define LSL_HEADERGUARD_BATTLE_PRESETS_H
+
+#include <lslutils/type_forwards.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+namespace LSL {
+namespace Battle {
+
+//! a start rect as presets keep it, ally counts from 0
+struct PresetRect
+{
+	int ally, left, top, right, bottom;
+	bool operator == ( const PresetRect& o ) const
+	{
+		return ally == o.ally && left == o.left && top == o.top && right == o.right && bottom == o.bottom;
+	}
+};
+
+/** \brief a hosting preset with its private options already typed
+ * options holds one sorted key/value list per OptionsWrapper category, the one of
+ * PrivateOptions stays empty since map, rects and restrictions have their own fields
+ **/
+struct HostingPreset
+{
+	typedef std::vector< std::pair<std::string, std::string> > OptionList;
+
+	std::string name;
+	std::vector<OptionList> options;
+	std::string map;
+	std::vector<PresetRect> rects;
+	std::vector< std::pair<std::string, int> > restrictions;
+
+	bool operator == ( const HostingPreset& o ) const
+	{
+		return name == o.name && options == o.options && map == o.map && rects == o.rects && restrictions == o.restrictions;
+	}
+
+	//! converts the per category maps the settings store presets as
+	static HostingPreset FromSettings( const std::string& name, const std::vector<StringMap>& categories );
+	//! and back, one map per category
+	std::vector<StringMap> ToSettings() const;
+};
+
+/** \brief hosting presets by case folded name
+ * Snapshot and LoadSnapshot write and read all presets as one binary blob, so a host
+ * can keep them without going through the settings for every category of every preset.
+ **/
+class PresetStore
+{
+public:
+	//! \return the preset called \param name in any case, NULL if there is none
+	const HostingPreset* Find( const std::string& name ) const;
+	//! adds \param preset or replaces the one with the same name in any case
+	void Put( const HostingPreset& preset );
+	bool Remove( const std::string& name );
+	void Clear() { m_presets.clear(); }
+
+	StringVector Names() const;
+	size_t size() const { return m_presets.size(); }
+	bool empty() const { return m_presets.empty(); }
+
+	std::string Snapshot() const;
+	//! replaces all presets with the ones in \param data, \return false and keeps them if it isn't a valid snapshot
+	bool LoadSnapshot( const std::string& data );
+	bool SaveSnapshotFile( const std::string& path ) const;
+	bool LoadSnapshotFile( const std::string& path );
+
+private:
+	static std::string Fold( const std::string& name );
+
+	boost::unordered_map<std::string, HostingPreset> m_presets;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_PRESETS_H
+
+/**
+ * \file presets.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
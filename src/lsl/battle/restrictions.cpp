@@ -0,0 +1,274 @@
+#include "restrictions.h"
+
+#include <lslutils/conversion.h>
+#include <lslutils/bits.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace LSL {
+namespace Battle {
+
+namespace {
+
+//! "Full Name (shortname)" -> "shortname", anything else is taken as is
+std::string ShortName( const std::string& entry )
+{
+	const size_t open = entry.rfind( " (" );
+	if ( open == std::string::npos || entry.empty() || entry[entry.size() - 1] != ')' )
+		return entry;
+	return entry.substr( open + 2, entry.size() - open - 3 );
+}
+
+/** calls \param visitor( unit, limit ) for the "unit=limit" entries of a preset string,
+ * parsing it in place. An entry without '=' is a unit that is disabled completely */
+template < class Visitor >
+void ForEachPresetEntry( const std::string& text, Visitor visitor )
+{
+	std::string unit;
+	const char* pos = text.data();
+	const char* const end = pos + text.size();
+	while ( pos < end ) {
+		const char* const tab = std::find( pos, end, '\t' );
+		if ( tab != pos ) {
+			// the name may contain '=' itself, the limit follows the last one
+			const char* equals = tab;
+			while ( equals != pos && *( equals - 1 ) != '=' )
+				--equals;
+			if ( equals == pos ) {
+				unit.assign( pos, tab );
+				visitor( unit, 0 );
+			}
+			else {
+				unit.assign( pos, equals - 1 );
+				visitor( unit, int( std::strtol( equals, 0, 10 ) ) ); // stops at the tab
+			}
+		}
+		pos = tab + 1;
+	}
+}
+
+} // namespace
+
+const int UnitRestrictions::UNRESTRICTED;
+const size_t UnitRestrictions::WORD_BITS;
+
+UnitRestrictions::UnitRestrictions()
+	: m_restricted( 0 ),
+	m_cleared( false )
+{
+}
+
+void UnitRestrictions::Bind( const StringVector& units )
+{
+	const std::map<std::string, int> current = ToMap();
+	std::map<std::string, int> sent( m_extra_sent );
+	for ( size_t i = 0; i < m_names.size(); ++i )
+		if ( m_sent[i] != UNRESTRICTED )
+			sent[m_names[i]] = m_sent[i];
+
+	m_names.clear();
+	m_names.reserve( units.size() );
+	m_index.clear();
+	for ( size_t i = 0; i < units.size(); ++i ) {
+		m_names.push_back( ShortName( units[i] ) );
+		m_index.insert( std::make_pair( m_names.back(), i ) );
+	}
+	m_limits.assign( m_names.size(), UNRESTRICTED );
+	m_sent.assign( m_names.size(), UNRESTRICTED );
+	m_dirty.assign( ( m_names.size() + WORD_BITS - 1 ) / WORD_BITS, 0 );
+	m_restricted = 0;
+	m_extra.clear();
+	m_extra_sent.clear();
+
+	for ( std::map<std::string, int>::const_iterator it = sent.begin(); it != sent.end(); ++it ) {
+		const size_t index = Find( it->first );
+		if ( index < m_names.size() )
+			m_sent[index] = it->second;
+		else
+			m_extra_sent[it->first] = it->second;
+	}
+	for ( std::map<std::string, int>::const_iterator it = current.begin(); it != current.end(); ++it )
+		Restrict( it->first, it->second );
+	// units that were sent restricted and aren't any more
+	for ( size_t i = 0; i < m_names.size(); ++i )
+		if ( m_sent[i] != m_limits[i] )
+			m_dirty[i / WORD_BITS] |= boost::uint64_t( 1 ) << ( i % WORD_BITS );
+}
+
+void UnitRestrictions::Restrict( const std::string& unit, int count )
+{
+	// a negative limit would read as unrestricted
+	count = std::max( count, 0 );
+	const size_t index = Find( unit );
+	if ( index < m_names.size() )
+		Set( index, count );
+	else
+		m_extra[unit] = count;
+}
+
+void UnitRestrictions::Unrestrict( const std::string& unit )
+{
+	const size_t index = Find( unit );
+	if ( index < m_names.size() )
+		Set( index, UNRESTRICTED );
+	else
+		m_extra.erase( unit );
+}
+
+void UnitRestrictions::Clear()
+{
+	std::fill( m_limits.begin(), m_limits.end(), int( UNRESTRICTED ) );
+	m_restricted = 0;
+	m_extra.clear();
+	m_cleared = true;
+}
+
+int UnitRestrictions::Limit( const std::string& unit ) const
+{
+	const size_t index = Find( unit );
+	if ( index < m_names.size() )
+		return m_limits[index];
+	std::map<std::string, int>::const_iterator it = m_extra.find( unit );
+	return it == m_extra.end() ? UNRESTRICTED : it->second;
+}
+
+std::map<std::string, int> UnitRestrictions::ToMap() const
+{
+	std::map<std::string, int> result;
+	ForEach( [&result]( const std::string& unit, int limit ) { result[unit] = limit; } );
+	return result;
+}
+
+UnitRestrictions::Changes UnitRestrictions::TakeChanges()
+{
+	Changes changes;
+	if ( m_cleared ) {
+		changes.all_enabled = true;
+		ForEach( [&changes]( const std::string& unit, int limit ) {
+			changes.disabled.push_back( unit );
+			changes.limits.push_back( std::make_pair( unit, limit ) );
+		} );
+		m_sent = m_limits;
+		m_extra_sent = m_extra;
+		std::fill( m_dirty.begin(), m_dirty.end(), 0 );
+		m_cleared = false;
+		return changes;
+	}
+
+	for ( size_t w = 0; w < m_dirty.size(); ++w ) {
+		for ( boost::uint64_t word = m_dirty[w]; word != 0; word &= word - 1 ) {
+			const size_t i = w * WORD_BITS + Util::CountTrailingZeros( word );
+			if ( m_limits[i] == m_sent[i] )
+				continue;
+			if ( m_limits[i] == UNRESTRICTED )
+				changes.enabled.push_back( m_names[i] );
+			else {
+				if ( m_sent[i] == UNRESTRICTED )
+					changes.disabled.push_back( m_names[i] );
+				changes.limits.push_back( std::make_pair( m_names[i], m_limits[i] ) );
+			}
+			m_sent[i] = m_limits[i];
+		}
+		m_dirty[w] = 0;
+	}
+
+	// the fallback map is small, a merge walk is enough
+	std::map<std::string, int>::const_iterator now = m_extra.begin(), then = m_extra_sent.begin();
+	while ( now != m_extra.end() || then != m_extra_sent.end() ) {
+		if ( then == m_extra_sent.end() || ( now != m_extra.end() && now->first < then->first ) ) {
+			changes.disabled.push_back( now->first );
+			changes.limits.push_back( *now );
+			++now;
+		}
+		else if ( now == m_extra.end() || then->first < now->first ) {
+			changes.enabled.push_back( then->first );
+			++then;
+		}
+		else {
+			if ( now->second != then->second )
+				changes.limits.push_back( *now );
+			++now;
+			++then;
+		}
+	}
+	m_extra_sent = m_extra;
+	return changes;
+}
+
+std::string UnitRestrictions::ToPresetString() const
+{
+	std::string result;
+	ForEach( [&result]( const std::string& unit, int limit ) {
+		result += unit;
+		result += '=';
+		result += Util::ToString( limit );
+		result += '\t';
+	} );
+	return result;
+}
+
+void UnitRestrictions::LoadPresetString( const std::string& text )
+{
+	Reset();
+	ForEachPresetEntry( text, [this]( const std::string& unit, int count ) { Restrict( unit, count ); } );
+}
+
+std::vector< std::pair<std::string, int> > UnitRestrictions::ParsePresetString( const std::string& text )
+{
+	std::vector< std::pair<std::string, int> > result;
+	ForEachPresetEntry( text, [&result]( const std::string& unit, int count ) {
+		result.push_back( std::make_pair( unit, count ) );
+	} );
+	return result;
+}
+
+void UnitRestrictions::Assign( const std::vector< std::pair<std::string, int> >& limits )
+{
+	Reset();
+	for ( size_t i = 0; i < limits.size(); ++i )
+		Restrict( limits[i].first, limits[i].second );
+}
+
+bool UnitRestrictions::HasChanges() const
+{
+	if ( m_cleared || m_extra != m_extra_sent )
+		return true;
+	for ( size_t w = 0; w < m_dirty.size(); ++w ) {
+		for ( boost::uint64_t word = m_dirty[w]; word != 0; word &= word - 1 ) {
+			const size_t i = w * WORD_BITS + Util::CountTrailingZeros( word );
+			if ( m_limits[i] != m_sent[i] )
+				return true;
+		}
+	}
+	return false;
+}
+
+size_t UnitRestrictions::Find( const std::string& unit ) const
+{
+	boost::unordered_map<std::string, size_t>::const_iterator it = m_index.find( unit );
+	return it == m_index.end() ? m_names.size() : it->second;
+}
+
+void UnitRestrictions::Reset()
+{
+	for ( size_t i = 0; m_restricted > 0; ++i )
+		Set( i, UNRESTRICTED );
+	m_extra.clear();
+}
+
+void UnitRestrictions::Set( size_t index, int count )
+{
+	int& limit = m_limits[index];
+	if ( limit == count )
+		return;
+	if ( limit == UNRESTRICTED )
+		++m_restricted;
+	else if ( count == UNRESTRICTED )
+		--m_restricted;
+	limit = count;
+	m_dirty[index / WORD_BITS] |= boost::uint64_t( 1 ) << ( index % WORD_BITS );
+}
+
+} // namespace Battle
+} // namespace LSL
@@ -0,0 +1,144 @@
+#ifndef LSL_HEADERGUARD_BATTLE_RESTRICTIONS_H
+#define LSL_HEADERGUARD_BATTLE_RESTRICTIONS_H
+
+#include <lslutils/type_forwards.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief unit limits of a battle, indexed by the unit list of the mod
+ * Units of the bound mod live in a dense limit array, every change sets a bit
+ * in a dirty bitset so TakeChanges only looks at what was touched since the last
+ * call. Names the mod doesn't know ( or all of them while no mod is bound ) fall
+ * back to a map.
+ **/
+class UnitRestrictions
+{
+public:
+	static const int UNRESTRICTED = -1;
+
+	//! what changed since the last TakeChanges, as the protocol wants it
+	struct Changes
+	{
+		Changes() : all_enabled( false ) {}
+		bool empty() const { return !all_enabled && enabled.empty() && limits.empty(); }
+
+		//! everything was enabled first, enabled is empty then
+		bool all_enabled;
+		//! units no longer restricted
+		StringVector enabled;
+		//! units restricted now that weren't before
+		StringVector disabled;
+		//! new limit of every unit in disabled and every unit whose limit changed
+		std::vector< std::pair<std::string, int> > limits;
+	};
+
+	UnitRestrictions();
+
+	/** indexes the units of a mod, keeping the current limits.
+	 * \param units as Unitsync::GetUnitsList returns them: "Full Name (shortname)" or plain names */
+	void Bind( const StringVector& units );
+
+	void Restrict( const std::string& unit, int count = 0 );
+	void Unrestrict( const std::string& unit );
+	void Clear();
+
+	bool IsRestricted( const std::string& unit ) const { return Limit( unit ) != UNRESTRICTED; }
+	//! \return the limit of \param unit or UNRESTRICTED
+	int Limit( const std::string& unit ) const;
+	//! number of restricted units
+	size_t size() const { return m_restricted + m_extra.size(); }
+	bool empty() const { return size() == 0; }
+
+	//! calls \param visitor( unit, limit ) for every restricted unit, mod units first in mod order
+	template < class Visitor >
+	void ForEach( Visitor visitor ) const
+	{
+		for ( size_t i = 0, found = 0; found < m_restricted; ++i ) {
+			if ( m_limits[i] == UNRESTRICTED )
+				continue;
+			visitor( m_names[i], m_limits[i] );
+			++found;
+		}
+		for ( std::map<std::string, int>::const_iterator it = m_extra.begin(); it != m_extra.end(); ++it )
+			visitor( it->first, it->second );
+	}
+
+	std::map<std::string, int> ToMap() const;
+
+	//! the changes since the last call, which count as sent from now on
+	Changes TakeChanges();
+	//! whether TakeChanges would return anything
+	bool HasChanges() const;
+
+	//! "unit=limit\t" for every restricted unit, the format hosting presets keep them in
+	std::string ToPresetString() const;
+	//! replaces all limits with the ones in \param text, see ToPresetString
+	void LoadPresetString( const std::string& text );
+	//! the ( unit, limit ) entries of a preset string, in order
+	static std::vector< std::pair<std::string, int> > ParsePresetString( const std::string& text );
+	//! replaces all limits with \param limits
+	void Assign( const std::vector< std::pair<std::string, int> >& limits );
+
+private:
+	static const size_t WORD_BITS = 64;
+
+	//! index of \param unit in the bound mod, or m_names.size()
+	size_t Find( const std::string& unit ) const;
+	void Set( size_t index, int count );
+	//! unrestricts everything without counting as Clear
+	void Reset();
+
+	StringVector m_names;
+	boost::unordered_map<std::string, size_t> m_index;
+	std::vector<int> m_limits;
+	//! limits as of the last TakeChanges
+	std::vector<int> m_sent;
+	std::vector<boost::uint64_t> m_dirty;
+	size_t m_restricted;
+
+	std::map<std::string, int> m_extra;
+	std::map<std::string, int> m_extra_sent;
+
+	//! Clear was called since the last TakeChanges
+	bool m_cleared;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_RESTRICTIONS_H
+
+/**
+ * \file restrictions.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
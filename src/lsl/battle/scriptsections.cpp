@@ -0,0 +1,86 @@
+#include "scriptsections.h"
+
+#include <lslutils/casefold.h>
+
+#include <limits>
+
+namespace LSL {
+namespace Battle {
+
+namespace {
+
+//! sections numbered beyond this are ignored rather than growing the arrays without bound
+const int MAX_INDEX = 1 << 16;
+
+} // namespace
+
+ScriptSections::ScriptSections( const TDF::PDataList& game, size_t players, size_t teams, size_t allies )
+{
+	m_players.reserve( players );
+	m_bots.reserve( players );
+	m_teams.reserve( teams );
+	m_allies.reserve( allies );
+	if ( !game.ok() )
+		return;
+	for ( TDF::PNode node = game->First(); node.ok() && node != game->End(); node = game->Next( node ) ) {
+		const std::string& name = node->Name();
+		if ( name.empty() )
+			continue;
+		int index = -1;
+		Sections* sections = NULL;
+		switch ( name[0] ) {
+			case 'P': case 'p':
+				index = Index( name, "PLAYER" );
+				sections = &m_players;
+				break;
+			case 'T': case 't':
+				index = Index( name, "TEAM" );
+				sections = &m_teams;
+				break;
+			case 'A': case 'a':
+				if ( ( index = Index( name, "AI" ) ) >= 0 )
+					sections = &m_bots;
+				else if ( ( index = Index( name, "ALLYTEAM" ) ) >= 0 )
+					sections = &m_allies;
+				break;
+			default:
+				break;
+		}
+		if ( index < 0 || index > MAX_INDEX )
+			continue;
+		const TDF::PDataList section( node );
+		if ( section.ok() )
+			Put( *sections, index, section );
+	}
+}
+
+int ScriptSections::Index( const std::string& name, const char* prefix )
+{
+	size_t pos = 0;
+	for ( ; prefix[pos] != 0; ++pos ) {
+		if ( pos >= name.size() )
+			return -1;
+		if ( Util::FoldChar( name[pos] ) != Util::FoldChar( prefix[pos] ) )
+			return -1;
+	}
+	// digits only and no leading zeros, the way Util::ToString would have built the name
+	if ( pos == name.size() || ( name[pos] == '0' && pos + 1 != name.size() ) )
+		return -1;
+	int index = 0;
+	for ( ; pos < name.size(); ++pos ) {
+		if ( name[pos] < '0' || name[pos] > '9' || index > ( std::numeric_limits<int>::max() - 9 ) / 10 )
+			return -1;
+		index = index * 10 + ( name[pos] - '0' );
+	}
+	return index;
+}
+
+void ScriptSections::Put( Sections& sections, int index, const TDF::PDataList& section )
+{
+	if ( size_t( index ) >= sections.size() )
+		sections.resize( index + 1 );
+	sections[index] = section;
+}
+
+} // namespace Battle
+} // namespace LSL
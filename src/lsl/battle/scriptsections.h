@@ -0,0 +1,76 @@
+#ifndef LSL_HEADERGUARD_BATTLE_SCRIPTSECTIONS_H
+#define LSL_HEADERGUARD_BATTLE_SCRIPTSECTIONS_H
+
+#include "tdfcontainer.h"
+
+#include <string>
+#include <vector>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief the numbered PLAYERn, AIn, TEAMn and ALLYTEAMn sections of a script's GAME section
+ * They are sorted into arrays by index in a single walk over the children, so reconstructing
+ * a battle needs neither name building nor lookups per player.
+ **/
+class ScriptSections
+{
+public:
+	//! the hints presize the arrays, usually NumPlayers, NumTeams and NumAllyTeams of the script
+	explicit ScriptSections( const TDF::PDataList& game, size_t players = 0, size_t teams = 0, size_t allies = 0 );
+
+	//! the sections with index \param index, not ok() if the script has none
+	TDF::PDataList Player( int index ) const { return At( m_players, index ); }
+	TDF::PDataList Bot( int index ) const { return At( m_bots, index ); }
+	TDF::PDataList Team( int index ) const { return At( m_teams, index ); }
+	TDF::PDataList Ally( int index ) const { return At( m_allies, index ); }
+
+	//! \return the index in a section name like "TEAM12" or -1, names are matched case insensitively
+	static int Index( const std::string& name, const char* prefix );
+
+private:
+	typedef std::vector<TDF::PDataList> Sections;
+
+	static TDF::PDataList At( const Sections& sections, int index )
+	{
+		return index >= 0 && size_t( index ) < sections.size() ? sections[index] : TDF::PDataList();
+	}
+	static void Put( Sections& sections, int index, const TDF::PDataList& section );
+
+	Sections m_players;
+	Sections m_bots;
+	Sections m_teams;
+	Sections m_allies;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_SCRIPTSECTIONS_H
+
+/**
+ * \file scriptsections.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,229 @@
+#include "scripttags.h"
+
+#include <lslutils/casefold.h>
+
+#include <algorithm>
+
+namespace LSL {
+namespace Battle {
+
+namespace {
+
+//! lower cases [ \param data, \param data + \param size ) into \param buffer, reusing its storage
+const std::string& Lowered( const char* data, size_t size, std::string& buffer )
+{
+	buffer.assign( data, size );
+	std::transform( buffer.begin(), buffer.end(), buffer.begin(), Util::FoldChar );
+	return buffer;
+}
+
+bool LoweredEqual( const std::string& name, const char* data, size_t size )
+{
+	if ( name.size() != size )
+		return false;
+	for ( size_t i = 0; i < size; ++i )
+		if ( name[i] != Util::FoldChar( data[i] ) )
+			return false;
+	return true;
+}
+
+//! splits [ \param begin, \param end ) at '/' and lower cases every piece into \param path
+void Split( const char* begin, const char* end, std::vector<std::string>& path )
+{
+	std::string buffer;
+	path.clear();
+	for ( ;; ) {
+		const char* slash = std::find( begin, end, '/' );
+		path.push_back( Lowered( begin, slash - begin, buffer ) );
+		if ( slash == end )
+			break;
+		begin = slash + 1;
+	}
+}
+
+} // namespace
+
+void ScriptTags::Router::Add( const std::string& prefix, const Handler& handler )
+{
+	Route route;
+	if ( !prefix.empty() )
+		Split( prefix.data(), prefix.data() + prefix.size(), route.prefix );
+	route.handler = handler;
+	m_routes.push_back( route );
+}
+
+bool ScriptTags::Router::Dispatch( const Segment* path, size_t count, const std::string& value ) const
+{
+	const Route* best = 0;
+	for ( size_t r = 0; r < m_routes.size(); ++r ) {
+		const Route& route = m_routes[r];
+		if ( route.prefix.size() > count || ( best && best->prefix.size() >= route.prefix.size() ) )
+			continue;
+		if ( std::equal( route.prefix.begin(), route.prefix.end(), path,
+						 []( const std::string& name, Segment segment ) { return name == *segment; } ) )
+			best = &route;
+	}
+	if ( !best )
+		return false;
+	best->handler( path + best->prefix.size(), count - best->prefix.size(), value );
+	return true;
+}
+
+ScriptTags::ScriptTags()
+{
+	clear();
+}
+
+const std::string& ScriptTags::Name( Segment segment )
+{
+	return *segment;
+}
+
+std::string ScriptTags::Join( const Segment* path, size_t count )
+{
+	std::string result;
+	for ( size_t i = 0; i < count; ++i ) {
+		if ( i > 0 )
+			result += '/';
+		result += Name( path[i] );
+	}
+	return result;
+}
+
+void ScriptTags::Set( const std::string& key, const std::string& value )
+{
+	Store( Insert( key.data(), key.data() + key.size() ) ) = value;
+}
+
+std::string ScriptTags::Get( const std::string& key, const std::string& fallback ) const
+{
+	const size_t node = Resolve( key );
+	if ( node == NO_NODE || !m_nodes[node].has_value )
+		return fallback;
+	return m_nodes[node].value;
+}
+
+bool ScriptTags::Has( const std::string& key ) const
+{
+	const size_t node = Resolve( key );
+	return node != NO_NODE && m_nodes[node].has_value;
+}
+
+size_t ScriptTags::Ingest( const std::string& line, const Router* router )
+{
+	size_t tags = 0;
+	const char* pos = line.data();
+	const char* const end = pos + line.size();
+	while ( pos < end ) {
+		const char* const tab = std::find( pos, end, '\t' );
+		if ( tab != pos ) {
+			// like Util::BeforeFirst / AfterFirst: without a '=' key and value are the whole pair
+			const char* const equals = std::find( pos, tab, '=' );
+			const char* const value = equals == tab ? pos : equals + 1;
+			std::string& stored = Store( Insert( pos, equals ) );
+			stored.assign( value, tab );
+			++tags;
+			if ( router )
+				router->Dispatch( &m_path[0], m_path.size(), stored );
+		}
+		pos = tab + 1;
+	}
+	return tags;
+}
+
+void ScriptTags::clear()
+{
+	m_nodes.clear();
+	m_edges.clear();
+	m_size = 0;
+	Node root;
+	root.has_value = false;
+	root.sorted = true;
+	m_nodes.push_back( root );
+}
+
+size_t ScriptTags::Insert( const char* begin, const char* end )
+{
+	m_path.clear();
+	size_t node = 0;
+	for ( ;; ) {
+		const char* slash = std::find( begin, end, '/' );
+		const size_t size = slash - begin;
+		const size_t child = Child( node, begin, size );
+		// only new segments take a lower cased copy
+		node = child != NO_NODE ? child : AddChild( node, Lowered( begin, size, m_buffer ) );
+		m_path.push_back( &m_nodes[node].name );
+		if ( slash == end )
+			return node;
+		begin = slash + 1;
+	}
+}
+
+size_t ScriptTags::Resolve( const std::string& key ) const
+{
+	if ( key.empty() )
+		return 0;
+	size_t node = 0;
+	const char* begin = key.data();
+	const char* const end = begin + key.size();
+	for ( ;; ) {
+		const char* slash = std::find( begin, end, '/' );
+		node = Child( node, begin, slash - begin );
+		if ( node == NO_NODE || slash == end )
+			return node;
+		begin = slash + 1;
+	}
+}
+
+size_t ScriptTags::Child( size_t parent, const char* data, size_t size ) const
+{
+	typedef Edges::const_iterator Iter;
+	const std::pair<Iter, Iter> range = m_edges.equal_range( EdgeKey( parent, data, size ) );
+	for ( Iter it = range.first; it != range.second; ++it )
+		if ( LoweredEqual( m_nodes[it->second].name, data, size ) )
+			return it->second;
+	return NO_NODE;
+}
+
+size_t ScriptTags::AddChild( size_t parent, const std::string& name )
+{
+	const size_t index = m_nodes.size();
+	m_nodes.push_back( Node() );
+	Node& node = m_nodes.back();
+	node.name = name;
+	node.has_value = false;
+	node.sorted = true;
+	m_nodes[parent].children.push_back( index );
+	m_nodes[parent].sorted = false;
+	m_edges.insert( std::make_pair( EdgeKey( parent, name.data(), name.size() ), index ) );
+	return index;
+}
+
+boost::uint64_t ScriptTags::EdgeKey( size_t parent, const char* data, size_t size )
+{
+	return ( boost::uint64_t( parent ) << 32 ) | Util::FoldedHash( data, size );
+}
+
+void ScriptTags::SortChildren( const Node& node ) const
+{
+	if ( node.sorted )
+		return;
+	const std::deque<Node>& nodes = m_nodes;
+	std::sort( node.children.begin(), node.children.end(),
+			   [&nodes]( size_t a, size_t b ) { return nodes[a].name < nodes[b].name; } );
+	node.sorted = true;
+}
+
+std::string& ScriptTags::Store( size_t node )
+{
+	Node& target = m_nodes[node];
+	if ( !target.has_value ) {
+		target.has_value = true;
+		++m_size;
+	}
+	return target.value;
+}
+
+} // namespace Battle
+} // namespace LSL
+
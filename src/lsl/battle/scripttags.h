@@ -0,0 +1,166 @@
+#ifndef LSL_HEADERGUARD_BATTLE_SCRIPTTAGS_H
+#define LSL_HEADERGUARD_BATTLE_SCRIPTTAGS_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace LSL {
+namespace Battle {
+
+/** \brief the script tags of a battle, as a tree of '/' separated key segments
+ * Keys are case insensitive and stored lower case. The segment names belong to the
+ * tags, not to the process wide StringPool: the keys come off the wire and are
+ * freed with the tags or by clear(). Routing compares segment names.
+ * Iteration visits a subtree with the segments of each level in name order.
+ **/
+class ScriptTags
+{
+public:
+	//! a lower case key segment, valid until the tags it came from are cleared or destroyed
+	typedef const std::string* Segment;
+
+	/** called for a tag below a routed prefix, with the \param count segments of the key
+	 * after the prefix in \param rest and the stored \param value */
+	typedef boost::function< void ( const Segment* rest, size_t count, const std::string& value ) > Handler;
+
+	//! hands ingested tags to the handler registered for the longest matching key prefix
+	class Router
+	{
+	public:
+		//! \param prefix '/' separated, the empty prefix matches every tag
+		void Add( const std::string& prefix, const Handler& handler );
+		//! \return false if no prefix matched
+		bool Dispatch( const Segment* path, size_t count, const std::string& value ) const;
+
+	private:
+		struct Route
+		{
+			std::vector<std::string> prefix;
+			Handler handler;
+		};
+		std::vector<Route> m_routes;
+	};
+
+	ScriptTags();
+
+	//! the lower case name of \param segment
+	static const std::string& Name( Segment segment );
+	//! the \param count segments at \param path joined by '/'
+	static std::string Join( const Segment* path, size_t count );
+
+	void Set( const std::string& key, const std::string& value );
+	//! \return the value of \param key or \param fallback if it is not set
+	std::string Get( const std::string& key, const std::string& fallback = "" ) const;
+	bool Has( const std::string& key ) const;
+
+	/** stores every key=value pair of a tab separated SETSCRIPTTAGS line and hands it to
+	 * \param router if given. Keys and values are read out of \param line in place.
+	 * \return the number of tags stored */
+	size_t Ingest( const std::string& line, const Router* router = 0 );
+
+	/** calls \param visitor( key, value ) for every tag below \param prefix, with the key
+	 * relative to the prefix. The key buffer is reused between calls, copy it to keep it */
+	template < class Visitor >
+	void ForEach( const std::string& prefix, Visitor visitor ) const
+	{
+		const size_t node = Resolve( prefix );
+		if ( node == NO_NODE )
+			return;
+		std::string key;
+		Visit( node, key, visitor );
+	}
+
+	template < class Visitor >
+	void ForEach( Visitor visitor ) const { ForEach( std::string(), visitor ); }
+
+	//! number of tags stored
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	void clear();
+
+private:
+	static const size_t NO_NODE = ~size_t( 0 );
+
+	struct Node
+	{
+		std::string name;
+		bool has_value;
+		std::string value;
+		//! in name order once sorted is set
+		mutable std::vector<size_t> children;
+		mutable bool sorted;
+	};
+
+	//! the node for the '/' separated key in [ \param begin, \param end ), created if needed. Leaves its segments in m_path
+	size_t Insert( const char* begin, const char* end );
+	size_t Resolve( const std::string& key ) const;
+	//! the child of \param parent named like the \param size chars at \param data, in any case
+	size_t Child( size_t parent, const char* data, size_t size ) const;
+	size_t AddChild( size_t parent, const std::string& name );
+	static boost::uint64_t EdgeKey( size_t parent, const char* data, size_t size );
+	void SortChildren( const Node& node ) const;
+	std::string& Store( size_t node );
+
+	template < class Visitor >
+	void Visit( size_t index, std::string& key, Visitor& visitor ) const
+	{
+		const Node& node = m_nodes[index];
+		if ( node.has_value && !key.empty() )
+			visitor( key, node.value );
+		SortChildren( node );
+		const size_t length = key.size();
+		for ( size_t i = 0; i < node.children.size(); ++i ) {
+			if ( length > 0 )
+				key += '/';
+			key += m_nodes[node.children[i]].name;
+			Visit( node.children[i], key, visitor );
+			key.resize( length );
+		}
+	}
+
+	//! a deque so the names the segments point to never move
+	std::deque<Node> m_nodes;
+	//! ( parent node << 32 | hash of the lower cased segment ) -> child nodes, so a known key is found without copying it
+	typedef boost::unordered_multimap< boost::uint64_t, size_t > Edges;
+	Edges m_edges;
+	//! segments of the key being ingested and a lower casing buffer, kept to avoid reallocating per tag
+	std::vector<Segment> m_path;
+	std::string m_buffer;
+	size_t m_size;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_SCRIPTTAGS_H
+
+/**
+ * \file scripttags.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -63,6 +63,12 @@ void SinglePlayerBattle::SendHostInfo( HostInfo update )
       }
     }
   }
+  if ( (update & HI_Options) != 0 )
+  {
+    const std::vector< std::pair<int, std::string> > changed = TakeChangedOptions();
+    for ( size_t i = 0; i < changed.size(); i++ )
+      Update(  wxFormat(_T("%d_%s") ) % changed[i].first % changed[i].second );
+  }
 }
 
 void SinglePlayerBattle::RemoveUnfittingBots()
@@ -0,0 +1,101 @@
+#ifndef LSL_HEADERGUARD_BATTLE_SYNCSTATE_H
+#define LSL_HEADERGUARD_BATTLE_SYNCSTATE_H
+
+#include <cstddef>
+#include <string>
+
+namespace LSL {
+namespace Battle {
+
+//! the host didn't announce a checksum: nothing or "0"
+inline bool IsUnknownHash( const std::string& hash )
+{
+	return hash.empty() || hash == "0";
+}
+
+/** \return whether the local archive is the one the host announced. Names are only
+ * compared if the host sent one, checksums only if the host knows its own */
+inline bool ArchiveSynced( const std::string& host_name, const std::string& host_hash,
+						   const std::string& local_name, const std::string& local_hash )
+{
+	if ( !IsUnknownHash( host_hash ) && local_hash != host_hash )
+		return false;
+	return host_name.empty() || local_name == host_name;
+}
+
+/** \brief memoized IBattle::IsSynced
+ * The result holds for the host map and mod it was computed for, as long as the
+ * unitsync catalog generation stays the same. Changes to the local archives have
+ * to Invalidate it explicitly.
+ **/
+class SyncState
+{
+public:
+	SyncState() : m_valid( false ), m_generation( 0 ), m_synced( false ) {}
+
+	void Invalidate() { m_valid = false; }
+
+	//! \return true and the memoized result in \param synced if it still holds
+	bool Lookup( const std::string& map_name, const std::string& map_hash, const std::string& mod_name,
+				 const std::string& mod_hash, size_t generation, bool& synced ) const
+	{
+		if ( !m_valid || generation != m_generation || map_hash != m_map_hash || mod_hash != m_mod_hash
+			 || map_name != m_map_name || mod_name != m_mod_name )
+			return false;
+		synced = m_synced;
+		return true;
+	}
+
+	void Store( const std::string& map_name, const std::string& map_hash, const std::string& mod_name,
+				const std::string& mod_hash, size_t generation, bool synced )
+	{
+		m_map_name = map_name;
+		m_map_hash = map_hash;
+		m_mod_name = mod_name;
+		m_mod_hash = mod_hash;
+		m_generation = generation;
+		m_synced = synced;
+		m_valid = true;
+	}
+
+private:
+	bool m_valid;
+	std::string m_map_name;
+	std::string m_map_hash;
+	std::string m_mod_name;
+	std::string m_mod_hash;
+	size_t m_generation;
+	bool m_synced;
+};
+
+} // namespace Battle
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_SYNCSTATE_H
+
+/**
+ * \file syncstate.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -5,6 +5,8 @@
 #include <lslutils/debug.h>
 
 #include <cmath>
+#include <cstring>
+#include <iterator>
 #include <sstream>
 #include <fstream>
 #include <iomanip>
@@ -61,169 +63,194 @@ void TDFWriter::AppendLineBreak() {
 }
 
 void Tokenizer::ReportError( const Token &t, const std::string &err ) {
-    LslError( "TDF parsing error at (%s), on token \"%s\" : %s", t.pos_string.c_str(), t.value_s.c_str(), err.c_str() );
+    LslError( "TDF parsing error at (%s), on token \"%s\" : %s", Position( t ).c_str(), Value( t ).c_str(), err.c_str() );
 	errors++;
 }
 
-//#define ReportError(a) {std::cerr<<"error "<<(a);}
-//#define ReportError(a) {wxLogMessage(\1;}
-
 void Tokenizer::EnterStream( std::istream &stream_, const std::string &name ) {
-	skip_eol = false;
-    include_stack.push_back( IncludeCacheEntry( &stream_, false ) );
-	include_stack.back().name = name;
+	sources.push_back( Source( NULL, 0, name ) );
+	Source& source = sources.back();
+	source.owned.assign( std::istreambuf_iterator<char>( stream_ ), std::istreambuf_iterator<char>() );
+	source.size = source.owned.size();
 }
 
-void Tokenizer::UnwindStack() {
-	while ( ( !include_stack.empty() ) && include_stack.back().stream && ( !include_stack.back().stream->good() ) ) {
-		include_stack.pop_back();
-	}
+void Tokenizer::EnterBuffer( const char* data, size_t size, const std::string &name ) {
+	sources.push_back( Source( data, size, name ) );
 }
 
-char Tokenizer::PeekNextChar() {
-	UnwindStack();
-	//std::string tmp;
-	char tmp = 0;
-	if ( !include_stack.empty() )tmp = ( *include_stack.back().stream ).peek();
-	return tmp;
+Tokenizer::Source* Tokenizer::Current() {
+	for ( size_t i = sources.size(); i > 0; --i ) {
+		if ( sources[i - 1].pos < sources[i - 1].size )
+			return &sources[i - 1];
+	}
+	return NULL;
 }
 
-char Tokenizer::GetNextChar() {
-	UnwindStack();
-	//std::string tmp;
-	if ( include_stack.empty() )return 0;
-
-	char c = ( *include_stack.back().stream ).get();
-
-	if ( ( !skip_eol ) && ( c == 10 || c == 13 ) ) {// end of line
-		include_stack.back().line += 1;
-		include_stack.back().column = 1;
+bool Tokenizer::Good() {
+	return Current() != NULL;
+}
 
-		// if next is different we'll skip it.
-		//std::istream &stream=(*include_stack.back().stream);
-		char nc = ( *include_stack.back().stream ).peek();
-		if ( ( nc == 10 || nc == 13 ) && ( nc != c ) )skip_eol = true;
-	} else {
-		if ( !skip_eol )include_stack.back().column += 1;
-		skip_eol = false;
+const char* Tokenizer::Data( const Token &t ) const {
+	if ( t.IsEOF() || t.source >= sources.size() )
+		return NULL;
+	return sources[t.source].Begin() + t.offset;
+}
+
+std::string Tokenizer::Value( const Token &t ) const {
+	const char* begin = Data( t );
+	if ( !begin )
+		return std::string();
+	const char* const end = begin + t.length;
+	if ( !t.escaped )
+		return std::string( begin, end );
+	std::string result;
+	result.reserve( t.length );
+	for ( ; begin != end; ++begin ) {
+		if ( *begin == '\\' ) {
+			if ( begin + 1 != end )
+				result += *++begin;
+		}
+		// std::string has problem with zero characters, replace by space.
+		else
+			result += *begin ? *begin : ' ';
 	}
-
-	return c;
+	return result;
 }
 
-bool Tokenizer::Good() {
-	UnwindStack();
-	return !include_stack.empty();
+std::string Tokenizer::Position( const Token &t ) {
+	if ( t.IsEOF() || t.source >= sources.size() )
+		return "EOF";
+	Source& source = sources[t.source];
+	if ( t.position < source.counted ) {
+		source.counted = 0;
+		source.line = 1;
+		source.column = 1;
+		source.skip_eol = false;
+	}
+	// a line ends with CR, LF, CRLF or LFCR
+	const char* const data = source.Begin();
+	for ( ; source.counted < t.position; ++source.counted ) {
+		const char c = data[source.counted];
+		if ( !source.skip_eol && ( c == 10 || c == 13 ) ) {
+			source.line += 1;
+			source.column = 1;
+			const char nc = source.counted + 1 < source.size ? data[source.counted + 1] : 0;
+			if ( ( nc == 10 || nc == 13 ) && ( nc != c ) ) source.skip_eol = true;
+		} else {
+			if ( !source.skip_eol ) source.column += 1;
+			source.skip_eol = false;
+		}
+	}
+	std::stringstream result;
+	if ( !source.name.empty() )
+		result << source.name << " , ";
+	result << "line " << source.line << " , column " << source.column;
+	return result.str();
 }
 
 void Tokenizer::ReadToken( Token &token ) {
+	token = Token();
+	Source* source = NULL;
+	const char* data = NULL;
+	const char* end = NULL;
+	const char* pos = NULL;
 start:
-
-	SkipSpaces();
-	token.value_s.clear();
-
-	if ( !Good() ) {
+	// skip spaces, carrying on with the sources entered before this one
+	while ( ( source = Current() ) ) {
+		data = source->Begin();
+		end = data + source->size;
+		pos = data + source->pos;
+		while ( pos != end && IsWhitespace( *pos ) )
+			++pos;
+		source->pos = pos - data;
+		if ( pos != end )
+			break;
+	}
+	if ( !source ) {
 		token.type = Token::type_eof;
-        token.pos_string = "EOF";
 		return;
 	}
 
-    std::stringstream token_tmp;
-    if ( !include_stack.empty() && !include_stack.back().name.empty() )
-        token_tmp << include_stack.back().name << " , ";
-    token_tmp << "line " << include_stack.back().line << " , column " << include_stack.back().column;
-    token.pos_string = token_tmp.str();
-
-	char c = GetNextChar();
-	token.value_s += c;
+	token.source = source - &sources.front();
+	token.position = token.offset = pos - data;
+	token.length = 1;
+	const char c = *pos++;
 	// first find what token is it, and handle all except numbers
 	switch ( c ) {
 		case '[': {
 				token.type = Token::type_section_name;
-				token.value_s.clear();
-				bool skip_next_eol_char = false;
-				while ( Good() ) {
-					c = GetNextChar();
-					// std::string has problem with zero characters, replace by space.
-					if ( c == 0 ) {
-						c = ' ';
-					}
-					if ( c == '\\' ) {
-						if ( Good() ) {
-							token.value_s += GetNextChar();
-						} else {
-                            ReportError( token, "Quotes not closed before end of file" );
-							return;
+				token.offset = pos - data;
+				const char* close = static_cast<const char*>( std::memchr( pos, ']', end - pos ) );
+				const char* const scanned = close ? close : end;
+				const char* escape = static_cast<const char*>( std::memchr( pos, '\\', scanned - pos ) );
+				token.escaped = escape || std::memchr( pos, 0, scanned - pos );
+				if ( escape ) {
+					// an escaped ']' doesn't close the name
+					close = NULL;
+					for ( const char* it = escape; it < end; ++it ) {
+						if ( *it == '\\' ) {
+							++it;
+						} else if ( *it == ']' ) {
+							close = it;
+							break;
 						}
-					} else if ( c == ']' ) {
-						return;
-					} else
-					{
-						token.value_s += c;
-					}
-					// handle end of line
-					if ( skip_next_eol_char ) {
-						skip_next_eol_char = false;
-					} else if ( c == 10 || c == 13 ) {
-						//++line;
-						//column=1;
-						if ( ( PeekNextChar() == 10 || PeekNextChar() == 13 ) && ( PeekNextChar() != c ) )skip_next_eol_char = true;
 					}
 				}
+				if ( close ) {
+					token.length = close - pos;
+					source->pos = close + 1 - data;
+					return;
+				}
+				token.length = end - pos;
+				source->pos = source->size;
                 ReportError( token, "Quotes not closed before end of file" );
+				token.type = Token::type_enter_section;
+				return;
 			}
 		case '{':
 			token.type = Token::type_enter_section;
+			source->pos = pos - data;
 			return;
 		case '}':
 			token.type = Token::type_leave_section;
+			source->pos = pos - data;
 			return;
 		case ';':
 			token.type = Token::type_semicolon;
+			source->pos = pos - data;
 			return;
-		case '=':
-			token.type = Token::type_entry_value;
-            token.value_s = "";
-			while ( Good() && PeekNextChar() != ';' ) {
-				unsigned char c_ = GetNextChar();
-				token.value_s += c_;
+		case '=': {
+				token.type = Token::type_entry_value;
+				const char* semicolon = static_cast<const char*>( std::memchr( pos, ';', end - pos ) );
+				token.offset = pos - data;
+				token.length = ( semicolon ? semicolon : end ) - pos;
+				source->pos = token.offset + token.length;
+				return;
 			}
-			return;
 		case '/':// handle comments
-			if ( PeekNextChar() == '/' ) {
-				//SkipToEOL();
-				if ( !include_stack.empty() ) {
-					std::string tmp;
-					std::getline( ( *include_stack.back().stream ), tmp );
-					include_stack.back().line += 1;
-					include_stack.back().column = 1;
-				}
-
+			if ( pos != end && *pos == '/' ) {
+				const char* eol = static_cast<const char*>( std::memchr( pos, '\n', end - pos ) );
+				source->pos = eol ? eol + 1 - data : source->size;
 				goto start;
 			}
-			else if ( PeekNextChar() == '*' ) {// multi-line comment
-				while ( Good() ) {
-					char c1 = GetNextChar();
-					if ( ( c1 == '*' ) && ( PeekNextChar() == '/' ) ) {
-						GetNextChar();
+			else if ( pos != end && *pos == '*' ) {// multi-line comment, the '*' opening it may close it too
+				const char* star = pos;
+				while ( ( star = static_cast<const char*>( std::memchr( star, '*', end - star ) ) ) ) {
+					if ( star + 1 != end && star[1] == '/' )
 						break;
-					}
+					++star;
 				}
+				source->pos = star ? star + 2 - data : source->size;
 				goto start;
 			}
-		default:
-			while ( Good() && PeekNextChar() != '=' ) {
-				unsigned char c_ = GetNextChar();
-				token.value_s += c_;
+			// fall through, a name starting with '/'
+		default: {
+				const char* equals = static_cast<const char*>( std::memchr( pos, '=', end - pos ) );
+				token.length = ( equals ? equals : end ) - data - token.offset;
+				source->pos = token.offset + token.length;
+				token.type = Token::type_entry_name;
+				return;
 			}
-			token.type = Token::type_entry_name;
-			return;
-	}
-}
-
-void Tokenizer::SkipSpaces() {
-	while ( Good() && IsWhitespace( PeekNextChar() ) ) {
-		GetNextChar();
 	}
 }
 
@@ -242,6 +269,11 @@ Token Tokenizer::GetToken( int i ) {
 
 void Tokenizer::Step( int i ) {
 	buffer_pos += i;
+	// tokens behind are dropped, so the lookahead stays as short as the parser needs it
+	if ( buffer_pos >= token_buffer.size() ) {
+		buffer_pos -= token_buffer.size();
+		token_buffer.clear();
+	}
 }
 
 Node::~Node() {
@@ -569,7 +601,7 @@ void DataList::Load( Tokenizer &f ) {
 			case Token::type_entry_name:
 				{
 					PDataLeaf new_leaf( new DataLeaf );
-					new_leaf->SetName( t.value_s );
+					new_leaf->SetName( f.Value( t ) );
 					new_leaf->Load( f );
 					Insert( PNode( new_leaf ) );
 				}
@@ -582,7 +614,7 @@ void DataList::Load( Tokenizer &f ) {
                         f.ReportError( t, "'{' expected" );
 					} else {
 						PDataList new_list( new DataList );
-						new_list->SetName( t.value_s );
+						new_list->SetName( f.Value( t ) );
 						new_list->Load( f );// will eat the '}'
 						Insert( PNode( new_list ) );
 					}
@@ -683,16 +715,14 @@ void DataLeaf::Save( TDFWriter &f ) {
 }
 void DataLeaf::Load( Tokenizer &f ) {
 	Token t = f.TakeToken();
-	value = t.value_s;
+	value = f.Value( t );
 	t = f.TakeToken();
-    if ( t.value_s != ";" ) {
+    if ( t.type != Token::type_semicolon ) {
         f.ReportError( t, "; expected" );
 	}
 }
 
-PDataList ParseTDF( std::istream &s, int *error_count ) {
-	Tokenizer t;
-	t.EnterStream( s );
+static PDataList Parse( Tokenizer &t, int *error_count ) {
     PDataList result( new DataList );
 	result->Load( t );
 	if ( error_count ) {
@@ -701,4 +731,20 @@ PDataList ParseTDF( std::istream &s, int *error_count ) {
 	return result;
 }
 
+PDataList ParseTDF( std::istream &s, int *error_count ) {
+	Tokenizer t;
+	t.EnterStream( s );
+	return Parse( t, error_count );
+}
+
+PDataList ParseTDF( const std::string &text, int *error_count ) {
+	return ParseTDF( text.data(), text.size(), error_count );
+}
+
+PDataList ParseTDF( const char* data, size_t size, int *error_count ) {
+	Tokenizer t;
+	t.EnterBuffer( data, size );
+	return Parse( t, error_count );
+}
+
 } } // namespace LSL { namespace TDF {
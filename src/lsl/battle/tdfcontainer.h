@@ -169,6 +169,9 @@ inline bool IsAlphaNum( char c ) {
 inline bool IsWhitespace( char c ) {
 	return ( c == ' ' ) || ( c == 10 ) || ( c == 13 ) || ( c == '\t' );
 }
+/** \brief a token of a TDF source, as a range of the buffer it was read from
+ * Tokens don't own their text, Tokenizer::Value copies it out of the source.
+ **/
 struct Token {
 	enum TokenType {
 		type_none,
@@ -181,88 +184,80 @@ struct Token {
 		type_eof
 	};
 	TokenType type;
-	std::string value_s;
-
-	std::string pos_string;// for error reporting
+	size_t source; ///< index of the source in the tokenizer
+	size_t position; ///< offset of the first character, line and column are counted from it for error reporting
+	size_t offset; ///< where the value starts
+	size_t length;
+	bool escaped; ///< a section name with backslash escapes or zero characters, Value has to rewrite it
 
 	bool IsEOF() const {
 		return ( type == type_eof );
 	}
-	Token(): type( type_eof )
+	Token(): type( type_eof ), source( 0 ), position( 0 ), offset( 0 ), length( 0 ), escaped( false )
 	{
 	}
 
 };
 
 /** \brief Tokenizer used in TDF parsing
- * \todo clean up, move to CPP file
+ * Scans contiguous buffers, delimiters are found with memchr and tokens only point into the
+ * source. Streams are read into a buffer of their own first, callers that already have the
+ * text in memory should use EnterBuffer or EnterString.
  **/
 class Tokenizer {
-		
-		/// simple reference counted pointer to stream.
-		struct IncludeCacheEntry {
+
+		/// a buffer being tokenized, sources entered later are read first
+		struct Source {
 			std::string name; ///< used for error reporting
+			std::string owned; ///< the text of a stream, empty for buffers the caller keeps
+			const char* data;
+			size_t size;
+			size_t pos;
+			/// offset up to which line and column have been counted, so reporting errors in order doesn't recount from the start
+			size_t counted;
 			int line;
 			int column;
-			std::istream *stream;
-			//bool must_delete;
-			int *refcount;
-
-			IncludeCacheEntry( std::istream *stream_, bool must_delete_ = false ):
+			bool skip_eol;
+
+			Source( const char* data_, size_t size_, const std::string& name_ ):
+					name( name_ ),
+					data( data_ ),
+					size( size_ ),
+					pos( 0 ),
+					counted( 0 ),
 					line( 1 ),
 					column( 1 ),
-					stream( stream_ ),
-					refcount( NULL )
-			{
-				if ( must_delete_ ) {
-					refcount = new int;
-					( *refcount ) = 1;
-				}
-			}
-			IncludeCacheEntry( const IncludeCacheEntry &other ):
-					line( other.line ),
-					column( other.column ),
-					stream( other.stream ),
-					refcount( other.refcount )
-			{
-				stream = other.stream;
-				refcount = other.refcount;
-				if ( refcount )( *refcount ) += 1;
-			}
-			~IncludeCacheEntry()
+					skip_eol( false )
 			{
-				if ( refcount ) {
-					( *refcount )--;
-					if ( ( *refcount ) <= 0 ) {
-						delete stream;
-						delete refcount;
-					}
-				}
 			}
+			const char* Begin() const { return owned.empty() ? data : owned.data(); }
 		};
-		std::vector<IncludeCacheEntry> include_stack;
-		void UnwindStack();
+		std::vector<Source> sources;
+		/// the source tokens are read from, NULL once all are exhausted
+		Source* Current();
 
-		std::deque<Token> token_buffer;
-		//size_t max_buffer_size;
+		/// lookahead, only as long as GetToken asked for
+		std::vector<Token> token_buffer;
 		size_t buffer_pos;
 
-		bool skip_eol;
-		char GetNextChar();
-		char PeekNextChar();
-
 		void ReadToken( Token &token );
-		void SkipSpaces();
 
 		int errors;
 
 	public:
-		Tokenizer(): buffer_pos( 0 ), skip_eol( false ), errors( 0 )
+		Tokenizer(): buffer_pos( 0 ), errors( 0 )
 		{
 		}
 
+		/// reads all of \param stream_ into a buffer of its own
 		void EnterStream( std::istream& stream_, const std::string& name = "" );
+		/// tokenizes \param data in place, it has to outlive the tokenizer
+		void EnterBuffer( const char* data, size_t size, const std::string& name = "" );
+		void EnterString( const std::string& text, const std::string& name = "" ) {
+			EnterBuffer( text.data(), text.size(), name );
+		}
 
+		/// \param i tokens ahead of the current one, looking back is not supported
 		Token GetToken( int i = 0 );
 		void Step( int i = 1 );
 		inline Token TakeToken() {
@@ -273,6 +268,12 @@ class Tokenizer {
 
 		bool Good();
 
+		/// the text of \param t, section names without their escapes
+		std::string Value( const Token& t ) const;
+		/// where the text of \param t starts in its source, escapes left in; NULL for EOF
+		const char* Data( const Token& t ) const;
+		/// "line 3 , column 7" style position of \param t for error reporting
+		std::string Position( const Token& t );
 		void ReportError( const Token& t, const std::string& err );
 
 		int NumErrors() const {
@@ -286,6 +287,9 @@ inline Tokenizer &operator >>( Tokenizer& tokenizer, Token& token ) {
 }
 
 PDataList ParseTDF( std::istream &s, int *error_count = NULL );
+/// parses \param text in place, without going through a stream
+PDataList ParseTDF( const std::string& text, int *error_count = NULL );
+PDataList ParseTDF( const char* data, size_t size, int *error_count = NULL );
 
 //Defintions to not clutter up the class declaration
 template<class T> void TDFWriter:: Append( const std::string& name, T value )
@@ -0,0 +1,317 @@
+#include "tdfdocument.h"
+#include "tdfcontainer.h"
+
+#include <lslutils/misc.h>
+#include <lslutils/casefold.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace LSL {
+namespace TDF {
+
+namespace {
+
+//! the first block is at least this big and later ones double
+const size_t FIRST_BLOCK_SIZE = 64 * 1024;
+//! a script with its nodes takes about five times its size
+const size_t BYTES_PER_SOURCE_BYTE = 5;
+const size_t ALIGNMENT = sizeof( void* );
+//! sections with more children than this get a hash table, smaller ones are searched in order
+const size_t LINEAR_FIND_MAX = 8;
+
+bool SameName( const Document::Node& node, const char* name, size_t size )
+{
+	if ( node.name_size != size )
+		return false;
+	for ( size_t i = 0; i < size; ++i )
+		if ( Util::FoldChar( node.name[i] ) != Util::FoldChar( name[i] ) )
+			return false;
+	return true;
+}
+
+const Document::Node* FindHashed( const Document::Node& section, const char* name, size_t size, boost::uint32_t hash )
+{
+	if ( !section.table ) {
+		for ( size_t i = 0; i < section.count; ++i )
+			if ( section.children[i].hash == hash && SameName( section.children[i], name, size ) )
+				return &section.children[i];
+		return NULL;
+	}
+	const boost::uint32_t mask = section.table_size - 1;
+	for ( boost::uint32_t slot = hash & mask; section.table[slot]; slot = ( slot + 1 ) & mask ) {
+		const Document::Node& child = section.children[section.table[slot] - 1];
+		if ( child.hash == hash && SameName( child, name, size ) )
+			return &child;
+	}
+	return NULL;
+}
+
+Document::Node EmptyNode()
+{
+	Document::Node node;
+	std::memset( &node, 0, sizeof( node ) );
+	return node;
+}
+
+} // namespace
+
+Document::Document()
+	: m_root( EmptyNode() )
+{
+}
+
+Document::~Document()
+{
+	for ( size_t i = 0; i < m_blocks.size(); ++i )
+		::operator delete( m_blocks[i].data );
+}
+
+void Document::Clear()
+{
+	for ( size_t i = 1; i < m_blocks.size(); ++i )
+		::operator delete( m_blocks[i].data );
+	if ( !m_blocks.empty() ) {
+		m_blocks.resize( 1 );
+		m_blocks.front().used = 0;
+	}
+	m_open.clear();
+	m_root = EmptyNode();
+}
+
+void* Document::Allocate( size_t size, size_t reserve )
+{
+	size = ( size + ALIGNMENT - 1 ) & ~( ALIGNMENT - 1 );
+	if ( m_blocks.empty() || m_blocks.back().size - m_blocks.back().used < size ) {
+		Block block;
+		block.size = std::max( std::max( size, reserve ), m_blocks.empty() ? FIRST_BLOCK_SIZE : 2 * m_blocks.back().size );
+		block.data = static_cast<char*>( ::operator new( block.size ) );
+		block.used = 0;
+		m_blocks.push_back( block );
+	}
+	Block& block = m_blocks.back();
+	void* result = block.data + block.used;
+	block.used += size;
+	return result;
+}
+
+size_t Document::BytesUsed() const
+{
+	size_t result = 0;
+	for ( size_t i = 0; i < m_blocks.size(); ++i )
+		result += m_blocks[i].used;
+	return result;
+}
+
+size_t Document::BytesReserved() const
+{
+	size_t result = 0;
+	for ( size_t i = 0; i < m_blocks.size(); ++i )
+		result += m_blocks[i].size;
+	return result;
+}
+
+int Document::Parse( const std::string& text )
+{
+	return Parse( text.data(), text.size() );
+}
+
+int Document::Parse( const char* data, size_t size )
+{
+	Clear();
+	// terminated, so numbers at the very end of the source stop there
+	char* source = static_cast<char*>( Allocate( size + 1, size * BYTES_PER_SOURCE_BYTE ) );
+	std::memcpy( source, data, size );
+	source[size] = 0;
+	Tokenizer f;
+	f.EnterBuffer( source, size );
+	Load( f, m_root );
+	return f.NumErrors();
+}
+
+const char* Document::View( const Tokenizer& f, const Token& t, boost::uint32_t& size )
+{
+	const char* data = f.Data( t );
+	if ( !data ) {
+		size = 0;
+		return "";
+	}
+	if ( !t.escaped ) {
+		size = boost::uint32_t( t.length );
+		return data;
+	}
+	const std::string value = f.Value( t );
+	char* result = static_cast<char*>( Allocate( value.size() ) );
+	std::memcpy( result, value.data(), value.size() );
+	size = boost::uint32_t( value.size() );
+	return result;
+}
+
+//! DataList::Load, with the same errors for the same input
+void Document::Load( Tokenizer& f, Node& section )
+{
+	const size_t begin = m_open.size();
+	while ( f.Good() ) {
+		const Token t = f.TakeToken();
+		if ( t.type == Token::type_leave_section || t.type == Token::type_eof )
+			break;
+		if ( t.type == Token::type_entry_name ) {
+			Node leaf = EmptyNode();
+			leaf.name = View( f, t, leaf.name_size );
+			leaf.hash = Util::FoldedHash( leaf.name, leaf.name_size );
+			leaf.value = View( f, f.TakeToken(), leaf.value_size );
+			const Token end = f.TakeToken();
+			if ( end.type != Token::type_semicolon )
+				f.ReportError( end, "; expected" );
+			m_open.push_back( leaf );
+		} else if ( t.type == Token::type_section_name ) {
+			if ( f.TakeToken().type != Token::type_enter_section ) {
+				f.ReportError( t, "'{' expected" );
+				continue;
+			}
+			Node list = EmptyNode();
+			list.name = View( f, t, list.name_size );
+			list.hash = Util::FoldedHash( list.name, list.name_size );
+			Load( f, list ); // will eat the '}'
+			m_open.push_back( list );
+		} else {
+			f.ReportError( t, "[sectionname] or entryname= expected." );
+		}
+	}
+	Close( section, begin );
+}
+
+void Document::Close( Node& section, size_t begin )
+{
+	const size_t count = m_open.size() - begin;
+	Node* children = count ? static_cast<Node*>( Allocate( count * sizeof( Node ) ) ) : NULL;
+	boost::uint32_t* table = NULL;
+	section.table_size = 0;
+	if ( count > LINEAR_FIND_MAX ) {
+		section.table_size = 1;
+		while ( section.table_size < 2 * count )
+			section.table_size *= 2;
+		table = static_cast<boost::uint32_t*>( Allocate( section.table_size * sizeof( boost::uint32_t ) ) );
+		std::memset( table, 0, section.table_size * sizeof( boost::uint32_t ) );
+	}
+	section.children = children;
+	section.table = table;
+	section.count = 0;
+	const boost::uint32_t mask = section.table_size - 1;
+	for ( size_t i = begin; i < m_open.size(); ++i ) {
+		const Node& child = m_open[i];
+		// like DataList::Insert, the first one with a name stays
+		if ( FindHashed( section, child.name, child.name_size, child.hash ) )
+			continue;
+		children[section.count] = child;
+		section.count++;
+		if ( table ) {
+			boost::uint32_t slot = child.hash & mask;
+			while ( table[slot] )
+				slot = ( slot + 1 ) & mask;
+			table[slot] = section.count;
+		}
+	}
+	m_open.resize( begin );
+}
+
+const Document::Node* Document::Find( const Node& section, const char* name, size_t size )
+{
+	return FindHashed( section, name, size, Util::FoldedHash( name, size ) );
+}
+
+std::string DocNode::Name() const
+{
+	return m_node ? std::string( m_node->name, m_node->name_size ) : std::string();
+}
+
+std::string DocNode::GetValue() const
+{
+	return IsList() || !m_node ? std::string() : std::string( m_node->value, m_node->value_size );
+}
+
+DocNode DocList::Find( const std::string& name ) const
+{
+	return m_node ? Document::Find( *m_node, name.data(), name.size() ) : NULL;
+}
+
+namespace {
+
+//! the leaf \param name of \param list, NULL for sections and missing ones
+const Document::Node* Leaf( const DocList& list, const std::string& name, bool* it_worked )
+{
+	const DocNode node( list.Find( name ) );
+	const Document::Node* leaf = node.ok() && !node.IsList() ? node.Get() : NULL;
+	if ( it_worked )
+		*it_worked = leaf != NULL;
+	return leaf;
+}
+
+//! numbers are short, they are copied into \param buffer to have them terminated
+const char* Terminated( const Document::Node& leaf, char ( &buffer )[64] )
+{
+	const size_t size = std::min<size_t>( leaf.value_size, sizeof( buffer ) - 1 );
+	std::memcpy( buffer, leaf.value, size );
+	buffer[size] = 0;
+	return buffer;
+}
+
+} // namespace
+
+int DocList::GetInt( const std::string& name, int default_value, bool* it_worked ) const
+{
+	const Document::Node* leaf = Leaf( *this, name, it_worked );
+	if ( !leaf )
+		return default_value;
+	char buffer[64];
+	return int( std::strtol( Terminated( *leaf, buffer ), NULL, 10 ) );
+}
+
+double DocList::GetDouble( const std::string& name, double default_value, bool* it_worked ) const
+{
+	const Document::Node* leaf = Leaf( *this, name, it_worked );
+	if ( !leaf )
+		return default_value;
+	char buffer[64];
+	return std::strtod( Terminated( *leaf, buffer ), NULL );
+}
+
+std::string DocList::GetString( const std::string& name, const std::string& default_value, bool* it_worked ) const
+{
+	const Document::Node* leaf = Leaf( *this, name, it_worked );
+	return leaf ? std::string( leaf->value, leaf->value_size ) : default_value;
+}
+
+int DocList::GetDoubleArray( const std::string& name, int n_values, double* values ) const
+{
+	const Document::Node* leaf = Leaf( *this, name, NULL );
+	if ( !leaf )
+		return 0;
+	const std::string value( leaf->value, leaf->value_size );
+	const char* pos = value.c_str();
+	int values_read = 0;
+	while ( values_read < n_values ) {
+		char* end = NULL;
+		const double d = std::strtod( pos, &end );
+		if ( end == pos )
+			break;
+		values[values_read++] = d;
+		pos = end;
+	}
+	return values_read;
+}
+
+lslColor DocList::GetColour( const std::string& name, const lslColor& default_value, bool* it_worked ) const
+{
+	double values[3];
+	const bool worked = GetDoubleArray( name, 3, values ) == 3;
+	if ( it_worked )
+		*it_worked = worked;
+	if ( !worked )
+		return default_value;
+	return lslColor( values[0] * 255.99, values[1] * 255.99, values[2] * 255.99 );
+}
+
+} // namespace TDF
+} // namespace LSL
@@ -0,0 +1,158 @@
+#ifndef LSL_HEADERGUARD_BATTLE_TDFDOCUMENT_H
+#define LSL_HEADERGUARD_BATTLE_TDFDOCUMENT_H
+
+#include <lslutils/type_forwards.h>
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace LSL {
+namespace TDF {
+
+class Tokenizer;
+struct Token;
+
+/** \brief a parsed TDF source, read only, with everything in one arena
+ * The document keeps a copy of the source and names and values point into it, only escaped
+ * section names get rewritten. The children of a section are one array in source order,
+ * sections with more than a few children also get a hash table for Find.
+ * Like DataList, names compare case insensitively and the first of two entries with the same
+ * name is kept. Use DocList to read it the way a DataList is read.
+ **/
+class Document : public boost::noncopyable
+{
+public:
+	struct Node
+	{
+		const char* name;
+		//! NULL for sections
+		const char* value;
+		const Node* children;
+		//! child index + 1 at hash & ( table_size - 1 ), NULL for small sections
+		const boost::uint32_t* table;
+		boost::uint32_t name_size;
+		boost::uint32_t value_size;
+		boost::uint32_t count;
+		boost::uint32_t table_size;
+		boost::uint32_t hash;
+	};
+
+	Document();
+	~Document();
+
+	/** replaces the content with \param text, errors are logged like ParseTDF does
+	 * \return the number of errors **/
+	int Parse( const std::string& text );
+	int Parse( const char* data, size_t size );
+	//! gives the arena back, except for its first block
+	void Clear();
+
+	const Node& Root() const { return m_root; }
+	//! the child of \param section called \param name in any case, NULL if there is none
+	static const Node* Find( const Node& section, const char* name, size_t size );
+
+	//! bytes taken from the arena and the bytes of the blocks they were taken from
+	size_t BytesUsed() const;
+	size_t BytesReserved() const;
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+		size_t used;
+	};
+
+	//! a new block is at least \param reserve bytes big
+	void* Allocate( size_t size, size_t reserve = 0 );
+	const char* View( const Tokenizer& f, const Token& t, boost::uint32_t& size );
+	void Load( Tokenizer& f, Node& section );
+	//! moves the children collected since \param begin into the arena
+	void Close( Node& section, size_t begin );
+
+	std::vector<Block> m_blocks;
+	//! children of the sections still being parsed
+	std::vector<Node> m_open;
+	Node m_root;
+};
+
+//! a node of a Document, the counterpart of PNode
+class DocNode
+{
+public:
+	DocNode( const Document::Node* node = NULL ) : m_node( node ) {}
+
+	bool ok() const { return m_node != NULL; }
+	bool IsList() const { return m_node && !m_node->value; }
+	std::string Name() const;
+	//! empty for sections
+	std::string GetValue() const;
+	const Document::Node* Get() const { return m_node; }
+
+	bool operator == ( const DocNode& other ) const { return m_node == other.m_node; }
+	bool operator != ( const DocNode& other ) const { return m_node != other.m_node; }
+
+protected:
+	const Document::Node* m_node;
+};
+
+/** \brief the reading half of DataList over a section of a Document
+ * Like PDataList( PNode ), a DocList of a leaf isn't ok(). Children are iterated the same way:
+ * for ( DocNode n = list.First(); n != list.End(); n = list.Next( n ) )
+ * The document has to outlive it.
+ **/
+class DocList : public DocNode
+{
+public:
+	DocList( const Document::Node* node = NULL ) : DocNode( node && !node->value ? node : NULL ) {}
+	DocList( const DocNode& node ) : DocNode( node.IsList() ? node.Get() : NULL ) {}
+	explicit DocList( const Document& document ) : DocNode( &document.Root() ) {}
+
+	DocNode Find( const std::string& name ) const;
+	size_t size() const { return m_node ? m_node->count : 0; }
+
+	DocNode First() const { return m_node ? m_node->children : NULL; }
+	DocNode Next( const DocNode& what ) const { return what.ok() ? what.Get() + 1 : NULL; }
+	DocNode End() const { return m_node ? m_node->children + m_node->count : NULL; }
+
+	int GetInt( const std::string& name, int default_value = 0, bool* it_worked = NULL ) const;
+	double GetDouble( const std::string& name, double default_value = 0, bool* it_worked = NULL ) const;
+	std::string GetString( const std::string& name, const std::string& default_value = std::string(), bool* it_worked = NULL ) const;
+	//! reads up to \param n_values space separated numbers, \return how many it read
+	int GetDoubleArray( const std::string& name, int n_values, double* values ) const;
+	lslColor GetColour( const std::string& name, const lslColor& default_value, bool* it_worked = NULL ) const;
+};
+
+} // namespace TDF
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_TDFDOCUMENT_H
+
+/**
+ * \file tdfdocument.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
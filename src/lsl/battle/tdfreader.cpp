@@ -0,0 +1,266 @@
+#include "tdfreader.h"
+#include "tdfcontainer.h"
+
+#include <lslutils/conversion.h>
+#include <lslutils/casefold.h>
+#include <lslutils/bits.h>
+
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+
+namespace LSL {
+namespace TDF {
+
+namespace {
+
+typedef boost::uint64_t Mask;
+
+//! \param pattern is folded already, a '*' in it matches any run of characters
+bool Match( const std::string& pattern, const Span& name )
+{
+	size_t p = 0, n = 0;
+	size_t star = std::string::npos, resume = 0;
+	while ( n < name.size ) {
+		if ( p < pattern.size() && pattern[p] == '*' ) {
+			star = p++;
+			resume = n;
+		} else if ( p < pattern.size() && pattern[p] == Util::FoldChar( name.data[n] ) ) {
+			++p;
+			++n;
+		} else if ( star != std::string::npos ) {
+			p = star + 1;
+			n = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while ( p < pattern.size() && pattern[p] == '*' )
+		++p;
+	return p == pattern.size();
+}
+
+//! the text of \param t, escaped section names are rewritten into \param buffer
+Span View( const Tokenizer& f, const Token& t, std::string& buffer )
+{
+	Span result = { f.Data( t ), t.length };
+	if ( !result.data ) {
+		result.data = "";
+		result.size = 0;
+	} else if ( t.escaped ) {
+		buffer = f.Value( t );
+		result.data = buffer.data();
+		result.size = buffer.size();
+	}
+	return result;
+}
+
+//! the paths in \param candidates with a section or entry at \param depth matching \param name
+Mask Matching( const PathFilter& filter, Mask candidates, size_t depth, bool entry, const Span& name )
+{
+	Mask result = 0;
+	for ( size_t i = 0; candidates; ++i, candidates >>= 1 ) {
+		if ( !( candidates & 1 ) )
+			continue;
+		const StringVector& segments = filter[i].segments;
+		const bool is_entry = segments.size() == depth + 1;
+		if ( is_entry == entry && depth < segments.size() && Match( segments[depth], name ) )
+			result |= Mask( 1 ) << i;
+	}
+	return result;
+}
+
+} // namespace
+
+bool Span::Is( const std::string& name ) const
+{
+	if ( name.size() != size )
+		return false;
+	for ( size_t i = 0; i < size; ++i )
+		if ( Util::FoldChar( data[i] ) != Util::FoldChar( name[i] ) )
+			return false;
+	return true;
+}
+
+PathFilter::PathFilter( const StringVector& paths )
+{
+	if ( paths.size() > MAX_PATHS )
+		throw std::length_error( "PathFilter: more than " + Util::ToString( size_t( MAX_PATHS ) ) + " paths" );
+	for ( size_t i = 0; i < paths.size(); ++i )
+		Add( paths[i] );
+}
+
+bool PathFilter::Add( const std::string& path )
+{
+	if ( m_paths.size() == MAX_PATHS )
+		return false;
+	Path result;
+	result.literal = 0;
+	std::string segment;
+	for ( size_t i = 0; i <= path.size(); ++i ) {
+		if ( i < path.size() && path[i] != '/' ) {
+			segment += Util::FoldChar( path[i] );
+			continue;
+		}
+		if ( result.literal == result.segments.size() && segment.find( '*' ) == std::string::npos )
+			result.literal++;
+		result.segments.push_back( segment );
+		segment.clear();
+	}
+	m_paths.push_back( result );
+	return true;
+}
+
+int ReadTDF( const std::string& text, Handler& handler, const PathFilter& filter )
+{
+	return ReadTDF( text.data(), text.size(), handler, filter );
+}
+
+//! follows DataList::Load, so the same input gives the same errors
+int ReadTDF( const char* data, size_t size, Handler& handler, const PathFilter& filter )
+{
+	Tokenizer f;
+	f.EnterBuffer( data, size );
+	const bool filtered = !filter.empty();
+	// paths not seen yet, and of those the ones the current section is on
+	Mask pending = filtered ? ( ~Mask( 0 ) >> ( PathFilter::MAX_PATHS - filter.size() ) ) : 0;
+	Mask current = pending;
+	std::vector<Mask> open;
+	// sections deep into one nobody asked for
+	size_t skipping = 0;
+	std::string name_buffer, value_buffer;
+	bool reading = true;
+	while ( reading && f.Good() ) {
+		const Token t = f.TakeToken();
+		switch ( t.type ) {
+			case Token::type_leave_section:
+			case Token::type_eof:
+				if ( skipping ) {
+					--skipping;
+					break;
+				}
+				// a '}' at the top ends the source like it ends ParseTDF
+				if ( open.empty() ) {
+					reading = false;
+					break;
+				}
+				for ( Mask left = current; left; left &= left - 1 ) {
+					const size_t i = Util::CountTrailingZeros( left );
+					if ( filter[i].literal >= open.size() )
+						pending &= ~( Mask( 1 ) << i );
+				}
+				current = open.back() & pending;
+				open.pop_back();
+				reading = handler.LeaveSection() && ( !filtered || pending );
+				break;
+			case Token::type_entry_name: {
+					const Token value = f.TakeToken();
+					const Token end = f.TakeToken();
+					if ( end.type != Token::type_semicolon )
+						f.ReportError( end, "; expected" );
+					if ( skipping )
+						break;
+					const Span name = View( f, t, name_buffer );
+					int path = -1;
+					if ( filtered ) {
+						const Mask matching = Matching( filter, current, open.size(), true, name );
+						if ( !matching )
+							break;
+						path = int( Util::CountTrailingZeros( matching ) );
+						// a path without '*' is done with its first entry, the one DataList::Insert keeps
+						for ( Mask seen = matching; seen; seen &= seen - 1 ) {
+							const size_t i = Util::CountTrailingZeros( seen );
+							if ( filter[i].literal == filter[i].segments.size() ) {
+								pending &= ~( Mask( 1 ) << i );
+								current &= ~( Mask( 1 ) << i );
+							}
+						}
+					}
+					reading = handler.Entry( name, View( f, value, value_buffer ), path ) && ( !filtered || pending );
+					break;
+				}
+			case Token::type_section_name: {
+					if ( f.TakeToken().type != Token::type_enter_section ) {
+						f.ReportError( t, "'{' expected" );
+						break;
+					}
+					if ( skipping ) {
+						++skipping;
+						break;
+					}
+					const Span name = View( f, t, name_buffer );
+					Mask inner = 0;
+					if ( filtered ) {
+						inner = Matching( filter, current, open.size(), false, name );
+						if ( !inner ) {
+							skipping = 1;
+							break;
+						}
+					}
+					open.push_back( current );
+					current = inner;
+					reading = handler.EnterSection( name );
+					break;
+				}
+			default:
+				f.ReportError( t, "[sectionname] or entryname= expected." );
+		}
+	}
+	// sections left open at the end are closed, like DataList does
+	if ( reading ) {
+		for ( ; !open.empty() && handler.LeaveSection(); open.pop_back() )
+			;
+	}
+	return f.NumErrors();
+}
+
+namespace {
+
+//! collects matching entries by their full path
+class PathCollector : public Handler
+{
+public:
+	explicit PathCollector( StringMap& values ) : m_values( values ) {}
+
+	bool EnterSection( const Span& name )
+	{
+		m_lengths.push_back( m_path.size() );
+		for ( size_t i = 0; i < name.size; ++i )
+			m_path += Util::FoldChar( name.data[i] );
+		m_path += '/';
+		return true;
+	}
+	bool LeaveSection()
+	{
+		m_path.resize( m_lengths.back() );
+		m_lengths.pop_back();
+		return true;
+	}
+	bool Entry( const Span& name, const Span& value, int /*path*/ )
+	{
+		std::string key( m_path );
+		for ( size_t i = 0; i < name.size; ++i )
+			key += Util::FoldChar( name.data[i] );
+		m_values.insert( std::make_pair( key, value.str() ) );
+		return true;
+	}
+
+private:
+	StringMap& m_values;
+	std::string m_path;
+	std::vector<size_t> m_lengths;
+};
+
+} // namespace
+
+StringMap ReadPaths( const std::string& text, const StringVector& paths, int* error_count )
+{
+	StringMap result;
+	PathCollector collector( result );
+	const int errors = ReadTDF( text, collector, PathFilter( paths ) );
+	if ( error_count )
+		*error_count = errors;
+	return result;
+}
+
+} // namespace TDF
+} // namespace LSL
@@ -0,0 +1,120 @@
+#ifndef LSL_HEADERGUARD_BATTLE_TDFREADER_H
+#define LSL_HEADERGUARD_BATTLE_TDFREADER_H
+
+#include <lslutils/type_forwards.h>
+
+#include <string>
+#include <vector>
+
+namespace LSL {
+namespace TDF {
+
+//! a name or value as it was read, only valid during the Handler call it is passed to
+struct Span
+{
+	const char* data;
+	size_t size;
+
+	std::string str() const { return std::string( data, size ); }
+	//! compares case insensitively, like DataList names
+	bool Is( const std::string& name ) const;
+};
+
+/** \brief receives what ReadTDF reads, in source order
+ * Nothing is merged: a name given twice in a section, or a section given twice, arrives
+ * twice unless the filter already ended it (see ReadTDF). To get what DataList keeps, keep
+ * the first entry of a path and ignore the others, like ReadPaths does.
+ **/
+class Handler
+{
+public:
+	virtual ~Handler() {}
+	//! \return false to stop reading, the same for the others
+	virtual bool EnterSection( const Span& /*name*/ ) { return true; }
+	virtual bool LeaveSection() { return true; }
+	//! \param path index in the filter of the first path \param name matched, -1 without a filter
+	virtual bool Entry( const Span& name, const Span& value, int path ) = 0;
+};
+
+//! the entries a ReadTDF caller wants, like game/mapname or game/player*/name: segments are
+//! separated by '/' and compare case insensitively, a '*' in one matches any characters and
+//! the last one names entries
+class PathFilter
+{
+public:
+	//! so the paths still open fit a machine word at every depth
+	static const size_t MAX_PATHS = 64;
+
+	PathFilter() {}
+	//! throws std::length_error for more than MAX_PATHS paths instead of dropping the rest
+	explicit PathFilter( const StringVector& paths );
+	//! \return false if there already are MAX_PATHS
+	bool Add( const std::string& path );
+
+	size_t size() const { return m_paths.size(); }
+	bool empty() const { return m_paths.empty(); }
+
+	struct Path
+	{
+		StringVector segments;
+		//! how many segments from the front have no '*'
+		size_t literal;
+	};
+	const Path& operator [] ( size_t i ) const { return m_paths[i]; }
+
+private:
+	std::vector<Path> m_paths;
+};
+
+/** \brief reads \param data without building a tree
+ * Errors are reported like ParseTDF does. With a filter only the sections leading to one
+ * of its paths are entered and only matching entries are passed on; the rest is still
+ * tokenized but not looked at. Reading stops once every path was seen: a path without
+ * '*' is seen at its first match, so only that one is passed on. A path with '*' is seen
+ * when the first section of its leading literal segments is left, every match up to there
+ * is passed on, duplicates included; one starting with '*' is never seen and keeps reading
+ * to the end. Without a filter every entry and section is passed on. Memory doesn't
+ * grow with the source, only with the depth of its sections.
+ * \return the number of errors
+ **/
+int ReadTDF( const char* data, size_t size, Handler& handler, const PathFilter& filter = PathFilter() );
+int ReadTDF( const std::string& text, Handler& handler, const PathFilter& filter = PathFilter() );
+
+/** \brief the values of the entries matching \param paths
+ * keyed by their full path in lower case, e.g. "game/player3/name". Like DataList, the first
+ * of two entries with the same path is kept. Without paths it has all entries, more than
+ * PathFilter::MAX_PATHS throw std::length_error.
+ **/
+StringMap ReadPaths( const std::string& text, const StringVector& paths, int* error_count = NULL );
+
+} // namespace TDF
+} // namespace LSL
+
+#endif // LSL_HEADERGUARD_BATTLE_TDFREADER_H
+
+/**
+ * \file tdfreader.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -5,21 +5,37 @@
 namespace LSL {
 
 Channel::Channel()
+    : m_numusers( 0 )
 {
 }
 
-Channel::Channel(const std::string &/*name*/)
+Channel::Channel(const std::string& name)
+    : m_name( name )
+    , m_numusers( 0 )
 {
 }
 
-void Channel::OnChannelJoin(const ConstUserPtr /*user*/)
+void Channel::OnChannelJoin(const ConstCommonUserPtr user)
 {
-    assert(false);
+    if ( user && user->DenseIndex() != CommonUser::INVALID_INDEX )
+        m_members.Insert( user->DenseIndex() );
 }
 
-void Channel::SetNumUsers(size_t /*numusers*/)
+void Channel::OnChannelPart(const ConstCommonUserPtr user)
 {
-    assert(false);
+    if ( user && user->DenseIndex() != CommonUser::INVALID_INDEX )
+        m_members.Erase( user->DenseIndex() );
+}
+
+bool Channel::IsMember(const ConstCommonUserPtr user) const
+{
+    return user && user->DenseIndex() != CommonUser::INVALID_INDEX
+            && m_members.Contains( user->DenseIndex() );
+}
+
+void Channel::SetNumUsers(size_t numusers)
+{
+    m_numusers = numusers;
 }
 
 void Channel::SetTopic(const std::string& topic)
@@ -3,6 +3,8 @@
 
 #include <lslutils/global_interfaces.h>
 #include <lslutils/type_forwards.h>
+#include <lsl/container/memberset.h>
+#include <lslutils/stringpool.h>
 
 namespace LSL {
 
@@ -17,15 +19,25 @@ public:
     std::string key() const { return Name(); }
     static std::string className() { return "Channel"; }
 
-	std::string Name() const { return "dummy"; }
+	const std::string& Name() const { return m_name; }
 
-    void OnChannelJoin( const ConstUserPtr user );
+    //! O(1), users without a dense index (not in the server UserList) are ignored
+    void OnChannelJoin( const ConstCommonUserPtr user );
+    void OnChannelPart( const ConstCommonUserPtr user );
+    bool IsMember( const ConstCommonUserPtr user ) const;
+    //! dense user indices, resolve with UserList::GetByIndex
+    const MemberSet& Members() const { return m_members; }
 
+    //! user count as announced in the channel list, may differ from Members().size()
+    size_t GetNumUsers() const { return m_numusers; }
     void SetNumUsers( size_t numusers );
     void SetTopic( const std::string& topic);
 
 private:
+    Util::InternedString m_name;
     std::string m_topic;
+    size_t m_numusers;
+    MemberSet m_members;
 };
 
 } // namespace LSL {
@@ -54,6 +54,22 @@ typename ContainerBase<T>::PointerType ContainerBase<T>::Get( const KeyType& ind
     return it->second;
 }
 
+template < class T >
+typename ContainerBase<T>::ConstPointerType ContainerBase<T>::Find( const KeyType& index ) const
+{
+    typename ContainerBase<T>::MapType::const_iterator
+        it = m_map.find( index );
+    return it == m_map.end() ? ConstPointerType() : ConstPointerType( it->second );
+}
+
+template < class T >
+typename ContainerBase<T>::PointerType ContainerBase<T>::Find( const KeyType& index )
+{
+    typename ContainerBase<T>::MapType::iterator
+        it = m_map.find( index );
+    return it == m_map.end() ? PointerType() : it->second;
+}
+
 template < class T >
 bool ContainerBase<T>::Exists( const KeyType& index ) const
 {
@@ -3,9 +3,12 @@
 
 
 #include <boost/smart_ptr.hpp>
+#include <cstddef>
 #include <map>
 #include <vector>
+#include <iterator>
 #include <stdexcept>
+#include <type_traits>
 
 namespace LSL {
 
@@ -31,6 +34,59 @@ protected:
         ConstVectorType;
 
 public:
+    /** \brief forward iterator over the stored items
+     * the mutable flavour dereferences to a reference to the PointerType in the
+     * underlying map, the const flavour to a raw const ItemType*, so walking a
+     * list neither allocates nor touches the shared_ptr refcounts
+     **/
+    template < class Pointer >
+    class BasicViewIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Pointer value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional< std::is_same< Pointer, PointerType >::value,
+                                           const Pointer&, Pointer >::type reference;
+        typedef const Pointer* pointer;
+
+        BasicViewIterator() {}
+        explicit BasicViewIterator( typename MapType::const_iterator it ) : m_it( it ) {}
+        reference operator*() const { return Deref( m_it->second ); }
+        BasicViewIterator& operator++() { ++m_it; return *this; }
+        BasicViewIterator operator++( int ) { BasicViewIterator tmp( *this ); ++m_it; return tmp; }
+        bool operator==( const BasicViewIterator& other ) const { return m_it == other.m_it; }
+        bool operator!=( const BasicViewIterator& other ) const { return m_it != other.m_it; }
+    private:
+        static const PointerType& Deref( const PointerType& p, std::true_type ) { return p; }
+        static const ItemType* Deref( const PointerType& p, std::false_type ) { return p.get(); }
+        static reference Deref( const PointerType& p ) { return Deref( p, std::is_same< Pointer, PointerType >() ); }
+
+        typename MapType::const_iterator m_it;
+    };
+
+    /** \brief non-owning range over all items, usable in range-based for
+     * only valid as long as the list isn't modified
+     **/
+    template < class Pointer >
+    class BasicView {
+    public:
+        typedef BasicViewIterator< Pointer > iterator;
+        typedef BasicViewIterator< Pointer > const_iterator;
+        BasicView( typename MapType::const_iterator b, typename MapType::const_iterator e, typename MapType::size_type s )
+            : m_begin( b ), m_end( e ), m_size( s ) {}
+        iterator begin() const { return m_begin; }
+        iterator end() const { return m_end; }
+        typename MapType::size_type size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+    private:
+        iterator m_begin;
+        iterator m_end;
+        typename MapType::size_type m_size;
+    };
+
+    typedef BasicView< PointerType > View;
+    typedef BasicView< const ItemType* > ConstView;
+
     //! putting this here makes it inherently distinguishable on a per *List basis
 	struct MissingItemException : public std::runtime_error {
 		MissingItemException( const KeyType& key );
@@ -46,6 +102,9 @@ public:
 	//! throws MissingItemException if no item at \param key
 	const PointerType Get( const KeyType& key ) const;
 	PointerType Get( const KeyType& key );
+	//! null if no item at \param key
+	ConstPointerType Find( const KeyType& key ) const;
+	PointerType Find( const KeyType& key );
 	bool Exists( const KeyType& key ) const;
     bool Exists( const ConstPointerType ptr ) const;
 
@@ -65,8 +124,12 @@ public:
 	const ConstPointerType operator[]( typename MapType::size_type index ) const { return At(index); }
 	const PointerType operator[]( typename MapType::size_type index ) { return At(index); }
 
+    //! copies all pointers, prefer Items() unless the list may change while iterating
     ConstVectorType Vectorize() const;
     VectorType Vectorize();
+    //! cheap, non-copying view on all items
+    ConstView Items() const { return ConstView( m_map.begin(), m_map.end(), m_map.size() ); }
+    View Items() { return View( m_map.begin(), m_map.end(), m_map.size() ); }
 
 
 private:
@@ -1,12 +1,199 @@
 #include "battlelist.h"
 
+#include <lslutils/conversion.h>
+
+#include <limits>
+
 namespace LSL {
 namespace Battle {
 
-std::string BattleList::GetChannelName( const ConstIBattlePtr /*battle*/ )
+BattleQuery::BattleQuery()
+    : locked( ANY )
+    , passworded( ANY )
+    , free_slots( false )
+    , min_players( 0 )
+    , max_rankneeded( -1 )
+    , max_spectators( -1 )
+    , order( SORT_NONE )
+    , limit( 0 )
+{}
+
+std::string BattleList::GetChannelName( const ConstIBattlePtr battle )
+{
+    return "#__battle__" + Util::ToString( battle->GetBattleId() );
+}
+
+void BattleList::Add( PointerType item )
+{
+    ContainerBase< Battle >::Add( item );
+    UpdateIndex( item );
+}
+
+BattleList::PointerType BattleList::Add( ItemType* item )
+{
+    PointerType p( item );
+    Add( p );
+    return p;
+}
+
+void BattleList::Remove( const KeyType& key )
+{
+    ContainerBase< Battle >::Remove( key );
+    Unindex( key );
+}
+
+void BattleList::UpdateIndex( const ConstIBattlePtr battle )
+{
+    if ( !battle )
+        return;
+    const int id = battle->GetBattleId();
+    Unindex( id );
+    if ( !Exists( id ) )
+        return;
+
+    IndexEntry& entry = m_index_entries[id];
+    entry.modname = battle->GetHostModName();
+    entry.mapname = battle->GetHostMapName();
+    entry.players = battle->GetNumActivePlayers();
+    entry.maxplayers = battle->GetMaxPlayers();
+    entry.spectators = battle->GetSpectators();
+    entry.rankneeded = battle->GetRankNeeded();
+    entry.locked = battle->IsLocked();
+    entry.passworded = battle->IsPassworded();
+
+    const PlayerKey key( entry.players, id );
+    const bool free_slots = entry.players < entry.maxplayers;
+    m_all.insert( key );
+    ( entry.locked ? m_locked : m_unlocked ).insert( key );
+    if ( free_slots )
+        m_free_slots.insert( key );
+    if ( !entry.locked && !entry.passworded ) {
+        m_open.insert( key );
+        if ( free_slots )
+            m_open_free_slots.insert( key );
+    }
+    m_by_mod[entry.modname].insert( key );
+    m_by_map[entry.mapname].insert( key );
+    m_by_spectators.insert( RangeKey( entry.spectators, id ) );
+    m_by_rankneeded.insert( RangeKey( entry.rankneeded, id ) );
+}
+
+void BattleList::Unindex( int id )
+{
+    std::map< int, IndexEntry >::iterator it = m_index_entries.find( id );
+    if ( it == m_index_entries.end() )
+        return;
+    const IndexEntry& entry = it->second;
+    const PlayerKey key( entry.players, id );
+    m_all.erase( key );
+    m_locked.erase( key );
+    m_unlocked.erase( key );
+    m_free_slots.erase( key );
+    m_open.erase( key );
+    m_open_free_slots.erase( key );
+
+    std::map< std::string, PlayerOrdered >::iterator mod = m_by_mod.find( entry.modname );
+    mod->second.erase( key );
+    if ( mod->second.empty() )
+        m_by_mod.erase( mod );
+    std::map< std::string, PlayerOrdered >::iterator map = m_by_map.find( entry.mapname );
+    map->second.erase( key );
+    if ( map->second.empty() )
+        m_by_map.erase( map );
+    m_by_spectators.erase( RangeKey( entry.spectators, id ) );
+    m_by_rankneeded.erase( RangeKey( entry.rankneeded, id ) );
+
+    m_index_entries.erase( it );
+}
+
+bool BattleList::Matches( const IndexEntry& entry, const BattleQuery& query ) const
+{
+    if ( !query.modname.empty() && entry.modname != query.modname ) return false;
+    if ( !query.mapname.empty() && entry.mapname != query.mapname ) return false;
+    if ( query.locked != BattleQuery::ANY && entry.locked != ( query.locked == BattleQuery::YES ) ) return false;
+    if ( query.passworded != BattleQuery::ANY && entry.passworded != ( query.passworded == BattleQuery::YES ) ) return false;
+    if ( query.free_slots && entry.players >= entry.maxplayers ) return false;
+    if ( entry.players < query.min_players ) return false;
+    if ( query.max_rankneeded >= 0 && entry.rankneeded > query.max_rankneeded ) return false;
+    if ( query.max_spectators >= 0 && int(entry.spectators) > query.max_spectators ) return false;
+    return true;
+}
+
+bool BattleList::NarrowToRange( const RangeOrdered& index, int max, size_t& best, RangeOrdered::const_iterator& range_end )
 {
-    assert( false );
-    return "";
+    // counting stops as soon as the range is no better than what we have
+    size_t count = 0;
+    RangeOrdered::const_iterator it = index.begin();
+    for ( ; it != index.end() && it->first <= max; ++it )
+        if ( ++count >= best )
+            return false;
+    best = count;
+    range_end = it;
+    return true;
+}
+
+void BattleList::Narrow( const PlayerOrdered& index, const PlayerOrdered*& candidates )
+{
+    if ( index.size() < candidates->size() )
+        candidates = &index;
+}
+
+BattleList::BattleVector BattleList::Query( const BattleQuery& query ) const
+{
+    static const PlayerOrdered empty;
+    const PlayerOrdered* candidates = &m_all;
+    if ( query.locked == BattleQuery::YES )
+        Narrow( m_locked, candidates );
+    if ( query.locked == BattleQuery::NO )
+        Narrow( m_unlocked, candidates );
+    if ( query.free_slots )
+        Narrow( m_free_slots, candidates );
+    if ( query.locked == BattleQuery::NO && query.passworded == BattleQuery::NO ) {
+        Narrow( m_open, candidates );
+        if ( query.free_slots )
+            Narrow( m_open_free_slots, candidates );
+    }
+    if ( !query.modname.empty() ) {
+        std::map< std::string, PlayerOrdered >::const_iterator it = m_by_mod.find( query.modname );
+        Narrow( it == m_by_mod.end() ? empty : it->second, candidates );
+    }
+    if ( !query.mapname.empty() ) {
+        std::map< std::string, PlayerOrdered >::const_iterator it = m_by_map.find( query.mapname );
+        Narrow( it == m_by_map.end() ? empty : it->second, candidates );
+    }
+
+    const RangeOrdered* range = NULL;
+    RangeOrdered::const_iterator range_end;
+    size_t best = candidates->size();
+    if ( query.max_spectators >= 0 && NarrowToRange( m_by_spectators, query.max_spectators, best, range_end ) )
+        range = &m_by_spectators;
+    if ( query.max_rankneeded >= 0 && NarrowToRange( m_by_rankneeded, query.max_rankneeded, best, range_end ) )
+        range = &m_by_rankneeded;
+    PlayerOrdered in_range;
+    if ( range ) {
+        for ( RangeOrdered::const_iterator it = range->begin(); it != range_end; ++it )
+            in_range.insert( PlayerKey( m_index_entries.find( it->second )->second.players, it->second ) );
+        candidates = &in_range;
+    }
+
+    BattleVector ret;
+    const size_t limit = query.limit ? query.limit : candidates->size();
+    if ( query.order == BattleQuery::SORT_PLAYERS_DESC ) {
+        for ( PlayerOrdered::const_reverse_iterator it = candidates->rbegin(); it != candidates->rend() && ret.size() < limit; ++it ) {
+            if ( it->first < query.min_players )
+                break;
+            if ( Matches( m_index_entries.find( it->second )->second, query ) )
+                ret.push_back( find( it->second )->second );
+        }
+    } else {
+        // ascending player count can skip everything below min_players right away
+        PlayerOrdered::const_iterator it = candidates->lower_bound( PlayerKey( query.min_players, std::numeric_limits<int>::min() ) );
+        for ( ; it != candidates->end() && ret.size() < limit; ++it ) {
+            if ( Matches( m_index_entries.find( it->second )->second, query ) )
+                ret.push_back( find( it->second )->second );
+        }
+    }
+    return ret;
 }
 
 } } //namespace LSL { namespace Battle {
@@ -5,14 +5,117 @@
 #include <lsl/battle/battle.h>
 #include <lslutils/type_forwards.h>
 
+#include <map>
+#include <set>
+
 namespace LSL {
 namespace Battle {
 
+//! filter and ordering for BattleList::Query, default constructed it matches everything
+struct BattleQuery
+{
+    BattleQuery();
+
+    enum Tristate { ANY, YES, NO };
+    enum SortOrder { SORT_NONE, SORT_PLAYERS_ASC, SORT_PLAYERS_DESC };
+
+    //! empty matches any
+    std::string modname;
+    //! empty matches any
+    std::string mapname;
+    Tristate locked;
+    Tristate passworded;
+    //! only battles with numplayers < maxplayers
+    bool free_slots;
+    unsigned int min_players;
+    //! only battles whose rank requirement is <= this, -1 for any
+    int max_rankneeded;
+    //! only battles with at most this many spectators, -1 for any
+    int max_spectators;
+    SortOrder order;
+    //! stop after this many results, 0 for unlimited
+    size_t limit;
+};
+
 //! container for battle pointer
 class BattleList : public ContainerBase< Battle >
 {
 public:
+    typedef std::vector< BattlePtr >
+        BattleVector;
+
+    /** the key of the chat channel of \param battle. The lobby server names it __battle__<id> in
+     * JOINED, LEFT and SAID, and like every channel it is looked up with a leading # */
     std::string GetChannelName( const ConstIBattlePtr battle );
+
+    //! adding and removing keeps the query indexes in sync
+    void Add( PointerType item );
+    PointerType Add( ItemType* item );
+    void Remove( const KeyType& key );
+
+    //! must be called whenever an indexed attribute of \param battle changed
+    void UpdateIndex( const ConstIBattlePtr battle );
+
+    /** \brief battles matching \param query
+     * candidates are taken from the smallest index applicable to the query,
+     * so the cost is roughly proportional to the result instead of to the
+     * number of battles. There are indexes for mod, map, locked, free slots,
+     * open (neither locked nor passworded) and open with free slots, the
+     * spectator count and the rank needed; passworded on its own and
+     * min_players are only filters. The spectator and rank indexes hand out a
+     * range that is put in player count order first, the others are in that
+     * order already
+     **/
+    BattleVector Query( const BattleQuery& query ) const;
+
+private:
+    //! (active players, battle id)
+    typedef std::pair< unsigned int, int >
+        PlayerKey;
+    typedef std::set< PlayerKey >
+        PlayerOrdered;
+    //! (spectators or rank needed, battle id)
+    typedef std::pair< int, int >
+        RangeKey;
+    typedef std::set< RangeKey >
+        RangeOrdered;
+
+    //! the indexed attributes as of the last UpdateIndex
+    struct IndexEntry
+    {
+        std::string modname;
+        std::string mapname;
+        unsigned int players;
+        unsigned int maxplayers;
+        unsigned int spectators;
+        int rankneeded;
+        bool locked;
+        bool passworded;
+    };
+
+    void Unindex( int id );
+    //! points \param candidates at \param index if it is smaller
+    static void Narrow( const PlayerOrdered& index, const PlayerOrdered*& candidates );
+    bool Matches( const IndexEntry& entry, const BattleQuery& query ) const;
+    /** points \param range_end past the battles of \param index with a value <= \param max
+     * and lowers \param best to their count, if there are fewer than \param best of them
+     * \return whether it did */
+    static bool NarrowToRange( const RangeOrdered& index, int max, size_t& best, RangeOrdered::const_iterator& range_end );
+
+    std::map< int, IndexEntry > m_index_entries;
+    PlayerOrdered m_all;
+    PlayerOrdered m_locked;
+    PlayerOrdered m_unlocked;
+    //! fewer active players than maxplayers
+    PlayerOrdered m_free_slots;
+    //! neither locked nor passworded
+    PlayerOrdered m_open;
+    //! in both m_open and m_free_slots
+    PlayerOrdered m_open_free_slots;
+    std::map< std::string, PlayerOrdered > m_by_mod;
+    std::map< std::string, PlayerOrdered > m_by_map;
+    RangeOrdered m_by_spectators;
+    RangeOrdered m_by_rankneeded;
 };
 
 } //namespace Battle
@@ -1 +1,79 @@
 #include "channellist.h"
+
+#include <lsl/user/common.h>
+
+#include <algorithm>
+
+namespace LSL {
+
+void ChannelList::Remove( const KeyType& key )
+{
+    if ( !Exists( key ) )
+        return;
+    const ChannelPtr channel = Get( key );
+    channel->Members().ForEach( [&]( size_t idx ) {
+        if ( idx < m_by_user.size() ) {
+            KeyVector& keys = m_by_user[idx];
+            keys.erase( std::remove( keys.begin(), keys.end(), key ), keys.end() );
+        }
+    } );
+    ContainerBase< Channel >::Remove( key );
+}
+
+void ChannelList::Join( const ChannelPtr channel, const ConstCommonUserPtr user )
+{
+    if ( !channel || !user || user->DenseIndex() == CommonUser::INVALID_INDEX )
+        return;
+    const bool added = !channel->IsMember( user );
+    channel->OnChannelJoin( user );
+    if ( !added || !Exists( channel->key() ) )
+        return;
+    const size_t idx = user->DenseIndex();
+    if ( idx >= m_by_user.size() )
+        m_by_user.resize( idx + 1 );
+    m_by_user[idx].push_back( channel->key() );
+}
+
+void ChannelList::Part( const ChannelPtr channel, const ConstCommonUserPtr user )
+{
+    if ( !channel || !user || user->DenseIndex() == CommonUser::INVALID_INDEX )
+        return;
+    channel->OnChannelPart( user );
+    const size_t idx = user->DenseIndex();
+    if ( idx >= m_by_user.size() )
+        return;
+    KeyVector& keys = m_by_user[idx];
+    keys.erase( std::remove( keys.begin(), keys.end(), channel->key() ), keys.end() );
+}
+
+void ChannelList::PartAll( const ConstCommonUserPtr user )
+{
+    if ( !user || user->DenseIndex() >= m_by_user.size() )
+        return;
+    KeyVector& keys = m_by_user[user->DenseIndex()];
+    for ( const KeyType& key: keys ) {
+        if ( Exists( key ) )
+            Get( key )->OnChannelPart( user );
+    }
+    keys.clear();
+}
+
+ChannelList::ChannelVector ChannelList::CommonChannels( const ConstCommonUserPtr a, const ConstCommonUserPtr b ) const
+{
+    ChannelVector ret;
+    if ( !a || !b || a->DenseIndex() >= m_by_user.size() || b->DenseIndex() >= m_by_user.size() )
+        return ret;
+    // walk the channels of whoever is in fewer, the other one's membership is a bit test
+    const bool a_fewer = m_by_user[a->DenseIndex()].size() <= m_by_user[b->DenseIndex()].size();
+    const KeyVector& keys = m_by_user[( a_fewer ? a : b )->DenseIndex()];
+    const ConstCommonUserPtr other = a_fewer ? b : a;
+    for ( const KeyType& key: keys ) {
+        // the list hands out mutable channels, so go past the const Find
+        const MapType::const_iterator it = find( key );
+        if ( it != end() && it->second->IsMember( other ) )
+            ret.push_back( it->second );
+    }
+    return ret;
+}
+
+} // namespace LSL
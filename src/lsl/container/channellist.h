@@ -6,9 +6,33 @@
 
 namespace LSL {
 
-//! container for channel pointers
+/** \brief container for channel pointers
+ * additionally remembers which channels each user (by dense index) joined
+ * through it, so a leaving user is parted in O(its channels)
+ **/
 class ChannelList : public ContainerBase< Channel >
-{};
+{
+public:
+    typedef std::vector< ChannelPtr >
+        ChannelVector;
+
+    void Remove( const KeyType& key );
+
+    //! use instead of Channel::OnChannelJoin/OnChannelPart for channels in this list
+    void Join( const ChannelPtr channel, const ConstCommonUserPtr user );
+    void Part( const ChannelPtr channel, const ConstCommonUserPtr user );
+    //! parts \param user from every channel, call before its dense index is recycled
+    void PartAll( const ConstCommonUserPtr user );
+
+    //! all channels both users joined through Join, O(channels of the one in fewer)
+    ChannelVector CommonChannels( const ConstCommonUserPtr a, const ConstCommonUserPtr b ) const;
+
+private:
+    typedef std::vector< KeyType >
+        KeyVector;
+    //! channel keys per dense user index
+    std::vector< KeyVector > m_by_user;
+};
 
 } //end namespace LSL
 
@@ -0,0 +1,131 @@
+#ifndef LIBSPRINGLOBBY_HEADERGUARD_MEMBERSET_H
+#define LIBSPRINGLOBBY_HEADERGUARD_MEMBERSET_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <lslutils/bits.h>
+
+namespace LSL {
+
+/** \brief bitmap of dense user indices (see UserList)
+ * insert, erase and lookup are O(1), iterating and intersecting cost one
+ * step per 64 possible members
+ **/
+class MemberSet
+{
+public:
+	MemberSet() : m_count( 0 ) {}
+
+	//! returns false if \param idx was already a member
+	bool Insert( size_t idx )
+	{
+		const size_t word = idx / BITS;
+		if ( word >= m_words.size() )
+			m_words.resize( word + 1, 0 );
+		const boost::uint64_t bit = boost::uint64_t(1) << ( idx % BITS );
+		if ( m_words[word] & bit )
+			return false;
+		m_words[word] |= bit;
+		++m_count;
+		return true;
+	}
+
+	//! returns false if \param idx wasn't a member
+	bool Erase( size_t idx )
+	{
+		const size_t word = idx / BITS;
+		if ( word >= m_words.size() )
+			return false;
+		const boost::uint64_t bit = boost::uint64_t(1) << ( idx % BITS );
+		if ( !( m_words[word] & bit ) )
+			return false;
+		m_words[word] &= ~bit;
+		--m_count;
+		return true;
+	}
+
+	bool Contains( size_t idx ) const
+	{
+		const size_t word = idx / BITS;
+		return word < m_words.size() && ( m_words[word] >> ( idx % BITS ) ) & 1;
+	}
+
+	size_t size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+	//! keeps the storage around for refilling
+	void clear() { m_words.assign( m_words.size(), 0 ); m_count = 0; }
+
+	//! calls \param func with every member index in ascending order
+	template < class Func >
+	void ForEach( Func func ) const
+	{
+		for ( size_t w = 0; w < m_words.size(); ++w )
+			ForEachBit( m_words[w], w, func );
+	}
+
+	//! calls \param func with every index that is a member of both sets
+	template < class Func >
+	void ForEachCommon( const MemberSet& other, Func func ) const
+	{
+		const size_t n = std::min( m_words.size(), other.m_words.size() );
+		for ( size_t w = 0; w < n; ++w )
+			ForEachBit( m_words[w] & other.m_words[w], w, func );
+	}
+
+	size_t IntersectionSize( const MemberSet& other ) const
+	{
+		size_t count = 0;
+		const size_t n = std::min( m_words.size(), other.m_words.size() );
+		for ( size_t w = 0; w < n; ++w )
+			count += Util::PopCount( m_words[w] & other.m_words[w] );
+		return count;
+	}
+
+private:
+	static const size_t BITS = 64;
+
+	template < class Func >
+	static void ForEachBit( boost::uint64_t bits, size_t word, Func& func )
+	{
+		while ( bits ) {
+			func( word * BITS + Util::CountTrailingZeros( bits ) );
+			bits &= bits - 1;
+		}
+	}
+
+	std::vector< boost::uint64_t > m_words;
+	size_t m_count;
+};
+
+} // namespace LSL
+
+/**
+ * \file memberset.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LIBSPRINGLOBBY_HEADERGUARD_MEMBERSET_H
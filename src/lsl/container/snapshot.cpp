@@ -0,0 +1,147 @@
+#include "snapshot.h"
+
+#include <lsl/user/common.h>
+#include <lsl/battle/ibattle.h>
+#include <lsl/channel.h>
+
+namespace LSL {
+
+namespace {
+
+boost::shared_ptr< const UserSnapshot > MakeSnapshot( const CommonUser& user )
+{
+	boost::shared_ptr< UserSnapshot > s( new UserSnapshot );
+	s->id = user.Id();
+	s->nick = user.Nick();
+	s->country = user.GetCountry();
+	s->cpu = user.GetCpu();
+	s->status = user.Status();
+	const IBattlePtr battle = user.GetBattle();
+	s->battle_id = battle ? battle->GetBattleId() : -1;
+	return s;
+}
+
+boost::shared_ptr< const BattleSnapshot > MakeSnapshot( const Battle::IBattle& battle )
+{
+	const Battle::BattleOptions& opts = battle.GetBattleOptions();
+	boost::shared_ptr< BattleSnapshot > s( new BattleSnapshot );
+	s->id = opts.battleid;
+	s->founder = opts.founder;
+	s->description = opts.description;
+	s->mapname = opts.mapname;
+	s->maphash = opts.maphash;
+	s->modname = opts.modname;
+	s->modhash = opts.modhash;
+	s->maxplayers = opts.maxplayers;
+	s->spectators = opts.spectators;
+	s->numusers = battle.GetNumUsers();
+	s->rankneeded = opts.rankneeded;
+	s->locked = opts.islocked;
+	s->passworded = opts.ispassworded;
+	s->ingame = battle.InGame();
+	return s;
+}
+
+boost::shared_ptr< const ChannelSnapshot > MakeSnapshot( const Channel& channel )
+{
+	boost::shared_ptr< ChannelSnapshot > s( new ChannelSnapshot );
+	s->name = channel.key();
+	return s;
+}
+
+} // namespace
+
+//! copies the table and the touched shards (pointers only) and applies \param dirty on top
+template < class Table, class DirtyMap >
+boost::shared_ptr< const Table > LobbySnapshotWriter::Apply( const boost::shared_ptr< const Table >& table, DirtyMap& dirty )
+{
+	if ( dirty.empty() )
+		return table;
+	boost::shared_ptr< Table > next( new Table( *table ) );
+	boost::shared_ptr< typename Table::Shard > copies[Table::NUM_SHARDS];
+	for ( typename DirtyMap::const_iterator it = dirty.begin(); it != dirty.end(); ++it ) {
+		const size_t idx = Table::ShardIndex( it->first );
+		boost::shared_ptr< typename Table::Shard >& shard = copies[idx];
+		if ( !shard ) {
+			shard.reset( new typename Table::Shard( *next->m_shards[idx] ) );
+			next->m_size -= shard->size();
+		}
+		if ( it->second )
+			(*shard)[it->first] = MakeSnapshot( *it->second );
+		else
+			shard->erase( it->first );
+	}
+	for ( size_t idx = 0; idx < Table::NUM_SHARDS; ++idx ) {
+		if ( !copies[idx] )
+			continue;
+		next->m_size += copies[idx]->size();
+		next->m_shards[idx] = copies[idx];
+	}
+	dirty.clear();
+	return next;
+}
+
+LobbySnapshotWriter::LobbySnapshotWriter()
+	: m_users( new LobbySnapshot::UserTable )
+	, m_battles( new LobbySnapshot::BattleTable )
+	, m_channels( new LobbySnapshot::ChannelTable )
+	, m_generation( 0 )
+{
+	// readers always get a valid, if empty, snapshot
+	Publish();
+}
+
+void LobbySnapshotWriter::UserChanged( const ConstCommonUserPtr user )
+{
+	if ( user )
+		m_dirty_users[user->Id()] = user;
+}
+
+void LobbySnapshotWriter::UserRemoved( const std::string& id )
+{
+	m_dirty_users[id] = ConstCommonUserPtr();
+}
+
+void LobbySnapshotWriter::BattleChanged( const ConstIBattlePtr battle )
+{
+	if ( battle )
+		m_dirty_battles[battle->GetBattleId()] = battle;
+}
+
+void LobbySnapshotWriter::BattleRemoved( int id )
+{
+	m_dirty_battles[id] = ConstIBattlePtr();
+}
+
+void LobbySnapshotWriter::ChannelChanged( const ConstChannelPtr channel )
+{
+	if ( channel )
+		m_dirty_channels[channel->key()] = channel;
+}
+
+void LobbySnapshotWriter::ChannelRemoved( const std::string& name )
+{
+	m_dirty_channels[name] = ConstChannelPtr();
+}
+
+bool LobbySnapshotWriter::Publish()
+{
+	const bool changed = !m_dirty_users.empty() || !m_dirty_battles.empty() || !m_dirty_channels.empty();
+	if ( !changed && m_generation > 0 ) {
+		m_publisher.Reclaim();
+		return false;
+	}
+	m_users = Apply( m_users, m_dirty_users );
+	m_battles = Apply( m_battles, m_dirty_battles );
+	m_channels = Apply( m_channels, m_dirty_channels );
+
+	LobbySnapshot* snapshot = new LobbySnapshot;
+	snapshot->generation = ++m_generation;
+	snapshot->users = m_users;
+	snapshot->battles = m_battles;
+	snapshot->channels = m_channels;
+	m_publisher.Publish( snapshot );
+	return true;
+}
+
+} // namespace LSL
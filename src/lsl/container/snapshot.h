@@ -0,0 +1,190 @@
+#ifndef LIBSPRINGLOBBY_HEADERGUARD_SNAPSHOT_H
+#define LIBSPRINGLOBBY_HEADERGUARD_SNAPSHOT_H
+
+#include <lsl/user/userdata.h>
+#include <lslutils/rcu.h>
+#include <lslutils/type_forwards.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
+#include <map>
+#include <string>
+
+namespace LSL {
+
+//! immutable copy of the lobby relevant parts of a CommonUser
+struct UserSnapshot
+{
+	std::string id;
+	std::string nick;
+	std::string country;
+	int cpu;
+	UserStatus status;
+	//! -1 if not in a battle
+	int battle_id;
+};
+
+//! immutable copy of the lobby relevant parts of an IBattle
+struct BattleSnapshot
+{
+	int id;
+	std::string founder;
+	std::string description;
+	std::string mapname;
+	std::string maphash;
+	std::string modname;
+	std::string modhash;
+	unsigned int maxplayers;
+	unsigned int spectators;
+	unsigned int numusers;
+	int rankneeded;
+	bool locked;
+	bool passworded;
+	bool ingame;
+};
+
+struct ChannelSnapshot
+{
+	std::string name;
+};
+
+/** \brief immutable, sharded map used for the LobbySnapshot tables
+ * publishing copies only the shards that were touched since the last
+ * snapshot, all others are shared with the previous one
+ **/
+template < class Key, class Item >
+class SnapshotTable
+{
+public:
+	typedef boost::shared_ptr< const Item >
+		ItemPtr;
+	typedef std::map< Key, ItemPtr >
+		Shard;
+	static const size_t NUM_SHARDS = 64;
+
+	SnapshotTable() : m_size( 0 )
+	{
+		const boost::shared_ptr< const Shard > empty( new Shard );
+		for ( size_t i = 0; i < NUM_SHARDS; ++i )
+			m_shards[i] = empty;
+	}
+
+	//! NULL if there's no item with \param key
+	ItemPtr Find( const Key& key ) const
+	{
+		const Shard& shard = *m_shards[ShardIndex( key )];
+		typename Shard::const_iterator it = shard.find( key );
+		return it == shard.end() ? ItemPtr() : it->second;
+	}
+
+	size_t size() const { return m_size; }
+
+	//! calls \param func with every item, in no particular order
+	template < class Func >
+	void ForEach( Func func ) const
+	{
+		for ( size_t i = 0; i < NUM_SHARDS; ++i )
+			for ( typename Shard::const_iterator it = m_shards[i]->begin(); it != m_shards[i]->end(); ++it )
+				func( *it->second );
+	}
+
+	static size_t ShardIndex( const Key& key ) { return boost::hash< Key >()( key ) % NUM_SHARDS; }
+
+private:
+	friend class LobbySnapshotWriter;
+	boost::shared_ptr< const Shard > m_shards[NUM_SHARDS];
+	size_t m_size;
+};
+
+/** \brief consistent, immutable view of users, battles and channels
+ * unchanged tables and shards are shared between consecutive snapshots,
+ * so copying any of the pointers out of it is fine from any thread
+ **/
+struct LobbySnapshot
+{
+	typedef SnapshotTable< std::string, UserSnapshot >
+		UserTable;
+	typedef SnapshotTable< int, BattleSnapshot >
+		BattleTable;
+	typedef SnapshotTable< std::string, ChannelSnapshot >
+		ChannelTable;
+
+	//! increases by one with every published snapshot
+	unsigned long generation;
+	boost::shared_ptr< const UserTable > users;
+	boost::shared_ptr< const BattleTable > battles;
+	boost::shared_ptr< const ChannelTable > channels;
+};
+
+/** \brief collects changes from the protocol handlers and publishes them as LobbySnapshot
+ *
+ * everything but GetPublisher() and the Reader/ReadGuard obtained through it
+ * must only be used from the network thread.
+ **/
+class LobbySnapshotWriter
+{
+public:
+	typedef Util::RcuPublisher< LobbySnapshot >
+		Publisher;
+
+	LobbySnapshotWriter();
+
+	void UserChanged( const ConstCommonUserPtr user );
+	void UserRemoved( const std::string& id );
+	void BattleChanged( const ConstIBattlePtr battle );
+	void BattleRemoved( int id );
+	void ChannelChanged( const ConstChannelPtr channel );
+	void ChannelRemoved( const std::string& name );
+
+	//! publish pending changes, returns false if there were none
+	bool Publish();
+
+	Publisher& GetPublisher() { return m_publisher; }
+
+private:
+	template < class Table, class DirtyMap >
+	static boost::shared_ptr< const Table > Apply( const boost::shared_ptr< const Table >& table, DirtyMap& dirty );
+
+	//! a NULL pointer marks a removed item
+	std::map< std::string, ConstCommonUserPtr > m_dirty_users;
+	std::map< int, ConstIBattlePtr > m_dirty_battles;
+	std::map< std::string, ConstChannelPtr > m_dirty_channels;
+
+	boost::shared_ptr< const LobbySnapshot::UserTable > m_users;
+	boost::shared_ptr< const LobbySnapshot::BattleTable > m_battles;
+	boost::shared_ptr< const LobbySnapshot::ChannelTable > m_channels;
+	unsigned long m_generation;
+
+	Publisher m_publisher;
+};
+
+} // namespace LSL
+
+/**
+ * \file snapshot.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+	  conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+	  of conditions and the following disclaimer in the documentation and/or other materials
+	  provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LIBSPRINGLOBBY_HEADERGUARD_SNAPSHOT_H
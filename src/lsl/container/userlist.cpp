@@ -5,34 +5,124 @@ namespace LSL {
 
 const ConstUserPtr UserList::FindByNick( const std::string& nick ) const
 {
-    MapType::const_iterator it = find( nick );
-    if ( it != end() )
+    NickMap::const_iterator it = m_by_nick.find( nick );
+    if ( it != m_by_nick.end() )
         return it->second;
     return ConstUserPtr();
 }
 
 const UserPtr UserList::FindByNick(const std::string &nick)
 {
-    MapType::const_iterator it = find( nick );
-    if ( it != end() )
+    NickMap::const_iterator it = m_by_nick.find( nick );
+    if ( it != m_by_nick.end() )
         return it->second;
     return UserPtr();
 }
 
+void UserList::Add( PointerType item )
+{
+    if ( Exists( item->key() ) )
+        Remove( item->key() );
+    ContainerBase< User >::Add( item );
+    m_by_nick[item->Nick()] = item;
+    size_t idx;
+    if ( m_free_indices.empty() ) {
+        idx = m_by_index.size();
+        m_by_index.push_back( item );
+    } else {
+        idx = m_free_indices.back();
+        m_free_indices.pop_back();
+        m_by_index[idx] = item;
+    }
+    item->SetDenseIndex( idx );
+}
+
+UserList::PointerType UserList::Add( ItemType* item )
+{
+    PointerType p( item );
+    Add( p );
+    return p;
+}
+
+void UserList::Remove( const KeyType& key )
+{
+    if ( !Exists( key ) )
+        return;
+    const PointerType user = Get( key );
+    NickMap::iterator nick = m_by_nick.find( user->Nick() );
+    if ( nick != m_by_nick.end() && nick->second == user )
+        m_by_nick.erase( nick );
+    const size_t idx = user->DenseIndex();
+    if ( idx < m_by_index.size() && m_by_index[idx] == user ) {
+        m_by_index[idx].reset();
+        m_free_indices.push_back( idx );
+    }
+    user->SetDenseIndex( CommonUser::INVALID_INDEX );
+    ContainerBase< User >::Remove( key );
+}
+
+void UserList::Rename( const PointerType user, const std::string& nick )
+{
+    if ( user->Nick() == nick )
+        return;
+    NickMap::iterator old = m_by_nick.find( user->Nick() );
+    if ( old != m_by_nick.end() && old->second == user )
+        m_by_nick.erase( old );
+    user->SetNick( nick );
+    if ( Exists( user->key() ) )
+        m_by_nick[nick] = user;
+}
+
 const ConstCommonUserPtr CommonUserList::FindByNick( const std::string& nick ) const
 {
-    MapType::const_iterator it = find( nick );
-    if ( it != end() )
+    NickMap::const_iterator it = m_by_nick.find( nick );
+    if ( it != m_by_nick.end() )
         return it->second;
     return ConstCommonUserPtr();
 }
 
 const CommonUserPtr CommonUserList::FindByNick(const std::string &nick)
 {
-    MapType::const_iterator it = find( nick );
-    if ( it != end() )
+    NickMap::const_iterator it = m_by_nick.find( nick );
+    if ( it != m_by_nick.end() )
         return it->second;
     return CommonUserPtr();
 }
 
+void CommonUserList::Add( PointerType item )
+{
+    if ( Exists( item->key() ) )
+        Remove( item->key() );
+    ContainerBase< CommonUser >::Add( item );
+    m_by_nick[item->Nick()] = item;
+}
+
+CommonUserList::PointerType CommonUserList::Add( ItemType* item )
+{
+    PointerType p( item );
+    Add( p );
+    return p;
+}
+
+void CommonUserList::Remove( const KeyType& key )
+{
+    if ( !Exists( key ) )
+        return;
+    const PointerType user = Get( key );
+    NickMap::iterator nick = m_by_nick.find( user->Nick() );
+    if ( nick != m_by_nick.end() && nick->second == user )
+        m_by_nick.erase( nick );
+    ContainerBase< CommonUser >::Remove( key );
+}
+
+void CommonUserList::Renamed( const PointerType user, const std::string& old_nick )
+{
+    if ( !Exists( user->key() ) )
+        return;
+    NickMap::iterator old = m_by_nick.find( old_nick );
+    if ( old != m_by_nick.end() && old->second == user )
+        m_by_nick.erase( old );
+    m_by_nick[user->Nick()] = user;
+}
+
 }
@@ -4,21 +4,59 @@
 #include "base.h"
 #include <lsl/user/user.h>
 
+#include <boost/unordered_map.hpp>
+
 namespace LSL {
 
-//! container for user pointers
+/** \brief container for user pointers
+ * additionally hands out dense indices (CommonUser::DenseIndex) to its
+ * users and keeps a nick index for FindByNick
+ **/
 class UserList : public ContainerBase< User >
 {
 public:
     const ConstUserPtr FindByNick( const std::string& nick ) const;
     const UserPtr FindByNick( const std::string& nick );
+
+    void Add( PointerType item );
+    PointerType Add( ItemType* item );
+    void Remove( const KeyType& key );
+    //! use instead of User::SetNick for users in this list
+    void Rename( const PointerType user, const std::string& nick );
+
+    //! NULL if \param idx isn't in use
+    UserPtr GetByIndex( size_t idx ) const { return idx < m_by_index.size() ? m_by_index[idx] : UserPtr(); }
+    //! upper bound of all indices currently handed out
+    size_t IndexCapacity() const { return m_by_index.size(); }
+
+private:
+    typedef boost::unordered_map< std::string, UserPtr >
+        NickMap;
+    NickMap m_by_nick;
+    std::vector< UserPtr > m_by_index;
+    std::vector< size_t > m_free_indices;
 };
 
+/** \brief container for battle participants, keyed by id like UserList
+ * keeps a nick index for FindByNick, users renamed while in the list have to
+ * be passed to Renamed
+ **/
 class CommonUserList : public ContainerBase< CommonUser >
 {
 public:
     const ConstCommonUserPtr FindByNick( const std::string& nick ) const;
     const CommonUserPtr FindByNick( const std::string& nick );
+
+    void Add( PointerType item );
+    PointerType Add( ItemType* item );
+    void Remove( const KeyType& key );
+    //! moves \param user, whose nick already changed, from \param old_nick to its new one
+    void Renamed( const PointerType user, const std::string& old_nick );
+
+private:
+    typedef boost::unordered_map< std::string, CommonUserPtr >
+        NickMap;
+    NickMap m_by_nick;
 };
 
 } // namespace LSL
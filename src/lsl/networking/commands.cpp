@@ -37,7 +37,7 @@ CommandDictionary::CommandDictionary( ServerImpl* tas )
 	NEWCMD("MOTD",OnMotd,All);
 	NEWCMD("CLIENTSTATUS",OnUserStatusChanged,Word,Int);
 	//meh on 14 args >_>
-//    NEWCMD("BATTLEOPENED",OnBattleOpened,Int,Int,Int,Word,Word,Int,Int,Int,Int,Word,Sentence,Sentence,Sentence,Sentence);
+	NEWCMD("BATTLEOPENED",OnBattleOpenedCommand,All);
 	NEWCMD("JOINEDBATTLE",OnUserJoinedBattle,Int,Word,Word);
 	NEWCMD("UPDATEBATTLEINFO",OnBattleInfoUpdated,Int,Int,Int,Word,Sentence);
 	NEWCMD("LOGININFOEND",OnLoginInfoComplete,NoToken);
@@ -102,7 +102,8 @@ void CommandDictionary::Process(const std::string& cmd, std::string& params ) co
 	const MapType::const_iterator it = cmd_map_.find( cmd );
 	if ( it != cmd_map_.end() )
 		it->second->process( params );
-	LslError( "no way to process command \"%s\" with parameters %s", cmd.c_str(), params.c_str() );
+	else
+		LslError( "no way to process command \"%s\" with parameters %s", cmd.c_str(), params.c_str() );
 }
 
 } //namespace LSL {
@@ -83,7 +83,7 @@ struct Word : public Basic<std::string>{
 };
 struct Sentence : public Basic<std::string> {
 	Sentence( std::string& params )
-		:Basic<std::string>( GetWordParam( params ) ){}
+		:Basic<std::string>( GetSentenceParam( params ) ){}
 } ;
 struct Int : public Basic<int>{
 	Int( std::string& params )
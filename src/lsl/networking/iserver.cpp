@@ -63,6 +63,7 @@ bool Server::IsConnected()
 
 void Server::TimerUpdate()
 {
+    m_impl->m_snapshot.Publish();
 	if ( !IsConnected() )
 		return;
     if ( m_impl->m_sock->InTimeout( m_impl->m_ping_timeout ) )
@@ -523,7 +524,7 @@ void Server::OnUserQuit(const CommonUserPtr user)
 
 void Server::OnBattleOpened(const IBattlePtr battle )
 {
-    if ( battle && battle->GetFounder() ==
+    if ( battle && m_impl->m_relay_host_bot && battle->GetFounder() ==
          m_impl->m_relay_host_bot )
 	{
         battle->SetProxy( m_impl->m_relay_host_bot->Nick() );
@@ -552,7 +553,7 @@ void Server::OnBattleMaxPlayersChanged( const IBattlePtr battle, int maxplayers
 void Server::OnBattleHostChanged( const IBattlePtr battle, UserPtr host, const std::string& ip, int port )
 {
 	if (!battle) return;
-    if (!host) battle->SetFounder( host->Nick() );
+    if (host) battle->SetFounder( host->Nick() );
 	battle->SetHostIp( ip );
 	battle->SetHostPort( port );
 }
@@ -647,7 +648,7 @@ void Server::OnUserJoinedChannel( const ChannelPtr channel, const UserPtr user )
 {
 	if (!channel) return;
 	if (!user) return;
-	channel->OnChannelJoin( user );
+	m_impl->m_channels.Join( channel, user );
 	//TODO: event
 }
 
@@ -711,10 +712,13 @@ void Server::OnChannelSaid( const ChannelPtr channel, const CommonUserPtr user,
 //			}
 //		}
     //	}
+    sig_ChannelSaid( channel, user, message );
 }
 
 void Server::OnChannelPart(ChannelPtr channel, UserPtr user, const std::string &message)
 {
+	if (!channel) return;
+	m_impl->m_channels.Part( channel, user );
 }
 
 void Server::OnBattleStartRectAdd( const IBattlePtr battle, int allyno, int left, int top, int right, int bottom )
@@ -773,7 +777,10 @@ void Server::OnUserIP( const CommonUserPtr user, const std::string& ip )
 
 void Server::OnChannelJoinUserList( const ChannelPtr channel, const UserVector& users)
 {
-
+	if (!channel) return;
+	for( const UserPtr& user: users )
+		m_impl->m_channels.Join( channel, user );
+	//TODO: event
 }
 
 void Server::OnSelfHostedBattle(IBattlePtr battle )
@@ -795,7 +802,8 @@ void Server::OnRequestBattleStatus(IBattlePtr battle)
 
 void Server::OnUserScriptPassword(const CommonUserPtr user, const std::string &pw)
 {
-    assert( false );
+	if (!user) return;
+	user->BattleStatus().scriptPassword = pw;
 }
 
 void Server::OnBattleHostchanged(IBattlePtr battle, int udpport)
@@ -826,6 +834,11 @@ void Server::SendHostInfo(Enum::HostInfo update)
     m_impl->SendHostInfo(update);
 }
 
+void Server::SendHostInfo(const IBattlePtr battle, Enum::HostInfo update)
+{
+    m_impl->SendHostInfo(battle, update);
+}
+
 void Server::SendHostInfo(const std::string &key)
 {
     m_impl->SendHostInfo(key);
@@ -833,17 +846,38 @@ void Server::SendHostInfo(const std::string &key)
 
 void Server::RemoveUser(const CommonUserPtr user)
 {
+    // membership is keyed by the dense index, which is recycled on removal
+    m_impl->m_channels.PartAll( user );
     m_impl->m_users.Remove( user->key() );
+    m_impl->m_snapshot.UserRemoved( user->Id() );
 }
 
 void Server::RemoveChannel(const ChannelPtr chan)
 {
     m_impl->m_channels.Remove( chan->key() );
+    m_impl->m_snapshot.ChannelRemoved( chan->key() );
 }
 
 void Server::RemoveBattle(const IBattlePtr battle)
 {
     m_impl->m_battles.Remove( battle->key() );
+    m_impl->m_snapshot.BattleRemoved( battle->GetBattleId() );
+}
+
+LobbySnapshotWriter::Publisher& Server::GetSnapshotPublisher()
+{
+    return m_impl->m_snapshot.GetPublisher();
+}
+
+void Server::ExecuteCommand( const std::string& cmd, const std::string& params )
+{
+    std::string inparams = params;
+    m_impl->ExecuteCommand( cmd, inparams );
+}
+
+void Server::SetCommandSink( const boost::function<void (const std::string&)>& sink )
+{
+    m_impl->m_command_sink = sink;
 }
 
 void Server::SendMyBattleStatus( const UserBattleStatus& bs )
@@ -876,7 +910,7 @@ void Server::ForceSide( const IBattlePtr battle, const CommonUserPtr user, int s
     if (!battle) return;
     if (!user) return;
     UserBattleStatus status = user->BattleStatus();
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
     if ( user == m_impl->m_me )
     {
         status.side = side;
@@ -908,10 +942,10 @@ void Server::ForceTeam( const IBattlePtr battle, const CommonUserPtr user, int t
         SendMyBattleStatus( status );
         return;
     }
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
 
     //FORCETEAMNO username teamno
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(), "FORCETEAMNO", user->Nick() + " " + Util::ToString(team) );
+    SendOrRelayCmd( battle->IsProxy(), "FORCETEAMNO", user->Nick() + " " + Util::ToString(team) );
 }
 
 void Server::ForceAlly( const IBattlePtr battle, const CommonUserPtr user, int ally )
@@ -933,10 +967,10 @@ void Server::ForceAlly( const IBattlePtr battle, const CommonUserPtr user, int a
         SendMyBattleStatus( status );
         return;
     }
-    if (!m_impl->m_current_battle->IsFounderMe())
+    if (!battle->IsFounderMe())
         return;
     //FORCEALLYNO username teamno
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(), "FORCEALLYNO", user->Nick() + " " + Util::ToString(ally) );
+    SendOrRelayCmd( battle->IsProxy(), "FORCEALLYNO", user->Nick() + " " + Util::ToString(ally) );
 }
 
 void Server::ForceColor(const IBattlePtr battle, const CommonUserPtr user, const lslColor& rgb)
@@ -957,7 +991,7 @@ void Server::ForceColor(const IBattlePtr battle, const CommonUserPtr user, const
         SendMyBattleStatus( status );
         return;
     }
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
 
     UTASColor tascl;
     tascl.color.red = rgb.Red();
@@ -965,7 +999,7 @@ void Server::ForceColor(const IBattlePtr battle, const CommonUserPtr user, const
     tascl.color.blue = rgb.Blue();
     tascl.color.zero = 0;
     //FORCETEAMCOLOR username color
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(), "FORCETEAMCOLOR", user->Nick() + " " + Util::ToString( tascl.data ) );
+    SendOrRelayCmd( battle->IsProxy(), "FORCETEAMCOLOR", user->Nick() + " " + Util::ToString( tascl.data ) );
 }
 
 void Server::ForceSpectator( const IBattlePtr battle, const CommonUserPtr user, bool spectator )
@@ -986,10 +1020,10 @@ void Server::ForceSpectator( const IBattlePtr battle, const CommonUserPtr user,
         SendMyBattleStatus( status );
         return;
     }
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
 
     //FORCESPECTATORMODE username
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(), "FORCESPECTATORMODE", user->Nick() );
+    SendOrRelayCmd( battle->IsProxy(), "FORCESPECTATORMODE", user->Nick() );
 }
 
 void Server::BattleKickPlayer( const IBattlePtr battle, const CommonUserPtr user )
@@ -1008,16 +1042,16 @@ void Server::BattleKickPlayer( const IBattlePtr battle, const CommonUserPtr user
         LeaveBattle( battle );
         return;
     }
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
 
-    if( !m_impl->m_current_battle->IsProxy() )
+    if( !battle->IsProxy() )
     {
         // reset his password to something random, so he can't rejoin
         user->BattleStatus().scriptPassword = (boost::format("%04x%04x") % (rand()&0xFFFF) % (rand()&0xFFFF) ).str();
         SetRelayIngamePassword( user );
     }
     //KICKFROMBATTLE username
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(),"KICKFROMBATTLE", user->Nick() );
+    SendOrRelayCmd( battle->IsProxy(),"KICKFROMBATTLE", user->Nick() );
 }
 
 void Server::SetHandicap( const IBattlePtr battle, const CommonUserPtr user, int handicap)
@@ -1033,10 +1067,10 @@ void Server::SetHandicap( const IBattlePtr battle, const CommonUserPtr user, int
         return;
     }
 
-    if (!m_impl->m_current_battle->IsFounderMe()) return;
+    if (!battle->IsFounderMe()) return;
 
     //HANDICAP username value
-    SendOrRelayCmd( m_impl->m_current_battle->IsProxy(),"HANDICAP", user->Nick() + " " + Util::ToString(handicap) );
+    SendOrRelayCmd( battle->IsProxy(),"HANDICAP", user->Nick() + " " + Util::ToString(handicap) );
 }
 
 void Server::SendUserPosition( const CommonUserPtr user )
@@ -1066,10 +1100,12 @@ void Server::SendScriptToClients( const std::string& script )
 
 void Server::OnClientBattleStatus(IBattlePtr battle, UserPtr user, UserBattleStatus bstatus)
 {
+	battle->OnUserBattleStatusUpdated( user, bstatus );
 }
 
 void Server::OnBattleEnableUnits(IBattlePtr battle, const StringVector unitlist)
 {
+	OnBattleEnableUnit( battle, unitlist );
 }
 
 void Server::OnUserStartPositionUpdated(IBattlePtr battle, CommonUserPtr player, const UserPosition &pos)
@@ -1079,6 +1115,7 @@ void Server::OnUserStartPositionUpdated(IBattlePtr battle, CommonUserPtr player,
 //**************Get/Setters ******************
 IBattlePtr Server::GetCurrentBattle() { return m_impl->m_current_battle; }
 const ConstIBattlePtr Server::GetCurrentBattle() const { return m_impl->m_current_battle; }
+Battle::BattleList::BattleVector Server::QueryBattles( const Battle::BattleQuery& query ) const { return m_impl->m_battles.Query( query ); }
 
 void Server::SetKeepaliveInterval( int seconds ) { m_impl->m_keepalive = seconds; }
 int Server::GetKeepaliveInterval() { return m_impl->m_keepalive; }
@@ -1093,6 +1130,8 @@ void Server::SetPrivateUdpPort(int port) { m_impl->m_udp_private_port = port;}
 
 void Server::OnUserLeftChannel(ChannelPtr channel, UserPtr user)
 {
+	if (!channel) return;
+	m_impl->m_channels.Part( channel, user );
 }
 
 void Server::OnChannelAction(ChannelPtr channel, UserPtr user, const std::string &action)
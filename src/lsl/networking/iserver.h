@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <boost/function.hpp>
 #include <boost/signals2/signal.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
@@ -13,6 +14,7 @@
 #include <lsl/container/battlelist.h>
 #include <lsl/container/channellist.h>
 #include <lsl/container/userlist.h>
+#include <lsl/container/snapshot.h>
 
 #include <lslutils/type_forwards.h>
 #include "enums.h"
@@ -74,6 +76,8 @@ class Server : public boost::enable_shared_from_this<Server>
     boost::signals2::signal<void (bool)> sig_Disconnected;
     //! the udp port
     boost::signals2::signal<void (int)> sig_MyInternalUdpSourcePort;
+    //! channel, battle channels included | who said it | the message
+    boost::signals2::signal<void (const ChannelPtr,const CommonUserPtr,std::string)> sig_ChannelSaid;
 
 	void Connect( const std::string& servername, const std::string& addr, const int port );
     void Disconnect(const std::string& reason);
@@ -83,7 +87,14 @@ class Server : public boost::enable_shared_from_this<Server>
     void Login(const std::string& user, const std::string& password);
 	bool IsOnline()  const ;
 
+	//! also publishes the lobby snapshot, so call it from the network thread
 	void TimerUpdate();
+	//! readers on other threads register with this and pin snapshots via ReadGuard
+	LobbySnapshotWriter::Publisher& GetSnapshotPublisher();
+	//! handle a protocol command as if the socket had received it, for replays and benchmarks
+	void ExecuteCommand( const std::string& cmd, const std::string& params );
+	//! commands go to \param sink instead of the socket, for replays and benchmarks; an empty one restores the socket
+	void SetCommandSink( const boost::function<void (const std::string&)>& sink );
 
     void PartChannel( ChannelPtr channel );
     void JoinChannel( const std::string& channel, const std::string& key );
@@ -94,6 +105,8 @@ class Server : public boost::enable_shared_from_this<Server>
 
     IBattlePtr GetCurrentBattle();
     const ConstIBattlePtr GetCurrentBattle() const;
+    //! the open battles matching \param query, from the indexes BattleList keeps
+    Battle::BattleList::BattleVector QueryBattles( const Battle::BattleQuery& query ) const;
 
     void SetKeepaliveInterval( int seconds );
     int GetKeepaliveInterval();
@@ -137,6 +150,7 @@ class Server : public boost::enable_shared_from_this<Server>
     void StartHostedBattle();
     void LeaveBattle( const IBattlePtr battle);
     void SendHostInfo(Enum::HostInfo update);
+    void SendHostInfo(const IBattlePtr battle, Enum::HostInfo update);
     void SendHostInfo(const std::string &key);
 
     void RemoveUser(const CommonUserPtr user );
@@ -1,12 +1,14 @@
 #include "tasserver.h"
 
 #include <boost/algorithm/string.hpp>
+#include <cstdlib>
 #include <lslunitsync/optionswrapper.h>
 
 #include <lslutils/base64.h>
 #include <lslutils/md5.h>
 #include <lslutils/conversion.h>
 #include <lslutils/debug.h>
+#include <lslutils/pool.h>
 #include <lsl/battle/battle.h>
 
 #include "socket.h"
@@ -35,6 +37,9 @@ ServerImpl::ServerImpl(Server *serv)
     , m_iface( serv )
 {
     m_sock->sig_dataReceived.connect( boost::bind( &ServerImpl::ExecuteCommand, this, _1, _2 ) );
+    m_script_tag_router.Add( "", boost::bind( &ServerImpl::OnScriptTag, this, _1, _2, _3 ) );
+    m_script_tag_router.Add( "game", boost::bind( &ServerImpl::OnGameScriptTag, this, _1, _2, _3 ) );
+    m_script_tag_router.Add( "game/restrict", boost::bind( &ServerImpl::OnRestrictScriptTag, this, _1, _2, _3 ) );
 }
 
 void ServerImpl::ExecuteCommand(const std::string& cmd, std::string& inparams, int replyid )
@@ -247,6 +252,11 @@ void ServerImpl::SendCmd( const std::string& cmd, const std::string& param )
         msg = msg + cmd + "\n";
     else
         msg = msg + cmd + " " + param + "\n";
+	if ( m_command_sink )
+	{
+		m_command_sink( msg );
+		return;
+	}
 	bool send_success = m_sock->SendData( msg );
     assert( send_success );
 //	sig_SentMessage(send_success, msg, GetLastID());
@@ -405,15 +415,20 @@ void ServerImpl::LeaveBattle( const int& /*unused*/ )
 
 void ServerImpl::SendHostInfo( Enum::HostInfo update )
 {
-	if (!m_current_battle) return;
-	if (!m_current_battle->IsFounderMe()) return;
+	SendHostInfo( m_current_battle, update );
+}
+
+void ServerImpl::SendHostInfo( const IBattlePtr battle, Enum::HostInfo update )
+{
+	if (!battle) return;
+	if (!battle->IsFounderMe()) return;
 
 	if ( ( update & ( Enum::HI_Map | Enum::HI_Locked | Enum::HI_Spectators ) ) > 0 )
 	{
 		// UPDATEBATTLEINFO SpectatorCount locked maphash {mapname}
-		std::string cmd = (boost::format( "%d %d ") % m_current_battle->GetSpectators() % m_current_battle->IsLocked() ).str();
-		cmd += Util::MakeHashSigned( m_current_battle->LoadMap().hash ) + " ";
-		cmd += m_current_battle->LoadMap().name;
+		std::string cmd = (boost::format( "%d %d ") % battle->GetSpectators() % battle->IsLocked() ).str();
+		cmd += Util::MakeHashSigned( battle->LoadMap().hash ) + " ";
+		cmd += battle->LoadMap().name;
 		RelayCmd( "UPDATEBATTLEINFO", cmd );
 	}
 	int relayhostmessagesize = 0;
@@ -424,7 +439,7 @@ void ServerImpl::SendHostInfo( Enum::HostInfo update )
 	if ( ( update & Enum::HI_Send_All_opts ) > 0 )
 	{
 		std::string cmd;
-		OptionsWrapper::stringTripleVec optlistMap = m_current_battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::MapOption );
+		OptionsWrapper::stringTripleVec optlistMap = battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::MapOption );
 		for (LSL::OptionsWrapper::stringTripleVec::const_iterator it = optlistMap.begin(); it != optlistMap.end(); ++it)
 		{
 			std::string newcmd = "game/mapoptions/" + it->first + "=" + it->second.second + "\t";
@@ -435,7 +450,7 @@ void ServerImpl::SendHostInfo( Enum::HostInfo update )
 			}
 			cmd += newcmd;
 		}
-		OptionsWrapper::stringTripleVec optlistMod = m_current_battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::ModOption );
+		OptionsWrapper::stringTripleVec optlistMod = battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::ModOption );
 		for (LSL::OptionsWrapper::stringTripleVec::const_iterator it = optlistMod.begin(); it != optlistMod.end(); ++it)
 		{
 			std::string newcmd = "game/modoptions/" + it->first + "=" + it->second.second + "\t";
@@ -446,7 +461,7 @@ void ServerImpl::SendHostInfo( Enum::HostInfo update )
 			}
 			cmd += newcmd;
 		}
-		OptionsWrapper::stringTripleVec optlistEng = m_current_battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::EngineOption );
+		OptionsWrapper::stringTripleVec optlistEng = battle->CustomBattleOptions()->getOptions( LSL::OptionsWrapper::EngineOption );
 		for (LSL::OptionsWrapper::stringTripleVec::const_iterator it = optlistEng.begin(); it != optlistEng.end(); ++it)
 		{
 			std::string newcmd = "game/" + it->first + "=" + it->second.second + "\t";
@@ -459,47 +474,74 @@ void ServerImpl::SendHostInfo( Enum::HostInfo update )
 		}
 		RelayCmd( "SETSCRIPTTAGS", cmd );
 	}
+	if ( ( update & Enum::HI_Options ) > 0 )
+	{
+		// only the options a preset changed in this battle, batched like the full list above
+		const std::vector< std::pair<int, std::string> > changed = battle->TakeChangedOptions();
+		std::string cmd;
+		for ( size_t i = 0; i < changed.size(); ++i )
+		{
+			const LSL::OptionsWrapper::GameOption category = (LSL::OptionsWrapper::GameOption)changed[i].first;
+			std::string prefix;
+			if ( category == LSL::OptionsWrapper::MapOption ) prefix = "game/mapoptions/";
+			else if ( category == LSL::OptionsWrapper::ModOption ) prefix = "game/modoptions/";
+			else if ( category == LSL::OptionsWrapper::EngineOption ) prefix = "game/";
+			else continue;
+			std::string newcmd = prefix + changed[i].second + "=" + battle->CustomBattleOptions()->getSingleValue( changed[i].second, category ) + "\t";
+			if ( int(relayhostmessagesize + cmd.length() + newcmd.length()) > m_message_size_limit )
+			{
+				RelayCmd( "SETSCRIPTTAGS", cmd );
+				cmd = "";
+			}
+			cmd += newcmd;
+		}
+		if ( !cmd.empty() )
+			RelayCmd( "SETSCRIPTTAGS", cmd );
+	}
 
 	if ( (update & Enum::HI_StartRects) > 0 )   // Startrects should be updated.
 	{
-		unsigned int numrects = m_current_battle->GetLastRectIdx();
+		unsigned int numrects = battle->GetLastRectIdx();
 		for ( unsigned int i = 0; i <= numrects; i++ )   // Loop through all, and remove updated or deleted.
 		{
-			Battle::BattleStartRect sr = m_current_battle->GetStartRect( i );
+			Battle::BattleStartRect sr = battle->GetStartRect( i );
 			if ( !sr.exist ) continue;
 			if ( sr.todelete )
 			{
 				RelayCmd( "REMOVESTARTRECT", Util::ToString(i) );
-				m_current_battle->StartRectRemoved( i );
+				battle->StartRectRemoved( i );
 			}
 			else if ( sr.toadd )
 			{
 				RelayCmd( "ADDSTARTRECT", boost::format( "%d %d %d %d %d") % sr.ally % sr.left % sr.top % sr.right % sr.bottom );
-				m_current_battle->StartRectAdded( i );
+				battle->StartRectAdded( i );
 			}
 			else if ( sr.toresize )
 			{
 				RelayCmd( "REMOVESTARTRECT", Util::ToString(i) );
 				RelayCmd( "ADDSTARTRECT", boost::format( "%d %d %d %d %d") % sr.ally % sr.left % sr.top % sr.right % sr.bottom );
-				m_current_battle->StartRectResized( i );
+				battle->StartRectResized( i );
 			}
 		}
 	}
 	if ( (update & Enum::HI_Restrictions) > 0 )
 	{
-		std::map<std::string, int> units = m_current_battle->RestrictedUnits();
-		RelayCmd( "ENABLEALLUNITS" );
-		if ( !units.empty() )
+		// only what changed since the last time
+		const Battle::UnitRestrictions::Changes changes = battle->TakeRestrictionChanges();
+		if ( changes.all_enabled )
+			RelayCmd( "ENABLEALLUNITS" );
+		if ( !changes.enabled.empty() )
+			RelayCmd( "ENABLEUNITS", boost::algorithm::join( changes.enabled, " " ) );
+		if ( !changes.disabled.empty() )
+			RelayCmd( "DISABLEUNITS", boost::algorithm::join( changes.disabled, " " ) );
+		if ( !changes.limits.empty() )
 		{
-			std::stringstream msg;
-			std::stringstream scriptmsg;
-			for ( std::map<std::string, int>::const_iterator itor = units.begin(); itor != units.end(); ++itor )
+			std::string scriptmsg;
+			for ( size_t i = 0; i < changes.limits.size(); ++i )
 			{
-				 msg << itor->first + " ";
-				 scriptmsg << "game/restrict/" + itor->first + "=" + Util::ToString(itor->second) + '\t'; // this is a serious protocol abuse, but on the other hand, the protocol fucking suck and it's unmaintained so it will do for now
+				 scriptmsg += "game/restrict/" + changes.limits[i].first + "=" + Util::ToString( changes.limits[i].second ) + '\t'; // this is a serious protocol abuse, but on the other hand, the protocol fucking suck and it's unmaintained so it will do for now
 			}
-			RelayCmd( "DISABLEUNITS", msg.str() );
-			RelayCmd( "SETSCRIPTTAGS", scriptmsg.str() );
+			RelayCmd( "SETSCRIPTTAGS", scriptmsg );
 		}
 	}
 }
@@ -540,10 +582,12 @@ ChannelPtr ServerImpl::GetCreatePrivateChannel( const UserPtr user )
 {
     if (!user) return ChannelPtr();
     std::string channame = "U" + Util::ToString(user->Id());
-    ChannelPtr channel = m_channels.Get( channame );
+    ChannelPtr channel = m_channels.Find( channame );
     if (!channel)
     {
-        channel = m_channels.Add( new Channel( channame ) );
+        channel = Util::MakePooled<Channel>( channame );
+        m_channels.Add( channel );
+        m_snapshot.ChannelChanged( channel );
         m_iface->OnUserJoinedChannel( channel, user );
         m_iface->OnUserJoinedChannel( channel, m_me );
     }
@@ -562,7 +606,7 @@ void ServerImpl::RequestInGameTime( const std::string& nick )
 
 BattlePtr ServerImpl::AddBattle(const int &id)
 {
-    BattlePtr b( new Battle::Battle(m_iface->shared_from_this(), id) );
+    BattlePtr b = Util::MakePooled<Battle::Battle>( m_iface->shared_from_this(), id );
     m_battles.Add(b);
     return b;
 }
@@ -591,25 +635,47 @@ void ServerImpl::OnAcceptAgreement()
 void ServerImpl::OnNewUser( const std::string& nick, const std::string& country, int cpu, int id )
 {
     std::string str_id;
-    if ( !id )
+    if ( id )
         str_id = Util::ToString(id);
     else
         str_id = User::GetNewUserId();
-    UserPtr user = m_users.Get( str_id );
-    if ( !user )  {
-        user = UserPtr( new User( m_iface->shared_from_this(), str_id, nick, country, cpu ) );
+    UserPtr user;
+    if ( m_users.Exists( str_id ) )
+        user = m_users.Get( str_id );
+    else {
+        user = Util::MakePooled<User>( m_iface->shared_from_this(), str_id, nick, country, cpu );
+        m_users.Add( user );
     }
 	user->SetCountry( country );
 	user->SetCpu( cpu );
-	user->SetNick( nick );
+    const std::string old_nick = user->Nick();
+    m_users.Rename( user, nick );
+    const IBattlePtr battle = user->GetBattle();
+    if ( battle && old_nick != nick ) {
+        battle->OnUserRenamed( user, old_nick );
+        m_snapshot.BattleChanged( battle );
+    }
+    m_snapshot.UserChanged( user );
     m_iface->OnNewUser( user );
 }
 
-std::string ServerImpl::GetBattleChannelName( const BattlePtr battle )
+void ServerImpl::OnBattleOpenedCommand( const std::string& params )
 {
-	if (!battle)
-		return "";
-    return "B" + Util::ToString(battle->Id());
+	std::string rest = params;
+	const int id = GetIntParam( rest );
+	const Enum::BattleType type = Enum::BattleType( GetIntParam( rest ) );
+	const Enum::NatType nat = Enum::NatType( GetIntParam( rest ) );
+	const std::string nick = GetWordParam( rest );
+	const std::string host = GetWordParam( rest );
+	const int port = GetIntParam( rest );
+	const int maxplayers = GetIntParam( rest );
+	const bool haspass = GetBoolParam( rest );
+	const int rank = GetIntParam( rest );
+	const std::string maphash = GetWordParam( rest );
+	const std::string map = GetSentenceParam( rest );
+	const std::string title = GetSentenceParam( rest );
+	const std::string mod = GetSentenceParam( rest );
+	OnBattleOpened( id, type, nat, nick, host, port, maxplayers, haspass, rank, maphash, map, title, mod );
 }
 
 void ServerImpl::OnBattleOpened( int id, Enum::BattleType type, Enum::NatType nat, const std::string& nick,
@@ -627,21 +693,26 @@ void ServerImpl::OnBattleOpened( int id, Enum::BattleType type, Enum::NatType na
 	battle->SetDescription( title );
 
     m_iface->OnBattleOpened( battle );
+    m_snapshot.BattleChanged( battle );
+    m_snapshot.UserChanged( user );
     m_iface->OnBattleHostChanged( battle, user, host, port );
     if (user) m_iface->OnUserIP( user, host );
     m_iface->OnBattleMaxPlayersChanged(battle, maxplayers );
     m_iface->OnBattleMapChanged( battle,UnitsyncMap(map, maphash) );
     m_iface->OnBattleModChanged( battle, UnitsyncMod(mod, "") );
+    m_battles.UpdateIndex( battle );
 
     const std::string battlechanname = m_battles.GetChannelName(battle);
-    ChannelPtr channel = m_channels.Get( battlechanname );
+    ChannelPtr channel = m_channels.Find( battlechanname );
 	if (!channel)
 	{
+        channel = Util::MakePooled<Channel>( battlechanname );
         m_channels.Add( channel );
-		battle->SetChannel( channel );
+        m_snapshot.ChannelChanged( channel );
 	}
+	battle->SetChannel( channel );
 
-	if ( user->Status().in_game )
+	if ( user && user->Status().in_game )
 	{
         m_iface->OnBattleStarted(battle);
 	}
@@ -655,6 +726,7 @@ void ServerImpl::OnUserStatusChanged( const std::string& nick, int intstatus )
 	tasstatus.byte = intstatus;
     const UserStatus status = ConvTasclientstatus( tasstatus.tasdata );
     m_iface->sig_UserStatusChanged( user, status );
+    m_snapshot.UserChanged( user );
     IBattlePtr battle = user->GetBattle();
 	if ( battle )
 	{
@@ -662,6 +734,8 @@ void ServerImpl::OnUserStatusChanged( const std::string& nick, int intstatus )
             if ( status.in_game != battle->InGame() )
 			{
 				battle->SetInGame( status.in_game );
+                m_battles.UpdateIndex( battle );
+                m_snapshot.BattleChanged( battle );
                 if ( status.in_game )
                     m_iface->OnBattleStarted( battle );
                 else
@@ -672,8 +746,9 @@ void ServerImpl::OnUserStatusChanged( const std::string& nick, int intstatus )
 
 void ServerImpl::OnHostedBattle( int battleid )
 {
-    const BattlePtr battle = m_battles.Get( battleid );
+    const BattlePtr battle = m_battles.Find( battleid );
 	if(!battle) return;
+    m_current_battle = battle;
     m_iface->OnSelfHostedBattle(battle);
     m_iface->OnSelfJoinedBattle(battle);
 }
@@ -687,7 +762,7 @@ void ServerImpl::OnUserQuit(const std::string &nick )
 
 void ServerImpl::OnSelfJoinedBattle( int battleid, const std::string& hash )
 {
-    BattlePtr battle = m_battles.Get( battleid );
+    BattlePtr battle = m_battles.Find( battleid );
 	if ( !battle ) return;
     m_current_battle = battle;
     battle->SetHostMod( battle->GetHostModName(), hash );
@@ -702,6 +777,8 @@ void ServerImpl::OnStartHostedBattle()
 {
     IBattlePtr battle = m_current_battle;
 	battle->SetInGame( true );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
     m_iface->OnBattleStarted( battle );
 }
 
@@ -721,16 +798,21 @@ void ServerImpl::OnClientBattleStatus( const std::string& nick, int intstatus, i
     if ( user->GetBattle() != battle ) return;
     user->BattleStatus().color_index = bstatus.color_index;
     m_iface->OnClientBattleStatus( battle, user, bstatus );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
 }
 
 void ServerImpl::OnUserJoinedBattle( int battleid, const std::string& nick, const std::string& userScriptPassword )
 {
-    BattlePtr battle = m_battles.Get( battleid );
+    BattlePtr battle = m_battles.Find( battleid );
 	if ( !battle ) return;
     UserPtr user = m_users.FindByNick( nick );
 	if ( !user ) return;
     battle->OnUserAdded( user );
     m_iface->OnUserJoinedBattle( battle, user );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
+    m_snapshot.UserChanged( user );
     if ( user == m_me ) m_current_battle = battle;
     m_iface->OnUserScriptPassword( user, userScriptPassword );
     const ChannelPtr channel = battle->GetChannel();
@@ -749,7 +831,7 @@ void ServerImpl::OnUserJoinedBattle( int battleid, const std::string& nick, cons
 void ServerImpl::OnUserLeftBattle( int battleid, const std::string& nick )
 {
     UserPtr user = m_users.FindByNick(nick);
-    BattlePtr battle = m_battles.Get( battleid );
+    BattlePtr battle = m_battles.Find( battleid );
 	if (!user) return;
 	if(battle)
 	{
@@ -758,83 +840,78 @@ void ServerImpl::OnUserLeftBattle( int battleid, const std::string& nick )
             m_iface->OnUserLeftChannel( channel, user );
 	}
     m_iface->OnUserLeftBattle(battle, user);
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
+    m_snapshot.UserChanged( user );
     if ( user == m_me ) m_current_battle = IBattlePtr();
 }
 
 void ServerImpl::OnBattleInfoUpdated( int battleid, int spectators, bool locked, const std::string& maphash, const std::string& mapname )
 {
-    BattlePtr battle = m_battles.Get( battleid );
+    BattlePtr battle = m_battles.Find( battleid );
 	if ( !battle ) return;
     if (battle->GetSpectators() != spectators )
         m_iface->OnBattleSpectatorCountUpdated( battle, spectators );
     if (battle->IsLocked() != locked )
-        m_iface->OnBattleSpectatorCountUpdated( battle, locked );
+        m_iface->OnBattleLockUpdated( battle, locked );
     if (battle->GetHostMapName() != mapname )
         m_iface->OnBattleMapChanged( battle, UnitsyncMap(mapname, maphash) );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
 }
 
-void ServerImpl::OnSetBattleOption( std::string key, const std::string& value )
+void ServerImpl::OnSetBattleInfo( std::string infos )
 {
     IBattlePtr battle = m_current_battle;
 	if (!battle) return;
-    battle->m_script_tags[key] = value;
-    if ( key.substr( 0,5 ) == "game/" )
-	{
-        key = Util::AfterFirst( key, "/" );
-        //TODO the original had modoptions here???
-        if ( key.substr( 0,8 ) == "restrict" )
-		{
-            m_iface->OnBattleDisableUnit( battle, Util::AfterFirst(key,"/"), Util::FromString<int>(value) );
-		}
-        else if ( ( key.substr( 0,4 ) ==  "team" ) && key.find( "startpos" ) != std::string::npos )
-		{
-            int team = Util::FromString<int>( Util::BeforeFirst(key,"/").substr( 4, std::string::npos ) );
-            if ( key.find( "startposx" ) != std::string::npos )
-			{
-			for ( const CommonUserPtr player: battle->Users() )
-				{
-                    UserBattleStatus& status = player->BattleStatus();
-					if ( status.team == team )
-					{
-                        status.pos.x = Util::FromString<int>( value );
-                        m_iface->OnUserStartPositionUpdated( battle, player, status.pos );
-					}
-				}
-			 }
-             else if ( key.find( "startposy" ) != std::string::npos )
-			 {
-			for( const CommonUserPtr player: battle->Users() )
-				{
-                    UserBattleStatus& status = player->BattleStatus();
-					if ( status.team == team )
-					{
-                        status.pos.y = Util::FromString<int>( value );
-                        m_iface->OnUserStartPositionUpdated( battle, player, status.pos );
-					}
-				}
-			}
-        }
-	}
-	else
-        m_iface->OnSetBattleOption(battle, key, value );
+    battle->m_script_tags.Ingest( infos, &m_script_tag_router );
 }
 
-void ServerImpl::OnSetBattleInfo( std::string infos )
+void ServerImpl::OnScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value )
 {
-    IBattlePtr battle = m_current_battle;
-	if (!battle) return;
-	for( const std::string command:
-                   Util::StringTokenize( infos, "\t", boost::algorithm::token_compress_on ) )
-	{
-        const std::string key = boost::algorithm::to_lower_copy( Util::BeforeFirst( command,"=" ) );
-        const std::string value = Util::AfterFirst( command,"=" );
-		OnSetBattleOption( key, value );
-	}
+    m_iface->OnSetBattleOption( m_current_battle, Battle::ScriptTags::Join( key, count ), value );
+}
+
+void ServerImpl::OnGameScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value )
+{
+    if ( count == 0 )
+    {
+        // a bare "game" is not part of the game section
+        m_iface->OnSetBattleOption( m_current_battle, "game", value );
+        return;
+    }
+    // only start positions are acted on, mod, map and engine options stay in the battle's script tags
+    if ( count < 2 )
+        return;
+    const std::string& team = Battle::ScriptTags::Name( key[0] );
+    const std::string& coord = Battle::ScriptTags::Name( key[1] );
+    if ( team.compare( 0, 4, "team" ) != 0 )
+        return;
+    const bool is_x = coord == "startposx";
+    if ( !is_x && coord != "startposy" )
+        return;
+    const int pos = std::atoi( value.c_str() );
+    // a copy, the callback may move players around. Spectators have no start position and
+    // keep theirs, even if their stale team number matches
+    const CommonUserVector members = m_current_battle->GetTeamMembers( std::atoi( team.c_str() + 4 ) );
+    for ( const CommonUserPtr& player: members )
+    {
+        UserBattleStatus& status = player->BattleStatus();
+        if ( is_x ) status.pos.x = pos;
+        else status.pos.y = pos;
+        m_iface->OnUserStartPositionUpdated( m_current_battle, player, status.pos );
+    }
+}
+
+void ServerImpl::OnRestrictScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value )
+{
+    if ( count > 0 )
+        m_iface->OnBattleDisableUnit( m_current_battle, Battle::ScriptTags::Join( key, count ), std::atoi( value.c_str() ) );
 }
 
 void ServerImpl::OnBattleClosed( int battleid )
 {
-    BattlePtr battle = m_battles.Get( battleid );
+    BattlePtr battle = m_battles.Find( battleid );
 	if (!battle) return;
     m_iface->OnBattleClosed(battle);
 }
@@ -872,21 +949,25 @@ void ServerImpl::OnBattleEnableAllUnits()
 
 void ServerImpl::OnJoinChannel(const std::string& channel , const std::string &rest)
 {
-    ChannelPtr chan = m_channels.Get( "#" + channel );
+    ChannelPtr chan = m_channels.Find( "#" + channel );
     if(!chan) return;
     m_iface->OnUserJoinedChannel( chan, m_me );
 }
 
 void ServerImpl::OnJoinChannelFailed( const std::string& name, const std::string& reason )
 {
-    ChannelPtr chan = m_channels.Get( "#" + name );
-    if(!chan) chan = m_channels.Add( new Channel("#" + name) );
+    ChannelPtr chan = m_channels.Find( "#" + name );
+    if(!chan) {
+        chan = Util::MakePooled<Channel>( "#" + name );
+        m_channels.Add( chan );
+        m_snapshot.ChannelChanged( chan );
+    }
     m_iface->OnJoinChannelFailed( chan, reason );
 }
 
 void ServerImpl::OnChannelJoin( const std::string& name, const std::string& who )
 {
-    ChannelPtr channel = m_channels.Get( "#" + name );
+    ChannelPtr channel = m_channels.Find( "#" + name );
     UserPtr user = m_users.FindByNick( who );
     if(!channel) return;
 	if(!user) return;
@@ -895,16 +976,26 @@ void ServerImpl::OnChannelJoin( const std::string& name, const std::string& who
 
 void ServerImpl::OnChannelJoinUserList( const std::string& channel_name, const std::string& usernames )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
 	if(!channel) return;
-    UserVector users;
-	for( const std::string nick: Util::StringTokenize(usernames," ") )
+    // big channels send many of these lines on join, so reuse the buffers
+    m_joinlist_users.clear();
+    size_t pos = 0;
+    while ( pos < usernames.size() )
     {
-        UserPtr user = m_users.FindByNick( nick );
-		if(!user) continue;
-		users.push_back(user);
-	}
-    m_iface->OnChannelJoinUserList(channel,users);
+        size_t end = usernames.find( ' ', pos );
+        if ( end == std::string::npos )
+            end = usernames.size();
+        if ( end > pos )
+        {
+            m_joinlist_nick.assign( usernames, pos, end - pos );
+            const UserPtr user = m_users.FindByNick( m_joinlist_nick );
+            if ( user )
+                m_joinlist_users.push_back( user );
+        }
+        pos = end + 1;
+    }
+    m_iface->OnChannelJoinUserList( channel, m_joinlist_users );
 }
 
 void ServerImpl::OnJoinedBattle(const int battleid, const std::string& msg)
@@ -924,7 +1015,7 @@ void ServerImpl::OnLogin(const std::string &msg)
 
 void ServerImpl::OnUserJoinedChannel( const std::string& channel_name, const std::string& who )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
     UserPtr user = m_users.FindByNick( who );
 	if(!channel) return;
 	if(!user) return;
@@ -933,7 +1024,7 @@ void ServerImpl::OnUserJoinedChannel( const std::string& channel_name, const std
 
 void ServerImpl::OnChannelSaid( const std::string& channel_name, const std::string& who, const std::string& message )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
     UserPtr user = m_users.FindByNick( who );
 	if(!channel) return;
 	if(!user) return;
@@ -942,7 +1033,7 @@ void ServerImpl::OnChannelSaid( const std::string& channel_name, const std::stri
 
 void ServerImpl::OnChannelPart( const std::string& channel_name, const std::string& who, const std::string& message )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
     UserPtr user = m_users.FindByNick( who );
 	if(!channel) return;
 	if(!user) return;
@@ -951,7 +1042,7 @@ void ServerImpl::OnChannelPart( const std::string& channel_name, const std::stri
 
 void ServerImpl::OnChannelTopic( const std::string& channel_name, const std::string& who, int /*unused*/, const std::string& message )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
 	if(!channel) return;
     UserPtr user = m_users.FindByNick( who );
     if(!user) return;
@@ -961,7 +1052,7 @@ void ServerImpl::OnChannelTopic( const std::string& channel_name, const std::str
 
 void ServerImpl::OnChannelAction( const std::string& channel_name, const std::string& who, const std::string& action )
 {
-    ChannelPtr channel = m_channels.Get( "#" + channel_name );
+    ChannelPtr channel = m_channels.Find( "#" + channel_name );
     UserPtr user = m_users.FindByNick( who );
 	if(!channel) return;
 	if(!user) return;
@@ -1081,7 +1172,7 @@ void ServerImpl::OnMutelistItem( const std::string& mutee, const std::string& me
 
 void ServerImpl::OnMutelistEnd()
 {
-    ChannelPtr chan = m_channels.Get("#" + m_mutelist_current_channelname);
+    ChannelPtr chan = m_channels.Find("#" + m_mutelist_current_channelname);
     m_mutelist_current_channelname = "";
 	if (!chan) return;
     m_iface->OnMuteList(chan, m_mutelist);
@@ -1089,7 +1180,7 @@ void ServerImpl::OnMutelistEnd()
 
 void ServerImpl::OnChannelMessage( const std::string& channel, const std::string& msg )
 {
-    ChannelPtr chan = m_channels.Get(channel);
+    ChannelPtr chan = m_channels.Find(channel);
 	if (!chan) return;
     m_iface->OnChannelMessage( chan, msg );
 }
@@ -1107,7 +1198,7 @@ void ServerImpl::OnKickedFromBattle()
 
 void ServerImpl::OnKickedFromChannel( const std::string& channel, const std::string& fromWho, const std::string& message)
 {
-    ChannelPtr chan = m_channels.Get(channel);
+    ChannelPtr chan = m_channels.Find(channel);
 	if(!chan) return;
     m_iface->OnKickedFromChannel(chan, fromWho, message);
     m_iface->OnUserLeftChannel(chan, m_me );
@@ -1142,10 +1233,12 @@ void ServerImpl::OnHostExternalUdpPort( const int udpport )
 
 void ServerImpl::OnChannelListEntry( const std::string& channel, const int& numusers, const std::string& topic )
 {
-    ChannelPtr chan = m_channels.Get( "#" + channel );
+    ChannelPtr chan = m_channels.Find( "#" + channel );
 	if (!chan)
 	{
-        chan = m_channels.Add( new Channel( "#" + channel ) );
+        chan = Util::MakePooled<Channel>( "#" + channel );
+        m_channels.Add( chan );
+        m_snapshot.ChannelChanged( chan );
 	}
 	chan->SetNumUsers(numusers);
 	chan->SetTopic(topic);
@@ -1163,7 +1256,7 @@ void ServerImpl::OnRequestBattleStatus()
 
 void ServerImpl::OnBattleAddBot( int battleid, const std::string& nick, const std::string& owner, int intstatus, int intcolor, const std::string& aidll)
 {
-    BattlePtr battle = m_battles.Get(battleid);
+    BattlePtr battle = m_battles.Find(battleid);
 	if (!battle) return;
 	UTASBattleStatus tasbstatus;
 	UserBattleStatus status;
@@ -1174,15 +1267,17 @@ void ServerImpl::OnBattleAddBot( int battleid, const std::string& nick, const st
     status.color = lslColor( color.color.red, color.color.green, color.color.blue );
 	status.aishortname = aidll;
     status.owner = owner;
-    UserPtr user( new User( m_iface->shared_from_this(), User::GetNewUserId(), nick ) );
+    UserPtr user = Util::MakePooled<User>( m_iface->shared_from_this(), User::GetNewUserId(), nick );
     battle->OnUserAdded( user );
     m_iface->OnUserJoinedBattle( battle, user );
     m_iface->OnUserBattleStatusUpdated( battle, user, status );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
 }
 
 void ServerImpl::OnBattleUpdateBot( int battleid, const std::string& nick, int intstatus, int intcolor )
 {
-    BattlePtr battle = m_battles.Get(battleid);
+    BattlePtr battle = m_battles.Find(battleid);
 	if (!battle) return;
 	UTASBattleStatus tasbstatus;
 	UserBattleStatus status;
@@ -1197,11 +1292,13 @@ void ServerImpl::OnBattleUpdateBot( int battleid, const std::string& nick, int i
 
 void ServerImpl::OnBattleRemoveBot( int battleid, const std::string& nick )
 {
-    BattlePtr battle = m_battles.Get(battleid);
+    BattlePtr battle = m_battles.Find(battleid);
 	if (!battle) return;
     CommonUserPtr user = battle->GetUser( nick );
 	if (!user ) return;
     m_iface->OnUserLeftBattle( battle, user );
+    m_battles.UpdateIndex( battle );
+    m_snapshot.BattleChanged( battle );
     if (user->BattleStatus().IsBot())
         m_iface->OnUserQuit( user );
 }
@@ -4,6 +4,8 @@
 #include "iserver.h"
 
 #include <lslutils/type_forwards.h>
+#include <lsl/container/snapshot.h>
+#include <lsl/battle/scripttags.h>
 #include <boost/format/format_fwd.hpp>
 
 namespace LSL {
@@ -65,8 +67,6 @@ private:
 	void SendMyUserStatus();
 	void RequestSpringUpdate(std::string &currentspringversion);
 
-	std::string GetBattleChannelName(const BattlePtr battle);
-
 private:
 	void ExecuteCommand( const std::string& cmd, std::string& inparams );
 	void ExecuteCommand( const std::string& cmd, std::string& inparams, int replyid );
@@ -128,6 +128,8 @@ private:
     void OnLoginFailed( const std::string& reason );
     void OnServerBroadcast( const std::string& message );
     void OnRedirect( const std::string& address, int port );
+	//! BATTLEOPENED carries more parameters than a Command can tokenize
+	void OnBattleOpenedCommand(const std::string &params);
 	void OnBattleOpened(int id, Enum::BattleType type, Enum::NatType nat, const std::string &nick, const std::string &host, int port, int maxplayers, bool haspass, int rank, const std::string &maphash, const std::string &map, const std::string &title, const std::string &mod);
 	void OnUserStatusChanged(const std::string &nick, int intstatus);
 	void OnHostedBattle(int battleid);
@@ -138,8 +140,11 @@ private:
 	void OnUserJoinedBattle(int battleid, const std::string &nick, const std::string &userScriptPassword);
 	void OnUserLeftBattle(int battleid, const std::string &nick);
     void OnBattleInfoUpdated(int battleid, int spectators, bool locked, const std::string &maphash, const std::string &mapname);
-    void OnSetBattleOption(std::string key, const std::string &value);
     void OnSetBattleInfo(std::string infos);
+    //! SETSCRIPTTAGS handlers for the subtrees m_script_tag_router knows, \param key is relative to it
+    void OnScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value );
+    void OnGameScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value );
+    void OnRestrictScriptTag( const Battle::ScriptTags::Segment* key, size_t count, const std::string& value );
 	void OnAcceptAgreement();
 	void OnBattleClosed(int battleid);
 	void OnBattleDisableUnits(const std::string &unitlist);
@@ -191,6 +196,7 @@ private:
     void RelayCmd( const std::string& command, const std::string& param = "" );
     void RelayCmd( const std::string& command, const boost::format& param );
     void SendHostInfo(Enum::HostInfo update);
+    void SendHostInfo(const IBattlePtr battle, Enum::HostInfo update);
     void SendHostInfo(int type, const std::string &key);
     void SendHostInfo(const std::string& tag );
 
@@ -198,6 +204,8 @@ private:
     std::map<std::string,std::string> m_channel_pw;  /// channel name -> password, filled on channel join
 
     Socket* m_sock;
+    //! takes the commands instead of m_sock when set
+    boost::function<void (const std::string&)> m_command_sink;
     int m_keepalive; //! in seconds
     int m_ping_timeout; //! in seconds
     int m_ping_interval; //! in seconds
@@ -244,6 +252,13 @@ private:
     Battle::BattleList m_battles;
     UserList m_users;
     ChannelList m_channels;
+    //! scratch buffers for OnChannelJoinUserList
+    std::string m_joinlist_nick;
+    UserVector m_joinlist_users;
+    //! "" -> OnScriptTag, "game" -> OnGameScriptTag, "game/restrict" -> OnRestrictScriptTag
+    Battle::ScriptTags::Router m_script_tag_router;
+    //! published once per TimerUpdate for other threads
+    LobbySnapshotWriter m_snapshot;
     Server* m_iface;
 };
 
@@ -328,7 +328,7 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
     {
         std::set<int> parsedteams;
         unsigned int NumTeams = 0;
-        for( const ConstCommonUserPtr usr: battle->Users() )
+        for( const CommonUserPtr& usr: battle->UsersView() )
         {
             const UserBattleStatus& status = usr->BattleStatus();
             if ( status.spectator )
@@ -412,8 +412,8 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
     std::map<const ConstCommonUserPtr, int> player_to_number; // player -> ordernumber
     srand ( time(NULL) );
     int i = 0;
-    const unsigned int NumUsers = battle->Users().size();
-    for( const ConstCommonUserPtr user: battle->Users() )
+    const unsigned int NumUsers = battle->GetNumUsers();
+    for( const CommonUserPtr& user: battle->UsersView() )
     {
         const UserBattleStatus& status = user->BattleStatus();
         if ( !status.spectator )
@@ -425,7 +425,7 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
                 free_team++;
             }
         }
-        if ( battle->IsProxy() && ( user->Nick() == battle->GetFounder()->Nick() ) ) continue;
+        if ( battle->IsProxy() && battle->GetFounder() && ( user->Nick() == battle->GetFounder()->Nick() ) ) continue;
         if ( status.IsBot() ) continue;
         tdf.EnterSection( "PLAYER" + Util::ToString( i ) );
         tdf.Append( "Name", user->Nick() );
@@ -456,7 +456,7 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
     if ( usync().VersionSupports( LSL::USYNC_GetSkirmishAI ) )
     {
         unsigned int i = 0;
-        for( const ConstCommonUserPtr user: battle->Users() )
+        for( const CommonUserPtr& user: battle->UsersView() )
         {
             const UserBattleStatus& status = user->BattleStatus();
             if ( !status.IsBot() ) continue;
@@ -488,7 +488,7 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
 
     std::set<int> parsedteams;
     StringVector sides = usync().GetSides( battle->GetHostModName() );
-    for( const ConstCommonUserPtr usr: battle->Users() )
+    for( const CommonUserPtr& usr: battle->UsersView() )
     {
         const UserBattleStatus& status = usr->BattleStatus();
         if ( status.spectator ) continue;
@@ -557,16 +557,20 @@ std::string Spring::WriteScriptTxt( const IBattlePtr battle ) const
 
     unsigned int maxiter = std::max( NumUsers, battle->GetLastRectIdx() + 1 );
     std::set<int> parsedallys;
+    CommonUserList::View::iterator user_it = battle->UsersView().begin();
     for ( unsigned int i = 0; i < maxiter; i++ )
     {
-        const ConstCommonUserPtr  usr = battle->Users()[i];
-        const UserBattleStatus& status = usr->BattleStatus();
+        // past the end of the userlist only the remaining start rects are of interest
+        const UserBattleStatus* status = 0;
+        if ( i < NumUsers )
+            status = &(*user_it++)->BattleStatus();
+        const bool spectator = !status || status->spectator;
         Battle::BattleStartRect sr = battle->GetStartRect( i );
-        if ( status.spectator && !sr.IsOk() )
+        if ( spectator && !sr.IsOk() )
             continue;
-        int ally = status.ally;
-        if ( status.spectator )
-            ally = i;
+        int ally = i;
+        if ( !spectator )
+            ally = status->ally;
         if ( parsedallys.find( ally ) != parsedallys.end() )
             continue; // skip duplicates
         sr = battle->GetStartRect( ally );
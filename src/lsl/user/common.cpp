@@ -36,7 +36,7 @@ void CommonUser::SetStatus( const UserStatus& status )
 }
 
 CommonUser::CommonUser(const std::string id, const std::string nick, const std::string country, const int cpu)
-    : m_id(id), m_nick(nick), m_country(country), m_cpu(cpu)
+    : m_id(id), m_nick(nick), m_country(country), m_cpu(cpu), m_dense_index(INVALID_INDEX)
 {}
 
 std::string CommonUser::GetNewUserId()
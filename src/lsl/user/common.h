@@ -4,6 +4,7 @@
 #include <lslutils/global_interfaces.h>
 #include <lslutils/type_forwards.h>
 #include <lslutils/misc.h>
+#include <lslutils/stringpool.h>
 #include <lsl/user/userdata.h>
 
 #include <boost/enable_shared_from_this.hpp>
@@ -41,6 +42,11 @@ public:
 
     const std::string& Id() const { return m_id; }
 
+    static const size_t INVALID_INDEX = size_t(-1);
+    //! small, recycled number assigned by UserList, used for compact membership sets
+    size_t DenseIndex() const { return m_dense_index; }
+    void SetDenseIndex( size_t idx ) { m_dense_index = idx; }
+
 	UserStatus& Status() { return m_status; }
     const UserStatus& Status() const { return m_status; }
 	virtual void SetStatus( const UserStatus& status );
@@ -52,7 +58,7 @@ public:
 	//void SetBattleStatus( const UserBattleStatus& status );/// dont use this to avoid overwriting data like ip and port, use following method.
 	void UpdateBattleStatus( const UserBattleStatus& status );
 
-	bool Equals( const CommonUser& other ) const { return ( m_nick == other.Nick() ); }
+	bool Equals( const CommonUser& other ) const { return ( m_nick == other.m_nick ); }
 
     const IBattlePtr GetBattle() const;
     void SetBattle( IBattlePtr battle );
@@ -61,13 +67,14 @@ public:
     virtual UserStatus::RankContainer GetRank() const { return UserStatus::RANK_1; }
 
 protected:
-	std::string m_nick;
-	std::string m_country;
+	Util::InternedString m_nick;
+	Util::InternedString m_country;
     const std::string m_id;
 	int m_cpu;
 	UserStatus m_status;
 	UserBattleStatus m_bstatus;
     IBattlePtr m_battle;
+    size_t m_dense_index;
 };
 
 } // namespace LSL
@@ -28,7 +28,7 @@ void User::SetStatus( const UserStatus& status )
 		try
 		{
             const ConstCommonUserPtr user = m_battle->GetFounder();
-			if ( user->Nick() == m_nick ) {
+			if ( user && user->Nick() == m_nick ) {
                 m_battle->Update("");
 			}
 		}catch(...){}
@@ -4,18 +4,19 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <boost/unordered_map.hpp>
+#include <lslutils/stringpool.h>
 
 namespace LSL {
 
 struct UnitsyncMod
 {
     UnitsyncMod()
-        : name(std::string()),hash(std::string())
     {}
     UnitsyncMod(const std::string& name, const std::string& hash)
         : name(name),hash(hash)
     {}
-	std::string name;
+	Util::InternedString name;
 	std::string hash;
 };
 
@@ -57,15 +58,13 @@ struct MapInfo
 
 struct UnitsyncMap
 {
-    UnitsyncMap():
-		name(std::string()),
-        hash(std::string())
+    UnitsyncMap()
     {}
     UnitsyncMap(const std::string& name, const std::string& hash):
 		name(name),
 		hash(hash)
     {}
-	std::string name;
+	Util::InternedString name;
 	std::string hash;
 	MapInfo info;
 };
@@ -85,7 +84,7 @@ enum MediaType
 };
 
 
-typedef std::map<std::string,std::string> LocalArchivesVector;
+typedef boost::unordered_map<Util::InternedString,std::string> LocalArchivesVector;
 
 } // namespace LSL
 
@@ -30,6 +30,7 @@
 namespace LSL {
 
 Unitsync::Unitsync():
+	m_catalog_generation( 0 ),
 	m_cache_thread( new WorkerThread ),
 	m_map_image_cache( 3, "m_map_image_cache" ),         // may take about 3M per image ( 1024x1024 24 bpp minimap )
 	m_tiny_minimap_cache( 200, "m_tiny_minimap_cache" ), // takes at most 30k per image (   100x100 24 bpp minimap )
@@ -52,6 +53,16 @@ Unitsync::~Unitsync()
 	m_cache_thread = NULL;
 }
 
+//! hash of the archive \param name in \param list, empty if it isn't there, never adds \param name to either
+static std::string ArchiveHash( const LocalArchivesVector& list, const std::string& name )
+{
+	Util::InternedString key;
+	if ( !Util::InternedString::Find( name, key ) ) return std::string();
+	LocalArchivesVector::const_iterator itor = list.find( key );
+	if ( itor == list.end() ) return std::string();
+	return itor->second;
+}
+
 bool CompareStringNoCase(const std::string& first, const std::string& second)
 {
 	static std::locale l("C");
@@ -152,6 +163,7 @@ void Unitsync::PopulateArchiveList()
 	m_unsorted_map_array = m_map_array;
 	std::sort( m_map_array.begin(), m_map_array.end() , &CompareStringNoCase );
 	std::sort( m_mod_array.begin(), m_mod_array.end() , &CompareStringNoCase  );
+	m_catalog_generation++;
 }
 
 
@@ -246,13 +258,16 @@ int Unitsync::GetModIndex( const std::string& name ) const
 
 bool Unitsync::ModExists( const std::string& modname ) const
 {
-	return (m_mods_list.find(modname) != m_mods_list.end());
+	Util::InternedString key;
+	return Util::InternedString::Find( modname, key ) && (m_mods_list.find(key) != m_mods_list.end());
 }
 
 
 bool Unitsync::ModExists( const std::string& modname, const std::string& hash ) const
 {
-	LocalArchivesVector::const_iterator itor = m_mods_list.find(modname);
+	Util::InternedString key;
+	if ( !Util::InternedString::Find( modname, key ) ) return false;
+	LocalArchivesVector::const_iterator itor = m_mods_list.find(key);
 	if ( itor == m_mods_list.end() ) return false;
 	return itor->second == hash;
 }
@@ -271,7 +286,7 @@ UnitsyncMod Unitsync::GetMod( const std::string& modname )
 {
 	UnitsyncMod m;
 	m.name = modname;
-	m.hash = m_mods_list[modname];
+	m.hash = ArchiveHash( m_mods_list, modname );
 	return m;
 }
 
@@ -280,7 +295,7 @@ UnitsyncMod Unitsync::GetMod( int index )
 {
 	UnitsyncMod m;
 	m.name = m_mod_array[index];
-	m.hash = m_mods_list[m.name];
+	m.hash = ArchiveHash( m_mods_list, m.name );
 	return m;
 }
 
@@ -307,12 +322,15 @@ StringVector Unitsync::GetModValidMapList( const std::string& modname ) const
 
 bool Unitsync::MapExists( const std::string& mapname ) const
 {
-	return (m_maps_list.find(mapname) != m_maps_list.end());
+	Util::InternedString key;
+	return Util::InternedString::Find( mapname, key ) && (m_maps_list.find(key) != m_maps_list.end());
 }
 
 bool Unitsync::MapExists( const std::string& mapname, const std::string& hash ) const
 {
-	LocalArchivesVector::const_iterator itor = m_maps_list.find(mapname);
+	Util::InternedString key;
+	if ( !Util::InternedString::Find( mapname, key ) ) return false;
+	LocalArchivesVector::const_iterator itor = m_maps_list.find(key);
 	if ( itor == m_maps_list.end() ) return false;
 	return itor->second == hash;
 }
@@ -321,7 +339,7 @@ UnitsyncMap Unitsync::GetMap( const std::string& mapname )
 {
 	UnitsyncMap m;
 	m.name = mapname;
-	m.hash = m_maps_list[mapname];
+	m.hash = ArchiveHash( m_maps_list, mapname );
 	return m;
 }
 
@@ -329,7 +347,7 @@ UnitsyncMap Unitsync::GetMap( int index )
 {
 	UnitsyncMap m;
 	m.name = m_map_array[index];
-	m.hash = m_maps_list[m.name];
+	m.hash = ArchiveHash( m_maps_list, m.name );
 	return m;
 }
 
@@ -339,7 +357,7 @@ UnitsyncMap Unitsync::GetMapEx( int index )
 	if ( index < 0 )
 		return m;
 	m.name = m_map_array[index];
-	m.hash = m_maps_list[m.name];
+	m.hash = ArchiveHash( m_maps_list, m.name );
 	m.info = _GetMapInfoEx( m.name );
 	return m;
 }
@@ -810,10 +828,10 @@ std::string Unitsync::GetFileCachePath( const std::string& name, const std::stri
 	else
 	{
 		if ( IsMod )
-			ret += "-" + m_mods_list[name];
+			ret += "-" + ArchiveHash( m_mods_list, name );
 		else
 		{
-			ret += "-" + m_maps_list[name];
+			ret += "-" + ArchiveHash( m_maps_list, name );
 		}
 	}
 	return ret;
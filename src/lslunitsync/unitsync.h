@@ -9,6 +9,7 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/signals2/signal.hpp>
+#include <atomic>
 #include <map>
 
 #ifdef HAVE_WX
@@ -124,6 +125,8 @@ public:
 	std::string GetTextfileAsString( const std::string& modname, const std::string& file_path );
 
 	bool ReloadUnitSyncLib(  );
+	//! bumped every time the map and game lists are read, so results derived from them can be kept until it changes
+	size_t GetCatalogGeneration() const { return m_catalog_generation; }
 
     void SetSpringDataPath( const std::string& path );
     bool GetSpringDataPath( std::string& path);
@@ -177,6 +180,9 @@ public:
     /// WorkerThread operation... cache is invalidated on reload.
     std::string m_cache_path;
 
+    //! written by whichever thread loads unitsync, read by battles on theirs
+    std::atomic<size_t> m_catalog_generation;
+
 	mutable boost::mutex m_lock;
 	WorkerThread* m_cache_thread;
 	StringSignalType m_async_ops_complete_sig;
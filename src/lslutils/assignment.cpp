@@ -0,0 +1,67 @@
+#include "assignment.h"
+
+#include <cassert>
+#include <limits>
+
+namespace LSL {
+namespace Util {
+
+std::vector<size_t> SolveAssignment( const std::vector<double>& cost, size_t rows, size_t cols )
+{
+	assert( rows <= cols );
+	assert( cost.size() == rows * cols );
+	const double inf = std::numeric_limits<double>::max();
+	// potentials and matching are 1-based, column 0 is the virtual start of each augmenting path
+	std::vector<double> u( rows + 1, 0 ), v( cols + 1, 0 );
+	std::vector<size_t> row_of( cols + 1, 0 ), way( cols + 1, 0 );
+	std::vector<double> minv( cols + 1 );
+	std::vector<bool> used( cols + 1 );
+	for ( size_t i = 1; i <= rows; ++i ) {
+		row_of[0] = i;
+		size_t col = 0;
+		minv.assign( cols + 1, inf );
+		used.assign( cols + 1, false );
+		do {
+			used[col] = true;
+			const size_t row = row_of[col];
+			double delta = inf;
+			size_t next = 0;
+			for ( size_t j = 1; j <= cols; ++j ) {
+				if ( used[j] ) continue;
+				const double reduced = cost[( row - 1 ) * cols + ( j - 1 )] - u[row] - v[j];
+				if ( reduced < minv[j] ) {
+					minv[j] = reduced;
+					way[j] = col;
+				}
+				if ( minv[j] < delta ) {
+					delta = minv[j];
+					next = j;
+				}
+			}
+			for ( size_t j = 0; j <= cols; ++j ) {
+				if ( used[j] ) {
+					u[row_of[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+					minv[j] -= delta;
+			}
+			col = next;
+		} while ( row_of[col] != 0 );
+		// flip the augmenting path
+		do {
+			const size_t prev = way[col];
+			row_of[col] = row_of[prev];
+			col = prev;
+		} while ( col != 0 );
+	}
+
+	std::vector<size_t> result( rows );
+	for ( size_t j = 1; j <= cols; ++j )
+		if ( row_of[j] != 0 )
+			result[row_of[j] - 1] = j - 1;
+	return result;
+}
+
+} // namespace Util
+} // namespace LSL
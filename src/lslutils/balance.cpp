@@ -0,0 +1,299 @@
+#include "balance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace LSL {
+namespace Util {
+
+namespace {
+
+const size_t NO_ITEM = std::numeric_limits<size_t>::max();
+//! sums closer than this count as equal
+const double EPSILON = 1e-6;
+
+std::vector<size_t> HeaviestFirst( const std::vector<float>& weights )
+{
+	std::vector<size_t> order( weights.size() );
+	for ( size_t i = 0; i < order.size(); ++i )
+		order[i] = i;
+	std::stable_sort( order.begin(), order.end(), [&weights]( size_t a, size_t b ) { return weights[a] > weights[b]; } );
+	return order;
+}
+
+std::vector<size_t> Greedy( const std::vector<float>& weights, size_t bins, bool sorted )
+{
+	std::vector<size_t> order( weights.size() );
+	if ( sorted )
+		order = HeaviestFirst( weights );
+	else
+		for ( size_t i = 0; i < order.size(); ++i )
+			order[i] = i;
+
+	// min-heap on (sum, bin), ties go to the lower bin index
+	typedef std::pair<double, size_t> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > lightest;
+	for ( size_t b = 0; b < bins; ++b )
+		lightest.push( Entry( 0, b ) );
+	std::vector<size_t> result( weights.size() );
+	for ( size_t i = 0; i < order.size(); ++i ) {
+		Entry bin = lightest.top();
+		lightest.pop();
+		result[order[i]] = bin.second;
+		bin.first += weights[order[i]];
+		lightest.push( bin );
+	}
+	return result;
+}
+
+/** a partial solution of the differencing method: one subset per bin, heaviest first.
+ * The members of a subset are a linked list through Differencing's next array */
+struct Partial
+{
+	struct Subset
+	{
+		double sum;
+		size_t head, tail;
+		bool operator > ( const Subset& other ) const { return sum > other.sum; }
+	};
+	std::vector<Subset> subsets;
+
+	double Spread() const { return subsets.front().sum - subsets.back().sum; }
+};
+
+std::vector<size_t> Differencing( const std::vector<float>& weights, size_t bins )
+{
+	std::vector<size_t> next( weights.size(), NO_ITEM );
+	std::vector<Partial> partials( weights.size() );
+	// max-heap on the spread of each partial solution
+	typedef std::pair<double, size_t> Entry;
+	std::priority_queue<Entry> widest;
+	for ( size_t i = 0; i < weights.size(); ++i ) {
+		Partial::Subset empty = { 0, NO_ITEM, NO_ITEM };
+		partials[i].subsets.assign( bins, empty );
+		Partial::Subset& first = partials[i].subsets.front();
+		first.sum = weights[i];
+		first.head = first.tail = i;
+		widest.push( Entry( partials[i].Spread(), i ) );
+	}
+
+	// join the two widest partials so that the heaviest subset of one gets the lightest of the other
+	while ( widest.size() > 1 ) {
+		Partial& x = partials[widest.top().second];
+		widest.pop();
+		const size_t y_index = widest.top().second;
+		Partial& y = partials[y_index];
+		widest.pop();
+		for ( size_t b = 0; b < bins; ++b ) {
+			Partial::Subset& into = y.subsets[bins - 1 - b];
+			const Partial::Subset& from = x.subsets[b];
+			into.sum += from.sum;
+			if ( from.head == NO_ITEM )
+				continue;
+			if ( into.head == NO_ITEM )
+				into.head = from.head;
+			else
+				next[into.tail] = from.head;
+			into.tail = from.tail;
+		}
+		std::sort( y.subsets.begin(), y.subsets.end(), std::greater<Partial::Subset>() );
+		std::vector<Partial::Subset>().swap( x.subsets );
+		widest.push( Entry( y.Spread(), y_index ) );
+	}
+
+	std::vector<size_t> result( weights.size(), 0 );
+	if ( widest.empty() )
+		return result;
+	const Partial& last = partials[widest.top().second];
+	for ( size_t b = 0; b < bins; ++b )
+		for ( size_t i = last.subsets[b].head; i != NO_ITEM; i = next[i] )
+			result[i] = b;
+	return result;
+}
+
+/** depth first search over all assignments of the heaviest-first items, pruned by a
+ * lower bound on the spread any completion can reach. Bins with equal sums are
+ * interchangeable, so only the first of them is tried */
+class ExactPartition
+{
+public:
+	ExactPartition( const std::vector<float>& weights, size_t bins, const std::vector<size_t>& initial )
+		: m_weights( weights ),
+		m_order( HeaviestFirst( weights ) ),
+		m_sums( bins, 0 ),
+		m_current( weights.size() ),
+		m_best( initial ),
+		m_best_spread( PartitionSpread( weights, bins, initial ) ),
+		m_nodes( 0 )
+	{
+		double total = 0;
+		for ( size_t i = 0; i < weights.size(); ++i )
+			total += weights[i];
+		m_average = total / bins;
+		m_remaining.assign( weights.size() + 1, 0 );
+		for ( size_t i = weights.size(); i > 0; --i )
+			m_remaining[i - 1] = m_remaining[i] + weights[m_order[i - 1]];
+		Search( 0 );
+	}
+
+	const std::vector<size_t>& Result() const { return m_best; }
+
+private:
+	void Search( size_t depth )
+	{
+		if ( ++m_nodes > MAX_EXACT_NODES || m_best_spread < EPSILON )
+			return;
+		const double heaviest = *std::max_element( m_sums.begin(), m_sums.end() );
+		const double lightest = *std::min_element( m_sums.begin(), m_sums.end() );
+		if ( depth == m_order.size() ) {
+			if ( heaviest - lightest < m_best_spread - EPSILON ) {
+				m_best_spread = heaviest - lightest;
+				m_best = m_current;
+			}
+			return;
+		}
+		const double bound = std::max( heaviest, m_average ) - std::min( lightest + m_remaining[depth], m_average );
+		if ( bound >= m_best_spread - EPSILON )
+			return;
+
+		const size_t item = m_order[depth];
+		for ( size_t b = 0; b < m_sums.size(); ++b ) {
+			bool tried = false;
+			for ( size_t prev = 0; prev < b && !tried; ++prev )
+				tried = std::fabs( m_sums[prev] - m_sums[b] ) < EPSILON;
+			if ( tried )
+				continue;
+			m_sums[b] += m_weights[item];
+			m_current[item] = b;
+			Search( depth + 1 );
+			m_sums[b] -= m_weights[item];
+		}
+	}
+
+	const std::vector<float>& m_weights;
+	std::vector<size_t> m_order;
+	//! summed weight of the items from a depth on
+	std::vector<double> m_remaining;
+	std::vector<double> m_sums;
+	std::vector<size_t> m_current;
+	std::vector<size_t> m_best;
+	double m_best_spread;
+	double m_average;
+	size_t m_nodes;
+};
+
+} // namespace
+
+std::vector<size_t> PartitionWeights( const std::vector<float>& weights, size_t bins, PartitionMethod method )
+{
+	if ( bins <= 1 )
+		return std::vector<size_t>( weights.size(), 0 );
+	switch ( method ) {
+		case PARTITION_IN_ORDER:
+			return Greedy( weights, bins, false );
+		case PARTITION_GREEDY:
+			return Greedy( weights, bins, true );
+		case PARTITION_DIFFERENCING:
+			return Differencing( weights, bins );
+		case PARTITION_EXACT:
+		default:
+			break;
+	}
+	std::vector<size_t> result = Differencing( weights, bins );
+	if ( weights.size() <= MAX_EXACT_ITEMS )
+		result = ExactPartition( weights, bins, result ).Result();
+	return result;
+}
+
+std::vector<int> PackControlTeams( const std::vector<int>& current, const std::vector<float>& weights,
+	const std::vector<size_t>& groups, size_t teams, PartitionMethod method )
+{
+	const size_t players = current.size();
+	std::vector<int> result( players, -1 );
+	teams = std::max<size_t>( teams, 1 );
+	if ( teams >= players ) {
+		// only duplicates and ids out of range move, a player alone on a valid id stays
+		std::vector<bool> used( teams, false );
+		for ( size_t i = 0; i < players; ++i ) {
+			if ( current[i] >= 0 && size_t( current[i] ) < teams && !used[current[i]] ) {
+				used[current[i]] = true;
+				result[i] = current[i];
+			}
+		}
+		size_t free = 0;
+		for ( size_t i = 0; i < players; ++i ) {
+			if ( result[i] >= 0 )
+				continue;
+			while ( used[free] )
+				++free;
+			used[free] = true;
+			result[i] = int( free );
+		}
+		return result;
+	}
+
+	size_t items = 0;
+	for ( size_t i = 0; i < players; ++i )
+		items = std::max( items, groups[i] + 1 );
+	std::vector<float> item_weights( items, 0 );
+	for ( size_t i = 0; i < players; ++i )
+		item_weights[groups[i]] += weights[i];
+	const std::vector<size_t> parts = PartitionWeights( item_weights, teams, method );
+
+	// part -> team id: the biggest overlaps of parts with current teams are matched first,
+	// the parts left over get the remaining ids
+	std::vector<std::pair<size_t, size_t> > overlaps;
+	overlaps.reserve( players );
+	for ( size_t i = 0; i < players; ++i )
+		if ( current[i] >= 0 && size_t( current[i] ) < teams )
+			overlaps.push_back( std::make_pair( parts[groups[i]], size_t( current[i] ) ) );
+	std::sort( overlaps.begin(), overlaps.end() );
+	std::vector<std::pair<size_t, std::pair<size_t, size_t> > > counted;
+	for ( size_t i = 0; i < overlaps.size(); ) {
+		size_t j = i;
+		while ( j < overlaps.size() && overlaps[j] == overlaps[i] )
+			++j;
+		counted.push_back( std::make_pair( j - i, overlaps[i] ) );
+		i = j;
+	}
+	std::stable_sort( counted.begin(), counted.end(),
+		[]( const std::pair<size_t, std::pair<size_t, size_t> >& a, const std::pair<size_t, std::pair<size_t, size_t> >& b ) { return a.first > b.first; } );
+	std::vector<size_t> team_of_part( teams, NO_ITEM );
+	std::vector<bool> used( teams, false );
+	for ( size_t i = 0; i < counted.size(); ++i ) {
+		const size_t part = counted[i].second.first, team = counted[i].second.second;
+		if ( team_of_part[part] == NO_ITEM && !used[team] ) {
+			team_of_part[part] = team;
+			used[team] = true;
+		}
+	}
+	size_t free = 0;
+	for ( size_t part = 0; part < teams; ++part ) {
+		if ( team_of_part[part] != NO_ITEM )
+			continue;
+		while ( used[free] )
+			++free;
+		used[free] = true;
+		team_of_part[part] = free;
+	}
+	for ( size_t i = 0; i < players; ++i )
+		result[i] = int( team_of_part[parts[groups[i]]] );
+	return result;
+}
+
+float PartitionSpread( const std::vector<float>& weights, size_t bins, const std::vector<size_t>& assignment )
+{
+	if ( bins == 0 )
+		return 0;
+	std::vector<double> sums( bins, 0 );
+	for ( size_t i = 0; i < assignment.size(); ++i )
+		sums[assignment[i]] += weights[i];
+	return float( *std::max_element( sums.begin(), sums.end() ) - *std::min_element( sums.begin(), sums.end() ) );
+}
+
+} // namespace Util
+} // namespace LSL
@@ -0,0 +1,83 @@
+#ifndef LSL_BALANCE_H
+#define LSL_BALANCE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace LSL {
+namespace Util {
+
+//! how PartitionWeights spreads items over bins
+enum PartitionMethod
+{
+	//! each item goes to the lightest bin, items in the given order
+	PARTITION_IN_ORDER,
+	//! each item goes to the lightest bin, heaviest items first
+	PARTITION_GREEDY,
+	//! Karmarkar-Karp largest differencing, generalized to any number of bins
+	PARTITION_DIFFERENCING,
+	/** branch and bound for up to MAX_EXACT_ITEMS items, differencing above that.
+	 * Optimal only if the search finishes within MAX_EXACT_NODES nodes, otherwise
+	 * the best split found so far is returned without notice
+	 **/
+	PARTITION_EXACT
+};
+
+//! PARTITION_EXACT gives up on optimality for more items than this
+const size_t MAX_EXACT_ITEMS = 16;
+//! upper bound on the search nodes PARTITION_EXACT visits before it settles for the best so far
+const size_t MAX_EXACT_NODES = 1 << 20;
+
+/** \brief split weighted items into \param bins bins whose weight sums are as close as possible
+ * Items are indivisible, a group of players that has to stay together is one item
+ * weighing the sum of its members.
+ * \return for every item the index of the bin it got, all indices are below \param bins
+ **/
+std::vector<size_t> PartitionWeights( const std::vector<float>& weights, size_t bins, PartitionMethod method );
+
+/** \brief new control team of every player, packed into team ids 0 to \param teams - 1
+ * With at least as many teams as players everybody gets a team of their own: a player
+ * keeps their id if it is below \param teams and nobody before them has it, the others
+ * get the lowest free ids. Otherwise the groups of \param groups (players with the same value
+ * stay together) are split over the teams by PartitionWeights with \param method, and
+ * the parts are matched to team ids biggest overlap with the \param current teams first,
+ * so fixing teams that are already fine changes nothing.
+ * \param weights balance rank of every player
+ **/
+std::vector<int> PackControlTeams( const std::vector<int>& current, const std::vector<float>& weights,
+	const std::vector<size_t>& groups, size_t teams, PartitionMethod method );
+
+//! difference between the heaviest and the lightest bin of \param assignment
+float PartitionSpread( const std::vector<float>& weights, size_t bins, const std::vector<size_t>& assignment );
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_BALANCE_H
+
+/**
+ * \file balance.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,77 @@
+#ifndef LSL_BITS_H
+#define LSL_BITS_H
+
+#include <cstddef>
+#include <boost/cstdint.hpp>
+
+namespace LSL {
+namespace Util {
+
+//! number of set bits in \param v
+inline size_t PopCount( boost::uint64_t v )
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll( v );
+#else
+	size_t c = 0;
+	for ( ; v; v &= v - 1 ) ++c;
+	return c;
+#endif
+}
+
+//! index of the lowest set bit, \param v must not be 0
+inline size_t CountTrailingZeros( boost::uint64_t v )
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll( v );
+#else
+	size_t c = 0;
+	for ( ; !( v & 1 ); v >>= 1 ) ++c;
+	return c;
+#endif
+}
+
+//! number of zero bits above the highest set one, 64 for 0
+inline unsigned int CountLeadingZeros( boost::uint64_t v )
+{
+#if defined(__GNUC__)
+	return v == 0 ? 64 : unsigned( __builtin_clzll( v ) );
+#else
+	unsigned int c = 0;
+	for ( boost::uint64_t bit = boost::uint64_t( 1 ) << 63; bit != 0 && !( v & bit ); bit >>= 1 )
+		++c;
+	return c;
+#endif
+}
+
+} // namespace Util
+} // namespace LSL
+
+/**
+ * \file bits.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LSL_BITS_H
@@ -0,0 +1,57 @@
+#ifndef LSL_CASEFOLD_H
+#define LSL_CASEFOLD_H
+
+#include <cstddef>
+#include <boost/cstdint.hpp>
+
+namespace LSL {
+namespace Util {
+
+//! ASCII lower case, script tags and TDF names compare case-insensitively
+inline char FoldChar( char c )
+{
+	return ( c >= 'A' && c <= 'Z' ) ? char( c - 'A' + 'a' ) : c;
+}
+
+//! FNV-1a over the case folded chars of [ \param data, \param data + \param size )
+inline boost::uint32_t FoldedHash( const char* data, size_t size )
+{
+	boost::uint32_t hash = 2166136261u;
+	for ( size_t i = 0; i < size; ++i ) {
+		hash ^= static_cast<unsigned char>( FoldChar( data[i] ) );
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+} // namespace Util
+} // namespace LSL
+
+/**
+ * \file casefold.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LSL_CASEFOLD_H
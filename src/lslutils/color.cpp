@@ -0,0 +1,196 @@
+#include "color.h"
+#include "assignment.h"
+
+#include <cmath>
+#include <limits>
+
+namespace LSL {
+namespace Util {
+
+namespace {
+
+struct LinearTable
+{
+	float values[256];
+	LinearTable()
+	{
+		for ( int i = 0; i < 256; ++i ) {
+			const double c = i / 255.0;
+			values[i] = float( c <= 0.04045 ? c / 12.92 : std::pow( ( c + 0.055 ) / 1.055, 2.4 ) );
+		}
+	}
+};
+
+float SrgbToLinear( unsigned char c )
+{
+	static const LinearTable table;
+	return table.values[c];
+}
+
+//! channel steps of the sRGB grid the palette is picked from
+const int GRID_STEPS = 18;
+//! keep team colors away from near black and near white
+const float MIN_LIGHTNESS = 0.45f;
+const float MAX_LIGHTNESS = 0.95f;
+
+/** the palette is built by farthest point sampling: start with the most saturated
+ * candidate, then keep adding the candidate farthest away from everything chosen */
+struct PerceptualPalette
+{
+	std::vector<lslColor> colors;
+	std::vector<float> L, a, b;
+
+	PerceptualPalette()
+	{
+		std::vector<lslColor> candidates;
+		std::vector<LabColor> labs;
+		for ( int r = 0; r < GRID_STEPS; ++r )
+			for ( int g = 0; g < GRID_STEPS; ++g )
+				for ( int bl = 0; bl < GRID_STEPS; ++bl ) {
+					const lslColor col( r * 255 / ( GRID_STEPS - 1 ), g * 255 / ( GRID_STEPS - 1 ), bl * 255 / ( GRID_STEPS - 1 ) );
+					const LabColor lab = ToLab( col );
+					if ( lab.L < MIN_LIGHTNESS || lab.L > MAX_LIGHTNESS )
+						continue;
+					candidates.push_back( col );
+					labs.push_back( lab );
+				}
+
+		size_t next = 0;
+		float best_chroma = -1;
+		for ( size_t i = 0; i < labs.size(); ++i ) {
+			const float chroma = labs[i].a * labs[i].a + labs[i].b * labs[i].b;
+			if ( chroma > best_chroma ) {
+				best_chroma = chroma;
+				next = i;
+			}
+		}
+
+		std::vector<float> min_dist( labs.size(), std::numeric_limits<float>::max() );
+		while ( colors.size() < ColorAllocator::PALETTE_SIZE ) {
+			const LabColor chosen = labs[next];
+			colors.push_back( candidates[next] );
+			L.push_back( chosen.L );
+			a.push_back( chosen.a );
+			b.push_back( chosen.b );
+			float farthest = -1;
+			for ( size_t i = 0; i < labs.size(); ++i ) {
+				const float dL = labs[i].L - chosen.L, da = labs[i].a - chosen.a, db = labs[i].b - chosen.b;
+				const float d = dL * dL + da * da + db * db;
+				if ( d < min_dist[i] )
+					min_dist[i] = d;
+				if ( min_dist[i] > farthest ) {
+					farthest = min_dist[i];
+					next = i;
+				}
+			}
+		}
+	}
+};
+
+const PerceptualPalette& GetPalette()
+{
+	static const PerceptualPalette palette;
+	return palette;
+}
+
+} // namespace
+
+LabColor ToLab( const lslColor& col )
+{
+	const float r = SrgbToLinear( col.Red() );
+	const float g = SrgbToLinear( col.Green() );
+	const float b = SrgbToLinear( col.Blue() );
+	const float l = std::cbrt( 0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b );
+	const float m = std::cbrt( 0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b );
+	const float s = std::cbrt( 0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b );
+	LabColor lab;
+	lab.L = 0.2104542553f * l + 0.7936177850f * m - 0.0040720453f * s;
+	lab.a = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+	lab.b = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+	return lab;
+}
+
+float ColorDistance( const lslColor& col1, const lslColor& col2 )
+{
+	const LabColor x = ToLab( col1 );
+	const LabColor y = ToLab( col2 );
+	const float dL = x.L - y.L, da = x.a - y.a, db = x.b - y.b;
+	return 255.0f * std::sqrt( dL * dL + da * da + db * db );
+}
+
+ColorAllocator::ColorAllocator()
+	: m_min_dist( PALETTE_SIZE, std::numeric_limits<float>::max() )
+{
+}
+
+void ColorAllocator::Take( const lslColor& col )
+{
+	const PerceptualPalette& palette = GetPalette();
+	const LabColor lab = ToLab( col );
+	const float* L = &palette.L[0];
+	const float* a = &palette.a[0];
+	const float* b = &palette.b[0];
+	float* min_dist = &m_min_dist[0];
+	for ( size_t i = 0; i < PALETTE_SIZE; ++i ) {
+		const float dL = L[i] - lab.L, da = a[i] - lab.a, db = b[i] - lab.b;
+		const float d = dL * dL + da * da + db * db;
+		min_dist[i] = d < min_dist[i] ? d : min_dist[i];
+	}
+}
+
+size_t ColorAllocator::BestCandidate() const
+{
+	size_t best = 0;
+	for ( size_t i = 1; i < PALETTE_SIZE; ++i )
+		if ( m_min_dist[i] > m_min_dist[best] )
+			best = i;
+	return best;
+}
+
+lslColor ColorAllocator::Next() const
+{
+	return GetPalette().colors[BestCandidate()];
+}
+
+lslColor ColorAllocator::Allocate()
+{
+	const lslColor col = Next();
+	Take( col );
+	return col;
+}
+
+const std::vector<lslColor>& ColorAllocator::Palette()
+{
+	return GetPalette().colors;
+}
+
+std::vector<lslColor> AssignTeamColors( const lslColor& taken, const std::vector<lslColor>& current )
+{
+	const size_t n = current.size();
+	ColorAllocator allocator;
+	allocator.Take( taken );
+	std::vector<lslColor> targets( n );
+	for ( size_t j = 0; j < n; ++j )
+		targets[j] = allocator.Allocate();
+
+	std::vector<LabColor> target_labs( n );
+	for ( size_t j = 0; j < n; ++j )
+		target_labs[j] = ToLab( targets[j] );
+	std::vector<double> cost( n * n );
+	for ( size_t i = 0; i < n; ++i ) {
+		const LabColor lab = ToLab( current[i] );
+		for ( size_t j = 0; j < n; ++j ) {
+			const float dL = lab.L - target_labs[j].L, da = lab.a - target_labs[j].a, db = lab.b - target_labs[j].b;
+			cost[i * n + j] = std::sqrt( dL * dL + da * da + db * db );
+		}
+	}
+
+	const std::vector<size_t> assignment = SolveAssignment( cost, n, n );
+	std::vector<lslColor> result( n );
+	for ( size_t i = 0; i < n; ++i )
+		result[i] = targets[assignment[i]];
+	return result;
+}
+
+} // namespace Util
+} // namespace LSL
@@ -0,0 +1,91 @@
+#ifndef LSL_COLOR_H
+#define LSL_COLOR_H
+
+#include <cstddef>
+#include <vector>
+#include "misc.h"
+
+namespace LSL {
+namespace Util {
+
+//! a color in the Oklab space, where euclidean distance follows perceived difference
+struct LabColor
+{
+	float L, a, b;
+};
+
+LabColor ToLab( const lslColor& col );
+
+//! perceptual difference of two colors, black to white is 255
+float ColorDistance( const lslColor& col1, const lslColor& col2 );
+
+/** \brief hands out team colors that are as distinct from the taken ones as possible
+ * Candidates come from a palette of PALETTE_SIZE perceptually spaced colors that is
+ * built once per process, every prefix of it is itself well spread. For each candidate
+ * the distance to the closest taken color is kept in flat float arrays, so Take is one
+ * vectorizable pass over the palette and Next a scan of the same size, independent of
+ * how many colors are taken.
+ **/
+class ColorAllocator
+{
+public:
+	static const size_t PALETTE_SIZE = 256;
+
+	ColorAllocator();
+
+	//! mark \param col as in use
+	void Take( const lslColor& col );
+	//! the palette color farthest away from all taken colors, the first palette color if none are
+	lslColor Next() const;
+	//! Next(), and take it
+	lslColor Allocate();
+
+	//! the shared palette, in allocation order for an empty battle
+	static const std::vector<lslColor>& Palette();
+
+private:
+	size_t BestCandidate() const;
+
+	//! squared lab distance of each candidate to its closest taken color
+	std::vector<float> m_min_dist;
+};
+
+/** \brief distinct colors for the teams currently colored \param current, next to a fixed \param taken one
+ * The targets are the first current.size() colors a ColorAllocator hands out after \param taken,
+ * matched to the teams so the summed perceptual change is minimal. Since the allocator sequence
+ * only grows with the number of teams, a team that already has its target color keeps it.
+ * \return the new color of each team, in the order of \param current
+ **/
+std::vector<lslColor> AssignTeamColors( const lslColor& taken, const std::vector<lslColor>& current );
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_COLOR_H
+
+/**
+ * \file color.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -1,5 +1,6 @@
 #include "misc.h"
 #include "conversion.h"
+#include "color.h"
 
 #include <boost/filesystem.hpp>
 #include <fstream>
@@ -104,13 +105,7 @@ std::string AfterFirst( const std::string& phrase, const std::string& searchterm
 
 bool AreColorsSimilar( const lslColor& col1, const lslColor& col2, int mindiff )
 {
-	int r,g,b;
-	r = std::abs( col1.Red() - col2.Red() );
-	g = std::abs( col1.Green() - col2.Green() );
-	b = std::abs( col1.Blue() - col2.Blue() );
-	int difference = std::min( r, g );
-	difference = std::min( difference, b );
-	return difference < mindiff;
+	return ColorDistance( col1, col2 ) < mindiff;
 }
 
 typedef std::vector<double> huevec;
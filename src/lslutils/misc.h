@@ -160,7 +160,7 @@ std::string BeforeFirst( const std::string& phrase, const std::string& searchter
 std::string AfterFirst( const std::string& phrase, const std::string& searchterm );
 //! get a list of minimum numteam colors have maximum total difference in a certain metric
 std::vector<lslColor>& GetBigFixColorsPalette( int numteams );
-//! checks wheter two colors' difference is below mindiff
+//! checks wheter two colors' perceptual difference (see ColorDistance) is below mindiff
 bool AreColorsSimilar( const lslColor& col1, const lslColor& col2, int mindiff );
 //! tokenize input string and convert into rgb color
 lslColor ColorFromFloatString( const std::string& rgb_string );
@@ -1,7 +1,197 @@
 #include "net.h"
-#include <boost/asio/ip/address.hpp>
-#include <boost/system/error_code.hpp>
+#include "bits.h"
+
+#include <algorithm>
+#include <sstream>
 
 namespace LSL { namespace Util { namespace Net {
 
+namespace {
+
+//! the top \param length bits of a 64 bit half set
+boost::uint64_t HighMask( unsigned int length )
+{
+    if ( length == 0 )
+        return 0;
+    if ( length >= 64 )
+        return ~boost::uint64_t( 0 );
+    return ~boost::uint64_t( 0 ) << ( 64 - length );
+}
+
+//! reads a decimal number of at most \param max from [pos, end), \return false if there is none
+//! or it has a leading zero, which some parsers would take for octal
+bool ReadDecimal( const char*& pos, const char* end, unsigned long max, unsigned long& value )
+{
+    const char* start = pos;
+    value = 0;
+    while ( pos != end && *pos >= '0' && *pos <= '9' ) {
+        if ( pos - start == 3 ) // neither octets nor prefix lengths take more digits
+            return false;
+        value = value * 10 + unsigned( *pos - '0' );
+        ++pos;
+    }
+    if ( pos - start > 1 && *start == '0' )
+        return false;
+    return pos != start && value <= max;
+}
+
+bool ParseV4( const char* pos, const char* end, boost::uint32_t& result )
+{
+    result = 0;
+    for ( int part = 0; part < 4; ++part ) {
+        if ( part > 0 && ( pos == end || *pos++ != '.' ) )
+            return false;
+        unsigned long value;
+        if ( !ReadDecimal( pos, end, 255, value ) )
+            return false;
+        result = ( result << 8 ) | boost::uint32_t( value );
+    }
+    return pos == end;
+}
+
+int HexDigit( char c )
+{
+    if ( c >= '0' && c <= '9' ) return c - '0';
+    if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+    if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+    return -1;
+}
+
+bool ParseV6( const char* pos, const char* end, Address& address )
+{
+    boost::uint16_t groups[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    int count = 0;
+    int gap = -1; // group index of the ::
+    if ( end - pos >= 2 && pos[0] == ':' && pos[1] == ':' ) {
+        gap = 0;
+        pos += 2;
+    }
+    while ( pos != end ) {
+        if ( count == 8 )
+            return false;
+        // a trailing dotted IPv4 part takes the last two groups
+        const char* group_end = pos;
+        while ( group_end != end && *group_end != ':' )
+            ++group_end;
+        if ( group_end == end && std::find( pos, end, '.' ) != end ) {
+            boost::uint32_t v4;
+            if ( count > 6 || !ParseV4( pos, end, v4 ) )
+                return false;
+            groups[count++] = boost::uint16_t( v4 >> 16 );
+            groups[count++] = boost::uint16_t( v4 );
+            pos = end;
+            break;
+        }
+        if ( group_end == pos || group_end - pos > 4 )
+            return false;
+        unsigned int value = 0;
+        for ( ; pos != group_end; ++pos ) {
+            const int digit = HexDigit( *pos );
+            if ( digit < 0 )
+                return false;
+            value = ( value << 4 ) | unsigned( digit );
+        }
+        groups[count++] = boost::uint16_t( value );
+        if ( pos == end )
+            break;
+        ++pos; // the ':'
+        if ( pos != end && *pos == ':' ) {
+            if ( gap >= 0 )
+                return false;
+            gap = count;
+            ++pos;
+        }
+        else if ( pos == end )
+            return false;
+    }
+    if ( gap < 0 && count != 8 )
+        return false;
+    if ( gap >= 0 ) {
+        if ( count == 8 )
+            return false;
+        const int moved = count - gap;
+        for ( int i = 0; i < moved; ++i )
+            groups[7 - i] = groups[count - 1 - i];
+        for ( int i = gap; i < 8 - moved; ++i )
+            groups[i] = 0;
+    }
+    address.hi = address.lo = 0;
+    for ( int i = 0; i < 4; ++i ) {
+        address.hi = ( address.hi << 16 ) | groups[i];
+        address.lo = ( address.lo << 16 ) | groups[i + 4];
+    }
+    return true;
+}
+
+} // namespace
+
+Address Address::Prefix( unsigned int length ) const
+{
+    Address result;
+    result.hi = hi & HighMask( length );
+    result.lo = length > 64 ? lo & HighMask( length - 64 ) : 0;
+    return result;
+}
+
+unsigned int Address::CommonBits( const Address& other ) const
+{
+    if ( hi != other.hi )
+        return CountLeadingZeros( hi ^ other.hi );
+    return 64 + CountLeadingZeros( lo ^ other.lo );
+}
+
+bool ParseAddress( const std::string& text, Address& address )
+{
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    if ( std::find( begin, end, ':' ) != end )
+        return ParseV6( begin, end, address );
+    boost::uint32_t v4;
+    if ( !ParseV4( begin, end, v4 ) )
+        return false;
+    address.hi = 0;
+    address.lo = ( boost::uint64_t( 0xffff ) << 32 ) | v4;
+    return true;
+}
+
+bool ParseNetwork( const std::string& text, Address& network, unsigned int& length )
+{
+    const size_t slash = text.find( '/' );
+    if ( !ParseAddress( text.substr( 0, slash ), network ) )
+        return false;
+    const unsigned int offset = network.IsV4() ? V4_MAPPED_BITS : 0;
+    length = 128;
+    if ( slash != std::string::npos ) {
+        const char* pos = text.data() + slash + 1;
+        const char* end = text.data() + text.size();
+        unsigned long prefix;
+        if ( !ReadDecimal( pos, end, 128 - offset, prefix ) || pos != end )
+            return false;
+        length = offset + unsigned( prefix );
+    }
+    network = network.Prefix( length );
+    return true;
+}
+
+std::string FormatNetwork( const Address& network, unsigned int length )
+{
+    std::ostringstream out;
+    if ( network.IsV4() && length >= V4_MAPPED_BITS ) {
+        out << ( ( network.lo >> 24 ) & 0xff ) << '.' << ( ( network.lo >> 16 ) & 0xff ) << '.'
+            << ( ( network.lo >> 8 ) & 0xff ) << '.' << ( network.lo & 0xff );
+        length -= V4_MAPPED_BITS;
+        if ( length != 32 )
+            out << '/' << length;
+        return out.str();
+    }
+    out << std::hex;
+    for ( int i = 0; i < 8; ++i ) {
+        const boost::uint64_t half = i < 4 ? network.hi : network.lo;
+        out << ( i > 0 ? ":" : "" ) << ( ( half >> ( 48 - 16 * ( i % 4 ) ) ) & 0xffff );
+    }
+    if ( length != 128 )
+        out << '/' << std::dec << length;
+    return out.str();
+}
+
 } } }// namespace LSL { namespace Util { namespace Net {
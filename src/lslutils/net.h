@@ -13,9 +13,41 @@ class error_code;
 }
 
 #include <string>
+#include <boost/cstdint.hpp>
 
 namespace LSL { namespace Util { namespace Net {
 
+/** \brief an IPv4 or IPv6 address as one 128 bit number, most significant half first.
+ * IPv4 addresses are kept IPv4-mapped ( ::ffff:a.b.c.d ) so both share one key space */
+struct Address
+{
+    Address() : hi( 0 ), lo( 0 ) {}
+    bool IsV4() const { return hi == 0 && ( lo >> 32 ) == 0xffff; }
+    //! \return bit \param index counted from the most significant one
+    int Bit( unsigned int index ) const
+    {
+        return index < 64 ? int( ( hi >> ( 63 - index ) ) & 1 ) : int( ( lo >> ( 127 - index ) ) & 1 );
+    }
+    //! the first \param length bits, the rest zeroed
+    Address Prefix( unsigned int length ) const;
+    //! number of leading bits this and \param other have in common
+    unsigned int CommonBits( const Address& other ) const;
+    bool operator == ( const Address& other ) const { return hi == other.hi && lo == other.lo; }
+
+    boost::uint64_t hi, lo;
+};
+
+//! number of bits in the mapped part of an IPv4 address
+static const unsigned int V4_MAPPED_BITS = 96;
+
+//! parses dotted IPv4 or IPv6 ( with :: and a trailing dotted part ), \return false if \param text is neither
+bool ParseAddress( const std::string& text, Address& address );
+/** parses "address/prefix", a plain address counts as a single host. The IPv4 prefix
+ * is moved into the 128 bit space, "10.0.0.0/8" comes back with \param length 104 */
+bool ParseNetwork( const std::string& text, Address& network, unsigned int& length );
+//! the inverse of ParseNetwork, IPv4 networks print dotted
+std::string FormatNetwork( const Address& network, unsigned int length );
+
 } } }// namespace LSL { namespace Util { namespace Net {
 
 /**
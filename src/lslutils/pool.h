@@ -0,0 +1,167 @@
+#ifndef LSL_POOL_H
+#define LSL_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace LSL {
+namespace Util {
+
+//! process wide counters of all FixedSizePool instances
+struct PoolStats
+{
+	//! blocks requested from the system in chunks
+	std::atomic<size_t> chunks;
+	//! blocks handed out
+	std::atomic<size_t> allocations;
+	//! blocks handed out that came from the free list
+	std::atomic<size_t> recycled;
+
+	static PoolStats& Get() { static PoolStats stats; return stats; }
+
+private:
+	PoolStats() : chunks( 0 ), allocations( 0 ), recycled( 0 ) {}
+};
+
+/** \brief free list of equally sized blocks
+ * blocks are carved out of larger chunks, freed blocks are recycled and
+ * chunks are never given back to the system
+ **/
+template < size_t BlockSize >
+class FixedSizePool : public boost::noncopyable
+{
+public:
+	static const size_t BLOCKS_PER_CHUNK = 64;
+
+	//! intentionally never destroyed, pooled objects may outlive static destruction
+	static FixedSizePool& Instance() { static FixedSizePool* pool = new FixedSizePool; return *pool; }
+
+	void* Allocate()
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		PoolStats::Get().allocations++;
+		if ( m_free ) {
+			FreeBlock* block = m_free;
+			m_free = block->next;
+			PoolStats::Get().recycled++;
+			return block;
+		}
+		if ( m_next_in_chunk == BLOCKS_PER_CHUNK ) {
+			m_chunks.push_back( static_cast<char*>( ::operator new( BlockSize * BLOCKS_PER_CHUNK ) ) );
+			m_next_in_chunk = 0;
+			PoolStats::Get().chunks++;
+		}
+		return m_chunks.back() + BlockSize * m_next_in_chunk++;
+	}
+
+	void Deallocate( void* p )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		FreeBlock* block = static_cast<FreeBlock*>( p );
+		block->next = m_free;
+		m_free = block;
+	}
+
+private:
+	FixedSizePool() : m_free( 0 ), m_next_in_chunk( BLOCKS_PER_CHUNK ) {}
+
+	struct FreeBlock { FreeBlock* next; };
+
+	boost::mutex m_mutex;
+	FreeBlock* m_free;
+	std::vector<char*> m_chunks;
+	size_t m_next_in_chunk;
+};
+
+//! std allocator serving single objects from the FixedSizePool of matching size
+template < class T >
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	template < class U > struct rebind { typedef PoolAllocator<U> other; };
+
+	PoolAllocator() {}
+	template < class U > PoolAllocator( const PoolAllocator<U>& ) {}
+
+	T* allocate( size_type n )
+	{
+		if ( n != 1 )
+			return static_cast<T*>( ::operator new( n * sizeof(T) ) );
+		return static_cast<T*>( Pool::Instance().Allocate() );
+	}
+
+	void deallocate( T* p, size_type n )
+	{
+		if ( n != 1 )
+			::operator delete( p );
+		else
+			Pool::Instance().Deallocate( p );
+	}
+
+	template < class U, class... Args >
+	void construct( U* p, Args&&... args ) { ::new( static_cast<void*>( p ) ) U( std::forward<Args>( args )... ); }
+	template < class U >
+	void destroy( U* p ) { p->~U(); }
+
+	template < class U > bool operator==( const PoolAllocator<U>& ) const { return true; }
+	template < class U > bool operator!=( const PoolAllocator<U>& ) const { return false; }
+
+private:
+	static const size_t ALIGN = alignof( std::max_align_t );
+	static const size_t BLOCK_SIZE = ( ( sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*) ) + ALIGN - 1 ) / ALIGN * ALIGN;
+	typedef FixedSizePool< BLOCK_SIZE > Pool;
+};
+
+/** \brief pooled replacement for boost::shared_ptr<T>( new T(...) )
+ * object and refcount live in one recycled pool block
+ **/
+template < class T, class... Args >
+boost::shared_ptr<T> MakePooled( Args&&... args )
+{
+	return boost::allocate_shared<T>( PoolAllocator<T>(), std::forward<Args>( args )... );
+}
+
+} // namespace Util
+} // namespace LSL
+
+/**
+ * \file pool.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LSL_POOL_H
@@ -0,0 +1,199 @@
+#ifndef LSL_RCU_H
+#define LSL_RCU_H
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <boost/noncopyable.hpp>
+
+namespace LSL {
+namespace Util {
+
+/** \brief single writer, many readers publication of immutable objects
+ *
+ * The writer hands over a new immutable object with Publish(), readers pin
+ * the current one through a ReadGuard. Readers never lock and never write
+ * to shared cache lines: they announce the epoch they started in in their
+ * own slot and then load the current pointer. Replaced objects are deleted
+ * by the writer once no reader can still see them (epoch based reclamation).
+ **/
+template < class T >
+class RcuPublisher : public boost::noncopyable
+{
+public:
+	//! upper bound of concurrently registered Reader objects
+	static const size_t MAX_READERS = 64;
+
+	//! one per reader thread, owns a slot in the publisher
+	class Reader : public boost::noncopyable
+	{
+	public:
+		//! throws std::runtime_error if all slots are taken
+		explicit Reader( RcuPublisher& publisher )
+			: m_publisher( publisher )
+			, m_slot( publisher.ClaimSlot() )
+		{}
+		~Reader() { m_publisher.ReleaseSlot( m_slot ); }
+
+	private:
+		friend class RcuPublisher;
+		RcuPublisher& m_publisher;
+		size_t m_slot;
+	};
+
+	//! keeps the object current at construction time alive until destruction
+	class ReadGuard : public boost::noncopyable
+	{
+	public:
+		explicit ReadGuard( Reader& reader )
+			: m_reader( reader )
+			, m_data( reader.m_publisher.Enter( reader.m_slot ) )
+		{}
+		~ReadGuard() { m_reader.m_publisher.Leave( m_reader.m_slot ); }
+
+		//! may be NULL if nothing was published yet
+		const T* get() const { return m_data; }
+		const T& operator*() const { return *m_data; }
+		const T* operator->() const { return m_data; }
+
+	private:
+		Reader& m_reader;
+		const T* m_data;
+	};
+
+	RcuPublisher()
+		: m_current( 0 )
+		, m_epoch( 1 )
+	{
+		for ( size_t i = 0; i < MAX_READERS; ++i ) {
+			m_slots[i].epoch.store( IDLE );
+			m_slots[i].claimed.store( false );
+		}
+	}
+
+	//! readers must be gone by now
+	~RcuPublisher()
+	{
+		delete m_current.load();
+		for ( size_t i = 0; i < m_retired.size(); ++i )
+			delete m_retired[i].data;
+	}
+
+	//! writer only, takes ownership of \param next
+	void Publish( const T* next )
+	{
+		const T* old = m_current.exchange( next );
+		// readers entering from here on cannot observe old anymore
+		const unsigned long retire_epoch = ++m_epoch;
+		if ( old ) {
+			Retired r = { old, retire_epoch };
+			m_retired.push_back( r );
+		}
+		Reclaim();
+	}
+
+	//! writer only, frees everything no reader can reach any longer
+	void Reclaim()
+	{
+		if ( m_retired.empty() )
+			return;
+		unsigned long oldest = std::numeric_limits<unsigned long>::max();
+		for ( size_t i = 0; i < MAX_READERS; ++i ) {
+			const unsigned long e = m_slots[i].epoch.load();
+			if ( e != IDLE && e < oldest )
+				oldest = e;
+		}
+		size_t kept = 0;
+		for ( size_t i = 0; i < m_retired.size(); ++i ) {
+			if ( m_retired[i].epoch <= oldest )
+				delete m_retired[i].data;
+			else
+				m_retired[kept++] = m_retired[i];
+		}
+		m_retired.resize( kept );
+	}
+
+	//! number of replaced objects still waiting for readers to move on
+	size_t PendingReclaims() const { return m_retired.size(); }
+
+private:
+	static const unsigned long IDLE = 0;
+
+	const T* Enter( size_t slot )
+	{
+		m_slots[slot].epoch.store( m_epoch.load() );
+		return m_current.load();
+	}
+
+	void Leave( size_t slot )
+	{
+		m_slots[slot].epoch.store( IDLE, std::memory_order_release );
+	}
+
+	size_t ClaimSlot()
+	{
+		for ( size_t i = 0; i < MAX_READERS; ++i ) {
+			bool expected = false;
+			if ( m_slots[i].claimed.compare_exchange_strong( expected, true ) )
+				return i;
+		}
+		throw std::runtime_error( "RcuPublisher: too many readers" );
+	}
+
+	void ReleaseSlot( size_t slot )
+	{
+		m_slots[slot].epoch.store( IDLE );
+		m_slots[slot].claimed.store( false );
+	}
+
+	//! padded so that readers don't share cache lines
+	struct Slot {
+		std::atomic<unsigned long> epoch;
+		std::atomic<bool> claimed;
+		char pad[64 - sizeof(std::atomic<unsigned long>) - sizeof(std::atomic<bool>)];
+	};
+	struct Retired {
+		const T* data;
+		unsigned long epoch;
+	};
+
+	std::atomic<const T*> m_current;
+	char m_pad0[64];
+	std::atomic<unsigned long> m_epoch;
+	char m_pad1[64];
+	Slot m_slots[MAX_READERS];
+	std::vector<Retired> m_retired;
+};
+
+} // namespace Util
+} // namespace LSL
+
+/**
+ * \file rcu.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
+
+#endif // LSL_RCU_H
@@ -0,0 +1,149 @@
+#include "stringpool.h"
+
+#include <ostream>
+#include <new>
+
+namespace LSL {
+namespace Util {
+
+namespace {
+
+//! bytes \param s keeps on the heap, none while it fits its own inline buffer
+size_t HeapBytes( const std::string& s )
+{
+	const char* data = s.data();
+	const char* self = reinterpret_cast<const char*>( &s );
+	return ( data >= self && data < self + sizeof( s ) ) ? 0 : s.capacity() + 1;
+}
+
+} // namespace
+
+StringPool& StringPool::Get()
+{
+	static StringPool* pool = new StringPool;
+	return *pool;
+}
+
+StringPool::StringPool()
+	: m_size( 1 ),
+	m_used( 0 ),
+	m_chunks( 0 ),
+	m_heap_bytes( 0 )
+{
+	for ( size_t i = 0; i < NUM_DIRS; ++i )
+		m_dirs[i].store( 0, std::memory_order_relaxed );
+	const Id empty = Allocate();
+	m_index[&Lookup( empty )] = empty;
+}
+
+StringPool::~StringPool()
+{
+	for ( size_t i = 0; i < NUM_DIRS; ++i ) {
+		ChunkPtr* dir = m_dirs[i].load( std::memory_order_relaxed );
+		if ( !dir )
+			continue;
+		for ( size_t c = 0; c < DIR_SIZE; ++c )
+			delete[] dir[c].load( std::memory_order_relaxed );
+		delete[] dir;
+	}
+}
+
+StringPool::Id StringPool::Allocate()
+{
+	if ( !m_free.empty() ) {
+		const Id id = m_free.back();
+		m_free.pop_back();
+		return id;
+	}
+	// every id in use at once, the entries alone would take far more memory than there is
+	if ( m_used > Id( -1 ) )
+		throw std::bad_alloc();
+	const Id id = Id( m_used++ );
+	if ( id & ( CHUNK_SIZE - 1 ) )
+		return id;
+	ChunkPtr* dir = m_dirs[id >> ( CHUNK_BITS + DIR_BITS )].load( std::memory_order_relaxed );
+	if ( !dir ) {
+		dir = new ChunkPtr[DIR_SIZE];
+		for ( size_t c = 0; c < DIR_SIZE; ++c )
+			dir[c].store( 0, std::memory_order_relaxed );
+		m_dirs[id >> ( CHUNK_BITS + DIR_BITS )].store( dir, std::memory_order_release );
+	}
+	dir[( id >> CHUNK_BITS ) & ( DIR_SIZE - 1 )].store( new Entry[CHUNK_SIZE], std::memory_order_release );
+	m_chunks++;
+	return id;
+}
+
+StringPool::Id StringPool::Intern( const std::string& str )
+{
+	if ( str.empty() )
+		return EMPTY;
+	boost::mutex::scoped_lock lock( m_mutex );
+	IndexMap::const_iterator it = m_index.find( str, KeyHash(), KeyEqual() );
+	if ( it != m_index.end() ) {
+		Slot( it->second ).refs.fetch_add( 1, std::memory_order_relaxed );
+		return it->second;
+	}
+
+	const Id id = Allocate();
+	Entry& entry = Slot( id );
+	entry.str = str;
+	entry.refs.store( 1, std::memory_order_relaxed );
+	m_heap_bytes += HeapBytes( entry.str );
+	m_index[&entry.str] = id;
+	m_size.fetch_add( 1, std::memory_order_relaxed );
+	return id;
+}
+
+bool StringPool::Find( const std::string& str, Id& id )
+{
+	if ( str.empty() ) {
+		id = EMPTY;
+		return true;
+	}
+	boost::mutex::scoped_lock lock( m_mutex );
+	IndexMap::const_iterator it = m_index.find( str, KeyHash(), KeyEqual() );
+	if ( it == m_index.end() )
+		return false;
+	id = it->second;
+	Slot( id ).refs.fetch_add( 1, std::memory_order_relaxed );
+	return true;
+}
+
+void StringPool::Free( Id id )
+{
+	boost::mutex::scoped_lock lock( m_mutex );
+	Entry& entry = Slot( id );
+	// Intern may have handed out the string again, or an earlier Free already let it go
+	if ( entry.refs.load( std::memory_order_relaxed ) != 0 )
+		return;
+	IndexMap::iterator it = m_index.find( entry.str, KeyHash(), KeyEqual() );
+	if ( it == m_index.end() || it->second != id )
+		return;
+	m_index.erase( it );
+	m_heap_bytes -= HeapBytes( entry.str );
+	std::string().swap( entry.str );
+	m_free.push_back( id );
+	m_size.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+size_t StringPool::MemoryUsage() const
+{
+	boost::mutex::scoped_lock lock( m_mutex );
+	size_t dirs = 0;
+	for ( size_t i = 0; i < NUM_DIRS; ++i )
+		dirs += m_dirs[i].load( std::memory_order_relaxed ) ? 1 : 0;
+	return m_chunks * CHUNK_SIZE * sizeof(Entry)
+		+ dirs * DIR_SIZE * sizeof(ChunkPtr)
+		+ m_heap_bytes
+		+ m_free.capacity() * sizeof(Id)
+		+ m_index.bucket_count() * sizeof(void*)
+		+ m_index.size() * ( sizeof(IndexMap::value_type) + 2 * sizeof(void*) );
+}
+
+std::ostream& operator<<( std::ostream& os, const InternedString& s )
+{
+	return os << s.str();
+}
+
+} // namespace Util
+} // namespace LSL
@@ -0,0 +1,205 @@
+#ifndef LSL_STRINGPOOL_H
+#define LSL_STRINGPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace LSL {
+namespace Util {
+
+/** \brief process wide table of unique strings
+ * every distinct string is stored once and identified by a 32bit id,
+ * id 0 is always the empty string. Entries are reference counted: Intern and
+ * Find hand out a reference, AddRef takes another one and Release drops it.
+ * The last Release frees the entry and its id is reused, so the pool holds the
+ * strings that are alive and not every one it ever saw. References returned by
+ * Lookup stay valid while the caller holds a reference to the id.
+ * It holds names: nicks, countries, channels and archives. Free form protocol
+ * data like script tags and hashes stays out of it.
+ **/
+class StringPool : public boost::noncopyable
+{
+public:
+	typedef boost::uint32_t Id;
+
+	static const Id EMPTY = 0;
+	static const size_t CHUNK_BITS = 12;
+	static const size_t CHUNK_SIZE = 1 << CHUNK_BITS;
+	//! chunks per directory, directories cover the whole id range
+	static const size_t DIR_BITS = 10;
+	static const size_t DIR_SIZE = 1 << DIR_BITS;
+	static const size_t NUM_DIRS = size_t( 1 ) << ( 32 - CHUNK_BITS - DIR_BITS );
+
+	//! intentionally never destroyed, interned strings may outlive static destruction
+	static StringPool& Get();
+
+	StringPool();
+	~StringPool();
+
+	//! return the id of \param str with a reference to it, adding it to the pool if needed
+	Id Intern( const std::string& str );
+	//! look up \param str without adding it, returns false if it isn't pooled, a reference to \param id otherwise
+	bool Find( const std::string& str, Id& id );
+	//! lock free, \param id must be referenced by the caller
+	void AddRef( Id id )
+	{
+		if ( id != EMPTY )
+			Slot( id ).refs.fetch_add( 1, std::memory_order_relaxed );
+	}
+	//! drops a reference taken by Intern, Find or AddRef
+	void Release( Id id )
+	{
+		if ( id != EMPTY && Slot( id ).refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+			Free( id );
+	}
+	//! lock free, \param id must be referenced by the caller
+	const std::string& Lookup( Id id ) const { return Slot( id ).str; }
+
+	//! number of distinct strings alive, including the empty one
+	size_t size() const { return m_size.load( std::memory_order_relaxed ); }
+	//! bytes held by the pool: entries, heap buffers and the lookup tables
+	size_t MemoryUsage() const;
+
+private:
+	struct Entry
+	{
+		Entry() : refs( 0 ) {}
+		std::string str;
+		std::atomic<boost::uint32_t> refs;
+	};
+	typedef std::atomic<Entry*> ChunkPtr;
+
+	struct KeyHash
+	{
+		size_t operator()( const std::string* s ) const { return boost::hash_range( s->begin(), s->end() ); }
+		size_t operator()( const std::string& s ) const { return boost::hash_range( s.begin(), s.end() ); }
+	};
+	struct KeyEqual
+	{
+		bool operator()( const std::string* a, const std::string* b ) const { return *a == *b; }
+		bool operator()( const std::string& a, const std::string* b ) const { return a == *b; }
+	};
+	typedef boost::unordered_map<const std::string*, Id, KeyHash, KeyEqual> IndexMap;
+
+	Entry& Slot( Id id ) const
+	{
+		const ChunkPtr* dir = m_dirs[id >> ( CHUNK_BITS + DIR_BITS )].load( std::memory_order_acquire );
+		return dir[( id >> CHUNK_BITS ) & ( DIR_SIZE - 1 )].load( std::memory_order_acquire )[id & ( CHUNK_SIZE - 1 )];
+	}
+	//! a new or recycled entry, called with m_mutex held
+	Id Allocate();
+	//! frees \param id once its last reference is gone, unless Intern or Find took a new one meanwhile
+	void Free( Id id );
+
+	mutable boost::mutex m_mutex;
+	std::atomic<ChunkPtr*> m_dirs[NUM_DIRS];
+	std::atomic<size_t> m_size;
+	//! ids below it were handed out at least once
+	boost::uint64_t m_used;
+	size_t m_chunks;
+	size_t m_heap_bytes;
+	std::vector<Id> m_free;
+	IndexMap m_index;
+};
+
+/** \brief handle to a string in the StringPool
+ * four bytes per copy, equality and hashing work on the id alone.
+ * Ordering stays lexicographic so sorted containers keep their order.
+ * Every handle holds a reference to its string in the pool.
+ **/
+class InternedString
+{
+public:
+	InternedString() : m_id( StringPool::EMPTY ) {}
+	InternedString( const std::string& str ) : m_id( StringPool::Get().Intern( str ) ) {}
+	InternedString( const char* str ) : m_id( StringPool::Get().Intern( str ) ) {}
+	InternedString( const InternedString& other ) : m_id( other.m_id ) { StringPool::Get().AddRef( m_id ); }
+	InternedString( InternedString&& other ) : m_id( other.m_id ) { other.m_id = StringPool::EMPTY; }
+	~InternedString() { StringPool::Get().Release( m_id ); }
+
+	InternedString& operator=( InternedString other )
+	{
+		std::swap( m_id, other.m_id );
+		return *this;
+	}
+
+	const std::string& str() const { return StringPool::Get().Lookup( m_id ); }
+	operator const std::string&() const { return str(); }
+	const char* c_str() const { return str().c_str(); }
+	size_t size() const { return str().size(); }
+	bool empty() const { return m_id == StringPool::EMPTY; }
+	StringPool::Id id() const { return m_id; }
+
+	//! handle for \param str only if it is pooled already, never grows the pool
+	static bool Find( const std::string& str, InternedString& out )
+	{
+		InternedString found;
+		if ( !StringPool::Get().Find( str, found.m_id ) )
+			return false;
+		out = std::move( found );
+		return true;
+	}
+
+private:
+	StringPool::Id m_id;
+};
+
+inline bool operator==( const InternedString& a, const InternedString& b ) { return a.id() == b.id(); }
+inline bool operator!=( const InternedString& a, const InternedString& b ) { return a.id() != b.id(); }
+inline bool operator==( const InternedString& a, const std::string& b ) { return a.str() == b; }
+inline bool operator!=( const InternedString& a, const std::string& b ) { return a.str() != b; }
+inline bool operator==( const std::string& a, const InternedString& b ) { return a == b.str(); }
+inline bool operator!=( const std::string& a, const InternedString& b ) { return a != b.str(); }
+inline bool operator==( const InternedString& a, const char* b ) { return a.str() == b; }
+inline bool operator!=( const InternedString& a, const char* b ) { return a.str() != b; }
+inline bool operator==( const char* a, const InternedString& b ) { return a == b.str(); }
+inline bool operator!=( const char* a, const InternedString& b ) { return a != b.str(); }
+inline bool operator<( const InternedString& a, const InternedString& b ) { return a.id() != b.id() && a.str() < b.str(); }
+inline std::string operator+( const std::string& a, const InternedString& b ) { return a + b.str(); }
+inline std::string operator+( const InternedString& a, const std::string& b ) { return a.str() + b; }
+inline std::string operator+( const char* a, const InternedString& b ) { return a + b.str(); }
+inline std::string operator+( const InternedString& a, const char* b ) { return a.str() + b; }
+
+inline size_t hash_value( const InternedString& s ) { return s.id(); }
+
+std::ostream& operator<<( std::ostream& os, const InternedString& s );
+
+} // namespace Util
+} // namespace LSL
+
+#endif // LSL_STRINGPOOL_H
+
+/**
+ * \file stringpool.h
+ * \section LICENSE
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
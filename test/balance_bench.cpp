@@ -0,0 +1,161 @@
+#include <lslutils/balance.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t PLAYER_COUNTS[] = { 8, 16, 32, 64, 128, 256 };
+const size_t ALLIANCE_COUNTS[] = { 2, 4 };
+const size_t SAMPLES = 20;
+
+//! what CommonUser::GetBalanceRank hands out, 1.0 for RANK_1 up to 1.1 for RANK_8
+std::vector<float> RandomRanks( size_t players )
+{
+    std::vector<float> ranks( players );
+    for ( size_t i = 0; i < players; ++i )
+        ranks[i] = 1.0f + 0.1f * float( rand() % 8 ) / 7.0f;
+    return ranks;
+}
+
+//! Battle::Autobalance before: re-sort all alliances for every player placed
+std::vector<size_t> OldAutobalance( const std::vector<float>& ranks, size_t alliances )
+{
+    struct Alliance
+    {
+        float ranksum;
+        size_t index;
+        bool operator < ( const Alliance& other ) const { return ranksum < other.ranksum; }
+    };
+    std::vector<Alliance> sorted( alliances );
+    for ( size_t a = 0; a < alliances; ++a ) {
+        sorted[a].ranksum = 0;
+        sorted[a].index = a;
+    }
+    std::vector<size_t> order( ranks.size() );
+    for ( size_t i = 0; i < order.size(); ++i )
+        order[i] = i;
+    std::sort( order.begin(), order.end(), [&ranks]( size_t a, size_t b ) { return ranks[a] > ranks[b]; } );
+    std::vector<size_t> result( ranks.size() );
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        std::sort( sorted.begin(), sorted.end() );
+        result[order[i]] = sorted[0].index;
+        sorted[0].ranksum += ranks[order[i]];
+    }
+    return result;
+}
+
+struct Result
+{
+    double ns;
+    double spread;
+    Result() : ns( 0 ), spread( 0 ) {}
+};
+
+template < class Balance >
+Result Measure( Balance balance, const std::vector<std::vector<float> >& samples, size_t alliances )
+{
+    Result result;
+    for ( size_t s = 0; s < samples.size(); ++s ) {
+        std::vector<size_t> assignment;
+        result.ns += MeasureNs( [&]() { assignment = balance( samples[s], alliances ); }, 5 );
+        if ( assignment.size() != samples[s].size() )
+            throw TestFailedException( "not every player got an alliance" );
+        for ( size_t i = 0; i < assignment.size(); ++i )
+            if ( assignment[i] >= alliances )
+                throw TestFailedException( "player put into a non existing alliance" );
+        result.spread += LSL::Util::PartitionSpread( samples[s], alliances, assignment );
+    }
+    result.ns /= samples.size();
+    result.spread /= samples.size();
+    return result;
+}
+
+std::vector<size_t> Engine( LSL::Util::PartitionMethod method, const std::vector<float>& ranks, size_t alliances )
+{
+    return LSL::Util::PartitionWeights( ranks, alliances, method );
+}
+
+void Report( const char* name, const Result& result )
+{
+    std::cout << "; " << name << " " << result.ns / 1e3 << " us, spread " << result.spread;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL::Util;
+    using namespace std::placeholders;
+    srand( 4242 );
+
+    for ( size_t a = 0; a < sizeof( ALLIANCE_COUNTS ) / sizeof( ALLIANCE_COUNTS[0] ); ++a ) {
+        const size_t alliances = ALLIANCE_COUNTS[a];
+        for ( size_t p = 0; p < sizeof( PLAYER_COUNTS ) / sizeof( PLAYER_COUNTS[0] ); ++p ) {
+            const size_t players = PLAYER_COUNTS[p];
+            std::vector<std::vector<float> > samples;
+            for ( size_t s = 0; s < SAMPLES; ++s )
+                samples.push_back( RandomRanks( players ) );
+
+            const Result old_result = Measure( OldAutobalance, samples, alliances );
+            const Result greedy = Measure( std::bind( Engine, PARTITION_GREEDY, _1, _2 ), samples, alliances );
+            const Result differencing = Measure( std::bind( Engine, PARTITION_DIFFERENCING, _1, _2 ), samples, alliances );
+            std::cout << players << " players in " << alliances << " alliances";
+            Report( "old", old_result );
+            Report( "greedy", greedy );
+            Report( "differencing", differencing );
+            if ( players <= MAX_EXACT_ITEMS ) {
+                const Result exact = Measure( std::bind( Engine, PARTITION_EXACT, _1, _2 ), samples, alliances );
+                Report( "exact", exact );
+                if ( exact.spread > differencing.spread + 1e-4 || exact.spread > greedy.spread + 1e-4 )
+                    throw TestFailedException( "exact balance is worse than a heuristic" );
+            }
+            std::cout << std::endl;
+            if ( greedy.spread > old_result.spread + 1e-4 )
+                throw TestFailedException( "heap greedy balances worse than the old greedy" );
+            if ( differencing.spread > greedy.spread + 1e-4 )
+                throw TestFailedException( "differencing balances worse than greedy" );
+        }
+    }
+
+    // a clan of 3 is one item, it has to end up in a single alliance with the rest around it
+    std::vector<float> clan( 1, 3.3f );
+    for ( size_t i = 0; i < 5; ++i )
+        clan.push_back( 1.0f );
+    const std::vector<size_t> assignment = PartitionWeights( clan, 2, PARTITION_EXACT );
+    if ( PartitionSpread( clan, 2, assignment ) > 0.31f )
+        throw TestFailedException( "exact balance missed the best split around a clan" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
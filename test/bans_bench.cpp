@@ -0,0 +1,261 @@
+#include <lsl/battle/bans.h>
+#include <lslutils/net.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const size_t NETWORK_RULES = 70000;
+const size_t V6_RULES = 10000;
+const size_t NAME_RULES = 10000;
+const size_t JOINS = 100000;
+//! joins the linear scan reference gets to check, it is far too slow for all of them
+const size_t CHECKED_JOINS = 2000;
+const std::time_t NOW = 1400000000;
+
+struct Rule
+{
+    LSL::Util::Net::Address network;
+    unsigned int length;
+    std::time_t expires;
+};
+
+unsigned int RandomByte() { return unsigned( rand() ) & 0xff; }
+
+std::string RandomV4()
+{
+    return LSL::Util::ToString( RandomByte() ) + "." + LSL::Util::ToString( RandomByte() ) + "."
+         + LSL::Util::ToString( RandomByte() ) + "." + LSL::Util::ToString( RandomByte() );
+}
+
+std::string RandomV6()
+{
+    std::ostringstream out;
+    out << std::hex << "2001:db8:" << ( rand() & 0xff );
+    for ( int i = 0; i < 5; ++i )
+        out << ':' << ( rand() & 0xffff );
+    return out.str();
+}
+
+//! what ban list mirrors look like: mostly single hosts and /24s, a few big ranges
+unsigned int RandomV4Prefix()
+{
+    const int r = rand() % 1000;
+    if ( r < 500 ) return 32;
+    if ( r < 850 ) return 24;
+    if ( r < 999 ) return 16 + rand() % 8;
+    return 8 + rand() % 8;
+}
+
+std::time_t RandomExpiry()
+{
+    // a quarter of the rules are temporary, half of those are over already
+    switch ( rand() % 8 ) {
+        case 0: return NOW - 1 - rand() % 1000;
+        case 1: return NOW + 1 + rand() % 1000;
+        default: return LSL::Battle::BanList::PERMANENT;
+    }
+}
+
+//! what an autohost without CIDR support falls back to: test every rule
+bool LinearMatch( const std::vector<Rule>& rules, const LSL::Util::Net::Address& address, std::time_t now )
+{
+    for ( size_t i = 0; i < rules.size(); ++i )
+        if ( address.CommonBits( rules[i].network ) >= rules[i].length
+             && ( rules[i].expires == LSL::Battle::BanList::PERMANENT || rules[i].expires > now ) )
+            return true;
+    return false;
+}
+
+void CheckParsing()
+{
+    using namespace LSL::Util::Net;
+    Address a, b;
+    unsigned int length;
+    if ( !ParseAddress( "10.1.2.3", a ) || !a.IsV4() || !ParseAddress( "::ffff:10.1.2.3", b ) || !( a == b ) )
+        throw TestFailedException( "IPv4 and IPv4-mapped IPv6 disagree" );
+    if ( !ParseAddress( "2001:db8::1", a ) || a.hi != 0x20010db800000000ULL || a.lo != 1 )
+        throw TestFailedException( "IPv6 with :: parsed wrong" );
+    if ( !ParseAddress( "::", a ) || a.hi != 0 || a.lo != 0 )
+        throw TestFailedException( ":: parsed wrong" );
+    const char* bad[] = { "", "1.2.3", "1.2.3.4.5", "256.1.1.1", "1..2.3", "1:2:3:4:5:6:7:8:9", "1::2::3",
+                          "12345::", "1.2.3.4/33", "::/129", "g::", "1:2:3:4:5:6:7:", "10.0.0.0/",
+                          "0001.2.3.4", "1.2.3.4/0008", "001.2.3.4", "10.010.1.1", "1.2.3.00", "1.2.3.4/08",
+                          "::ffff:10.01.2.3" };
+    for ( size_t i = 0; i < sizeof( bad ) / sizeof( bad[0] ); ++i )
+        if ( ParseNetwork( bad[i], a, length ) )
+            throw TestFailedException( std::string( "accepted " ) + bad[i] );
+    if ( !ParseAddress( "0.0.0.0", a ) || !ParseAddress( "10.0.100.1", b ) || b.lo != 0xffff0a006401ULL )
+        throw TestFailedException( "single zeros and zeros inside octets have to parse" );
+    if ( !ParseNetwork( "10.20.30.40/8", a, length ) || length != V4_MAPPED_BITS + 8
+         || FormatNetwork( a, length ) != "10.0.0.0/8" )
+        throw TestFailedException( "IPv4 network parsed wrong" );
+    if ( !ParseNetwork( "2001:db8::/32", a, length ) || length != 32 || FormatNetwork( a, length ) != "2001:db8:0:0:0:0:0:0/32" )
+        throw TestFailedException( "IPv6 network parsed wrong" );
+}
+
+void CheckRules()
+{
+    using LSL::Battle::BanList;
+    BanList bans;
+    bans.BanNick( "griefer" );
+    bans.BanAccount( "4242", NOW + 10 );
+    bans.BanNetwork( "192.168.0.0/16" );
+    bans.BanNetwork( "192.168.7.7", NOW + 10 );
+    bans.BanNetwork( "2001:db8::/48" );
+    if ( !bans.IsBanned( "griefer", "1", "1.1.1.1", NOW ) || !bans.IsBanned( "x", "4242", "1.1.1.1", NOW )
+         || bans.IsBanned( "x", "4242", "1.1.1.1", NOW + 10 ) )
+        throw TestFailedException( "nick or account rule ignored" );
+    if ( !bans.IsBanned( "x", "1", "192.168.200.1", NOW ) || bans.IsBanned( "x", "1", "192.169.0.1", NOW )
+         || !bans.IsBanned( "x", "1", "2001:db8:0:ffff::1", NOW ) || bans.IsBanned( "x", "1", "2001:db8:1::1", NOW )
+         || bans.IsBanned( "x", "1", "not an ip", NOW ) )
+        throw TestFailedException( "network rule matched wrong" );
+    // the /16 still covers the host whose own rule ran out
+    if ( !bans.Unban( "192.168.0.0/16" ) || bans.IsBanned( "x", "1", "192.168.200.1", NOW )
+         || !bans.IsBanned( "x", "1", "192.168.7.7", NOW ) || bans.IsBanned( "x", "1", "192.168.7.7", NOW + 10 ) )
+        throw TestFailedException( "unban of a network went wrong" );
+    if ( bans.size() != 4 || bans.Expire( NOW + 10 ) != 2 || bans.size() != 2 )
+        throw TestFailedException( "expired rules weren't dropped" );
+
+    // what List writes, Load reads back
+    bans.BanNetwork( "10.0.0.0/8", NOW + 100 );
+    std::ostringstream out;
+    const LSL::StringVector rules = bans.List();
+    for ( size_t i = 0; i < rules.size(); ++i )
+        out << rules[i] << "\n";
+    out << "# comment\n\nip 300.1.1.1\nfoo bar\nnick\n";
+    BanList loaded;
+    size_t errors = 0;
+    std::istringstream in( out.str() );
+    if ( loaded.Load( in, &errors ) != rules.size() || errors != 3 || loaded.List() != rules )
+        throw TestFailedException( "ban list didn't survive a round trip" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    srand( 4242 );
+    CheckParsing();
+    CheckRules();
+
+    // the rule file an autohost mirrors
+    const std::string path = "bans_bench.txt";
+    std::vector<Rule> networks;
+    std::set<std::string> old_ips, old_nicks, old_networks;
+    {
+        std::ofstream file( path.c_str() );
+        for ( size_t i = 0; i < NETWORK_RULES + V6_RULES; ++i ) {
+            const bool v6 = i >= NETWORK_RULES;
+            const std::string host = v6 ? RandomV6() : RandomV4();
+            const unsigned int prefix = v6 ? 32 + rand() % 97 : RandomV4Prefix();
+            Rule rule;
+            rule.expires = RandomExpiry();
+            const std::string text = host + "/" + Util::ToString( prefix );
+            if ( !Util::Net::ParseNetwork( text, rule.network, rule.length ) )
+                throw TestFailedException( "generated network didn't parse: " + text );
+            // banning a range again replaces its expiry, keep the reference free of that
+            if ( !old_networks.insert( Util::Net::FormatNetwork( rule.network, rule.length ) ).second )
+                continue;
+            networks.push_back( rule );
+            old_ips.insert( host );
+            file << "ip " << text;
+            if ( rule.expires != Battle::BanList::PERMANENT )
+                file << " " << rule.expires;
+            file << "\n";
+        }
+        for ( size_t i = 0; i < NAME_RULES; ++i ) {
+            const std::string nick = "banned" + Util::ToString( i );
+            old_nicks.insert( nick );
+            file << "nick " << nick << "\naccount " << 100000 + i << "\n";
+        }
+    }
+
+    Battle::BanList bans;
+    size_t errors = 0, loaded = 0;
+    const double load_ns = MeasureNs( [&]() { bans.Clear(); loaded = bans.LoadFile( path, &errors ); }, 3 );
+    std::remove( path.c_str() );
+    if ( errors != 0 || loaded != networks.size() + 2 * NAME_RULES )
+        throw TestFailedException( "rule file didn't load completely" );
+
+    // joining users: most are random, some come from banned ranges
+    std::vector<std::string> ips;
+    std::vector<Util::Net::Address> addresses;
+    for ( size_t i = 0; i < JOINS; ++i ) {
+        std::string ip = rand() % 10 == 0 ? RandomV6() : RandomV4();
+        if ( rand() % 4 == 0 ) {
+            const Rule& rule = networks[rand() % networks.size()];
+            ip = Util::Net::FormatNetwork( rule.network, 128 );
+        }
+        ips.push_back( ip );
+        Util::Net::Address address;
+        if ( !Util::Net::ParseAddress( ip, address ) )
+            throw TestFailedException( "generated address didn't parse: " + ip );
+        addresses.push_back( address );
+    }
+
+    size_t banned = 0;
+    const double trie_ns = MeasureNs( [&]() {
+        banned = 0;
+        for ( size_t i = 0; i < JOINS; ++i )
+            banned += bans.IsBanned( "player", "1", ips[i], NOW );
+    }, 5 ) / JOINS;
+    size_t old_banned = 0;
+    const double old_ns = MeasureNs( [&]() {
+        old_banned = 0;
+        for ( size_t i = 0; i < JOINS; ++i )
+            old_banned += old_nicks.count( "player" ) + old_ips.count( ips[i] );
+    }, 5 ) / JOINS;
+    StopWatch watch;
+    for ( size_t i = 0; i < CHECKED_JOINS; ++i )
+        if ( LinearMatch( networks, addresses[i], NOW ) != bans.IsAddressBanned( addresses[i], NOW ) )
+            throw TestFailedException( "trie disagrees with a scan of all rules for " + ips[i] );
+    const double linear_ns = watch.ElapsedNs() / CHECKED_JOINS;
+
+    std::cout << loaded << " rules loaded in " << load_ns / 1e6 << " ms; " << JOINS << " joins, " << banned
+              << " banned: trie " << trie_ns << " ns per join, exact sets " << old_ns << " ns (" << old_banned
+              << " banned), scanning every range " << linear_ns / 1e3 << " us" << std::endl;
+
+    // a day later the temporary rules are gone
+    const size_t expired = bans.Expire( NOW + 100000 );
+    for ( size_t i = 0; i < CHECKED_JOINS; ++i )
+        if ( LinearMatch( networks, addresses[i], NOW + 100000 ) != bans.IsAddressBanned( addresses[i], NOW + 100000 ) )
+            throw TestFailedException( "trie disagrees with a scan after expiry for " + ips[i] );
+    std::cout << expired << " rules expired, " << bans.size() << " left" << std::endl;
+    return 0;
+}
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,286 @@
+#include <lsl/networking/iserver.h>
+#include <lsl/battle/battle.h>
+#include <lsl/user/user.h>
+#include <lslutils/conversion.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#define ALLOC_COUNTING
+#include "bench.h"
+
+namespace {
+
+const size_t USER_COUNTS[] = { 16, 64, 256 };
+const size_t ROUNDS = 20;
+//! every eighth user is a bot, every fourth human is in one of a few clans
+const size_t BOT_EVERY = 8;
+const size_t CLAN_EVERY = 4;
+const size_t NUM_CLANS = 6;
+//! users leaving and coming back each round
+const size_t LEAVERS = 4;
+//! a per-user operation may get this much slower per user added before the run fails,
+//! linear growth stays well below it, a rescan of the battle per call doesn't
+const double MAX_PER_USER_GROWTH = 0.5;
+//! floor under the small battle's median, so timer noise on tiny numbers doesn't fail the run
+const double MIN_BASE_NS = 2000;
+
+//! latency samples and allocations of one kind of operation
+class OpStats
+{
+public:
+    OpStats() : m_allocs( 0 ) {}
+
+    template < class Func >
+    void Time( Func func )
+    {
+        const size_t allocs = g_allocs.load();
+        StopWatch watch;
+        func();
+        m_samples.push_back( watch.ElapsedNs() );
+        m_allocs += g_allocs.load() - allocs;
+    }
+
+    //! \param q between 0 and 1
+    double Percentile( double q ) const
+    {
+        if ( m_samples.empty() )
+            return 0;
+        std::vector<double> sorted( m_samples );
+        const size_t index = std::min( sorted.size() - 1, size_t( q * sorted.size() ) );
+        std::nth_element( sorted.begin(), sorted.begin() + index, sorted.end() );
+        return sorted[index];
+    }
+
+    void Report( const std::string& name ) const
+    {
+        std::cout << "  " << std::left << std::setw( 28 ) << name << std::right << std::setw( 7 ) << m_samples.size()
+                  << " calls  p50 " << std::setw( 9 ) << Percentile( 0.5 ) << " ns  p90 " << std::setw( 9 ) << Percentile( 0.9 )
+                  << " ns  p99 " << std::setw( 9 ) << Percentile( 0.99 ) << " ns  max " << std::setw( 9 ) << Percentile( 1 )
+                  << " ns  " << double( m_allocs ) / std::max<size_t>( m_samples.size(), 1 ) << " allocs/call" << std::endl;
+    }
+
+private:
+    std::vector<double> m_samples;
+    size_t m_allocs;
+};
+
+struct Stats
+{
+    OpStats join, status, leave, host_map, host_mod, game_end;
+    OpStats fix_colors, autobalance, fix_team_ids, free_team, free_color;
+    //! my own status, sent to the server and echoed back by it
+    OpStats request_status, ready;
+    //! what the battle sent to the server
+    size_t commands;
+
+    Stats() : commands( 0 ) {}
+
+    void Report() const
+    {
+        std::cout << "  " << commands << " commands sent" << std::endl;
+        join.Report( "OnUserAdded" );
+        status.Report( "OnUserBattleStatusUpdated" );
+        request_status.Report( "OnRequestBattleStatus + echo" );
+        ready.Report( "SetImReady + echo" );
+        leave.Report( "OnUserRemoved" );
+        host_map.Report( "SetHostMap" );
+        host_mod.Report( "SetHostMod" );
+        game_end.Report( "SetInGame (autospec queue)" );
+        free_team.Report( "GetFreeTeam" );
+        free_color.Report( "GetFreeColor" );
+        fix_colors.Report( "FixColors" );
+        autobalance.Report( "Autobalance" );
+        fix_team_ids.Report( "FixTeamIDs" );
+    }
+};
+
+LSL::UserPtr MakeUser( const LSL::IServerPtr& server, size_t i )
+{
+    using namespace LSL;
+    std::string nick = "player" + Util::ToString( i );
+    if ( i % CLAN_EVERY == 0 )
+        nick = "[clan" + Util::ToString( i % NUM_CLANS ) + "]" + nick;
+    const UserPtr user( new User( server, CommonUser::GetNewUserId(), nick, "DE" ) );
+    user->Status().rank = UserStatus::RankContainer( rand() % 8 );
+    if ( i % BOT_EVERY == BOT_EVERY - 1 )
+        user->BattleStatus().aishortname = "bot";
+    return user;
+}
+
+LSL::UserBattleStatus Churn( LSL::UserBattleStatus status )
+{
+    switch ( rand() % 6 ) {
+        case 0: status.ready = !status.ready; break;
+        case 1: status.sync = status.sync ? LSL::SYNC_UNKNOWN : LSL::SYNC_SYNCED; break;
+        case 2: status.spectator = !status.spectator && !status.IsBot(); break;
+        case 3: status.team = rand() % 64; break;
+        case 4: status.color = LSL::lslColor( rand() % 256, rand() % 256, rand() % 256 ); break;
+        default: status.ally = rand() % 16; break;
+    }
+    return status;
+}
+
+void CheckFreeTeam( const LSL::Battle::Battle& battle )
+{
+    const int team = battle.GetFreeTeam();
+    for ( const LSL::CommonUser* user: battle.UsersView() ) {
+        const LSL::UserBattleStatus& status = user->BattleStatus();
+        if ( !status.spectator && status.team == team )
+            throw TestFailedException( "GetFreeTeam handed out a team in use" );
+    }
+}
+
+//! the ready count kept by the battle has to match its users
+void CheckReadyCount( const LSL::Battle::Battle& battle )
+{
+    unsigned int ready = 0;
+    for ( const LSL::CommonUser* user: battle.UsersView() ) {
+        const LSL::UserBattleStatus& status = user->BattleStatus();
+        if ( !status.spectator && !status.IsBot() && status.ready )
+            ready++;
+    }
+    if ( battle.GetNumReadyPlayers() != ready )
+        throw TestFailedException( "the ready count drifted from the users' status" );
+}
+
+/** one hosted battle with \param count users, driven through its public entry points. The server
+ * is never connected, whatever the battle sends goes to a sink that only counts it, and unitsync
+ * has nothing loaded, so it knows no maps or games */
+Stats Run( size_t count )
+{
+    using namespace LSL;
+    const IServerPtr server( new Server() );
+    Stats stats;
+    server->SetCommandSink( [&stats]( const std::string& ) { stats.commands++; } );
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "host", "DE" ) );
+    server->OnLogin( me );
+    const boost::shared_ptr<Battle::Battle> battle( new Battle::Battle( server, 1 ) );
+    battle->SetFounder( me->Nick() );
+    battle->OnUserAdded( me );
+    if ( !battle->IsFounderMe() )
+        throw TestFailedException( "battle isn't hosted by us" );
+
+    std::vector<UserPtr> users;
+    for ( size_t i = 1; i < count; ++i ) {
+        users.push_back( MakeUser( server, i ) );
+        stats.join.Time( [&]() { battle->OnUserAdded( users.back() ); } );
+    }
+
+    for ( size_t round = 0; round < ROUNDS; ++round ) {
+        for ( size_t i = 0; i < users.size(); ++i ) {
+            const UserPtr& user = users[rand() % users.size()];
+            const UserBattleStatus status = Churn( user->BattleStatus() );
+            stats.status.Time( [&]() { battle->OnUserBattleStatusUpdated( user, status ); } );
+        }
+        // the server echoes my status back as CLIENTBATTLESTATUS once it got it
+        stats.request_status.Time( [&]() {
+            battle->OnRequestBattleStatus();
+            battle->OnUserBattleStatusUpdated( me, me->BattleStatus() );
+        } );
+        stats.ready.Time( [&]() {
+            battle->SetImReady( round % 2 == 0 );
+            battle->OnUserBattleStatusUpdated( me, me->BattleStatus() );
+        } );
+        CheckReadyCount( *battle );
+        for ( size_t i = 0; i < LEAVERS; ++i ) {
+            const UserPtr user = users[rand() % users.size()];
+            stats.leave.Time( [&]() { battle->OnUserRemoved( user ); } );
+            if ( battle->GetNumUsers() != count - 1 )
+                throw TestFailedException( "a leaving user stayed in the battle" );
+            stats.join.Time( [&]() { battle->OnUserAdded( user ); } );
+        }
+        const std::string suffix = Util::ToString( round % 3 );
+        stats.host_map.Time( [&]() { battle->SetHostMap( "Map" + suffix, "" ); } );
+        stats.host_mod.Time( [&]() { battle->SetHostMod( "Game-" + suffix, "" ); } );
+        // a game ending queues everybody not ready for the auto spectate timer
+        battle->SetInGame( true );
+        stats.game_end.Time( [&]() { battle->SetInGame( false ); } );
+
+        stats.free_team.Time( [&]() { battle->GetFreeTeam( true ); } );
+        stats.free_color.Time( [&]() { battle->GetFreeColor( users.front() ); } );
+        CheckFreeTeam( *battle );
+        stats.fix_colors.Time( [&]() { battle->FixColors(); } );
+        stats.autobalance.Time( [&]() { battle->Autobalance( Enum::balance_divide, true, true, 2 ); } );
+        stats.fix_team_ids.Time( [&]() { battle->FixTeamIDs( Enum::balance_divide, true, true, 0 ); } );
+    }
+
+    if ( battle->GetNumUsers() != count )
+        throw TestFailedException( "users got lost on the way" );
+    // one who leaves while waiting for the auto spectate timer is let go by the battle
+    UserPtr leaver = MakeUser( server, count );
+    leaver->BattleStatus().aishortname.clear();
+    battle->OnUserAdded( leaver );
+    battle->OnUserRemoved( leaver );
+    if ( !leaver.unique() )
+        throw TestFailedException( "the battle holds on to a user that left" );
+    battle->OnSelfLeftBattle();
+    return stats;
+}
+
+#ifdef NDEBUG
+//! fails if \param op gets slower per call than linear in the user count allows
+void CheckGrowth( const std::string& name, const OpStats& small, size_t small_count, const OpStats& big, size_t big_count )
+{
+    const double base = std::max( small.Percentile( 0.5 ), MIN_BASE_NS );
+    const double limit = base * ( 1 + MAX_PER_USER_GROWTH * double( big_count - small_count ) );
+    if ( big.Percentile( 0.5 ) > limit )
+        throw TestFailedException( name + " got superlinearly slower from " + LSL::Util::ToString( small_count )
+                                   + " to " + LSL::Util::ToString( big_count ) + " users" );
+}
+#endif
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 4242 );
+    std::vector<Stats> results;
+    for ( size_t c = 0; c < sizeof( USER_COUNTS ) / sizeof( USER_COUNTS[0] ); ++c ) {
+        results.push_back( Run( USER_COUNTS[c] ) );
+        std::cout << USER_COUNTS[c] << " users, " << ROUNDS << " rounds of churn:" << std::endl;
+        results.back().Report();
+    }
+#ifndef NDEBUG
+    std::cout << "debug build, the growth limits are only checked in release builds" << std::endl;
+#else
+    // the per user entry points must not walk the whole battle
+    const Stats& small = results.front();
+    const Stats& big = results.back();
+    const size_t small_count = USER_COUNTS[0];
+    const size_t big_count = USER_COUNTS[sizeof( USER_COUNTS ) / sizeof( USER_COUNTS[0] ) - 1];
+    CheckGrowth( "OnUserAdded", small.join, small_count, big.join, big_count );
+    CheckGrowth( "OnUserBattleStatusUpdated", small.status, small_count, big.status, big_count );
+    CheckGrowth( "OnUserRemoved", small.leave, small_count, big.leave, big_count );
+#endif
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,470 @@
+#include <lsl/networking/iserver.h>
+#include <lsl/networking/tasserverdataformats.h>
+#include <lsl/user/user.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace {
+
+const size_t NUM_USERS = 160;
+//! the index of the logged in user, who hosts battles of its own
+const size_t ME = NUM_USERS;
+const size_t MAX_BATTLES = 24;
+const size_t STEPS = 600;
+const char* const MODS[] = { "Zero-K v1.0", "Balanced Annihilation V9.0", "EvolutionRTS" };
+const char* const MAPS[] = { "Comet Catcher Redux", "DeltaSiegeDry", "Tabula-v4" };
+
+using LSL::Battle::BattleQuery;
+using LSL::Util::ToString;
+
+//! what BattleList should know about an open battle, kept next to the server
+struct Expected
+{
+    std::string mod, map;
+    //! indices of the users in it, the host first
+    std::vector<size_t> users;
+    unsigned int maxplayers, spectators;
+    int rank;
+    bool locked, passworded;
+
+    //! like IBattle::GetNumActivePlayers for a battle without bots
+    unsigned int Players() const { return users.size() - spectators; }
+};
+
+typedef std::map<int, Expected>
+    ExpectedMap;
+
+bool Wanted( const Expected& battle, const BattleQuery& query )
+{
+    return ( query.modname.empty() || battle.mod == query.modname )
+        && ( query.mapname.empty() || battle.map == query.mapname )
+        && ( query.locked == BattleQuery::ANY || battle.locked == ( query.locked == BattleQuery::YES ) )
+        && ( query.passworded == BattleQuery::ANY || battle.passworded == ( query.passworded == BattleQuery::YES ) )
+        && ( !query.free_slots || battle.Players() < battle.maxplayers )
+        && battle.Players() >= query.min_players
+        && ( query.max_rankneeded < 0 || battle.rank <= query.max_rankneeded )
+        && ( query.max_spectators < 0 || int( battle.spectators ) <= query.max_spectators );
+}
+
+//! every filter on its own and a few combinations, each then run in every order with and without a limit
+std::vector< std::pair<std::string, BattleQuery> > Queries()
+{
+    std::vector< std::pair<std::string, BattleQuery> > ret;
+    BattleQuery q;
+    ret.push_back( std::make_pair( "everything", q ) );
+    q.modname = MODS[0];
+    ret.push_back( std::make_pair( "mod", q ) );
+    q.mapname = MAPS[1];
+    ret.push_back( std::make_pair( "mod and map", q ) );
+    q = BattleQuery();
+    q.modname = "not hosted anywhere";
+    ret.push_back( std::make_pair( "unknown mod", q ) );
+    q = BattleQuery();
+    q.mapname = MAPS[2];
+    ret.push_back( std::make_pair( "map", q ) );
+    q = BattleQuery();
+    q.locked = BattleQuery::YES;
+    ret.push_back( std::make_pair( "locked", q ) );
+    q.locked = BattleQuery::NO;
+    ret.push_back( std::make_pair( "unlocked", q ) );
+    q = BattleQuery();
+    q.passworded = BattleQuery::YES;
+    ret.push_back( std::make_pair( "passworded", q ) );
+    q.passworded = BattleQuery::NO;
+    ret.push_back( std::make_pair( "no password", q ) );
+    q.locked = BattleQuery::NO;
+    ret.push_back( std::make_pair( "open", q ) );
+    q.modname = MODS[1];
+    q.free_slots = true;
+    ret.push_back( std::make_pair( "open with free slots on a mod", q ) );
+    q = BattleQuery();
+    q.free_slots = true;
+    ret.push_back( std::make_pair( "free slots", q ) );
+    q = BattleQuery();
+    q.min_players = 4;
+    ret.push_back( std::make_pair( "min players", q ) );
+    q = BattleQuery();
+    q.max_rankneeded = 1;
+    ret.push_back( std::make_pair( "rank needed", q ) );
+    q = BattleQuery();
+    q.max_spectators = 1;
+    ret.push_back( std::make_pair( "spectators", q ) );
+    q.min_players = 2;
+    q.mapname = MAPS[0];
+    ret.push_back( std::make_pair( "spectators, min players and map", q ) );
+    q = BattleQuery();
+    q.max_spectators = 0;
+    q.max_rankneeded = 0;
+    ret.push_back( std::make_pair( "no spectators and no rank needed", q ) );
+    return ret;
+}
+
+struct ByPlayers
+{
+    const ExpectedMap& battles;
+    explicit ByPlayers( const ExpectedMap& b ) : battles( b ) {}
+    bool operator () ( int a, int b ) const
+    {
+        const unsigned int pa = battles.find( a )->second.Players(), pb = battles.find( b )->second.Players();
+        return pa < pb || ( pa == pb && a < b );
+    }
+};
+
+//! drives the server through ExecuteCommand and keeps the Expected side in step
+class Lobby
+{
+public:
+    Lobby()
+        : m_server( new LSL::Server() )
+        , m_next_id( 1 )
+        , m_battle_of( NUM_USERS + 1, 0 )
+        , m_checked( 0 )
+    {
+        m_server->SetCommandSink( []( const std::string& ) {} );
+        // BATTLEOPENED asks whether we host, so there has to be a logged in user
+        const LSL::UserPtr me( new LSL::User( m_server, LSL::CommonUser::GetNewUserId(), "me", "DE" ) );
+        m_server->OnLogin( me );
+        for ( size_t i = 0; i <= NUM_USERS; ++i )
+            m_server->ExecuteCommand( "ADDUSER", Nick( i ) + " DE 0 " + ToString( i + 1 ) );
+    }
+
+    void Step()
+    {
+        switch ( rand() % 13 ) {
+            case 0: case 1: Open(); break;
+            case 2: case 3: case 4: case 5: Join(); break;
+            case 6: case 7: Leave(); break;
+            case 8: case 9: case 10: UpdateInfo(); break;
+            case 11: Host(); break;
+            default: Close(); break;
+        }
+    }
+
+    void CloseAll()
+    {
+        while ( !m_battles.empty() )
+            Close();
+    }
+
+    void CheckQueries( const std::string& when )
+    {
+        typedef std::vector< std::pair<std::string, BattleQuery> > QueryVector;
+        const QueryVector queries = Queries();
+        const BattleQuery::SortOrder orders[] = { BattleQuery::SORT_NONE, BattleQuery::SORT_PLAYERS_ASC, BattleQuery::SORT_PLAYERS_DESC };
+        const size_t limits[] = { 0, 3 };
+        for ( QueryVector::const_iterator it = queries.begin(); it != queries.end(); ++it )
+            for ( BattleQuery::SortOrder order: orders )
+                for ( size_t limit: limits ) {
+                    BattleQuery query = it->second;
+                    query.order = order;
+                    query.limit = limit;
+                    Check( query, when + ", " + it->first + " query, order " + ToString( int( order ) )
+                           + ", limit " + ToString( limit ) );
+                }
+    }
+
+    size_t Checked() const { return m_checked; }
+
+private:
+    static std::string Nick( size_t i ) { return i == ME ? "me" : "player" + ToString( i ); }
+
+    //! a random user in no battle, NUM_USERS if there is none
+    size_t FreeUser() const
+    {
+        const size_t start = rand() % NUM_USERS;
+        for ( size_t i = 0; i < NUM_USERS; ++i )
+            if ( !m_battle_of[( start + i ) % NUM_USERS] )
+                return ( start + i ) % NUM_USERS;
+        return NUM_USERS;
+    }
+
+    ExpectedMap::iterator RandomBattle()
+    {
+        ExpectedMap::iterator it = m_battles.begin();
+        std::advance( it, rand() % m_battles.size() );
+        return it;
+    }
+
+    void Open()
+    {
+        const size_t host = FreeUser();
+        if ( m_battles.size() >= MAX_BATTLES || host == NUM_USERS )
+            return;
+        Open( host );
+    }
+
+    int Open( size_t host )
+    {
+        const int id = m_next_id++;
+        Expected& battle = m_battles[id];
+        battle.mod = MODS[rand() % 3];
+        battle.map = MAPS[rand() % 3];
+        battle.users.push_back( host );
+        battle.maxplayers = 2 + rand() % 8;
+        battle.spectators = 0;
+        battle.rank = rand() % 4;
+        battle.locked = false;
+        battle.passworded = rand() % 3 == 0;
+        m_battle_of[host] = id;
+        m_server->ExecuteCommand( "BATTLEOPENED", ToString( id ) + " 0 0 " + Nick( host ) + " 10.0.0.1 8452 "
+                                  + ToString( battle.maxplayers ) + " " + ToString( int( battle.passworded ) ) + " "
+                                  + ToString( battle.rank ) + " 1234 " + battle.map + "\tBattle " + ToString( id ) + "\t" + battle.mod );
+        CheckFounder( id, host );
+        CheckQueries( "battle " + ToString( id ) + " opened" );
+        return id;
+    }
+
+    void Join()
+    {
+        const size_t user = FreeUser();
+        if ( m_battles.empty() || user == NUM_USERS )
+            return;
+        Join( user, RandomBattle() );
+    }
+
+    void Join( size_t user, ExpectedMap::iterator it )
+    {
+        it->second.users.push_back( user );
+        m_battle_of[user] = it->first;
+        m_server->ExecuteCommand( "JOINEDBATTLE", ToString( it->first ) + " " + Nick( user ) + " pw" );
+        CheckQueries( Nick( user ) + " joined battle " + ToString( it->first ) );
+    }
+
+    void Leave()
+    {
+        if ( m_battles.empty() )
+            return;
+        const ExpectedMap::iterator it = RandomBattle();
+        Expected& battle = it->second;
+        // the host stays, and the spectators the server reported have to remain
+        if ( battle.users.size() - 1 <= battle.spectators )
+            return;
+        const size_t pos = 1 + rand() % ( battle.users.size() - 1 );
+        const size_t user = battle.users[pos];
+        battle.users.erase( battle.users.begin() + pos );
+        m_battle_of[user] = 0;
+        m_server->ExecuteCommand( "LEFTBATTLE", ToString( it->first ) + " " + Nick( user ) );
+        CheckQueries( Nick( user ) + " left battle " + ToString( it->first ) );
+    }
+
+    void UpdateInfo()
+    {
+        if ( m_battles.empty() )
+            return;
+        const ExpectedMap::iterator it = RandomBattle();
+        Expected& battle = it->second;
+        battle.spectators = rand() % battle.users.size();
+        battle.locked = rand() % 2;
+        battle.map = MAPS[rand() % 3];
+        m_server->ExecuteCommand( "UPDATEBATTLEINFO", ToString( it->first ) + " " + ToString( battle.spectators ) + " "
+                                  + ToString( int( battle.locked ) ) + " 1234 " + battle.map );
+        CheckQueries( "battle " + ToString( it->first ) + " updated" );
+    }
+
+    //! opens a battle as me and has a player in it spectate and play again
+    void Host()
+    {
+        const size_t player = FreeUser();
+        if ( m_battles.size() >= MAX_BATTLES || m_battle_of[ME] || player == NUM_USERS )
+            return;
+        const int id = Open( ME );
+        m_server->ExecuteCommand( "OPENBATTLE", ToString( id ) );
+        const ExpectedMap::iterator it = m_battles.find( id );
+        Join( player, it );
+        Expected& battle = it->second;
+        battle.spectators = 1;
+        SendBattleStatus( player, true );
+        CheckQueries( Nick( player ) + " spectates in my battle " + ToString( id ) );
+        battle.spectators = 0;
+        SendBattleStatus( player, false );
+        CheckQueries( Nick( player ) + " plays in my battle " + ToString( id ) );
+    }
+
+    void SendBattleStatus( size_t user, bool spectator )
+    {
+        LSL::UserBattleStatus status;
+        status.spectator = spectator;
+        status.sync = LSL::SYNC_SYNCED;
+        LSL::UTASBattleStatus tas;
+        tas.data = 0;
+        tas.tasdata = LSL::ConvTasbattlestatus( status );
+        m_server->ExecuteCommand( "CLIENTBATTLESTATUS", Nick( user ) + " " + ToString( tas.data ) + " 0" );
+    }
+
+    void Close()
+    {
+        if ( m_battles.empty() )
+            return;
+        const ExpectedMap::iterator it = RandomBattle();
+        const int id = it->first;
+        for ( size_t user: it->second.users )
+            m_battle_of[user] = 0;
+        m_battles.erase( it );
+        m_server->ExecuteCommand( "BATTLECLOSED", ToString( id ) );
+        CheckQueries( "battle " + ToString( id ) + " closed" );
+    }
+
+    LSL::BattlePtr Find( int id ) const
+    {
+        for ( const LSL::BattlePtr& battle: m_server->QueryBattles( BattleQuery() ) )
+            if ( battle->GetBattleId() == id )
+                return battle;
+        throw TestFailedException( "battle " + ToString( id ) + " isn't listed" );
+    }
+
+    //! the host is found by nick in the id keyed userlist, and its in-game flag starts the battle
+    void CheckFounder( int id, size_t host )
+    {
+        const LSL::BattlePtr battle = Find( id );
+        const LSL::CommonUserPtr founder = battle->GetFounder();
+        if ( !founder || founder->Nick() != Nick( host ) || !battle->IsFounder( founder ) )
+            throw TestFailedException( "battle " + ToString( id ) + " doesn't know its founder" );
+        m_server->ExecuteCommand( "CLIENTSTATUS", Nick( host ) + " 1" );
+        if ( !battle->InGame() )
+            throw TestFailedException( "battle " + ToString( id ) + " didn't start with its founder" );
+        m_server->ExecuteCommand( "CLIENTSTATUS", Nick( host ) + " 0" );
+        if ( battle->InGame() )
+            throw TestFailedException( "battle " + ToString( id ) + " didn't stop with its founder" );
+        if ( host == ME )
+            return;
+        // a rename keeps the battle's nick index and founder in step
+        m_server->ExecuteCommand( "ADDUSER", "renamed DE 0 " + ToString( host + 1 ) );
+        if ( battle->GetUser( Nick( host ) ) || battle->GetUser( "renamed" ) != founder || battle->GetFounder() != founder )
+            throw TestFailedException( "battle " + ToString( id ) + " lost its founder to a rename" );
+        m_server->ExecuteCommand( "ADDUSER", Nick( host ) + " DE 0 " + ToString( host + 1 ) );
+        if ( battle->GetUser( "renamed" ) || battle->GetFounder() != founder )
+            throw TestFailedException( "battle " + ToString( id ) + " lost its founder to a rename" );
+    }
+
+    void Check( const BattleQuery& query, const std::string& what )
+    {
+        m_checked++;
+        std::vector<int> expected;
+        for ( ExpectedMap::const_iterator it = m_battles.begin(); it != m_battles.end(); ++it )
+            if ( Wanted( it->second, query ) )
+                expected.push_back( it->first );
+        std::sort( expected.begin(), expected.end(), ByPlayers( m_battles ) );
+        if ( query.order == BattleQuery::SORT_PLAYERS_DESC )
+            std::reverse( expected.begin(), expected.end() );
+        const size_t count = query.limit ? std::min( query.limit, expected.size() ) : expected.size();
+
+        std::vector<int> got;
+        for ( const LSL::BattlePtr& battle: m_server->QueryBattles( query ) )
+            got.push_back( battle->GetBattleId() );
+        if ( got.size() != count )
+            throw TestFailedException( what + ": " + ToString( got.size() ) + " results instead of " + ToString( count ) );
+        if ( query.order != BattleQuery::SORT_NONE ) {
+            if ( !std::equal( got.begin(), got.end(), expected.begin() ) )
+                throw TestFailedException( what + ": results are not in player order" );
+            return;
+        }
+        // unsorted only promises which battles, and with a limit any of them
+        for ( int id: got )
+            if ( std::find( expected.begin(), expected.end(), id ) == expected.end() )
+                throw TestFailedException( what + ": battle " + ToString( id ) + " doesn't match" );
+        std::sort( got.begin(), got.end() );
+        if ( std::adjacent_find( got.begin(), got.end() ) != got.end() )
+            throw TestFailedException( what + ": a battle came back twice" );
+    }
+
+    const boost::shared_ptr<LSL::Server> m_server;
+    int m_next_id;
+    ExpectedMap m_battles;
+    //! battle id per user, 0 for none
+    std::vector<int> m_battle_of;
+    size_t m_checked;
+};
+
+/** battle chat comes as SAIDBATTLE and JOINEDBATTLE, and as SAID, JOINED and LEFT naming the battle's
+ * channel __battle__<id>, all of them have to end up in the one channel of the battle */
+void CheckBattleChannel()
+{
+    using namespace LSL;
+    const IServerPtr server( new Server() );
+    server->SetCommandSink( []( const std::string& ) {} );
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "me", "DE" ) );
+    server->OnLogin( me );
+    ChannelPtr said_in;
+    CommonUserPtr said_by;
+    server->sig_ChannelSaid.connect( [&]( const ChannelPtr channel, const CommonUserPtr user, std::string ) {
+        said_in = channel;
+        said_by = user;
+    } );
+    server->ExecuteCommand( "ADDUSER", "me DE 0 1" );
+    for ( size_t i = 0; i < 3; ++i )
+        server->ExecuteCommand( "ADDUSER", "player" + ToString( i ) + " DE 0 " + ToString( i + 2 ) );
+    // we host it, which makes it the battle SAIDBATTLE talks about
+    server->ExecuteCommand( "BATTLEOPENED", "7 0 0 me 10.0.0.1 8452 8 0 0 1234 " + std::string( MAPS[0] ) + "\tChat\t" + MODS[0] );
+    server->ExecuteCommand( "OPENBATTLE", "7" );
+    const LSL::Battle::BattleList::BattleVector battles = server->QueryBattles( BattleQuery() );
+    if ( battles.size() != 1 || !battles[0]->GetChannel() )
+        throw TestFailedException( "the battle got no channel" );
+    const IBattlePtr battle = battles[0];
+    const ChannelPtr channel = battle->GetChannel();
+
+    server->ExecuteCommand( "JOINEDBATTLE", "7 player1 pw" );
+    const CommonUserPtr player1 = battle->GetUser( "player1" );
+    if ( !player1 || !channel->IsMember( player1 ) )
+        throw TestFailedException( "JOINEDBATTLE didn't join the battle channel" );
+    server->ExecuteCommand( "SAIDBATTLE", "player1 hi" );
+    if ( said_in != channel || said_by != player1 )
+        throw TestFailedException( "SAIDBATTLE didn't arrive in the battle channel" );
+
+    said_by.reset();
+    server->ExecuteCommand( "JOINED", "__battle__7 player2" );
+    server->ExecuteCommand( "SAID", "__battle__7 player2 hello" );
+    if ( said_in != channel || !said_by || said_by->Nick() != "player2" )
+        throw TestFailedException( "SAID __battle__7 didn't arrive in the battle channel" );
+    if ( !channel->IsMember( said_by ) )
+        throw TestFailedException( "JOINED __battle__7 didn't join the battle channel" );
+    server->ExecuteCommand( "LEFT", "__battle__7 player2 bye" );
+    if ( channel->IsMember( said_by ) )
+        throw TestFailedException( "LEFT __battle__7 didn't part the battle channel" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 1729 );
+    CheckBattleChannel();
+    Lobby lobby;
+    lobby.CheckQueries( "empty lobby" );
+    for ( size_t i = 0; i < STEPS; ++i )
+        lobby.Step();
+    lobby.CloseAll();
+    std::cout << lobby.Checked() << " battle queries matched a full scan over " << STEPS << " lobby updates" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,105 @@
+#ifndef LSL_TESTS_BENCH_H
+#define LSL_TESTS_BENCH_H
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+//! minimal wall clock helper shared by the *_bench programs
+class StopWatch {
+public:
+    StopWatch() : m_start( std::chrono::steady_clock::now() ) {}
+    void Reset() { m_start = std::chrono::steady_clock::now(); }
+    double ElapsedNs() const
+    {
+        return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - m_start ).count();
+    }
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+//! runs \param func \param iterations times and returns the mean ns per iteration
+template < class Func >
+double MeasureNs( Func func, size_t iterations )
+{
+    StopWatch watch;
+    for ( size_t i = 0; i < iterations; ++i )
+        func();
+    return watch.ElapsedNs() / double( iterations );
+}
+
+inline void ReportNs( const std::string& name, double ns )
+{
+    std::cout << name << ": " << ns << " ns" << std::endl;
+}
+
+#ifdef ALLOC_COUNTING
+/* define ALLOC_COUNTING before including this header to count everything going
+ * through the global operator new; do so in one translation unit per program */
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+//! allocations, requested bytes and live heap bytes (glibc only) since start
+static std::atomic<size_t> g_allocs( 0 );
+static std::atomic<size_t> g_bytes( 0 );
+static std::atomic<size_t> g_live_bytes( 0 );
+
+void* operator new( std::size_t size )
+{
+    void* p = std::malloc( size ? size : 1 );
+    if ( !p )
+        throw std::bad_alloc();
+    g_allocs++;
+    g_bytes += size;
+#if defined(__GLIBC__)
+    g_live_bytes += malloc_usable_size( p );
+#endif
+    return p;
+}
+
+void operator delete( void* p ) noexcept
+{
+    if ( !p )
+        return;
+#if defined(__GLIBC__)
+    g_live_bytes -= malloc_usable_size( p );
+#endif
+    std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept
+{
+    operator delete( p );
+}
+#endif // ALLOC_COUNTING
+
+#endif // LSL_TESTS_BENCH_H
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,174 @@
+#include <lslutils/color.h>
+#include <lslutils/misc.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const size_t TEAM_COUNTS[] = { 16, 64, 256 };
+const size_t FIX_TEAM_COUNTS[] = { 16, 32, 64 };
+const size_t REPEATS = 20;
+
+/** what IBattle::GetFreeColor used to do: grow the fix palette until an unused color shows up.
+ * The fix palette repeats itself, so the original never returned once it ran out of
+ * distinct colors; here it gives up after a while and hands out the first one */
+LSL::lslColor OldFreeColor( const std::vector<LSL::lslColor>& used )
+{
+    using namespace LSL;
+    for ( size_t inc = 1; inc <= 64; ++inc ) {
+        std::vector<lslColor> palette = Util::GetBigFixColorsPalette( used.size() + inc );
+        std::vector<lslColor>::iterator it = palette.begin();
+        for ( ; it != palette.end(); ++it )
+            if ( std::find( used.begin(), used.end(), *it ) == used.end() )
+                return *it;
+    }
+    return Util::GetBigFixColorsPalette( 1 ).front();
+}
+
+//! what it does now, the allocator is rebuilt from the battle's users on every call
+LSL::lslColor NewFreeColor( const std::vector<LSL::lslColor>& used )
+{
+    LSL::Util::ColorAllocator colors;
+    for ( size_t i = 0; i < used.size(); ++i )
+        colors.Take( used[i] );
+    return colors.Next();
+}
+
+//! Battle::FixColors before: greedy, team by team, against the fix palette
+std::vector<LSL::lslColor> OldFixColors( const LSL::lslColor& mine, const std::vector<LSL::lslColor>& current )
+{
+    using namespace LSL;
+    std::vector<lslColor>& palette = Util::GetBigFixColorsPalette( current.size() + 1 );
+    std::vector<int> palette_use( palette.size(), 0 );
+    std::vector<lslColor> result;
+    int difference = 0;
+    lslColor col = mine;
+    for ( size_t i = 0; i <= current.size(); ++i ) {
+        int found = 0;
+        for ( size_t p = 0; p < palette.size(); ++p ) {
+            if ( !palette_use[p] && Util::AreColorsSimilar( palette[p], col, difference ) ) {
+                found = p;
+                break;
+            }
+        }
+        palette_use[found]++;
+        if ( i > 0 )
+            result.push_back( palette[found] );
+        if ( i < current.size() )
+            col = current[i];
+        difference = 60;
+    }
+    return result;
+}
+
+size_t CountChanges( const std::vector<LSL::lslColor>& before, const std::vector<LSL::lslColor>& after )
+{
+    size_t changes = 0;
+    for ( size_t i = 0; i < before.size(); ++i )
+        changes += before[i] != after[i];
+    return changes;
+}
+
+float MinDistance( const std::vector<LSL::lslColor>& colors )
+{
+    float result = 255;
+    for ( size_t i = 0; i < colors.size(); ++i )
+        for ( size_t j = i + 1; j < colors.size(); ++j )
+            result = std::min( result, LSL::Util::ColorDistance( colors[i], colors[j] ) );
+    return result;
+}
+
+//! fills a battle with \param teams players one by one, returns the mean ns per join
+template < class FreeColor >
+double FillBattle( FreeColor free_color, size_t teams, std::vector<LSL::lslColor>& used )
+{
+    StopWatch watch;
+    for ( size_t r = 0; r < REPEATS; ++r ) {
+        used.clear();
+        for ( size_t i = 0; i < teams; ++i )
+            used.push_back( free_color( used ) );
+    }
+    return watch.ElapsedNs() / double( REPEATS * teams );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    // palette construction is a one time cost, keep it out of the timings
+    std::cout << "palette: " << Util::ColorAllocator::Palette().size() << " colors" << std::endl;
+
+    for ( size_t t = 0; t < sizeof( TEAM_COUNTS ) / sizeof( TEAM_COUNTS[0] ); ++t ) {
+        const size_t teams = TEAM_COUNTS[t];
+        std::vector<lslColor> old_colors, new_colors;
+        const double old_ns = FillBattle( OldFreeColor, teams, old_colors );
+        const double new_ns = FillBattle( NewFreeColor, teams, new_colors );
+        const float old_min = MinDistance( old_colors );
+        const float new_min = MinDistance( new_colors );
+        std::cout << teams << " teams: fix palette " << old_ns << " ns per join, closest pair " << old_min
+                  << "; allocator " << new_ns << " ns per join, closest pair " << new_min << std::endl;
+        if ( new_min <= 0 )
+            throw TestFailedException( "allocator handed out the same color twice" );
+        if ( new_min < old_min )
+            throw TestFailedException( "allocator colors are less distinct than the fix palette" );
+    }
+
+    // FixColors on a battle where everybody picked a random color
+    const lslColor mine( 255, 0, 0 );
+    for ( size_t t = 0; t < sizeof( FIX_TEAM_COUNTS ) / sizeof( FIX_TEAM_COUNTS[0] ); ++t ) {
+        const size_t teams = FIX_TEAM_COUNTS[t];
+        std::vector<lslColor> current;
+        for ( size_t i = 0; i < teams; ++i )
+            current.push_back( lslColor( ( i * 97 ) % 256, ( i * 57 + 80 ) % 256, ( i * 23 + 160 ) % 256 ) );
+        std::vector<lslColor> old_fixed, new_fixed;
+        const double old_ns = MeasureNs( [&]() { old_fixed = OldFixColors( mine, current ); }, REPEATS );
+        const double new_ns = MeasureNs( [&]() { new_fixed = Util::AssignTeamColors( mine, current ); }, REPEATS );
+        std::vector<lslColor> with_mine( new_fixed );
+        with_mine.push_back( mine );
+        std::cout << "FixColors " << teams << " teams: greedy " << old_ns / 1e3 << " us, " << CountChanges( current, old_fixed )
+                  << " updates, closest pair " << MinDistance( old_fixed ) << "; assignment " << new_ns / 1e3 << " us, "
+                  << CountChanges( current, new_fixed ) << " updates, closest pair " << MinDistance( with_mine ) << std::endl;
+        if ( MinDistance( with_mine ) <= 0 )
+            throw TestFailedException( "two teams got the same color" );
+        // a second run must not touch anything
+        if ( CountChanges( new_fixed, Util::AssignTeamColors( mine, new_fixed ) ) != 0 )
+            throw TestFailedException( "FixColors changed already fixed colors" );
+        // nor does a team joining move the others
+        std::vector<lslColor> grown( new_fixed );
+        grown.push_back( lslColor( 0, 0, 0 ) );
+        if ( CountChanges( new_fixed, Util::AssignTeamColors( mine, grown ) ) != 0 )
+            throw TestFailedException( "a new team made FixColors recolor existing teams" );
+    }
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,140 @@
+#include <lsl/battle/ibattle.h>
+#include <lsl/networking/iserver.h>
+#include <lsl/user/user.h>
+
+#include "common.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+using namespace LSL;
+
+//! a logged in server that sends nothing anywhere
+IServerPtr MakeServer()
+{
+    const IServerPtr server( new Server() );
+    server->SetCommandSink( []( const std::string& ) {} );
+    server->OnLogin( UserPtr( new User( server, CommonUser::GetNewUserId(), "me", "DE" ) ) );
+    return server;
+}
+
+//! the only battle \param server knows
+IBattlePtr OnlyBattle( const IServerPtr& server )
+{
+    const Battle::BattleList::BattleVector battles = server->QueryBattles( Battle::BattleQuery() );
+    if ( battles.size() != 1 )
+        throw TestFailedException( "expected exactly one battle" );
+    return battles[0];
+}
+
+//! ADDUSER with an account id keys the user by that id, only id 0 gets a made up one
+void CheckUserIds()
+{
+    const IServerPtr server = MakeServer();
+    server->ExecuteCommand( "ADDUSER", "host DE 0 4711" );
+    server->ExecuteCommand( "BATTLEOPENED", "7 0 0 host 10.0.0.1 8452 8 0 0 1234 Map\tTitle\tGame" );
+    const CommonUserPtr host = OnlyBattle( server )->GetUser( "host" );
+    if ( !host || host->Id() != "4711" )
+        throw TestFailedException( "ADDUSER didn't key the user by its account id" );
+}
+
+/** BATTLEOPENED makes the named user the founder, and a battle hosted by
+ * someone the server never sent an ADDUSER for gets no founder **/
+void CheckBattleHost()
+{
+    const IServerPtr server = MakeServer();
+    server->ExecuteCommand( "ADDUSER", "host DE 0 2" );
+    server->ExecuteCommand( "BATTLEOPENED", "7 0 0 host 10.0.0.1 8452 8 0 0 1234 Map\tTitle\tGame" );
+    const IBattlePtr battle = OnlyBattle( server );
+    if ( !battle->GetFounder() || battle->GetFounder()->Nick() != "host" )
+        throw TestFailedException( "BATTLEOPENED didn't set the founder" );
+    if ( battle->GetHostIp() != "10.0.0.1" || battle->GetHostPort() != 8452 )
+        throw TestFailedException( "BATTLEOPENED didn't set the host address" );
+
+    const IServerPtr other = MakeServer();
+    other->ExecuteCommand( "BATTLEOPENED", "8 0 0 stranger 10.0.0.2 8452 8 0 0 1234 Map\tTitle\tGame" );
+    if ( OnlyBattle( other )->GetFounder() )
+        throw TestFailedException( "a battle by an unknown user got a founder" );
+}
+
+//! a Sentence parameter runs up to the next tab, map names have spaces in them
+void CheckSentenceParams()
+{
+    const IServerPtr server = MakeServer();
+    server->ExecuteCommand( "ADDUSER", "host DE 0 2" );
+    server->ExecuteCommand( "BATTLEOPENED", "7 0 0 host 10.0.0.1 8452 8 0 0 1234 Map\tTitle\tGame" );
+    server->ExecuteCommand( "UPDATEBATTLEINFO", "7 0 0 5678 Comet Catcher Redux" );
+    if ( OnlyBattle( server )->GetHostMapName() != "Comet Catcher Redux" )
+        throw TestFailedException( "UPDATEBATTLEINFO cut the map name at the first space" );
+}
+
+//! what \param server prints while running \param cmd, LslError goes to stdout
+std::string Output( const IServerPtr& server, const std::string& cmd, const std::string& params )
+{
+    std::FILE* capture = std::tmpfile();
+    std::fflush( stdout );
+    const int saved = dup( fileno( stdout ) );
+    dup2( fileno( capture ), fileno( stdout ) );
+    server->ExecuteCommand( cmd, params );
+    std::fflush( stdout );
+    dup2( saved, fileno( stdout ) );
+    close( saved );
+    std::string out;
+    std::rewind( capture );
+    for ( int c = std::fgetc( capture ); c != EOF; c = std::fgetc( capture ) )
+        out += char( c );
+    std::fclose( capture );
+    return out;
+}
+
+//! only commands nobody handles are reported as unprocessed
+void CheckUnhandledOnly()
+{
+    const IServerPtr server = MakeServer();
+    const std::string unprocessed = "no way to process command";
+    if ( Output( server, "ADDUSER", "host DE 0 2" ).find( unprocessed ) != std::string::npos )
+        throw TestFailedException( "a handled command was reported as unprocessed" );
+    if ( Output( server, "NOSUCHCOMMAND", "" ).find( unprocessed ) == std::string::npos )
+        throw TestFailedException( "an unknown command wasn't reported" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    CheckUserIds();
+    CheckBattleHost();
+    CheckSentenceParams();
+    CheckUnhandledOnly();
+    std::cout << "command handlers ok" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,158 @@
+#include <lsl/battle/battle.h>
+#include <lsl/container/userlist.h>
+#include <lsl/container/channellist.h>
+#include <lsl/networking/iserver.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <iostream>
+#include <type_traits>
+
+namespace {
+
+// a const list only hands out const items, a mutable one mutable items
+static_assert( std::is_same< decltype( std::declval< const LSL::ChannelList& >().Find( "" ) ),
+                             LSL::ChannelList::ConstPointerType >::value, "const Find hands out a mutable item" );
+static_assert( std::is_same< decltype( std::declval< LSL::ChannelList& >().Find( "" ) ),
+                             LSL::ChannelList::PointerType >::value, "Find hands out a const item" );
+
+const size_t NUM_PLAYERS = 32;
+const size_t ITERATIONS = 2000;
+//! roughly #main on a busy evening
+const size_t NUM_CHANNEL_USERS = 5000;
+
+//! the colors GetFreeColor skips, through the copy Users() hands out
+size_t TakenColorsCopy( const LSL::Battle::IBattle& battle )
+{
+    size_t taken = 0;
+    for ( const auto& user: battle.Users() )
+        taken += !user->BattleStatus().spectator && user->BattleStatus().color.IsOk();
+    return taken;
+}
+
+//! same as above on the non-copying const view, which hands out raw pointers
+size_t TakenColorsView( const LSL::Battle::IBattle& battle )
+{
+    size_t taken = 0;
+    for ( const LSL::CommonUser* user: battle.UsersView() )
+        taken += !user->BattleStatus().spectator && user->BattleStatus().color.IsOk();
+    return taken;
+}
+
+void BenchChannelMembership()
+{
+    using namespace LSL;
+    UserList users;
+    for ( size_t i = 0; i < NUM_CHANNEL_USERS; ++i )
+        users.Add( UserPtr( new User( IServerPtr(), Util::ToString(i), "user" + Util::ToString(i) ) ) );
+    ChannelList channels;
+    const ChannelPtr main( new Channel( "#main" ) );
+    const ChannelPtr newbies( new Channel( "#newbies" ) );
+    channels.Add( main );
+    channels.Add( newbies );
+
+    StopWatch watch;
+    for ( const UserPtr& user: users.Items() ) {
+        channels.Join( main, user );
+        if ( user->DenseIndex() % 3 == 0 )
+            channels.Join( newbies, user );
+    }
+    ReportNs( "channel join, per user", watch.ElapsedNs() / double( NUM_CHANNEL_USERS * 4 / 3 ) );
+
+    size_t members = 0;
+    watch.Reset();
+    for ( const UserPtr& user: users.Items() )
+        members += main->IsMember( user );
+    ReportNs( "channel IsMember, per user", watch.ElapsedNs() / double( NUM_CHANNEL_USERS ) );
+    if ( members != NUM_CHANNEL_USERS || main->Members().size() != NUM_CHANNEL_USERS )
+        throw TestFailedException( "channel membership lost users" );
+
+    watch.Reset();
+    const size_t common = main->Members().IntersectionSize( newbies->Members() );
+    ReportNs( "channel member intersection", watch.ElapsedNs() );
+    if ( common != newbies->Members().size() )
+        throw TestFailedException( "wrong channel intersection" );
+
+    const UserPtr first = users.GetByIndex( 0 );
+    const UserPtr second = users.GetByIndex( 1 );
+    if ( channels.CommonChannels( first, second ).size() != 1 )
+        throw TestFailedException( "wrong common channels" );
+
+    channels.PartAll( first );
+    if ( main->IsMember( first ) || newbies->IsMember( first ) )
+        throw TestFailedException( "PartAll left the user in a channel" );
+
+    for ( const UserPtr& user: users.Items() )
+        channels.Part( main, user );
+    if ( !main->Members().empty() )
+        throw TestFailedException( "channel part left members behind" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    // a battle we host, filled like tasserver does on JOINEDBATTLE, with nothing sent anywhere
+    const IServerPtr server( new Server() );
+    server->SetCommandSink( []( const std::string& ) {} );
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "host", "DE" ) );
+    server->OnLogin( me );
+    const boost::shared_ptr<Battle::Battle> battle( new Battle::Battle( server, 1 ) );
+    battle->SetFounder( me->Nick() );
+    battle->OnUserAdded( me );
+    for ( size_t i = 1; i < NUM_PLAYERS; ++i )
+        battle->OnUserAdded( UserPtr( new User( server, CommonUser::GetNewUserId(), "player" + Util::ToString( i ), "DE" ) ) );
+    const Battle::IBattle& view = *battle;
+
+    size_t sink = 0;
+    const double copy_ns = MeasureNs( [&]() { sink += TakenColorsCopy( view ); }, ITERATIONS );
+    const double view_ns = MeasureNs( [&]() { sink += TakenColorsView( view ); }, ITERATIONS );
+    const double free_color_ns = MeasureNs( [&]() { sink += view.GetFreeColor( me ).Red(); }, ITERATIONS );
+    const double player_num_ns = MeasureNs( [&]() { sink += view.GetPlayerNum( me ); }, ITERATIONS );
+    ReportNs( "32 player battle walk, Users()", copy_ns );
+    ReportNs( "32 player battle walk, UsersView() const", view_ns );
+    ReportNs( "32 player GetFreeColor", free_color_ns );
+    ReportNs( "32 player GetPlayerNum", player_num_ns );
+
+    if ( TakenColorsCopy( view ) != TakenColorsView( view ) )
+        throw TestFailedException( "view and copy disagree" );
+    size_t count = 0;
+    for ( const CommonUser* user: view.UsersView() ) {
+        if ( !battle->GetUser( user->Nick() ) )
+            throw TestFailedException( "view visited a user the battle doesn't know" );
+        ++count;
+    }
+    if ( count != NUM_PLAYERS || view.UsersView().size() != NUM_PLAYERS || sink == 0 )
+        throw TestFailedException( "view size mismatch" );
+
+    BenchChannelMembership();
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
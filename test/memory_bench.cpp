@@ -0,0 +1,165 @@
+#include <lsl/networking/iserver.h>
+#include <lsl/container/snapshot.h>
+#include <lsl/user/user.h>
+#include <lslutils/conversion.h>
+#include <lslutils/stringpool.h>
+
+#include "common.h"
+#define ALLOC_COUNTING
+#include "bench.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <sys/resource.h>
+
+namespace {
+
+const size_t NUM_USERS = 10000;
+const size_t NUM_BATTLES = 1000;
+const size_t NUM_CHANNELS = 500;
+//! players joining each battle besides the founder
+const size_t PLAYERS_PER_BATTLE = 7;
+const size_t USERS_PER_CHANNEL = 40;
+const size_t STATUS_ROUNDS = 5;
+
+//! regression limits, generous on purpose: they catch blowups, not bytes
+const size_t MAX_BYTES_PER_USER = 8 * 1024;
+const size_t MAX_BYTES_PER_BATTLE = 128 * 1024;
+const size_t MAX_BYTES_PER_CHANNEL = 16 * 1024;
+
+std::string Nick( size_t i ) { return "player" + LSL::Util::ToString( i ); }
+
+struct Phase
+{
+    Phase() : bytes( g_live_bytes.load() ), allocs( g_allocs.load() ) {}
+    long Bytes() const { return long( g_live_bytes.load() ) - long( bytes ); }
+    size_t Allocs() const { return g_allocs.load() - allocs; }
+    size_t bytes;
+    size_t allocs;
+};
+
+size_t Report( const std::string& name, const Phase& phase, size_t count )
+{
+    const size_t per_item = phase.Bytes() > 0 ? phase.Bytes() / count : 0;
+    std::cout << name << ": " << phase.Bytes() << " heap bytes, " << per_item << " per item, "
+              << phase.Allocs() << " allocations, " << double( phase.Allocs() ) / count << " per item" << std::endl;
+    return per_item;
+}
+
+void Check( size_t per_item, size_t limit, const std::string& what )
+{
+    if ( per_item > limit )
+        throw TestFailedException( what + " uses " + LSL::Util::ToString( per_item )
+                                   + " bytes, limit is " + LSL::Util::ToString( limit ) );
+}
+
+size_t PeakRssKb()
+{
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return usage.ru_maxrss;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    boost::shared_ptr<Server> server( new Server() );
+    // BATTLEOPENED asks whether we host, so there has to be a logged in user
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "me", "DE" ) );
+    server->OnLogin( me );
+
+    // logins, everything the server sends before LOGININFOEND
+    Phase users;
+    for ( size_t i = 0; i < NUM_USERS; ++i )
+        server->ExecuteCommand( "ADDUSER", Nick( i ) + " DE 0 " + Util::ToString( i + 1 ) );
+    const size_t per_user = Report( "users", users, NUM_USERS );
+
+    Phase battles;
+    for ( size_t b = 0; b < NUM_BATTLES; ++b ) {
+        const std::string id = Util::ToString( b + 1 );
+        server->ExecuteCommand( "BATTLEOPENED", id + " 0 0 " + Nick( b ) + " 10.0.0.1 8452 16 0 0 " + Util::ToString( 1000 + b % 50 )
+                                + " Map" + Util::ToString( b % 50 ) + "\tBattle " + id + "\tGame-" + Util::ToString( b % 5 ) );
+        for ( size_t p = 0; p < PLAYERS_PER_BATTLE; ++p )
+            server->ExecuteCommand( "JOINEDBATTLE", id + " " + Nick( NUM_BATTLES + b * PLAYERS_PER_BATTLE + p ) + " pw" );
+    }
+    const size_t per_battle = Report( "battles (incl. players joining and battle channels)", battles, NUM_BATTLES );
+
+    Phase channels;
+    for ( size_t c = 0; c < NUM_CHANNELS; ++c ) {
+        const std::string name = "chan" + Util::ToString( c );
+        server->ExecuteCommand( "CHANNEL", name + " " + Util::ToString( USERS_PER_CHANNEL ) + " topic of " + name );
+        std::string members;
+        for ( size_t u = 0; u < USERS_PER_CHANNEL; ++u )
+            members += ( u ? " " : "" ) + Nick( ( c * 13 + u * 97 ) % NUM_USERS );
+        server->ExecuteCommand( "CLIENTS", name + " " + members );
+    }
+    const size_t per_channel = Report( "channels", channels, NUM_CHANNELS );
+
+    // steady state churn: status flips, battle info updates, channel joins/parts
+    Phase churn;
+    StopWatch watch;
+    for ( size_t round = 0; round < STATUS_ROUNDS; ++round ) {
+        for ( size_t i = 0; i < NUM_USERS; ++i )
+            server->ExecuteCommand( "CLIENTSTATUS", Nick( i ) + " " + Util::ToString( ( i + round ) % 4 ) );
+        for ( size_t b = 0; b < NUM_BATTLES; ++b )
+            server->ExecuteCommand( "UPDATEBATTLEINFO", Util::ToString( b + 1 ) + " " + Util::ToString( round ) + " 0 "
+                                    + Util::ToString( 1000 + ( b + round ) % 50 ) + " Map" + Util::ToString( ( b + round ) % 50 ) );
+        for ( size_t c = 0; c < NUM_CHANNELS; ++c ) {
+            const std::string name = "chan" + Util::ToString( c );
+            const std::string nick = Nick( ( c * 31 + round ) % NUM_USERS );
+            server->ExecuteCommand( "JOINED", name + " " + nick );
+            server->ExecuteCommand( "LEFT", name + " " + nick + " bye" );
+        }
+        server->TimerUpdate();
+    }
+    std::cout << "churn: " << watch.ElapsedNs() / 1e6 << " ms, " << churn.Allocs() << " allocations, "
+              << churn.Bytes() << " heap bytes retained (incl. published snapshot)" << std::endl;
+
+    LobbySnapshotWriter::Publisher::Reader reader( server->GetSnapshotPublisher() );
+    {
+        LobbySnapshotWriter::Publisher::ReadGuard snapshot( reader );
+        if ( snapshot->users->size() != NUM_USERS )
+            throw TestFailedException( "users missing from the lobby" );
+        if ( snapshot->battles->size() != NUM_BATTLES )
+            throw TestFailedException( "battles missing from the lobby" );
+        if ( snapshot->channels->size() != NUM_BATTLES + NUM_CHANNELS )
+            throw TestFailedException( "channels missing from the lobby" );
+    }
+
+    std::cout << "string pool: " << Util::StringPool::Get().size() << " strings, "
+              << Util::StringPool::Get().MemoryUsage() << " bytes" << std::endl;
+    std::cout << "total: " << g_live_bytes.load() << " heap bytes live, " << g_allocs.load()
+              << " allocations, peak RSS " << PeakRssKb() << " KiB" << std::endl;
+
+    Check( per_user, MAX_BYTES_PER_USER, "a user" );
+    Check( per_battle, MAX_BYTES_PER_BATTLE, "a battle" );
+    Check( per_channel, MAX_BYTES_PER_CHANNEL, "a channel" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
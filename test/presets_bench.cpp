@@ -0,0 +1,204 @@
+#include <lsl/battle/presets.h>
+#include <lsl/battle/restrictions.h>
+#include <lslunitsync/optionswrapper.h>
+#include <lslutils/conversion.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t NUM_PRESETS = 200;
+const size_t NUM_MOD_OPTIONS = 40;
+const size_t NUM_ENGINE_OPTIONS = 12;
+const size_t NUM_MAP_OPTIONS = 8;
+const size_t NUM_RECTS = 16;
+const size_t NUM_RESTRICTIONS = 60;
+const size_t REPEATS = 20;
+
+typedef std::vector<LSL::StringMap> Categories;
+//! what the settings hold: one map per option category of every preset
+typedef std::map<std::string, Categories> Settings;
+
+Categories RandomPreset()
+{
+    using namespace LSL;
+    Categories categories( OptionsWrapper::LastOption );
+    for ( size_t i = 0; i < NUM_MOD_OPTIONS; ++i )
+        categories[OptionsWrapper::ModOption]["modopt" + Util::ToString( i )] = Util::ToString( rand() % 1000 );
+    for ( size_t i = 0; i < NUM_MAP_OPTIONS; ++i )
+        categories[OptionsWrapper::MapOption]["mapopt" + Util::ToString( i )] = Util::ToString( rand() % 10 );
+    for ( size_t i = 0; i < NUM_ENGINE_OPTIONS; ++i )
+        categories[OptionsWrapper::EngineOption]["engineopt" + Util::ToString( i )] = Util::ToString( rand() % 100 );
+    StringMap& opts = categories[OptionsWrapper::PrivateOptions];
+    opts["mapname"] = "map" + Util::ToString( rand() % 50 );
+    for ( size_t r = 0; r < NUM_RECTS; ++r ) {
+        const std::string prefix = "rect_" + Util::ToString( r ) + "_";
+        opts[prefix + "ally"] = Util::ToString( r + 1 );
+        opts[prefix + "left"] = Util::ToString( rand() % 200 );
+        opts[prefix + "top"] = Util::ToString( rand() % 200 );
+        opts[prefix + "right"] = Util::ToString( 200 + rand() % 200 );
+        opts[prefix + "bottom"] = Util::ToString( 200 + rand() % 200 );
+    }
+    opts["numrects"] = Util::ToString( NUM_RECTS );
+    std::string restrictions;
+    for ( size_t i = 0; i < NUM_RESTRICTIONS; ++i )
+        restrictions += "unit" + Util::ToString( rand() % 500 ) + "=" + Util::ToString( rand() % 5 ) + "\t";
+    opts["restrictions"] = restrictions;
+    return categories;
+}
+
+//! FixPresetName before: a case insensitive walk over the list of names
+std::string OldFind( const LSL::StringVector& names, const std::string& name )
+{
+    for ( size_t i = 0; i < names.size(); ++i )
+        if ( boost::algorithm::iequals( names[i], name ) )
+            return names[i];
+    return "";
+}
+
+/** LoadOptionsPreset before, without the battle: a map per category out of the settings,
+ * a key lookup per rect field and the restrictions parsed again. \return a checksum */
+size_t OldParse( const Settings& settings, const std::string& name )
+{
+    using namespace LSL;
+    size_t sum = 0;
+    for ( size_t i = 0; i < size_t( OptionsWrapper::LastOption ); ++i ) {
+        StringMap options = settings.find( name )->second[i];
+        if ( i != size_t( OptionsWrapper::PrivateOptions ) ) {
+            for ( StringMap::const_iterator it = options.begin(); it != options.end(); ++it )
+                sum += it->second.size();
+            continue;
+        }
+        sum += options["mapname"].size();
+        const unsigned int rectcount = Util::FromString<long>( options["numrects"] );
+        for ( unsigned int r = 0; r < rectcount; ++r ) {
+            sum += Util::FromString<long>( options["rect_" + Util::ToString( r ) + "_ally"] );
+            sum += Util::FromString<long>( options["rect_" + Util::ToString( r ) + "_left"] );
+            sum += Util::FromString<long>( options["rect_" + Util::ToString( r ) + "_top"] );
+            sum += Util::FromString<long>( options["rect_" + Util::ToString( r ) + "_right"] );
+            sum += Util::FromString<long>( options["rect_" + Util::ToString( r ) + "_bottom"] );
+        }
+        sum += Battle::UnitRestrictions::ParsePresetString( options["restrictions"] ).size();
+    }
+    return sum;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    using namespace LSL::Battle;
+    srand( 4242 );
+    Settings settings;
+    StringVector names;
+    for ( size_t i = 0; i < NUM_PRESETS; ++i ) {
+        const std::string name = "Preset " + Util::ToString( i );
+        settings[name] = RandomPreset();
+        names.push_back( name );
+    }
+
+    // what the settings hold survives a trip through the typed preset
+    PresetStore store;
+    for ( Settings::const_iterator it = settings.begin(); it != settings.end(); ++it ) {
+        const HostingPreset preset = HostingPreset::FromSettings( it->first, it->second );
+        if ( preset.rects.size() != NUM_RECTS || preset.restrictions.size() != NUM_RESTRICTIONS )
+            throw TestFailedException( "preset lost rects or restrictions" );
+        if ( preset.ToSettings() != it->second )
+            throw TestFailedException( "preset doesn't convert back to the same settings" );
+        store.Put( preset );
+    }
+    if ( store.size() != NUM_PRESETS )
+        throw TestFailedException( "store lost presets" );
+    StringVector sorted( names );
+    std::sort( sorted.begin(), sorted.end() );
+    if ( store.Names() != sorted )
+        throw TestFailedException( "store lists other names than it was given" );
+    const HostingPreset* found = store.Find( "pReSeT 17" );
+    if ( !found || found->name != "Preset 17" )
+        throw TestFailedException( "lookup isn't case insensitive" );
+    if ( store.Find( "Preset 17 " ) )
+        throw TestFailedException( "lookup found a preset that doesn't exist" );
+
+    // snapshot round trip, a corrupt one changes nothing
+    const std::string snapshot = store.Snapshot();
+    PresetStore loaded;
+    if ( !loaded.LoadSnapshot( snapshot ) || loaded.Snapshot().size() != snapshot.size() )
+        throw TestFailedException( "snapshot didn't load" );
+    for ( size_t i = 0; i < names.size(); ++i ) {
+        const HostingPreset* a = store.Find( names[i] );
+        const HostingPreset* b = loaded.Find( names[i] );
+        if ( !b || !( *a == *b ) )
+            throw TestFailedException( "snapshot changed a preset" );
+    }
+    for ( size_t cut = 0; cut < snapshot.size(); cut += 1 + cut / 8 )
+        if ( loaded.LoadSnapshot( snapshot.substr( 0, cut ) ) )
+            throw TestFailedException( "truncated snapshot loaded" );
+    std::string garbage( snapshot );
+    garbage[0] = 'X';
+    if ( loaded.LoadSnapshot( garbage ) || loaded.LoadSnapshot( snapshot + "x" ) || loaded.size() != NUM_PRESETS )
+        throw TestFailedException( "corrupt snapshot loaded or emptied the store" );
+    if ( !loaded.Remove( "PRESET 3" ) || loaded.Find( "Preset 3" ) || loaded.size() != NUM_PRESETS - 1 )
+        throw TestFailedException( "remove by folded name failed" );
+
+    size_t sum = 0;
+    const double old_find = MeasureNs( [&]() { sum += OldFind( names, "pReSeT " + Util::ToString( rand() % NUM_PRESETS ) ).size(); }, REPEATS * 50 );
+    const double new_find = MeasureNs( [&]() { sum += store.Find( "pReSeT " + Util::ToString( rand() % NUM_PRESETS ) )->name.size(); }, REPEATS * 50 );
+    std::cout << NUM_PRESETS << " presets: name lookup scan " << old_find << " ns, hashed " << new_find << " ns" << std::endl;
+
+    const double old_parse = MeasureNs( [&]() { sum += OldParse( settings, names[rand() % NUM_PRESETS] ); }, REPEATS * 10 );
+    const double new_parse = MeasureNs( [&]() {
+        const HostingPreset* preset = store.Find( names[rand() % NUM_PRESETS] );
+        sum += preset->rects.size() + preset->restrictions.size();
+    }, REPEATS * 10 );
+    std::cout << "preset fetch: from settings maps " << old_parse << " ns, typed " << new_parse << " ns" << std::endl;
+
+    const double from_settings = MeasureNs( [&]() {
+        PresetStore fresh;
+        for ( Settings::const_iterator it = settings.begin(); it != settings.end(); ++it )
+            fresh.Put( HostingPreset::FromSettings( it->first, it->second ) );
+        sum += fresh.size();
+    }, REPEATS );
+    const double from_snapshot = MeasureNs( [&]() {
+        PresetStore fresh;
+        fresh.LoadSnapshot( snapshot );
+        sum += fresh.size();
+    }, REPEATS );
+    std::cout << "load all: from settings " << from_settings / 1e3 << " us, from " << snapshot.size()
+              << " byte snapshot " << from_snapshot / 1e3 << " us (" << sum << ")" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
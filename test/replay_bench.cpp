@@ -0,0 +1,100 @@
+#include <lsl/container/userlist.h>
+#include <lsl/container/channellist.h>
+#include <lslutils/conversion.h>
+#include <lslutils/pool.h>
+
+#include "common.h"
+#define ALLOC_COUNTING
+#include "bench.h"
+
+#include <iostream>
+
+namespace {
+
+const size_t NUM_USERS = 2000;
+const size_t ROUNDS = 20;
+
+//! the same churn the server sees on ADDUSER/REMOVEUSER and private channels
+template < class MakeUser, class MakeChannel >
+double Replay( MakeUser make_user, MakeChannel make_channel )
+{
+    using namespace LSL;
+    CommonUserList users;
+    ChannelList channels;
+    StopWatch watch;
+    for ( size_t round = 0; round < ROUNDS; ++round ) {
+        for ( size_t i = 0; i < NUM_USERS; ++i ) {
+            const std::string id = Util::ToString( i );
+            users.Add( make_user( id ) );
+            channels.Add( make_channel( "U" + id ) );
+        }
+        for ( size_t i = 0; i < NUM_USERS; ++i ) {
+            const std::string id = Util::ToString( i );
+            users.Remove( id );
+            channels.Remove( "U" + id );
+        }
+    }
+    return watch.ElapsedNs();
+}
+
+void Report( const std::string& name, double ns, size_t news )
+{
+    std::cout << name << ": " << ( ns / 1e6 ) << " ms, "
+              << news << " operator new calls, "
+              << double( news ) / ( NUM_USERS * ROUNDS ) << " per user login" << std::endl;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+
+    size_t before = g_allocs.load();
+    const double plain_ns = Replay(
+        []( const std::string& id ) { return CommonUserPtr( new CommonUser( id, "user" + id, "DE" ) ); },
+        []( const std::string& name ) { return ChannelPtr( new Channel( name ) ); } );
+    const size_t plain_news = g_allocs.load() - before;
+    Report( "new + shared_ptr", plain_ns, plain_news );
+
+    before = g_allocs.load();
+    const size_t chunks_before = Util::PoolStats::Get().chunks.load();
+    const double pooled_ns = Replay(
+        []( const std::string& id ) { return Util::MakePooled<CommonUser>( id, "user" + id, "DE" ); },
+        []( const std::string& name ) { return Util::MakePooled<Channel>( name ); } );
+    const size_t pooled_news = g_allocs.load() - before;
+    Report( "MakePooled", pooled_ns, pooled_news );
+    std::cout << "pool: " << Util::PoolStats::Get().allocations.load() << " blocks handed out, "
+              << Util::PoolStats::Get().recycled.load() << " recycled, "
+              << ( Util::PoolStats::Get().chunks.load() - chunks_before ) << " chunks allocated" << std::endl;
+
+    // object and control block used to be two allocations each
+    if ( pooled_news + 2 * NUM_USERS * ROUNDS > plain_news )
+        throw TestFailedException( "pooled construction did not save the control block allocations" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,190 @@
+#include <lsl/battle/restrictions.h>
+#include <lslutils/conversion.h>
+#include <lslutils/misc.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t NUM_UNITS = 5000;
+const size_t PRESET_SIZE = 1000;
+const size_t EDITS = 200;
+const size_t REPEATS = 20;
+
+//! what Unitsync::GetUnitsList hands out
+LSL::StringVector UnitsList()
+{
+    LSL::StringVector units;
+    for ( size_t i = 0; i < NUM_UNITS; ++i )
+        units.push_back( "Unit number " + LSL::Util::ToString( i ) + " (unit" + LSL::Util::ToString( i ) + ")" );
+    return units;
+}
+
+std::string Preset( size_t offset )
+{
+    std::string preset;
+    for ( size_t i = 0; i < PRESET_SIZE; ++i )
+        preset += "unit" + LSL::Util::ToString( ( i * 7 + offset ) % NUM_UNITS ) + "=" + LSL::Util::ToString( i % 5 ) + "\t";
+    // a unit the mod doesn't have
+    return preset + "oldunit=3\t";
+}
+
+//! the bytes SendHostInfo( HI_Restrictions ) put on the wire before: everything, every time
+size_t OldSend( const std::map<std::string, int>& units )
+{
+    std::stringstream msg;
+    std::stringstream scriptmsg;
+    for ( std::map<std::string, int>::const_iterator itor = units.begin(); itor != units.end(); ++itor ) {
+        msg << itor->first + " ";
+        scriptmsg << "game/restrict/" + itor->first + "=" + LSL::Util::ToString( itor->second ) + '\t';
+    }
+    return std::string( "ENABLEALLUNITS" ).size() + msg.str().size() + scriptmsg.str().size();
+}
+
+void OldLoadPreset( const std::string& preset, std::map<std::string, int>& units )
+{
+    using namespace LSL::Util;
+    units.clear();
+    const LSL::StringVector infos = StringTokenize( preset, "\t" );
+    for ( const std::string& unitinfo: infos )
+        units[BeforeLast( unitinfo, "=" )] = FromString<long>( AfterLast( unitinfo, "=" ) );
+    // the trailing tab also restricted a unit without a name
+    units.erase( "" );
+}
+
+//! what the new SendHostInfo sends, applied to a client the way Server applies the commands
+size_t Send( LSL::Battle::UnitRestrictions& host, LSL::Battle::UnitRestrictions& client )
+{
+    const LSL::Battle::UnitRestrictions::Changes changes = host.TakeChanges();
+    size_t bytes = 0;
+    if ( changes.all_enabled ) {
+        client.Clear();
+        bytes += std::string( "ENABLEALLUNITS" ).size();
+    }
+    for ( size_t i = 0; i < changes.enabled.size(); ++i ) {
+        client.Unrestrict( changes.enabled[i] );
+        bytes += changes.enabled[i].size() + 1;
+    }
+    for ( size_t i = 0; i < changes.disabled.size(); ++i ) {
+        client.Restrict( changes.disabled[i], 0 );
+        bytes += changes.disabled[i].size() + 1;
+    }
+    for ( size_t i = 0; i < changes.limits.size(); ++i ) {
+        client.Restrict( changes.limits[i].first, changes.limits[i].second );
+        bytes += changes.limits[i].first.size() + 16;
+    }
+    return bytes;
+}
+
+void CheckSame( const LSL::Battle::UnitRestrictions& host, const LSL::Battle::UnitRestrictions& client,
+                const std::map<std::string, int>& old_units )
+{
+    if ( host.ToMap() != old_units )
+        throw TestFailedException( "restriction table disagrees with the old map" );
+    if ( client.ToMap() != old_units )
+        throw TestFailedException( "a client applying the diffs ended up with other restrictions" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using LSL::Battle::UnitRestrictions;
+    srand( 4242 );
+    UnitRestrictions host, client;
+    host.Bind( UnitsList() );
+    std::map<std::string, int> old_units;
+
+    const std::string preset = Preset( 0 );
+    const double old_preset_ns = MeasureNs( [&]() { OldLoadPreset( preset, old_units ); OldSend( old_units ); }, REPEATS );
+    size_t preset_bytes = 0;
+    host.LoadPresetString( preset );
+    preset_bytes = Send( host, client );
+    const double preset_ns = MeasureNs( [&]() { host.LoadPresetString( preset ); Send( host, client ); }, REPEATS );
+    CheckSame( host, client, old_units );
+    if ( host.size() != PRESET_SIZE + 1 || !host.IsRestricted( "oldunit" ) || host.Limit( "unit7" ) != 1 )
+        throw TestFailedException( "preset loaded wrong" );
+    if ( Send( host, client ) != 0 )
+        throw TestFailedException( "reloading the same preset sent something" );
+
+    // a preset that overlaps the current one by half
+    const std::string other = Preset( PRESET_SIZE * 7 / 2 );
+    OldLoadPreset( other, old_units );
+    host.LoadPresetString( other );
+    const size_t switch_bytes = Send( host, client );
+    CheckSame( host, client, old_units );
+
+    // single edits, each sent right away
+    size_t old_bytes = 0, new_bytes = 0;
+    double old_edit_ns = 0, edit_ns = 0;
+    for ( size_t e = 0; e < EDITS; ++e ) {
+        const std::string unit = "unit" + LSL::Util::ToString( rand() % NUM_UNITS );
+        const bool restrict = rand() % 2;
+        const int limit = rand() % 4;
+        StopWatch old_watch;
+        if ( restrict ) old_units[unit] = limit;
+        else old_units.erase( unit );
+        old_bytes += OldSend( old_units );
+        old_edit_ns += old_watch.ElapsedNs();
+        StopWatch watch;
+        if ( restrict ) host.Restrict( unit, limit );
+        else host.Unrestrict( unit );
+        new_bytes += Send( host, client );
+        edit_ns += watch.ElapsedNs();
+    }
+    CheckSame( host, client, old_units );
+
+    // everything off, and a new mod version dropping some units
+    host.Clear();
+    old_units.clear();
+    host.Restrict( "unit1", 2 );
+    old_units["unit1"] = 2;
+    Send( host, client );
+    CheckSame( host, client, old_units );
+    LSL::StringVector smaller = UnitsList();
+    smaller.resize( NUM_UNITS / 2 );
+    host.Restrict( "unit4999", 1 );
+    old_units["unit4999"] = 1;
+    host.Bind( smaller );
+    if ( host.Limit( "unit4999" ) != 1 || Send( host, client ) == 0 )
+        throw TestFailedException( "rebinding lost a restriction of a unit the mod no longer has" );
+    CheckSame( host, client, old_units );
+
+    std::cout << NUM_UNITS << " units, preset of " << PRESET_SIZE << ": old load+send " << old_preset_ns / 1e3 << " us, table "
+              << preset_ns / 1e3 << " us (" << preset_bytes << " bytes first, 0 again, " << switch_bytes << " switching presets)" << std::endl;
+    std::cout << EDITS << " single edits: old " << old_edit_ns / EDITS / 1e3 << " us and " << old_bytes / EDITS
+              << " bytes each, table " << edit_ns / EDITS / 1e3 << " us and " << new_bytes / EDITS << " bytes each" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,283 @@
+#include <lsl/battle/scriptsections.h>
+#include <lsl/battle/tdfcontainer.h>
+#include <lslutils/conversion.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t PLAYER_COUNTS[] = { 16, 32, 64, 128, 250 };
+const size_t REPEATS = 20;
+//! every tenth slot is a bot hosted by the player before it
+const size_t BOT_EVERY = 10;
+
+//! what GetBattleFromScript keeps per team and ally, the same fields as IBattle's containers
+struct TeamInfo
+{
+    bool exist;
+    int AllyTeam, StartPosX, StartPosY, Handicap, SideNum;
+    std::string RGBColor, SideName;
+};
+struct AllyInfo
+{
+    bool exist;
+    int StartRectLeft, StartRectTop, StartRectRight, StartRectBottom;
+};
+
+//! one reconstructed user
+struct Slot
+{
+    std::string name, owner, color;
+    int team, ally, side, rect;
+    bool operator != ( const Slot& o ) const
+    {
+        return name != o.name || owner != o.owner || color != o.color || team != o.team || ally != o.ally
+               || side != o.side || rect != o.rect;
+    }
+};
+
+std::string MakeScript( size_t players )
+{
+    using LSL::Util::ToString;
+    const size_t teams = players - players / 4; // a quarter are spectators
+    const size_t allies = 2 + players / 64;
+    std::ostringstream s;
+    s << "[GAME]\n{\n\tMapName=Some Map v2;\n\tGameType=Some Game v1.2;\n\tNumPlayers=" << players
+      << ";\n\tNumTeams=" << teams << ";\n\tNumAllyTeams=" << allies << ";\n\tHostIP=;\n\tHostPort=8452;\n";
+    s << "\t[modoptions]\n\t{\n\t\tstartmetal=1000;\n\t\tstartenergy=1000;\n\t\tdeathmode=com;\n\t}\n";
+    for ( size_t i = 0; i < players; ++i ) {
+        const bool bot = i % BOT_EVERY == BOT_EVERY - 1;
+        s << "\t[" << ( bot ? "AI" : "PLAYER" ) << i << "]\n\t{\n\t\tName=" << ( bot ? "bot" : "player" ) << i << ";\n";
+        if ( bot )
+            s << "\t\tShortName=KAIK;\n\t\tVersion=0.13;\n\t\tHost=" << i - 1 << ";\n";
+        else
+            s << "\t\tCountryCode=de;\n\t\tRank=" << rand() % 8 << ";\n\t\tSpectator=" << ( i >= teams ) << ";\n";
+        s << "\t\tTeam=" << i % teams << ";\n\t}\n";
+    }
+    for ( size_t t = 0; t < teams; ++t )
+        s << "\t[TEAM" << t << "]\n\t{\n\t\tTeamLeader=" << t << ";\n\t\tAllyTeam=" << t % allies
+          << ";\n\t\tRGBColor=0.1 " << float( t % 10 ) / 10 << " 0.5;\n\t\tSide=" << ( t % 2 ? "CORE" : "ARM" )
+          << ";\n\t\tHandicap=0;\n\t\tStartPosX=" << 100 * t << ";\n\t\tStartPosY=" << 50 * t << ";\n\t}\n";
+    for ( size_t a = 0; a < allies; ++a )
+        s << "\t[ALLYTEAM" << a << "]\n\t{\n\t\tNumAllies=0;\n\t\tStartRectLeft=0." << a << ";\n\t\tStartRectTop=0;\n"
+          << "\t\tStartRectRight=1;\n\t\tStartRectBottom=1;\n\t}\n";
+    s << "}\n";
+    return s.str();
+}
+
+int SideIndex( const std::vector<std::string>& sides, const std::string& name )
+{
+    for ( size_t i = 0; i < sides.size(); ++i )
+        if ( sides[i] == name )
+            return int( i );
+    return -1;
+}
+
+void ReadTeam( const LSL::TDF::PDataList& team, const std::vector<std::string>& sides, TeamInfo& info )
+{
+    info.exist = true;
+    info.StartPosX = team->GetInt( "StartPosX", -1 );
+    info.StartPosY = team->GetInt( "StartPosY", -1 );
+    info.AllyTeam = team->GetInt( "AllyTeam", 0 );
+    info.RGBColor = team->GetString( "RGBColor" );
+    info.SideName = team->GetString( "Side", "" );
+    info.Handicap = team->GetInt( "Handicap", 0 );
+    info.SideNum = SideIndex( sides, info.SideName );
+}
+
+void ReadAlly( const LSL::TDF::PDataList& ally, AllyInfo& info )
+{
+    info.exist = true;
+    info.StartRectLeft = ally->GetInt( "StartRectLeft", 0 );
+    info.StartRectTop = ally->GetInt( "StartRectTop", 0 );
+    info.StartRectRight = ally->GetInt( "StartRectRight", 0 );
+    info.StartRectBottom = ally->GetInt( "StartRectBottom", 0 );
+}
+
+Slot MakeSlot( const LSL::TDF::PDataList& player, const LSL::TDF::PDataList& owner, int team )
+{
+    Slot slot;
+    slot.name = player->GetString( "Name" );
+    slot.owner = owner.ok() ? owner->GetString( "Name" ) : "";
+    slot.team = team;
+    slot.ally = slot.side = slot.rect = -1;
+    return slot;
+}
+
+void ApplyTeam( Slot& slot, const TeamInfo& team, const std::map<int, AllyInfo>& allies )
+{
+    slot.ally = team.AllyTeam;
+    slot.color = team.RGBColor;
+    slot.side = team.SideNum;
+    std::map<int, AllyInfo>::const_iterator ally = allies.find( slot.ally );
+    if ( ally != allies.end() && ally->second.exist )
+        slot.rect = ally->second.StartRectLeft;
+}
+
+//! the loop GetBattleFromScript had: names built and looked up per player, containers copied
+std::vector<Slot> OldReconstruct( const LSL::TDF::PDataList& game, const std::vector<std::string>& sides,
+                                  const std::map<int, TeamInfo>& stored_teams, const std::map<int, AllyInfo>& stored_allies )
+{
+    using namespace LSL;
+    std::vector<Slot> result;
+    std::map<int, TeamInfo> parsed_teams = stored_teams;
+    std::map<int, AllyInfo> parsed_allies = stored_allies;
+    const int playernum = game->GetInt( "NumPlayers", 0 );
+    for ( int i = 0; i < playernum; ++i ) {
+        TDF::PDataList player( game->Find( "PLAYER" + Util::ToString( i ) ) );
+        TDF::PDataList bot( game->Find( "AI" + Util::ToString( i ) ) );
+        if ( !player.ok() && !bot.ok() )
+            continue;
+        if ( bot.ok() ) player = bot;
+        TDF::PDataList owner;
+        if ( bot.ok() )
+            owner = TDF::PDataList( game->Find( "PLAYER" + Util::ToString( bot->GetInt( "Host" ) ) ) );
+        Slot slot = MakeSlot( player, owner, player->GetInt( "Team" ) );
+        TeamInfo teaminfos = parsed_teams[slot.team];
+        if ( !teaminfos.exist ) {
+            TDF::PDataList team( game->Find( "TEAM" + Util::ToString( slot.team ) ) );
+            if ( team.ok() ) {
+                ReadTeam( team, sides, teaminfos );
+                parsed_teams[slot.team] = teaminfos;
+            }
+        }
+        if ( teaminfos.exist ) {
+            AllyInfo allyinfos = parsed_allies[teaminfos.AllyTeam];
+            if ( !allyinfos.exist ) {
+                TDF::PDataList ally( game->Find( "ALLYTEAM" + Util::ToString( teaminfos.AllyTeam ) ) );
+                if ( ally.ok() ) {
+                    ReadAlly( ally, allyinfos );
+                    parsed_allies[teaminfos.AllyTeam] = allyinfos;
+                }
+            }
+            ApplyTeam( slot, teaminfos, parsed_allies );
+        }
+        result.push_back( slot );
+    }
+    return result;
+}
+
+//! what it does now: one walk sorts the sections, the containers are filled in place
+std::vector<Slot> NewReconstruct( const LSL::TDF::PDataList& game, const std::vector<std::string>& sides,
+                                  std::map<int, TeamInfo>& parsed_teams, std::map<int, AllyInfo>& parsed_allies )
+{
+    using namespace LSL;
+    std::vector<Slot> result;
+    const int playernum = game->GetInt( "NumPlayers", 0 );
+    result.reserve( std::max( playernum, 0 ) );
+    const Battle::ScriptSections sections( game, std::max( playernum, 0 ), game->GetInt( "NumTeams", 0 ),
+                                           game->GetInt( "NumAllyTeams", 0 ) );
+    for ( int i = 0; i < playernum; ++i ) {
+        const TDF::PDataList bot( sections.Bot( i ) );
+        const TDF::PDataList player( bot.ok() ? bot : sections.Player( i ) );
+        if ( !player.ok() )
+            continue;
+        Slot slot = MakeSlot( player, bot.ok() ? sections.Player( bot->GetInt( "Host" ) ) : TDF::PDataList(),
+                              player->GetInt( "Team" ) );
+        TeamInfo& teaminfos = parsed_teams[slot.team];
+        if ( !teaminfos.exist ) {
+            const TDF::PDataList team( sections.Team( slot.team ) );
+            if ( team.ok() )
+                ReadTeam( team, sides, teaminfos );
+        }
+        if ( teaminfos.exist ) {
+            AllyInfo& allyinfos = parsed_allies[teaminfos.AllyTeam];
+            if ( !allyinfos.exist ) {
+                const TDF::PDataList ally( sections.Ally( teaminfos.AllyTeam ) );
+                if ( ally.ok() )
+                    ReadAlly( ally, allyinfos );
+            }
+            ApplyTeam( slot, teaminfos, parsed_allies );
+        }
+        result.push_back( slot );
+    }
+    return result;
+}
+
+void CheckIndex()
+{
+    using LSL::Battle::ScriptSections;
+    if ( ScriptSections::Index( "PLAYER12", "PLAYER" ) != 12 || ScriptSections::Index( "player0", "PLAYER" ) != 0
+         || ScriptSections::Index( "AllyTeam3", "ALLYTEAM" ) != 3 || ScriptSections::Index( "ALLYTEAM3", "AI" ) != -1
+         || ScriptSections::Index( "PLAYER", "PLAYER" ) != -1 || ScriptSections::Index( "PLAYER01", "PLAYER" ) != -1
+         || ScriptSections::Index( "PLAYER1x", "PLAYER" ) != -1 || ScriptSections::Index( "TEAM99999999999", "TEAM" ) != -1 )
+        throw TestFailedException( "section names classified wrong" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    srand( 4242 );
+    CheckIndex();
+    std::vector<std::string> sides;
+    sides.push_back( "ARM" );
+    sides.push_back( "CORE" );
+    for ( size_t p = 0; p < sizeof( PLAYER_COUNTS ) / sizeof( PLAYER_COUNTS[0] ); ++p ) {
+        const size_t players = PLAYER_COUNTS[p];
+        const std::string text = MakeScript( players );
+        TDF::PDataList game;
+        const double parse_ns = MeasureNs( [&]() {
+            TDF::PDataList script( TDF::ParseTDF( text ) );
+            game = TDF::PDataList( script->Find( "GAME" ) );
+        }, REPEATS );
+        if ( !game.ok() )
+            throw TestFailedException( "generated script didn't parse" );
+
+        // a replay browser keeps the containers of the last replay around
+        std::map<int, TeamInfo> stored_teams;
+        std::map<int, AllyInfo> stored_allies;
+        for ( int t = 0; t < 256; ++t ) {
+            TeamInfo team = TeamInfo();
+            stored_teams[t + 1000] = team;
+        }
+        std::vector<Slot> old_slots, new_slots;
+        const double old_ns = MeasureNs( [&]() { old_slots = OldReconstruct( game, sides, stored_teams, stored_allies ); }, REPEATS );
+        const double new_ns = MeasureNs( [&]() {
+            std::map<int, TeamInfo> teams( stored_teams );
+            std::map<int, AllyInfo> allies( stored_allies );
+            new_slots = NewReconstruct( game, sides, teams, allies );
+        }, REPEATS );
+        if ( old_slots.size() != players || new_slots.size() != old_slots.size() )
+            throw TestFailedException( "not every player was reconstructed" );
+        for ( size_t i = 0; i < old_slots.size(); ++i )
+            if ( old_slots[i] != new_slots[i] )
+                throw TestFailedException( "single pass reconstructed " + new_slots[i].name + " differently" );
+        std::cout << players << " players: parsing " << parse_ns / 1e3 << " us; lookups " << old_ns / 1e3
+                  << " us, single pass " << new_ns / 1e3 << " us" << std::endl;
+    }
+    return 0;
+}
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,222 @@
+#include <lsl/battle/ibattle.h>
+#include <lsl/battle/scripttags.h>
+#include <lsl/networking/iserver.h>
+#include <lsl/networking/tasserverdataformats.h>
+#include <lsl/user/user.h>
+#include <lslutils/conversion.h>
+#include <lslutils/misc.h>
+#include <lslutils/stringpool.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t NUM_MODOPTIONS = 500;
+const size_t NUM_TEAMS = 16;
+const size_t NUM_RESTRICTIONS = 20;
+const size_t REPEATS = 50;
+
+//! a SETSCRIPTTAGS line as a host with a big game sends it on join
+std::string ModoptionLine()
+{
+    using LSL::Util::ToString;
+    std::string line;
+    for ( size_t i = 0; i < NUM_MODOPTIONS; ++i )
+        line += "game/modoptions/Option" + ToString( i ) + "=" + ToString( i * 7 ) + "\t";
+    for ( size_t i = 0; i < NUM_TEAMS; ++i ) {
+        line += "game/team" + ToString( i ) + "/StartPosX=" + ToString( i * 100 ) + "\t";
+        line += "game/team" + ToString( i ) + "/StartPosY=" + ToString( i * 50 ) + "\t";
+    }
+    for ( size_t i = 0; i < NUM_RESTRICTIONS; ++i )
+        line += "game/restrict/Unit" + ToString( i ) + "=0\t";
+    line += "game/mapoptions/metal=2\tgame/startpostype=2";
+    return line;
+}
+
+struct Routed
+{
+    size_t forwarded, startpos, restrict;
+    Routed() : forwarded( 0 ), startpos( 0 ), restrict( 0 ) {}
+    size_t total() const { return forwarded + startpos + restrict; }
+};
+
+//! ServerImpl::OnSetBattleInfo and OnSetBattleOption before, minus the callbacks
+void OldIngest( const std::string& infos, std::map<std::string, std::string>& tags, Routed& routed )
+{
+    using namespace LSL::Util;
+    for ( const std::string& command: StringTokenize( infos, "\t", boost::algorithm::token_compress_on ) ) {
+        std::string key = boost::algorithm::to_lower_copy( BeforeFirst( command, "=" ) );
+        const std::string value = AfterFirst( command, "=" );
+        tags[key] = value;
+        if ( key.substr( 0, 5 ) == "game/" ) {
+            key = AfterFirst( key, "/" );
+            if ( key.substr( 0, 8 ) == "restrict" )
+                routed.restrict += FromString<int>( value ) == 0;
+            else if ( key.substr( 0, 4 ) == "team" && key.find( "startpos" ) != std::string::npos )
+                routed.startpos += FromString<int>( BeforeFirst( key, "/" ).substr( 4, std::string::npos ) ) >= 0;
+        }
+        else
+            routed.forwarded++;
+    }
+}
+
+void CountForwarded( Routed* routed, const LSL::Battle::ScriptTags::Segment*, size_t, const std::string& )
+{
+    routed->forwarded++;
+}
+
+void CountGame( Routed* routed, const LSL::Battle::ScriptTags::Segment* key, size_t count, const std::string& )
+{
+    if ( count >= 2 && LSL::Battle::ScriptTags::Name( key[0] ).compare( 0, 4, "team" ) == 0 )
+        routed->startpos++;
+}
+
+void CountRestrict( Routed* routed, const LSL::Battle::ScriptTags::Segment*, size_t, const std::string& )
+{
+    routed->restrict++;
+}
+
+struct Collect
+{
+    std::map<std::string, std::string>* tags;
+    void operator()( const std::string& key, const std::string& value ) const { ( *tags )[key] = value; }
+};
+
+/** start positions from SETSCRIPTTAGS go to the players of the team in the battle we are in,
+ * a spectator keeps its position even if its team number matches */
+void StartPositions()
+{
+    using namespace LSL;
+    using Util::ToString;
+    const IServerPtr server( new Server() );
+    server->SetCommandSink( []( const std::string& ) {} );
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "me", "DE" ) );
+    server->OnLogin( me );
+    server->ExecuteCommand( "ADDUSER", "me DE 0 1" );
+    server->ExecuteCommand( "ADDUSER", "player DE 0 2" );
+    server->ExecuteCommand( "ADDUSER", "spectator DE 0 3" );
+    server->ExecuteCommand( "BATTLEOPENED", "7 0 0 me 10.0.0.1 8452 8 0 0 1234 Map\tStart positions\tGame" );
+    server->ExecuteCommand( "OPENBATTLE", "7" );
+    server->ExecuteCommand( "JOINEDBATTLE", "7 player pw" );
+    server->ExecuteCommand( "JOINEDBATTLE", "7 spectator pw" );
+    const IBattlePtr battle = server->GetCurrentBattle();
+    if ( !battle )
+        throw TestFailedException( "hosting didn't make the battle current" );
+    const char* const nicks[] = { "player", "spectator" };
+    for ( size_t i = 0; i < 2; ++i ) {
+        UserBattleStatus status;
+        status.team = 3;
+        status.spectator = i == 1;
+        UTASBattleStatus tas;
+        tas.data = 0;
+        tas.tasdata = ConvTasbattlestatus( status );
+        server->ExecuteCommand( "CLIENTBATTLESTATUS", std::string( nicks[i] ) + " " + ToString( tas.data ) + " 0" );
+    }
+    const CommonUserPtr player = battle->GetUser( "player" );
+    const CommonUserPtr spectator = battle->GetUser( "spectator" );
+    if ( !player || !spectator || spectator->BattleStatus().team != 3 || !spectator->BattleStatus().spectator )
+        throw TestFailedException( "the battle statuses didn't arrive" );
+    const UserPosition before = spectator->BattleStatus().pos;
+    server->ExecuteCommand( "SETSCRIPTTAGS", "game/team3/startposx=120\tgame/team3/startposy=340" );
+    if ( player->BattleStatus().pos.x != 120 || player->BattleStatus().pos.y != 340 )
+        throw TestFailedException( "a player didn't get the start position of its team" );
+    if ( spectator->BattleStatus().pos.x != before.x || spectator->BattleStatus().pos.y != before.y )
+        throw TestFailedException( "a spectator got a start position" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using LSL::Battle::ScriptTags;
+    const std::string line = ModoptionLine();
+
+    std::map<std::string, std::string> old_tags;
+    Routed old_routed;
+    const double old_ns = MeasureNs( [&]() { old_routed = Routed(); OldIngest( line, old_tags, old_routed ); }, REPEATS );
+
+    Routed routed;
+    ScriptTags::Router router;
+    router.Add( "", boost::bind( CountForwarded, &routed, _1, _2, _3 ) );
+    router.Add( "game", boost::bind( CountGame, &routed, _1, _2, _3 ) );
+    router.Add( "game/restrict", boost::bind( CountRestrict, &routed, _1, _2, _3 ) );
+    ScriptTags tags;
+    const size_t pooled = LSL::Util::StringPool::Get().size();
+    size_t ingested = 0;
+    const double first_ns = MeasureNs( [&]() { ingested = tags.Ingest( line, &router ); }, 1 );
+    const double new_ns = MeasureNs( [&]() { routed = Routed(); tags.Ingest( line, &router ); }, REPEATS );
+
+    if ( LSL::Util::StringPool::Get().size() != pooled )
+        throw TestFailedException( "script tag keys went to the process wide string pool" );
+    if ( tags.size() != old_tags.size() || ingested != old_tags.size() )
+        throw TestFailedException( "trie and map disagree on the number of tags" );
+    for ( std::map<std::string, std::string>::const_iterator it = old_tags.begin(); it != old_tags.end(); ++it )
+        if ( !tags.Has( it->first ) || tags.Get( it->first ) != it->second )
+            throw TestFailedException( "trie lost or changed a tag" );
+    if ( !tags.Has( "GAME/ModOptions/option7" ) || tags.Has( "game/modoptions" ) || tags.Has( "game/nosuchoption" ) )
+        throw TestFailedException( "trie lookups are not case insensitive key matches" );
+    if ( routed.forwarded != old_routed.forwarded || routed.startpos != old_routed.startpos
+         || routed.restrict != old_routed.restrict )
+        throw TestFailedException( "trie routed tags differently" );
+
+    // script generation walks one section
+    std::map<std::string, std::string> modoptions;
+    Collect collect = { &modoptions };
+    size_t old_section = 0;
+    const std::string prefix = "game/modoptions/";
+    const double old_walk_ns = MeasureNs( [&]() {
+        old_section = 0;
+        for ( std::map<std::string, std::string>::const_iterator it = old_tags.lower_bound( prefix );
+              it != old_tags.end() && it->first.compare( 0, prefix.size(), prefix ) == 0; ++it )
+            old_section += it->first.substr( prefix.size() ).size() + it->second.size();
+    }, REPEATS );
+    size_t section = 0;
+    const double walk_ns = MeasureNs( [&]() {
+        section = 0;
+        tags.ForEach( "game/modoptions", [&section]( const std::string& key, const std::string& value ) { section += key.size() + value.size(); } );
+    }, REPEATS );
+    tags.ForEach( "game/modoptions", collect );
+    if ( modoptions.size() != NUM_MODOPTIONS || section != old_section || modoptions["option499"] != "3493" )
+        throw TestFailedException( "modoptions subtree walk is incomplete" );
+
+    std::cout << ingested << " tags, " << routed.total() << " routed: tokenize+map " << old_ns / 1e3
+              << " us; trie first ingest " << first_ns / 1e3 << " us, again " << new_ns / 1e3 << " us" << std::endl;
+    std::cout << NUM_MODOPTIONS << " modoptions section walk: map prefix scan " << old_walk_ns / 1e3
+              << " us, trie subtree " << walk_ns / 1e3 << " us" << std::endl;
+    StartPositions();
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
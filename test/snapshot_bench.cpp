@@ -0,0 +1,132 @@
+#include <lsl/container/snapshot.h>
+#include <lsl/user/common.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const size_t NUM_USERS = 10000;
+//! users announced per network tick during the flood
+const size_t USERS_PER_TICK = 50;
+
+std::atomic<bool> g_running;
+std::atomic<bool> g_failed;
+
+struct ReaderTask
+{
+    LSL::LobbySnapshotWriter::Publisher* publisher;
+    unsigned long ops;
+
+    void operator()()
+    {
+        LSL::LobbySnapshotWriter::Publisher::Reader reader( *publisher );
+        unsigned long seen_generation = 0;
+        size_t probe = 0;
+        while ( g_running.load( std::memory_order_relaxed ) ) {
+            LSL::LobbySnapshotWriter::Publisher::ReadGuard snapshot( reader );
+            if ( snapshot->generation < seen_generation )
+                g_failed.store( true );
+            seen_generation = snapshot->generation;
+            // a typical stats exporter query: look up one user and touch the totals
+            const LSL::LobbySnapshot::UserTable::ItemPtr user = snapshot->users->Find( LSL::Util::ToString( probe++ % NUM_USERS ) );
+            if ( user && user->id.empty() )
+                g_failed.store( true );
+            if ( snapshot->users->size() > NUM_USERS )
+                g_failed.store( true );
+            ++ops;
+        }
+    }
+};
+
+//! replays a login flood: ADDUSER for every user, published in ticks
+double ReplayLoginFlood( LSL::LobbySnapshotWriter& writer, std::vector<LSL::CommonUserPtr>& users )
+{
+    StopWatch watch;
+    for ( size_t i = 0; i < users.size(); ++i ) {
+        writer.UserChanged( users[i] );
+        if ( i % USERS_PER_TICK == USERS_PER_TICK - 1 )
+            writer.Publish();
+    }
+    writer.Publish();
+    // and everybody leaves again, so the next round floods the same ids
+    for ( size_t i = 0; i < users.size(); ++i ) {
+        writer.UserRemoved( users[i]->Id() );
+        if ( i % USERS_PER_TICK == USERS_PER_TICK - 1 )
+            writer.Publish();
+    }
+    writer.Publish();
+    return watch.ElapsedNs();
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    std::vector<CommonUserPtr> users;
+    for ( size_t i = 0; i < NUM_USERS; ++i )
+        users.push_back( CommonUserPtr( new CommonUser( Util::ToString(i), "user" + Util::ToString(i), "DE" ) ) );
+
+    unsigned int max_readers = boost::thread::hardware_concurrency();
+    if ( max_readers < 2 )
+        max_readers = 2;
+    g_failed.store( false );
+    for ( unsigned int num_readers = 1; num_readers <= max_readers; num_readers *= 2 ) {
+        LobbySnapshotWriter writer;
+        std::vector<ReaderTask> tasks( num_readers );
+        boost::thread_group readers;
+        g_running.store( true );
+        for ( size_t i = 0; i < tasks.size(); ++i ) {
+            tasks[i].publisher = &writer.GetPublisher();
+            tasks[i].ops = 0;
+            readers.create_thread( boost::ref( tasks[i] ) );
+        }
+        StopWatch watch;
+        const double writer_ns = ReplayLoginFlood( writer, users );
+        g_running.store( false );
+        readers.join_all();
+        const double elapsed_s = watch.ElapsedNs() / 1e9;
+
+        unsigned long total = 0;
+        for ( size_t i = 0; i < tasks.size(); ++i )
+            total += tasks[i].ops;
+        std::cout << num_readers << " readers: " << ( total / elapsed_s ) << " snapshot reads/s, "
+                  << "writer " << ( writer_ns / 1e6 ) << " ms for " << 2 * NUM_USERS << " updates, "
+                  << writer.GetPublisher().PendingReclaims() << " snapshots pending reclaim" << std::endl;
+    }
+    if ( g_failed.load() )
+        throw TestFailedException( "reader observed an inconsistent snapshot" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
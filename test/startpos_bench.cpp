@@ -0,0 +1,214 @@
+#include <lsl/battle/ibattle.h>
+#include <lsl/user/common.h>
+#include <lslutils/conversion.h>
+#include <lslutils/misc.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const int NUM_TEAMS = 64;
+//! players sharing each control team
+const size_t TEAM_SIZE = 3;
+const size_t NUM_SPECTATORS = 32;
+const size_t REPEATS = 50;
+
+//! the parts of a hosted battle the membership index needs, without a server behind it
+class TagBattle : public LSL::Battle::IBattle
+{
+public:
+    TagBattle() { m_opts.founder = "host"; }
+
+    void Join( const LSL::CommonUserPtr user )
+    {
+        // OnUserAdded asks IsFounderMe, the first one to join is the host
+        if ( !m_me )
+            m_me = user;
+        m_userlist.Add( user );
+        OnUserAdded( user );
+    }
+
+    const LSL::CommonUserPtr GetMe() { return m_me; }
+    const LSL::ConstCommonUserPtr GetMe() const { return m_me; }
+    void SetChannel( const LSL::ChannelPtr channel ) { m_channel = channel; }
+    const LSL::ChannelPtr GetChannel() { return m_channel; }
+    void StartSpring() {}
+
+private:
+    LSL::CommonUserPtr m_me;
+    LSL::ChannelPtr m_channel;
+};
+
+typedef std::vector< std::pair<std::string, std::string> > Tags;
+
+//! game/teamN/startposx and startposy for every team, as the host sends them before a start
+Tags StartPosTags( int salt )
+{
+    Tags tags;
+    for ( int team = 0; team < NUM_TEAMS; ++team ) {
+        const std::string prefix = "game/team" + LSL::Util::ToString( team ) + "/";
+        tags.push_back( std::make_pair( prefix + "startposx", LSL::Util::ToString( team * 100 + salt ) ) );
+        tags.push_back( std::make_pair( prefix + "startposy", LSL::Util::ToString( team * 50 + salt ) ) );
+    }
+    return tags;
+}
+
+//! the team and axis of a game/teamN/startposx or startposy key
+bool ParseKey( const std::string& full_key, int& team, bool& is_x )
+{
+    using namespace LSL::Util;
+    const std::string key = AfterFirst( full_key, "/" );
+    if ( key.substr( 0, 4 ) != "team" || key.find( "startpos" ) == std::string::npos )
+        return false;
+    team = FromString<int>( BeforeFirst( key, "/" ).substr( 4, std::string::npos ) );
+    is_x = key.find( "startposx" ) != std::string::npos;
+    return true;
+}
+
+//! startpos tags before: every tag walked the whole userlist
+size_t ApplyScanning( TagBattle& battle, const Tags& tags )
+{
+    size_t updates = 0;
+    for ( size_t i = 0; i < tags.size(); ++i ) {
+        int team;
+        bool is_x;
+        if ( !ParseKey( tags[i].first, team, is_x ) )
+            continue;
+        for ( const LSL::CommonUserPtr& player: battle.UsersView() ) {
+            LSL::UserBattleStatus& status = player->BattleStatus();
+            if ( status.team != team )
+                continue;
+            if ( is_x ) status.pos.x = LSL::Util::FromString<int>( tags[i].second );
+            else status.pos.y = LSL::Util::FromString<int>( tags[i].second );
+            updates++;
+        }
+    }
+    return updates;
+}
+
+//! and now: only the members of the team
+size_t ApplyIndexed( TagBattle& battle, const Tags& tags )
+{
+    size_t updates = 0;
+    for ( size_t i = 0; i < tags.size(); ++i ) {
+        int team;
+        bool is_x;
+        if ( !ParseKey( tags[i].first, team, is_x ) )
+            continue;
+        const int coord = LSL::Util::FromString<int>( tags[i].second );
+        for ( const LSL::CommonUserPtr& player: battle.GetTeamMembers( team ) ) {
+            LSL::UserBattleStatus& status = player->BattleStatus();
+            if ( is_x ) status.pos.x = coord;
+            else status.pos.y = coord;
+            updates++;
+        }
+    }
+    return updates;
+}
+
+void CheckPositions( const TagBattle& battle, int salt )
+{
+    for ( const LSL::CommonUser* user: battle.UsersView() ) {
+        const LSL::UserBattleStatus& status = user->BattleStatus();
+        if ( status.spectator )
+            continue;
+        if ( status.pos.x != status.team * 100 + salt || status.pos.y != status.team * 50 + salt )
+            throw TestFailedException( "a player missed the start position of their team" );
+    }
+}
+
+void CheckIndex( const TagBattle& battle )
+{
+    size_t indexed = 0, playing = 0;
+    for ( const LSL::CommonUser* user: battle.UsersView() )
+        playing += !user->BattleStatus().spectator;
+    for ( int team = 0; team < NUM_TEAMS; ++team ) {
+        for ( const LSL::CommonUserPtr& user: battle.GetTeamMembers( team ) ) {
+            if ( user->BattleStatus().spectator || user->BattleStatus().team != team )
+                throw TestFailedException( "team index lists a user outside the team" );
+            indexed++;
+        }
+    }
+    if ( indexed != playing )
+        throw TestFailedException( "team index lost track of players" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    srand( 4242 );
+    boost::shared_ptr<TagBattle> battle( new TagBattle() );
+    std::vector<CommonUserPtr> users;
+    const size_t players = NUM_TEAMS * TEAM_SIZE;
+    for ( size_t i = 0; i < players + NUM_SPECTATORS; ++i ) {
+        CommonUserPtr user( new CommonUser( CommonUser::GetNewUserId(), "user" + Util::ToString( i ) ) );
+        battle->Join( user );
+        UserBattleStatus status = user->BattleStatus();
+        status.spectator = i >= players;
+        status.team = int( i % NUM_TEAMS );
+        status.ally = int( i % 2 );
+        battle->OnUserBattleStatusUpdated( user, status );
+        users.push_back( user );
+    }
+    CheckIndex( *battle );
+
+    const Tags tags = StartPosTags( 1 );
+    size_t scanned = 0, indexed = 0;
+    const double scan_ns = MeasureNs( [&]() { scanned = ApplyScanning( *battle, tags ); }, REPEATS );
+    const double index_ns = MeasureNs( [&]() { indexed = ApplyIndexed( *battle, tags ); }, REPEATS );
+    CheckPositions( *battle, 1 );
+    if ( indexed != 2 * players )
+        throw TestFailedException( "indexed startpos touched the wrong number of players" );
+
+    // players wander between teams and spectating, the index has to follow
+    for ( size_t i = 0; i < 4 * players; ++i ) {
+        const CommonUserPtr& user = users[rand() % users.size()];
+        UserBattleStatus status = user->BattleStatus();
+        if ( rand() % 4 == 0 )
+            status.spectator = !status.spectator;
+        else
+            status.team = rand() % NUM_TEAMS;
+        battle->OnUserBattleStatusUpdated( user, status );
+    }
+    CheckIndex( *battle );
+    ApplyIndexed( *battle, StartPosTags( 2 ) );
+    CheckPositions( *battle, 2 );
+
+    std::cout << NUM_TEAMS << " teams, " << players << " players, " << NUM_SPECTATORS << " spectators, "
+              << tags.size() << " startpos tags: userlist scan " << scan_ns / 1e3 << " us (" << scanned
+              << " updates), team index " << index_ns / 1e3 << " us (" << indexed << " updates)" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
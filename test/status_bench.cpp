@@ -0,0 +1,289 @@
+#include <lsl/battle/battle.h>
+#include <lsl/networking/iserver.h>
+#include <lsl/user/user.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+namespace {
+
+const size_t NUM_USERS = 256;
+const size_t STORM_ROUNDS = 40;
+//! every eighth user is a bot, they take teams but never count as players
+const size_t BOT_EVERY = 8;
+//! users leaving and joining again after every round
+const size_t LEAVERS = 16;
+
+//! the parts of a hosted battle the status bookkeeping needs, without a server behind it
+class StormBattle : public LSL::Battle::IBattle
+{
+public:
+    void Join( const LSL::CommonUserPtr user )
+    {
+        // OnUserAdded asks IsFounderMe, the first one to join is me and hosts
+        if ( !m_me ) {
+            m_me = user;
+            m_opts.founder = user->Nick();
+        }
+        m_userlist.Add( user );
+        OnUserAdded( user );
+    }
+
+    const LSL::CommonUserPtr GetMe() { return m_me; }
+    const LSL::ConstCommonUserPtr GetMe() const { return m_me; }
+    void SetChannel( const LSL::ChannelPtr channel ) { m_channel = channel; }
+    const LSL::ChannelPtr GetChannel() { return m_channel; }
+    void StartSpring() {}
+
+private:
+    LSL::CommonUserPtr m_me;
+    LSL::ChannelPtr m_channel;
+};
+
+//! what OnUserBattleStatusUpdated used to do after every status: walk the whole userlist
+struct Recount
+{
+    unsigned int spectators, ready, sync, ok;
+    bool everyone_ready;
+
+    explicit Recount( const LSL::Battle::IBattle& battle )
+        : spectators( 0 ), ready( 0 ), sync( 0 ), ok( 0 ), everyone_ready( true )
+    {
+        const LSL::ConstCommonUserPtr me = battle.GetMe();
+        for ( const LSL::CommonUser* user: battle.UsersView() ) {
+            const LSL::UserBattleStatus& bs = user->BattleStatus();
+            if ( bs.spectator ) {
+                spectators++;
+                continue;
+            }
+            if ( bs.IsBot() )
+                continue;
+            if ( bs.ready ) ready++;
+            if ( bs.sync ) sync++;
+            if ( bs.ready && bs.sync ) ok++;
+            if ( user != me.get() && !( bs.ready && bs.sync ) ) everyone_ready = false;
+        }
+    }
+};
+
+//! team and ally sizes count players only, the member lists bots as well
+void CheckTeams( LSL::Battle::IBattle& battle )
+{
+    std::map<int, int> teams, allies, team_members;
+    for ( const LSL::CommonUserPtr& user: battle.UsersView() ) {
+        const LSL::UserBattleStatus& bs = user->BattleStatus();
+        if ( bs.spectator )
+            continue;
+        team_members[bs.team]++;
+        if ( bs.IsBot() )
+            continue;
+        teams[bs.team]++;
+        allies[bs.ally]++;
+    }
+    if ( battle.GetTeamSizes() != teams || battle.GetAllySizes() != allies )
+        throw TestFailedException( "team or ally sizes drifted from the userlist" );
+    for ( std::map<int, int>::const_iterator it = team_members.begin(); it != team_members.end(); ++it )
+        if ( int( battle.GetTeamMembers( it->first ).size() ) != it->second )
+            throw TestFailedException( "team members drifted from the userlist" );
+    if ( team_members.count( battle.GetFreeTeam() ) )
+        throw TestFailedException( "GetFreeTeam handed out a team a bot is in" );
+}
+
+void Check( const LSL::Battle::IBattle& battle )
+{
+    const Recount expected( battle );
+    if ( battle.GetNumReadyPlayers() != expected.ready || battle.GetNumSyncedPlayers() != expected.sync
+         || battle.GetNumOkPlayers() != expected.ok )
+        throw TestFailedException( "ready/sync counts drifted from the userlist" );
+    if ( battle.GetNumActivePlayers() != battle.GetNumPlayers() - expected.spectators )
+        throw TestFailedException( "active player count drifted from the userlist" );
+    if ( battle.IsEveryoneReady() != expected.everyone_ready )
+        throw TestFailedException( "IsEveryoneReady disagrees with the userlist" );
+}
+
+void CheckMyStatus( const LSL::Battle::Battle& battle, const LSL::ConstCommonUserPtr& me )
+{
+    Check( battle );
+    const LSL::UserBattleStatus& bs = me->BattleStatus();
+    const LSL::CommonUserVector& members = battle.GetTeamMembers( bs.team );
+    if ( std::find( members.begin(), members.end(), me ) == members.end() )
+        throw TestFailedException( "my team doesn't list me" );
+    if ( battle.GetFreeTeam() == bs.team || battle.GetFreeAlly() == bs.ally )
+        throw TestFailedException( "my team or ally is handed out as free" );
+}
+
+/** my own status goes out through SetImReady and OnRequestBattleStatus and the server echoes
+ * it back as CLIENTBATTLESTATUS, the counts have to stay right across both */
+void LocalStatus()
+{
+    using namespace LSL;
+    const IServerPtr server( new Server() );
+    std::vector<std::string> sent;
+    server->SetCommandSink( [&sent]( const std::string& cmd ) { sent.push_back( cmd ); } );
+    const UserPtr me( new User( server, CommonUser::GetNewUserId(), "me", "DE" ) );
+    server->OnLogin( me );
+    const UserPtr host( new User( server, CommonUser::GetNewUserId(), "host", "DE" ) );
+    const boost::shared_ptr<Battle::Battle> battle( new Battle::Battle( server, 1 ) );
+    battle->SetFounder( host->Nick() );
+    battle->OnUserAdded( host );
+    battle->OnUserAdded( me );
+
+    battle->OnRequestBattleStatus();
+    CheckMyStatus( *battle, me );
+    const UserBattleStatus requested = me->BattleStatus();
+    battle->SetImReady( true );
+    CheckMyStatus( *battle, me );
+    if ( battle->GetNumReadyPlayers() != 1 )
+        throw TestFailedException( "SetImReady didn't count me as ready" );
+    const UserBattleStatus ready = me->BattleStatus();
+    // both echoes arrive after both sends went out
+    battle->OnUserBattleStatusUpdated( me, requested );
+    CheckMyStatus( *battle, me );
+    battle->OnUserBattleStatusUpdated( me, ready );
+    CheckMyStatus( *battle, me );
+    if ( battle->GetNumReadyPlayers() != 1 )
+        throw TestFailedException( "the echo of SetImReady lost my ready state" );
+    battle->SetImReady( false );
+    battle->OnUserBattleStatusUpdated( me, me->BattleStatus() );
+    CheckMyStatus( *battle, me );
+    if ( battle->GetNumReadyPlayers() != 0 )
+        throw TestFailedException( "SetImReady( false ) left me counted as ready" );
+    if ( sent.size() != 3 )
+        throw TestFailedException( "expected one MYBATTLESTATUS per status change" );
+}
+
+//! free team numbers past the first 256 and past what the bitset tracks at all
+void FreeNumbers()
+{
+    using namespace LSL;
+    Battle::Occupancy full;
+    for ( int i = 0; i < Battle::Occupancy::LIMIT; ++i )
+        full.Set( i );
+    full.Set( Battle::Occupancy::LIMIT );
+    full.Set( -1 );
+    if ( full.FirstFree() != Battle::Occupancy::LIMIT || full.Test( Battle::Occupancy::LIMIT ) || full.Test( -1 ) )
+        throw TestFailedException( "a full occupancy set handed out a taken number" );
+    if ( full.FirstFree( 300 ) != 300 )
+        throw TestFailedException( "a full occupancy set didn't hand out the number it was told to ignore" );
+    full.Reset( 1000 );
+    if ( full.FirstFree() != 1000 )
+        throw TestFailedException( "a number freed past 256 wasn't handed out" );
+
+    // a battle with 300 teams, and a few far past the bitset's limit
+    boost::shared_ptr<StormBattle> battle( new StormBattle() );
+    const int teams = 300;
+    std::vector<CommonUserPtr> users;
+    for ( int i = 0; i < teams + 3; ++i ) {
+        CommonUserPtr user( new CommonUser( CommonUser::GetNewUserId(), "team" + Util::ToString( i ) ) );
+        battle->Join( user );
+        UserBattleStatus status = user->BattleStatus();
+        status.team = i < teams ? i : Battle::Occupancy::LIMIT + i - teams;
+        status.ally = status.team;
+        battle->OnUserBattleStatusUpdated( user, status );
+        users.push_back( user );
+    }
+    if ( battle->GetFreeTeam() != teams || battle->GetFreeAlly() != teams )
+        throw TestFailedException( "GetFreeTeam stopped at the old 256 limit" );
+    UserBattleStatus status = users[0]->BattleStatus();
+    status.team = teams;
+    status.ally = teams;
+    battle->OnUserBattleStatusUpdated( users[0], status );
+    if ( battle->GetFreeTeam() != 0 )
+        throw TestFailedException( "GetFreeTeam missed a team freed below 256" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    using namespace LSL;
+    srand( 4242 );
+    LocalStatus();
+    FreeNumbers();
+    boost::shared_ptr<StormBattle> battle( new StormBattle() );
+    std::vector<CommonUserPtr> users;
+    for ( size_t i = 0; i < NUM_USERS; ++i ) {
+        CommonUserPtr user( new CommonUser( CommonUser::GetNewUserId(), "user" + Util::ToString( i ) ) );
+        if ( i % BOT_EVERY == BOT_EVERY - 1 )
+            user->BattleStatus().aishortname = "bot";
+        battle->Join( user );
+        users.push_back( user );
+    }
+    Check( *battle );
+
+    // every user flips ready, sync, spectator, team and ally in random order, the host
+    // asks ShouldAutoStart after each status like Battle::OnUserBattleStatusUpdated does
+    size_t updates = 0, could_start = 0;
+    double storm_ns = 0, recount_ns = 0;
+    for ( size_t round = 0; round < STORM_ROUNDS; ++round ) {
+        StopWatch watch;
+        for ( size_t i = 0; i < NUM_USERS; ++i ) {
+            const CommonUserPtr& user = users[rand() % NUM_USERS];
+            UserBattleStatus status = user->BattleStatus();
+            switch ( rand() % 5 ) {
+                case 0: status.ready = !status.ready; break;
+                case 1: status.sync = status.sync ? SYNC_UNKNOWN : SYNC_SYNCED; break;
+                case 2: status.spectator = !status.spectator && !status.IsBot(); break;
+                case 3: status.team = rand() % 64; break;
+                default: status.ally = rand() % 16; break;
+            }
+            battle->OnUserBattleStatusUpdated( user, status );
+            could_start += battle->ShouldAutoStart() + battle->IsEveryoneReady() + battle->GetNumActivePlayers();
+            updates++;
+        }
+        storm_ns += watch.ElapsedNs();
+        // the full rescan every one of these updates used to pay on top
+        recount_ns += NUM_USERS * MeasureNs( [&]() { could_start += Recount( *battle ).ok; }, 16 );
+        Check( *battle );
+        CheckTeams( *battle );
+        // the counts have to follow users leaving and coming back, the host stays
+        for ( size_t i = 0; i < LEAVERS; ++i ) {
+            const CommonUserPtr& user = users[1 + rand() % ( NUM_USERS - 1 )];
+            battle->OnUserRemoved( user );
+            if ( battle->GetNumUsers() != NUM_USERS - 1 )
+                throw TestFailedException( "a leaving user stayed in the battle" );
+            Check( *battle );
+            battle->Join( user );
+            Check( *battle );
+        }
+        CheckTeams( *battle );
+    }
+#ifdef LSL_CHECK_STATUS_COUNTS
+    std::cout << "built with LSL_CHECK_STATUS_COUNTS, every update is also checked against a full recount" << std::endl;
+#endif
+    std::cout << NUM_USERS << " users, " << updates << " status updates: " << storm_ns / updates
+              << " ns per update incl. ShouldAutoStart; a userlist rescan costs " << recount_ns / updates
+              << " ns per update (" << could_start << ")" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
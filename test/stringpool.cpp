@@ -0,0 +1,124 @@
+#include <lslutils/stringpool.h>
+#include <lslutils/conversion.h>
+
+#include "common.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace {
+
+//! released strings leave the pool and their ids are handed out again
+void Release()
+{
+    using namespace LSL;
+    Util::StringPool pool;
+    const size_t empty = pool.size();
+    const Util::StringPool::Id first = pool.Intern( "first" );
+    if ( pool.Intern( "first" ) != first || pool.size() != empty + 1 )
+        throw TestFailedException( "a string was pooled twice" );
+    pool.Release( first );
+    Util::StringPool::Id id;
+    if ( !pool.Find( "first", id ) || id != first || pool.Lookup( first ) != "first" )
+        throw TestFailedException( "a string went away while referenced" );
+    pool.Release( first );
+    pool.Release( first );
+    if ( pool.size() != empty || pool.Find( "first", id ) )
+        throw TestFailedException( "an unreferenced string stayed in the pool" );
+    if ( pool.Intern( "second" ) != first )
+        throw TestFailedException( "a freed id wasn't reused" );
+    pool.Release( first );
+
+    // nick churn doesn't grow the pool
+    const size_t bytes = pool.MemoryUsage();
+    for ( size_t i = 0; i < 4 * Util::StringPool::CHUNK_SIZE; ++i )
+        pool.Release( pool.Intern( "player with a rather long nick " + Util::ToString( i ) ) );
+    if ( pool.size() != empty || pool.MemoryUsage() != bytes )
+        throw TestFailedException( "the pool grew from strings nobody holds" );
+}
+
+//! short strings live in the entries, long ones are counted with their heap buffer
+void HeapBytes()
+{
+    using namespace LSL;
+    Util::StringPool pool;
+    // each string below takes the id the one before freed, only their own storage differs
+    pool.Release( pool.Intern( "warm up" ) );
+    Util::StringPool::Id id = pool.Intern( "nick" );
+    const size_t bytes = pool.MemoryUsage();
+    pool.Release( id );
+    id = pool.Intern( "nock" );
+    if ( pool.MemoryUsage() != bytes )
+        throw TestFailedException( "a short string was counted as heap" );
+    pool.Release( id );
+    const std::string long_name( 100, 'x' );
+    id = pool.Intern( long_name );
+    if ( pool.MemoryUsage() <= bytes + long_name.size() )
+        throw TestFailedException( "a long string's heap buffer wasn't counted" );
+    pool.Release( id );
+    id = pool.Intern( "nick" );
+    if ( pool.MemoryUsage() != bytes )
+        throw TestFailedException( "a freed string is still counted" );
+    pool.Release( id );
+}
+
+//! every handle holds its string, the last one to go frees it
+void Handles()
+{
+    using namespace LSL;
+    Util::StringPool& pool = Util::StringPool::Get();
+    const size_t before = pool.size();
+    {
+        Util::InternedString a( "handle test" );
+        Util::InternedString b( a );
+        Util::InternedString c;
+        c = b;
+        Util::InternedString found;
+        if ( !Util::InternedString::Find( "handle test", found ) || found != a || c != a )
+            throw TestFailedException( "handles of one string differ" );
+        a = Util::InternedString();
+        b = std::move( c );
+        if ( pool.size() != before + 1 || b != "handle test" )
+            throw TestFailedException( "a string went away while a handle held it" );
+    }
+    Util::InternedString missing;
+    if ( pool.size() != before || Util::InternedString::Find( "handle test", missing ) )
+        throw TestFailedException( "a string outlived its handles" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    Release();
+    HeapBytes();
+    Handles();
+    std::cout << "string pool checks passed" << std::endl;
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
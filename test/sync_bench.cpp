@@ -0,0 +1,192 @@
+#include <lsl/battle/ibattle.h>
+#include <lsl/user/common.h>
+#include <lslunitsync/data.h>
+
+#include <iostream>
+#include <string>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t REFRESHES = 100000;
+
+/** an IBattle without a server, on a unitsync with an empty catalog whose
+ * generation the test moves, counting how often IsSynced really checks */
+class SyncBattle : public LSL::Battle::IBattle
+{
+public:
+    SyncBattle() : m_me( new LSL::CommonUser( "0", "me" ) ), m_generation( 0 ), m_checks( 0 ) {}
+
+    //! what rereading the unitsync map and game lists does to the catalog generation
+    void ReloadCatalog() { m_generation++; }
+    size_t Checks() const { return m_checks; }
+    //! the uncached check IsSynced did on every call before it was memoized
+    bool CheckSyncedUncached() { return IBattle::CheckSynced(); }
+
+    const LSL::CommonUserPtr GetMe() { return m_me; }
+    const LSL::ConstCommonUserPtr GetMe() const { return m_me; }
+    void SetChannel( const LSL::ChannelPtr channel ) { m_channel = channel; }
+    const LSL::ChannelPtr GetChannel() { return m_channel; }
+    void StartSpring() {}
+
+protected:
+    size_t GetCatalogGeneration() const { return m_generation; }
+    bool CheckSynced()
+    {
+        m_checks++;
+        return IBattle::CheckSynced();
+    }
+
+private:
+    LSL::CommonUserPtr m_me;
+    size_t m_generation;
+    size_t m_checks;
+    LSL::ChannelPtr m_channel;
+};
+
+struct Case
+{
+    const char* host_name;
+    const char* host_hash;
+    const char* local_name;
+    const char* local_hash;
+    bool synced;
+};
+
+//! an empty or "0" host hash leaves it to the names, an empty host name to the hashes
+const Case CASES[] = {
+    { "Map", "abc", "Map", "abc", true },
+    { "Map", "abc", "Map", "def", false },
+    { "Map", "abc", "Other", "abc", false },
+    { "Map", "abc", "Map", "0", false },
+    { "Map", "abc", "Map", "", false },
+    { "Map", "abc", "", "", false },
+    { "Map", "", "Map", "def", true },
+    { "Map", "", "Map", "", true },
+    { "Map", "", "Other", "def", false },
+    { "Map", "0", "Map", "def", true },
+    { "Map", "0", "Map", "0", true },
+    { "Map", "0", "Other", "def", false },
+    { "Map", "0", "", "0", false },
+    { "", "abc", "Other", "abc", true },
+    { "", "abc", "Other", "def", false },
+    { "", "0", "Other", "def", true },
+    { "", "", "Other", "def", true },
+    { "", "", "", "", true },
+};
+
+void Expect( bool condition, const std::string& what )
+{
+    if ( !condition )
+        throw TestFailedException( what );
+}
+
+std::string Describe( const Case& c )
+{
+    return std::string( "host " ) + c.host_name + "/" + c.host_hash + " local " + c.local_name + "/" + c.local_hash;
+}
+
+//! every case once for the map and once for the game, the other archive is in sync
+void CheckCases()
+{
+    using LSL::UnitsyncMap;
+    using LSL::UnitsyncMod;
+    for ( size_t i = 0; i < sizeof( CASES ) / sizeof( CASES[0] ); ++i ) {
+        const Case& c = CASES[i];
+        SyncBattle map_battle;
+        map_battle.SetHostMod( "Game", "g1" );
+        map_battle.SetLocalMod( UnitsyncMod( "Game", "g1" ) );
+        map_battle.SetHostMap( c.host_name, c.host_hash );
+        map_battle.SetLocalMap( UnitsyncMap( c.local_name, c.local_hash ) );
+        Expect( map_battle.IsSynced() == c.synced, "wrong map sync state for " + Describe( c ) );
+
+        SyncBattle mod_battle;
+        mod_battle.SetHostMap( "Map", "m1" );
+        mod_battle.SetLocalMap( UnitsyncMap( "Map", "m1" ) );
+        mod_battle.SetHostMod( c.host_name, c.host_hash );
+        mod_battle.SetLocalMod( UnitsyncMod( c.local_name, c.local_hash ) );
+        Expect( mod_battle.IsSynced() == c.synced, "wrong game sync state for " + Describe( c ) );
+    }
+}
+
+//! the memo answers until the local archives, unitsync or the host archives change
+void CheckMemo()
+{
+    using LSL::UnitsyncMap;
+    using LSL::UnitsyncMod;
+    SyncBattle battle;
+    battle.SetHostMap( "Map", "abc" );
+    battle.SetHostMod( "Game", "def" );
+    battle.SetLocalMap( UnitsyncMap( "Map", "abc" ) );
+    battle.SetLocalMod( UnitsyncMod( "Game", "def" ) );
+    Expect( battle.IsSynced() && battle.Checks() == 1, "first IsSynced didn't check" );
+    Expect( battle.IsSynced() && battle.Checks() == 1, "IsSynced checked again without a change" );
+
+    battle.SetLocalMap( UnitsyncMap( "Map", "xyz" ) );
+    Expect( !battle.IsSynced() && battle.Checks() == 2, "SetLocalMap kept the memo" );
+    battle.SetLocalMap( UnitsyncMap( "Map", "abc" ) );
+    Expect( battle.IsSynced() && battle.Checks() == 3, "SetLocalMap kept the memo" );
+
+    battle.SetLocalMod( UnitsyncMod( "Game", "old" ) );
+    Expect( !battle.IsSynced() && battle.Checks() == 4, "SetLocalMod kept the memo" );
+    battle.SetLocalMod( UnitsyncMod( "Game", "def" ) );
+    Expect( battle.IsSynced() && battle.Checks() == 5, "SetLocalMod kept the memo" );
+
+    battle.OnUnitsyncReloaded();
+    Expect( battle.IsSynced() && battle.Checks() == 6, "OnUnitsyncReloaded kept the memo" );
+
+    battle.ReloadCatalog();
+    Expect( battle.IsSynced() && battle.Checks() == 7, "a new catalog generation kept the memo" );
+    Expect( battle.IsSynced() && battle.Checks() == 7, "IsSynced checked again within a generation" );
+
+    battle.SetHostMap( "Map", "0" );
+    Expect( battle.IsSynced() && battle.Checks() == 8, "a new host hash kept the memo" );
+    battle.SetHostMap( "Map", "" );
+    Expect( battle.IsSynced() && battle.Checks() == 9, "a new host hash kept the memo" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    CheckCases();
+    CheckMemo();
+
+    // every host info update and UI refresh asks, while the archives are still downloading
+    SyncBattle battle;
+    battle.SetHostMap( "Some Map v2", "1234567890" );
+    battle.SetHostMod( "Some Game v1.2", "987654321" );
+    size_t count = 0;
+    const double old_ns = MeasureNs( [&]() { count += battle.CheckSyncedUncached(); }, REFRESHES );
+    const double new_ns = MeasureNs( [&]() { count += battle.IsSynced(); }, REFRESHES );
+    Expect( battle.Checks() == 1, "IsSynced checked more than once while nothing changed" );
+    std::cout << "IsSynced while the archives are missing: reloading " << old_ns << " ns, memoized " << new_ns
+              << " ns (" << count << ")" << std::endl;
+    return 0;
+}
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
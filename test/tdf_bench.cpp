@@ -0,0 +1,312 @@
+#include <lsl/battle/tdfcontainer.h>
+#include <lslutils/conversion.h>
+
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t REPEATS = 10;
+
+using LSL::TDF::Token;
+using LSL::TDF::IsWhitespace;
+
+/** the tokenizer before: a character at a time through istream get/peek, the include stack
+ * unwound for every one, tokens buffered with their value and position as strings */
+class StreamTokenizer
+{
+public:
+    struct OldToken
+    {
+        Token::TokenType type;
+        std::string value_s;
+        std::string pos_string;
+        OldToken() : type( Token::type_eof ) {}
+    };
+
+    explicit StreamTokenizer( std::istream& stream ) : m_stream( &stream ), m_line( 1 ), m_column( 1 ),
+        m_skip_eol( false ), m_buffer_pos( 0 ), m_errors( 0 ) {}
+
+    OldToken TakeToken()
+    {
+        while ( m_buffer.size() < m_buffer_pos + 1 ) {
+            OldToken t;
+            ReadToken( t );
+            if ( t.type == Token::type_eof ) {
+                ++m_buffer_pos;
+                return t;
+            }
+            m_buffer.push_back( t );
+        }
+        return m_buffer[m_buffer_pos++];
+    }
+    int NumErrors() const { return m_errors; }
+
+private:
+    void Unwind()
+    {
+        if ( m_stream && !m_stream->good() )
+            m_stream = NULL;
+    }
+    bool Good() { Unwind(); return m_stream != NULL; }
+    char Peek() { Unwind(); return m_stream ? char( m_stream->peek() ) : 0; }
+    char Get()
+    {
+        Unwind();
+        if ( !m_stream )
+            return 0;
+        const char c = m_stream->get();
+        if ( !m_skip_eol && ( c == 10 || c == 13 ) ) {
+            m_line += 1;
+            m_column = 1;
+            const char nc = m_stream->peek();
+            if ( ( nc == 10 || nc == 13 ) && nc != c ) m_skip_eol = true;
+        } else {
+            if ( !m_skip_eol ) m_column += 1;
+            m_skip_eol = false;
+        }
+        return c;
+    }
+
+    void ReadToken( OldToken& token )
+    {
+    start:
+        while ( Good() && IsWhitespace( Peek() ) )
+            Get();
+        token.value_s.clear();
+        if ( !Good() ) {
+            token.type = Token::type_eof;
+            token.pos_string = "EOF";
+            return;
+        }
+        std::stringstream pos;
+        pos << "line " << m_line << " , column " << m_column;
+        token.pos_string = pos.str();
+        char c = Get();
+        token.value_s += c;
+        switch ( c ) {
+            case '[':
+                token.type = Token::type_section_name;
+                token.value_s.clear();
+                while ( Good() ) {
+                    c = Get();
+                    if ( c == 0 ) c = ' ';
+                    if ( c == '\\' ) {
+                        if ( !Good() ) { m_errors++; return; }
+                        token.value_s += Get();
+                    } else if ( c == ']' ) {
+                        return;
+                    } else {
+                        token.value_s += c;
+                    }
+                }
+                m_errors++;
+                // fall through
+            case '{': token.type = Token::type_enter_section; return;
+            case '}': token.type = Token::type_leave_section; return;
+            case ';': token.type = Token::type_semicolon; return;
+            case '=':
+                token.type = Token::type_entry_value;
+                token.value_s.clear();
+                while ( Good() && Peek() != ';' )
+                    token.value_s += Get();
+                return;
+            case '/':
+                if ( Peek() == '/' ) {
+                    std::string tmp;
+                    std::getline( *m_stream, tmp );
+                    m_line += 1;
+                    m_column = 1;
+                    goto start;
+                } else if ( Peek() == '*' ) {
+                    while ( Good() ) {
+                        if ( Get() == '*' && Peek() == '/' ) {
+                            Get();
+                            break;
+                        }
+                    }
+                    goto start;
+                }
+                // fall through
+            default:
+                while ( Good() && Peek() != '=' )
+                    token.value_s += Get();
+                token.type = Token::type_entry_name;
+                return;
+        }
+    }
+
+    std::istream* m_stream;
+    int m_line, m_column;
+    bool m_skip_eol;
+    std::deque<OldToken> m_buffer;
+    size_t m_buffer_pos;
+    int m_errors;
+};
+
+std::string Number( int max ) { return LSL::Util::ToString( rand() % max ); }
+
+//! a script.txt like the host writes for \param players
+std::string MakeScript( size_t players )
+{
+    std::stringstream s;
+    s << "[GAME]\n{\n\tMapName=Comet Catcher Redux;\n\tGameType=Balanced Annihilation V7.72;\n\tIsHost=1;\n"
+      << "\tHostIP=;\n\tHostPort=8452;\n\t[modoptions]\n\t{\n";
+    for ( size_t i = 0; i < 40; ++i )
+        s << "\t\toption" << i << "=" << Number( 1000 ) << ";\n";
+    s << "\t}\n\t// players and their teams\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[PLAYER" << i << "]\n\t{\n\t\tName=player" << i << ";\n\t\tCountryCode=DE;\n\t\tSpectator=0;\n\t\tRank="
+          << Number( 8 ) << ";\n\t\tTeam=" << i << ";\n\t}\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[TEAM" << i << "]\n\t{\n\t\tTeamLeader=" << i << ";\n\t\tAllyTeam=" << i % 16 << ";\n\t\tRGBColor=0."
+          << Number( 1000 ) << " 0." << Number( 1000 ) << " 0." << Number( 1000 ) << ";\n\t\tSide=ARM;\n\t\tHandicap=0;\n\t}\n";
+    for ( size_t i = 0; i < 16; ++i )
+        s << "\t[ALLYTEAM" << i << "]\n\t{\n\t\tNumAllies=0;\n\t\tStartRectLeft=0." << Number( 100 ) << ";\n\t}\n";
+    s << "\tNumPlayers=" << players << ";\n\tNumTeams=" << players << ";\n\tNumAllyTeams=16;\n}\n";
+    return s.str();
+}
+
+//! an old style mapinfo, CRLF line ends, comments and escaped names included
+std::string MakeMapinfo( size_t teams )
+{
+    std::stringstream s;
+    s << "/* generated\r\n * mapinfo */\r\n[MAP]\r\n{\r\n\tDescription=A map with " << teams << " start positions;\r\n"
+      << "\tGravity=130;\r\n\tMaxMetal=0.02;\r\n\t[SMF]\r\n\t{\r\n\t\tminheight=-100;\r\n\t\tmaxheight=500;\r\n\t}\r\n";
+    for ( size_t i = 0; i < teams; ++i )
+        s << "\t[TEAM" << i << "]\r\n\t{\r\n\t\tStartPosX=" << Number( 8192 ) << ";\r\n\t\tStartPosZ=" << Number( 8192 )
+          << ";\r\n\t} // team " << i << "\r\n";
+    s << "\t[ATMOSPHERE]\r\n\t{\r\n\t\tFogStart=0.2;\r\n\t\tSkyColor=0.1 0.15 0.7;\r\n\t\tCloudDensity=0.5;\r\n\t}\r\n"
+      << "\t[odd \\] name]\r\n\t{\r\n\t\tkey=value;\r\n\t}\r\n}\r\n";
+    return s.str();
+}
+
+struct Collected
+{
+    std::vector<Token::TokenType> types;
+    std::vector<std::string> values;
+    int errors;
+};
+
+Collected Old( const std::string& text )
+{
+    std::stringstream ss( text );
+    StreamTokenizer tokenizer( ss );
+    Collected result;
+    for ( StreamTokenizer::OldToken t = tokenizer.TakeToken(); t.type != Token::type_eof; t = tokenizer.TakeToken() ) {
+        result.types.push_back( t.type );
+        result.values.push_back( t.value_s );
+    }
+    result.errors = tokenizer.NumErrors();
+    return result;
+}
+
+Collected New( const std::string& text )
+{
+    LSL::TDF::Tokenizer tokenizer;
+    tokenizer.EnterString( text );
+    Collected result;
+    for ( Token t = tokenizer.TakeToken(); !t.IsEOF(); t = tokenizer.TakeToken() ) {
+        result.types.push_back( t.type );
+        result.values.push_back( tokenizer.Value( t ) );
+    }
+    result.errors = tokenizer.NumErrors();
+    return result;
+}
+
+//! malformed input leaves some junk at the end of the old values, so those only compare types and errors
+void Compare( const std::string& name, const std::string& text, bool values )
+{
+    const Collected old_tokens = Old( text );
+    const Collected new_tokens = New( text );
+    if ( old_tokens.types != new_tokens.types )
+        throw TestFailedException( name + ": token types differ from the stream tokenizer" );
+    if ( values && old_tokens.values != new_tokens.values )
+        throw TestFailedException( name + ": token values differ from the stream tokenizer" );
+    if ( old_tokens.errors != new_tokens.errors )
+        throw TestFailedException( name + ": error count differs from the stream tokenizer" );
+}
+
+void Throughput( const std::string& name, const std::string& text )
+{
+    Compare( name, text, true );
+    size_t tokens = 0;
+    const double old_ns = MeasureNs( [&]() {
+        std::stringstream ss( text );
+        StreamTokenizer tokenizer( ss );
+        while ( tokenizer.TakeToken().type != Token::type_eof )
+            ++tokens;
+    }, REPEATS );
+    const double new_ns = MeasureNs( [&]() {
+        LSL::TDF::Tokenizer tokenizer;
+        tokenizer.EnterString( text );
+        while ( !tokenizer.TakeToken().IsEOF() )
+            ++tokens;
+    }, REPEATS );
+    int errors = 0;
+    const double parse_ns = MeasureNs( [&]() { LSL::TDF::ParseTDF( text, &errors ); }, REPEATS );
+    if ( errors != 0 )
+        throw TestFailedException( name + " doesn't parse cleanly" );
+    const double mb = text.size() / 1e6;
+    std::cout << name << ", " << text.size() / 1024 << " KiB: stream tokenizer " << mb / ( old_ns / 1e9 ) << " MB/s, buffer tokenizer "
+              << mb / ( new_ns / 1e9 ) << " MB/s; ParseTDF " << mb / ( parse_ns / 1e9 ) << " MB/s (" << tokens << ")" << std::endl;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 4242 );
+    Throughput( "script.txt, 250 players", MakeScript( 250 ) );
+    Throughput( "mapinfo, 32 start positions", MakeMapinfo( 32 ) );
+    // what a replay browser reads off every demo header
+    Throughput( "replay header, 16 players", MakeScript( 16 ) );
+
+    // broken input still gives the same tokens and errors
+    const char* broken[] = { "[GAME", "[GAME]{a=1", "[GAME]{a", "a=1;}}[x]", "[a\\", "=;;=", "/* open", "// only\n[x]{y=2;}",
+                             "[\\]]{k=v;}", "/*/ a=1;", "[a]\r\n\r\n{\n\rb=2;\n}" };
+    for ( size_t i = 0; i < sizeof( broken ) / sizeof( broken[0] ); ++i )
+        Compare( std::string( "broken input " ) + LSL::Util::ToString( i ), broken[i], false );
+
+    // the parser reports errors at the same place
+    int errors = 0;
+    LSL::TDF::PDataList root( LSL::TDF::ParseTDF( std::string( "[GAME]\n{\n\ta=1;\n\tb\n}\n" ), &errors ) );
+    if ( errors != 1 )
+        throw TestFailedException( "a missing '=' isn't reported once" );
+    LSL::TDF::PDataList game( root->Find( "game" ) );
+    if ( !game.ok() || game->GetInt( "A" ) != 1 )
+        throw TestFailedException( "a parsed value got lost" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,205 @@
+#include <lsl/battle/tdfcontainer.h>
+#include <lsl/battle/tdfdocument.h>
+#include <lslutils/conversion.h>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#define ALLOC_COUNTING
+#include "bench.h"
+
+namespace {
+
+const size_t PLAYER_COUNTS[] = { 16, 64, 250 };
+const size_t REPEATS = 20;
+
+using LSL::TDF::DocList;
+using LSL::TDF::DocNode;
+using LSL::TDF::PDataList;
+using LSL::TDF::PDataLeaf;
+using LSL::TDF::PNode;
+
+std::string MakeScript( size_t players )
+{
+    using LSL::Util::ToString;
+    std::ostringstream s;
+    s << "[GAME]\n{\n\tMapName=Some Map v2;\n\tGameType=Some Game v1.2;\n\tNumPlayers=" << players
+      << ";\n\tHostIP=;\n\tHostPort=8452;\n\t[modoptions]\n\t{\n";
+    for ( size_t i = 0; i < 40; ++i )
+        s << "\t\toption" << i << "=" << rand() % 1000 << ";\n";
+    s << "\t}\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[PLAYER" << i << "]\n\t{\n\t\tName=player" << i << ";\n\t\tCountryCode=DE;\n\t\tSpectator=0;\n\t\tRank="
+          << rand() % 8 << ";\n\t\tTeam=" << i << ";\n\t}\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[TEAM" << i << "]\n\t{\n\t\tTeamLeader=" << i << ";\n\t\tAllyTeam=" << i % 16 << ";\n\t\tRGBColor=0."
+          << rand() % 1000 << " 0." << rand() % 1000 << " 0." << rand() % 1000 << ";\n\t\tSide=ARM;\n\t\tHandicap=0;\n\t}\n";
+    for ( size_t i = 0; i < 16; ++i )
+        s << "\t[ALLYTEAM" << i << "]\n\t{\n\t\tNumAllies=0;\n\t\tStartRectLeft=0." << rand() % 100 << ";\n\t}\n";
+    s << "}\n";
+    return s.str();
+}
+
+//! both trees hold the same nodes in the same order, and find them by any case
+void Compare( const PDataList& list, const DocList& doc )
+{
+    size_t count = 0;
+    DocNode d = doc.First();
+    for ( PNode node = list->First(); node.ok() && node != list->End(); node = list->Next( node ), d = doc.Next( d ), ++count ) {
+        if ( d == doc.End() || d.Name() != node->Name() )
+            throw TestFailedException( "document lost or reordered " + node->Name() );
+        if ( doc.Find( LSL::Util::ToString( node->Name() ) ) != d )
+            throw TestFailedException( "document can't find " + node->Name() );
+        const PDataList sub( node );
+        if ( sub.ok() != d.IsList() )
+            throw TestFailedException( node->Name() + " is a section in one tree only" );
+        if ( sub.ok() ) {
+            Compare( sub, DocList( d ) );
+            continue;
+        }
+        // an empty value leaves DataList::GetInt's result uninitialized
+        const PDataLeaf leaf( node );
+        if ( leaf->GetValue() != d.GetValue()
+             || ( !d.GetValue().empty() && list->GetInt( node->Name() ) != doc.GetInt( node->Name() ) ) )
+            throw TestFailedException( "different value for " + node->Name() );
+    }
+    if ( count != doc.size() )
+        throw TestFailedException( "document has extra nodes" );
+}
+
+//! what GetBattleFromScript reads per player
+size_t ReadPlayers( const PDataList& game, size_t players )
+{
+    size_t sum = 0;
+    for ( size_t i = 0; i < players; ++i ) {
+        const PDataList player( game->Find( "PLAYER" + LSL::Util::ToString( i ) ) );
+        const PDataList team( game->Find( "TEAM" + LSL::Util::ToString( i ) ) );
+        sum += player->GetString( "Name" ).size() + player->GetInt( "Team" ) + team->GetInt( "AllyTeam" );
+    }
+    return sum;
+}
+
+size_t ReadPlayers( const DocList& game, size_t players )
+{
+    size_t sum = 0;
+    for ( size_t i = 0; i < players; ++i ) {
+        const DocList player( game.Find( "PLAYER" + LSL::Util::ToString( i ) ) );
+        const DocList team( game.Find( "TEAM" + LSL::Util::ToString( i ) ) );
+        sum += player.GetString( "Name" ).size() + player.GetInt( "Team" ) + team.GetInt( "AllyTeam" );
+    }
+    return sum;
+}
+
+void Run( size_t players )
+{
+    const std::string text = MakeScript( players );
+
+    size_t allocs = g_allocs.load(), bytes = g_bytes.load();
+    PDataList root( LSL::TDF::ParseTDF( text ) );
+    const size_t list_allocs = g_allocs.load() - allocs, list_bytes = g_bytes.load() - bytes;
+    allocs = g_allocs.load();
+    bytes = g_bytes.load();
+    LSL::TDF::Document document;
+    if ( document.Parse( text ) != 0 )
+        throw TestFailedException( "script doesn't parse cleanly" );
+    const size_t doc_allocs = g_allocs.load() - allocs, doc_bytes = g_bytes.load() - bytes;
+    Compare( root, DocList( document ) );
+
+    const double list_ns = MeasureNs( [&]() { LSL::TDF::ParseTDF( text ); }, REPEATS );
+    const double doc_ns = MeasureNs( [&]() { LSL::TDF::Document fresh; fresh.Parse( text ); }, REPEATS );
+    const double reuse_ns = MeasureNs( [&]() { document.Parse( text ); }, REPEATS );
+
+    const PDataList game( root->Find( "game" ) );
+    const DocList doc_game( DocList( document ).Find( "game" ) );
+    size_t list_sum = 0, doc_sum = 0;
+    const double list_find_ns = MeasureNs( [&]() { list_sum = ReadPlayers( game, players ); }, REPEATS );
+    const double doc_find_ns = MeasureNs( [&]() { doc_sum = ReadPlayers( doc_game, players ); }, REPEATS );
+    if ( list_sum != doc_sum )
+        throw TestFailedException( "lookups read different values" );
+
+    std::cout << players << " players, " << text.size() / 1024 << " KiB: DataList " << list_ns / 1e3 << " us, " << list_allocs
+              << " allocations, " << list_bytes / 1024 << " KiB; Document " << doc_ns / 1e3 << " us (" << reuse_ns / 1e3
+              << " us reused), " << doc_allocs << " allocations, " << doc_bytes / 1024 << " KiB, " << document.BytesUsed() / 1024
+              << " KiB used; player lookups " << list_find_ns / 1e3 << " us vs " << doc_find_ns / 1e3 << " us" << std::endl;
+    if ( doc_allocs * 10 > list_allocs )
+        throw TestFailedException( "the document doesn't save allocations" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 4242 );
+    for ( size_t p = 0; p < sizeof( PLAYER_COUNTS ) / sizeof( PLAYER_COUNTS[0] ); ++p )
+        Run( PLAYER_COUNTS[p] );
+
+    // the first of two entries with the same name stays, escaped names come out unescaped
+    LSL::TDF::Document document;
+    const std::string dup( "[GAME]{a=1;b=2;A=3;[x\\]y]{k=v;}[X\\]Y]{k=w;}}" );
+    PDataList root( LSL::TDF::ParseTDF( dup ) );
+    if ( document.Parse( dup ) != 0 )
+        throw TestFailedException( "escaped section names don't parse" );
+    Compare( root, DocList( document ) );
+    const DocList game( DocList( document ).Find( "Game" ) );
+    if ( game.size() != 3 || game.GetInt( "a" ) != 1 || DocList( game.Find( "X]Y" ) ).GetString( "K" ) != "v" )
+        throw TestFailedException( "duplicates or escapes handled differently from DataList" );
+    bool worked = true;
+    if ( game.GetInt( "missing", 7, &worked ) != 7 || worked || DocList( game.Find( "a" ) ).ok() )
+        throw TestFailedException( "a missing key or a leaf read as a section" );
+
+    // a section with enough children for a hash table
+    std::ostringstream many;
+    for ( size_t i = 0; i < 100; ++i )
+        many << "Key" << i << "=" << i << ";";
+    many << "key5=dup;";
+    root = LSL::TDF::ParseTDF( many.str() );
+    document.Parse( many.str() );
+    Compare( root, DocList( document ) );
+    if ( DocList( document ).GetString( "KEY5" ) != "5" || DocList( document ).size() != 100 )
+        throw TestFailedException( "hashed lookup disagrees with DataList" );
+
+    double rgb[3];
+    document.Parse( "c=0.5 0.25 1;" );
+    if ( DocList( document ).GetDoubleArray( "c", 3, rgb ) != 3 || rgb[1] != 0.25 )
+        throw TestFailedException( "number lists aren't read" );
+
+    // broken input reports the same errors
+    const char* broken[] = { "[GAME", "[GAME]{a=1", "[GAME]{a", "a=1;}}[x]", "=;;=", "[a]x{b=1;}" };
+    for ( size_t i = 0; i < sizeof( broken ) / sizeof( broken[0] ); ++i ) {
+        int errors = 0;
+        root = LSL::TDF::ParseTDF( std::string( broken[i] ), &errors );
+        if ( document.Parse( broken[i], std::strlen( broken[i] ) ) != errors )
+            throw TestFailedException( std::string( "different errors for " ) + broken[i] );
+        Compare( root, DocList( document ) );
+    }
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
@@ -0,0 +1,280 @@
+#include <lsl/battle/tdfcontainer.h>
+#include <lsl/battle/tdfreader.h>
+#include <lslutils/conversion.h>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#define ALLOC_COUNTING
+#include "bench.h"
+
+namespace {
+
+//! what a replay browser lists
+const size_t REPLAYS = 1000;
+const size_t REPLAY_PLAYERS = 16;
+const size_t PLAYER_COUNTS[] = { 16, 64, 250 };
+
+using LSL::StringMap;
+using LSL::StringVector;
+using LSL::TDF::PDataList;
+using LSL::TDF::PNode;
+using LSL::TDF::Span;
+
+std::string MakeScript( size_t players )
+{
+    std::ostringstream s;
+    s << "[GAME]\n{\n\tMapName=Map " << rand() % 100 << ";\n\tGameType=Some Game v1." << rand() % 10 << ";\n\tNumPlayers="
+      << players << ";\n\tHostIP=;\n\tHostPort=8452;\n\t// settings\n\t[modoptions]\n\t{\n";
+    for ( size_t i = 0; i < 40; ++i )
+        s << "\t\toption" << i << "=" << rand() % 1000 << ";\n";
+    s << "\t}\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[PLAYER" << i << "]\n\t{\n\t\tName=player" << rand() % 10000 << ";\n\t\tCountryCode=DE;\n\t\tSpectator=0;\n\t\tRank="
+          << rand() % 8 << ";\n\t\tTeam=" << i << ";\n\t}\n";
+    for ( size_t i = 0; i < players; ++i )
+        s << "\t[TEAM" << i << "]\n\t{\n\t\tTeamLeader=" << i << ";\n\t\tAllyTeam=" << i % 16 << ";\n\t\tRGBColor=0."
+          << rand() % 1000 << " 0." << rand() % 1000 << " 0." << rand() % 1000 << ";\n\t\tSide=ARM;\n\t}\n";
+    s << "\tMapHash=" << rand() << ";\n}\n";
+    return s.str();
+}
+
+//! the whole source as the events a DataList walk gives
+void Dump( const PDataList& list, std::string& out )
+{
+    for ( PNode node = list->First(); node.ok() && node != list->End(); node = list->Next( node ) ) {
+        const PDataList sub( node );
+        if ( sub.ok() ) {
+            out += "[" + node->Name() + "]{";
+            Dump( sub, out );
+            out += "}";
+        } else {
+            out += node->Name() + "=" + LSL::TDF::PDataLeaf( node )->GetValue() + ";";
+        }
+    }
+}
+
+class DumpHandler : public LSL::TDF::Handler
+{
+public:
+    std::string out;
+    bool EnterSection( const Span& name ) { out += "[" + name.str() + "]{"; return true; }
+    bool LeaveSection() { out += "}"; return true; }
+    bool Entry( const Span& name, const Span& value, int ) { out += name.str() + "=" + value.str() + ";"; return true; }
+};
+
+//! stops at the entry named \param stop, anything that arrives after that is a bug
+class StopHandler : public DumpHandler
+{
+public:
+    explicit StopHandler( const std::string& stop ) : m_stop( stop ), stopped( false ), late( false ) {}
+    bool EnterSection( const Span& name ) { late |= stopped; return DumpHandler::EnterSection( name ); }
+    bool LeaveSection() { late |= stopped; return DumpHandler::LeaveSection(); }
+    bool Entry( const Span& name, const Span& value, int path )
+    {
+        late |= stopped;
+        DumpHandler::Entry( name, value, path );
+        stopped = name.Is( m_stop );
+        return !stopped;
+    }
+
+private:
+    const std::string m_stop;
+
+public:
+    bool stopped, late;
+};
+
+//! what a browser keeps per replay, without a string per value
+class HeaderHandler : public LSL::TDF::Handler
+{
+public:
+    size_t entries, bytes;
+    HeaderHandler() : entries( 0 ), bytes( 0 ) {}
+    bool Entry( const Span&, const Span& value, int )
+    {
+        entries++;
+        bytes += value.size;
+        return true;
+    }
+};
+
+void Replays()
+{
+    std::vector<std::string> scripts;
+    size_t total = 0;
+    for ( size_t i = 0; i < REPLAYS; ++i ) {
+        scripts.push_back( MakeScript( REPLAY_PLAYERS ) );
+        total += scripts.back().size();
+    }
+    StringVector paths;
+    paths.push_back( "game/mapname" );
+    paths.push_back( "game/gametype" );
+    paths.push_back( "game/maphash" );
+    const LSL::TDF::PathFilter filter( paths );
+
+    std::vector<std::string> from_dom, from_stream;
+    size_t allocs = g_allocs.load();
+    StopWatch dom_watch;
+    for ( size_t i = 0; i < REPLAYS; ++i ) {
+        const PDataList game( LSL::TDF::ParseTDF( scripts[i] )->Find( "GAME" ) );
+        from_dom.push_back( game->GetString( "MapName" ) + "|" + game->GetString( "GameType" ) + "|" + game->GetString( "MapHash" ) );
+    }
+    const double dom_ns = dom_watch.ElapsedNs();
+    const size_t dom_allocs = g_allocs.load() - allocs;
+
+    allocs = g_allocs.load();
+    StopWatch paths_watch;
+    for ( size_t i = 0; i < REPLAYS; ++i ) {
+        StringMap values( LSL::TDF::ReadPaths( scripts[i], paths ) );
+        from_stream.push_back( values["game/mapname"] + "|" + values["game/gametype"] + "|" + values["game/maphash"] );
+    }
+    const double paths_ns = paths_watch.ElapsedNs();
+    const size_t paths_allocs = g_allocs.load() - allocs;
+    if ( from_dom != from_stream )
+        throw TestFailedException( "ReadPaths disagrees with the DOM" );
+
+    allocs = g_allocs.load();
+    HeaderHandler header;
+    StopWatch stream_watch;
+    for ( size_t i = 0; i < REPLAYS; ++i )
+        LSL::TDF::ReadTDF( scripts[i], header, filter );
+    const double stream_ns = stream_watch.ElapsedNs();
+    const size_t stream_allocs = g_allocs.load() - allocs;
+    if ( header.entries != 3 * REPLAYS )
+        throw TestFailedException( "the filter passed on the wrong entries" );
+    // the hash is at the end of GAME, without it reading stops right at the top
+    const LSL::TDF::PathFilter top( StringVector( paths.begin(), paths.begin() + 2 ) );
+    StopWatch top_watch;
+    for ( size_t i = 0; i < REPLAYS; ++i )
+        LSL::TDF::ReadTDF( scripts[i], header, top );
+    const double top_ns = top_watch.ElapsedNs();
+    if ( header.entries != 5 * REPLAYS )
+        throw TestFailedException( "the filter passed on the wrong entries" );
+
+    std::cout << REPLAYS << " replay headers, " << total / 1024 << " KiB: DOM " << dom_ns / 1e6 << " ms, " << dom_allocs / REPLAYS
+              << " allocations each; ReadPaths " << paths_ns / 1e6 << " ms, " << paths_allocs / REPLAYS << " allocations each; ReadTDF "
+              << stream_ns / 1e6 << " ms, " << stream_allocs / REPLAYS << " allocations each; map and game only " << top_ns / 1e6
+              << " ms" << std::endl;
+}
+
+//! the names of all players, the filter has to look at the whole GAME section for those
+void Players( size_t players )
+{
+    const std::string text = MakeScript( players );
+    StringVector paths( 1, "game/player*/name" );
+    StringMap from_dom, from_stream;
+    const double dom_ns = MeasureNs( [&]() {
+        from_dom.clear();
+        const PDataList game( LSL::TDF::ParseTDF( text )->Find( "game" ) );
+        for ( PNode node = game->First(); node.ok() && node != game->End(); node = game->Next( node ) ) {
+            const PDataList player( node );
+            if ( player.ok() && node->Name().compare( 0, 6, "PLAYER" ) == 0 )
+                from_dom["game/" + LSL::Util::ToString( node->Name() ) + "/name"] = player->GetString( "name" );
+        }
+    }, 10 );
+    const double stream_ns = MeasureNs( [&]() { from_stream = LSL::TDF::ReadPaths( text, paths ); }, 10 );
+    if ( from_dom.size() != players || from_stream.size() != players )
+        throw TestFailedException( "players went missing" );
+    for ( StringMap::const_iterator it = from_dom.begin(); it != from_dom.end(); ++it )
+        if ( from_stream["game/player" + it->first.substr( 11 )] != it->second )
+            throw TestFailedException( "different name for " + it->first );
+
+    // memory grows with the depth of sections only: as many allocations for all players as for one
+    HeaderHandler handler;
+    const LSL::TDF::PathFilter filter( paths );
+    const std::string one( "[game]{[player0]{name=x;}}" );
+    size_t allocs = g_allocs.load();
+    LSL::TDF::ReadTDF( text, handler, filter );
+    const size_t stream_allocs = g_allocs.load() - allocs;
+    allocs = g_allocs.load();
+    LSL::TDF::ReadTDF( one, handler, filter );
+    if ( g_allocs.load() - allocs != stream_allocs )
+        throw TestFailedException( "ReadTDF allocates per entry" );
+
+    std::cout << players << " players, " << text.size() / 1024 << " KiB, all names: DOM " << dom_ns / 1e3 << " us; ReadPaths "
+              << stream_ns / 1e3 << " us, ReadTDF allocates " << stream_allocs << " times" << std::endl;
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 4242 );
+    Replays();
+    for ( size_t p = 0; p < sizeof( PLAYER_COUNTS ) / sizeof( PLAYER_COUNTS[0] ); ++p )
+        Players( PLAYER_COUNTS[p] );
+
+    // without a filter it reads what the DOM holds, with the same errors
+    const std::string sources[] = { MakeScript( 4 ), "[a\\]b]{x=1;[c]{y=2;}}", "[GAME]{a=1", "[GAME]{a", "a=1;}}[x]{b=2;}",
+                                    "=;;=", "[a]x{b=1;}", "[a]{[b]{c=1;}" };
+    for ( size_t i = 0; i < sizeof( sources ) / sizeof( sources[0] ); ++i ) {
+        int errors = 0;
+        std::string dom;
+        Dump( LSL::TDF::ParseTDF( sources[i], &errors ), dom );
+        DumpHandler handler;
+        if ( LSL::TDF::ReadTDF( sources[i], handler ) != errors || handler.out != dom )
+            throw TestFailedException( "ReadTDF disagrees with ParseTDF on " + sources[i] );
+    }
+
+    // a handler stopping in the middle of a section hears nothing more, the errors so far are counted
+    const std::string stop_source = "[game]{a=1;[p]{x=1;}} [game]{=;b=2;stop=3;c=4;[q]{y=2;}}";
+    int dom_errors = 0;
+    LSL::TDF::ParseTDF( stop_source, &dom_errors );
+    StopHandler stopping( "STOP" );
+    const int stop_errors = LSL::TDF::ReadTDF( stop_source, stopping );
+    if ( dom_errors == 0 || stop_errors != dom_errors || !stopping.stopped || stopping.late
+         || stopping.out != "[game]{a=1;[p]{x=1;}}[game]{b=2;stop=3;" )
+        throw TestFailedException( "ReadTDF went on after the handler stopped: " + stopping.out );
+
+    // the first GAME section is the one DataList keeps, reading stops before what follows
+    int errors = 0;
+    StringVector paths;
+    paths.push_back( "GAME/MapName" );
+    paths.push_back( "game/*/name" );
+    const StringMap values( LSL::TDF::ReadPaths( "[game]{mapname=a;mapname=b;[p]{NAME=c;}} [game]{mapname=d;} broken{", paths, &errors ) );
+    if ( errors != 0 || values.size() != 2 || values.find( "game/mapname" )->second != "a" || values.find( "game/p/name" )->second != "c" )
+        throw TestFailedException( "reading doesn't stop with the first GAME section" );
+
+    // more paths than a filter holds are refused, not dropped
+    StringVector too_many;
+    for ( size_t i = 0; i <= LSL::TDF::PathFilter::MAX_PATHS; ++i )
+        too_many.push_back( "game/option" + LSL::Util::ToString( i ) );
+    bool refused = false;
+    try {
+        LSL::TDF::ReadPaths( "[game]{option64=1;}", too_many );
+    } catch ( std::length_error& ) {
+        refused = true;
+    }
+    if ( !refused )
+        throw TestFailedException( "ReadPaths dropped paths past PathFilter::MAX_PATHS" );
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/
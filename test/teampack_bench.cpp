@@ -0,0 +1,193 @@
+#include <lslutils/balance.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#include "bench.h"
+
+namespace {
+
+const size_t PLAYER_COUNTS[] = { 128, 256 };
+//! players per control team in the shared team lobbies
+const size_t TEAM_SIZES[] = { 2, 4 };
+const size_t REPEATS = 20;
+
+//! a lobby as FixTeamIDs sees it: team, balance rank and balance group of every player
+struct Lobby
+{
+    std::vector<int> teams;
+    std::vector<float> ranks;
+    std::vector<size_t> groups;
+};
+
+//! everybody picked a team id of their own liking, so there are gaps and duplicates
+Lobby RandomLobby( size_t players, size_t clan_size )
+{
+    Lobby lobby;
+    for ( size_t i = 0; i < players; ++i ) {
+        lobby.teams.push_back( rand() % int( players + players / 2 ) );
+        lobby.ranks.push_back( 1.0f + 0.1f * float( rand() % 8 ) / 7.0f );
+        // every eighth player is in a clan with the next clan_size - 1 ones
+        lobby.groups.push_back( ( clan_size > 1 && i % 8 < clan_size ) ? i - i % 8 : i );
+    }
+    return lobby;
+}
+
+/** Battle::FixTeamIDs before: re-sort all control teams for every player placed, then force
+ * team and ally of everybody. Returns the number of commands it sent */
+size_t OldFixTeamIDs( const Lobby& lobby, size_t teams, std::vector<int>& result )
+{
+    const size_t players = lobby.teams.size();
+    result = lobby.teams;
+    if ( teams >= players ) {
+        std::set<int> allteams( lobby.teams.begin(), lobby.teams.end() );
+        std::set<int> taken;
+        size_t commands = 0;
+        int t = 0;
+        for ( size_t i = 0; i < players; ++i ) {
+            if ( taken.count( lobby.teams[i] ) ) {
+                while ( allteams.count( t ) || taken.count( t ) )
+                    t++;
+                result[i] = t;
+                ++commands;
+            }
+            taken.insert( result[i] );
+        }
+        return commands;
+    }
+    struct ControlTeam
+    {
+        float ranksum;
+        int teamnum;
+        bool operator < ( const ControlTeam& other ) const { return ranksum < other.ranksum; }
+    };
+    std::vector<ControlTeam> control_teams( teams );
+    for ( size_t t = 0; t < teams; ++t ) {
+        control_teams[t].ranksum = 0;
+        control_teams[t].teamnum = int( t );
+    }
+    std::vector<size_t> order( players );
+    for ( size_t i = 0; i < players; ++i )
+        order[i] = i;
+    std::sort( order.begin(), order.end(), [&lobby]( size_t a, size_t b ) { return lobby.ranks[a] > lobby.ranks[b]; } );
+    for ( size_t i = 0; i < players; ++i ) {
+        std::sort( control_teams.begin(), control_teams.end() );
+        result[order[i]] = control_teams[0].teamnum;
+        control_teams[0].ranksum += lobby.ranks[order[i]];
+    }
+    return 2 * players;
+}
+
+//! commands the new FixTeamIDs sends: a team change, and for shared teams an alliance change
+size_t CountCommands( const std::vector<int>& before, const std::vector<int>& after, bool comshare )
+{
+    size_t commands = 0;
+    for ( size_t i = 0; i < before.size(); ++i )
+        if ( before[i] != after[i] )
+            commands += comshare ? 2 : 1;
+    return commands;
+}
+
+void CheckTeams( const Lobby& lobby, const std::vector<int>& teams, size_t count )
+{
+    std::vector<size_t> members( count, 0 );
+    for ( size_t i = 0; i < teams.size(); ++i ) {
+        if ( teams[i] < 0 || size_t( teams[i] ) >= count )
+            throw TestFailedException( "team id out of range" );
+        members[teams[i]]++;
+        for ( size_t j = 0; j < i; ++j )
+            if ( lobby.groups[i] == lobby.groups[j] && teams[i] != teams[j] )
+                throw TestFailedException( "clan got split up" );
+    }
+    if ( count >= teams.size() && *std::max_element( members.begin(), members.end() ) > 1 )
+        throw TestFailedException( "two players share a team although there are enough" );
+}
+
+void Run( const char* name, const Lobby& lobby, size_t teams )
+{
+    using namespace LSL::Util;
+    const size_t players = lobby.teams.size();
+    const bool comshare = teams < players;
+    std::vector<int> old_result, new_result;
+    size_t old_commands = 0;
+    const double old_ns = MeasureNs( [&]() { old_commands = OldFixTeamIDs( lobby, teams, old_result ); }, REPEATS );
+    const double new_ns = MeasureNs( [&]() {
+        new_result = PackControlTeams( lobby.teams, lobby.ranks, lobby.groups, teams, PARTITION_GREEDY );
+    }, REPEATS );
+    CheckTeams( lobby, new_result, teams );
+    std::cout << players << " players " << name << " in " << teams << " teams: old " << old_ns / 1e3 << " us, "
+              << old_commands << " commands; packed " << new_ns / 1e3 << " us, "
+              << CountCommands( lobby.teams, new_result, comshare ) << " commands" << std::endl;
+
+    // fixing again changes nobody
+    if ( PackControlTeams( new_result, lobby.ranks, lobby.groups, teams, PARTITION_GREEDY ) != new_result )
+        throw TestFailedException( "fixing fixed teams moved players" );
+}
+
+//! with a team for everybody only players sharing an id or outside the range move
+void CheckFreeForAll()
+{
+    using namespace LSL::Util;
+    const std::vector<float> ranks( 4, 1.0f );
+    std::vector<size_t> groups( 4 );
+    for ( size_t i = 0; i < groups.size(); ++i )
+        groups[i] = i;
+    const int spread[] = { 7, 0, 9, 3 };
+    const std::vector<int> apart( spread, spread + 4 );
+    if ( PackControlTeams( apart, ranks, groups, 10, PARTITION_GREEDY ) != apart )
+        throw TestFailedException( "players alone on a valid team id were moved" );
+    const int clashing[] = { 5, 5, 12, -1 };
+    const int fixed[] = { 5, 0, 1, 2 };
+    if ( PackControlTeams( std::vector<int>( clashing, clashing + 4 ), ranks, groups, 10, PARTITION_GREEDY )
+         != std::vector<int>( fixed, fixed + 4 ) )
+        throw TestFailedException( "duplicate or out of range team ids weren't given the lowest free ones" );
+}
+
+} // namespace
+
+int main( int, char** )
+{
+    srand( 4242 );
+    CheckFreeForAll();
+    for ( size_t p = 0; p < sizeof( PLAYER_COUNTS ) / sizeof( PLAYER_COUNTS[0] ); ++p ) {
+        const size_t players = PLAYER_COUNTS[p];
+        // plain FFA: a team each
+        Run( "FFA", RandomLobby( players, 1 ), players );
+        // team FFA: a few players share each control team, with and without clans
+        for ( size_t s = 0; s < sizeof( TEAM_SIZES ) / sizeof( TEAM_SIZES[0] ); ++s ) {
+            Run( "team FFA", RandomLobby( players, 1 ), players / TEAM_SIZES[s] );
+            Run( "team FFA with clans", RandomLobby( players, TEAM_SIZES[s] ), players / TEAM_SIZES[s] );
+        }
+    }
+    return 0;
+}
+
+/**
+Copyright 2012 by The libSpringLobby team. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are
+permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this list of
+      conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copyright notice, this list
+      of conditions and the following disclaimer in the documentation and/or other materials
+      provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**/